@@ -0,0 +1,248 @@
+#include <google/protobuf/arena.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "addressbook.pb.h"
+#include "book/blocked.hpp"
+#include "book/person_view.hpp"
+#include "book/stream.hpp"
+#include "book/synthetic.hpp"
+
+/*
+ * Serialize and parse throughput of a synthetic book (see
+ * book/synthetic.hpp) in each format and through each read path, printed as
+ * one JSON document (stdout) for tracking regressions:
+ *
+ *   {"people": N, "seed": S,
+ *    "results": [{"name": ..., "ms": ..., "records_per_sec": ...,
+ *                 "mb_per_sec": ..., "peak_rss_kb": ...}, ...],
+ *    "formats": {"legacy": {"bytes": ..., "bytes_per_record": ...}, ...}}
+ *
+ * Every case runs in a child process of its own, so peak_rss_kb is the peak
+ * of that case alone. The serialize_* cases generate the people before the
+ * clock starts (and count them in the RSS); they write the books the parse_*
+ * cases read. mb_per_sec is of the book written or read, and the parse_*
+ * times include freeing what was parsed.
+ */
+
+namespace {
+
+constexpr long kDefaultPeople = 1000 * 1000;
+
+using google::protobuf::Arena;
+
+struct Result {
+  bool ok;
+  double ms;
+  uint64_t records;
+};
+
+int nresults;
+
+double msSince(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int64_t fileSize(const std::string& path) {
+  struct stat st {};
+  return stat(path.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+// Run a case in a child, which times run(records) after setup()
+bool runCase(const char* name, const std::string& book, const std::function<void()>& setup,
+             const std::function<bool(uint64_t*)>& run) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    perror("pipe");
+    return false;
+  }
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    setup();
+    Result r{};
+    auto t0 = std::chrono::steady_clock::now();
+    r.ok = run(&r.records);
+    r.ms = msSince(t0);
+    _exit(write(fds[1], &r, sizeof(r)) == sizeof(r) ? 0 : 1);
+  }
+  close(fds[1]);
+  Result r{};
+  bool ok = pid > 0 && read(fds[0], &r, sizeof(r)) == sizeof(r) && r.ok;
+  close(fds[0]);
+  int status;
+  struct rusage ru {};
+  ok = pid > 0 && wait4(pid, &status, 0, &ru) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 && ok;
+  if (!ok) {
+    fprintf(stderr, "\n%s failed\n", name);
+    return false;
+  }
+  double mb = book.empty() ? 0 : fileSize(book) / 1e6;
+  printf("%s\n    {\"name\": \"%s\", \"ms\": %.1f, \"records_per_sec\": %.0f, \"mb_per_sec\": %.1f, "
+         "\"peak_rss_kb\": %ld}",
+         nresults++ ? "," : "", name, r.ms, r.ms > 0 ? r.records * 1e3 / r.ms : 0.0, r.ms > 0 ? mb * 1e3 / r.ms : 0.0,
+         ru.ru_maxrss);
+  fflush(stdout);
+  return true;
+}
+
+// Read a stream or blocked book one person at a time
+bool readStream(const std::string& path, book::Input input, uint64_t* records) {
+  book::Reader reader;
+  tutorial::Person person;
+  bool ok = reader.open(path, input);
+  while (ok && reader.next(&person)) {
+    (*records)++;
+  }
+  return ok && reader.error().empty();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+  long people = argc > 1 ? strtol(argv[1], nullptr, 0) : kDefaultPeople;
+  book::SyntheticOptions options;
+  options.seed = argc > 2 ? strtoul(argv[2], nullptr, 0) : 0;
+  if (people <= 0 || argc > 3) {
+    fprintf(stderr, "Usage: %s [PEOPLE] [SEED]\n", argv[0]);
+    return -1;
+  }
+
+  char dir[] = "/tmp/bench_book.XXXXXX";
+  if (!mkdtemp(dir)) {
+    perror("mkdtemp");
+    return -1;
+  }
+  const std::string legacy = std::string(dir) + "/legacy.book";
+  const std::string stream = std::string(dir) + "/stream.book";
+  const std::string blocked = std::string(dir) + "/blocked.book";
+
+  // People generated in the child before the clock starts
+  tutorial::AddressBook address_book;
+  auto generate = [&]() {
+    for (long i = 0; i < people; i++) {
+      book::syntheticPerson(i, options, address_book.add_people());
+    }
+  };
+  auto none = []() {};
+
+  printf("{\"people\": %ld, \"seed\": %llu,\n  \"results\": [", people,
+         static_cast<unsigned long long>(options.seed));
+  bool ok =
+      runCase("generate", "", none,
+              [&](uint64_t* records) {
+                tutorial::Person person;
+                for (long i = 0; i < people; i++) {
+                  book::syntheticPerson(i, options, &person);
+                  (*records)++;
+                }
+                return true;
+              }) &&
+      runCase("serialize_legacy_fstream", legacy, generate,
+              [&](uint64_t* records) {
+                std::ofstream out(legacy, std::ios::out | std::ios::trunc | std::ios::binary);
+                *records = address_book.people_size();
+                return address_book.SerializeToOstream(&out) && out.flush();
+              }) &&
+      runCase("serialize_stream", stream, generate,
+              [&](uint64_t* records) {
+                book::Writer writer;
+                bool ok = writer.open(stream, true);
+                for (const auto& person : address_book.people()) {
+                  ok = ok && writer.append(person);
+                  (*records)++;
+                }
+                return writer.close() && ok;
+              }) &&
+      runCase("serialize_blocked", blocked, generate,
+              [&](uint64_t* records) {
+                book::BlockedWriter writer;
+                bool ok = writer.open(blocked);
+                for (const auto& person : address_book.people()) {
+                  ok = ok && writer.append(person);
+                  (*records)++;
+                }
+                return writer.close() && ok;
+              }) &&
+      runCase("parse_legacy_fstream", legacy, none,
+              [&](uint64_t* records) {
+                std::ifstream in(legacy, std::ios::in | std::ios::binary);
+                tutorial::AddressBook parsed;
+                bool ok = parsed.ParseFromIstream(&in);
+                *records = parsed.people_size();
+                return ok;
+              }) &&
+      runCase("parse_legacy_arena", legacy, none,
+              [&](uint64_t* records) {
+                std::ifstream in(legacy, std::ios::in | std::ios::binary);
+                Arena arena;
+                auto* parsed = Arena::CreateMessage<tutorial::AddressBook>(&arena);
+                bool ok = parsed->ParseFromIstream(&in);
+                *records = parsed->people_size();
+                return ok;
+              }) &&
+      runCase("parse_stream_fstream", stream, none,
+              [&](uint64_t* records) { return readStream(stream, book::Input::kFstream, records); }) &&
+      runCase("parse_stream_fd", stream, none,
+              [&](uint64_t* records) { return readStream(stream, book::Input::kFd, records); }) &&
+      runCase("parse_stream_mmap", stream, none,
+              [&](uint64_t* records) { return readStream(stream, book::Input::kMmap, records); }) &&
+      runCase("parse_stream_arena", stream, none,
+              [&](uint64_t* records) {
+                // The whole book on an Arena, as list_people --whole --arena
+                Arena arena;
+                auto* parsed = Arena::CreateMessage<tutorial::AddressBook>(&arena);
+                book::Reader reader;
+                bool ok = reader.open(stream);
+                while (ok && reader.next(parsed->add_people())) {
+                }
+                parsed->mutable_people()->RemoveLast();
+                *records = parsed->people_size();
+                return ok && reader.error().empty();
+              }) &&
+      runCase("parse_stream_view", stream, none,
+              [&](uint64_t* records) {
+                // Wire-level decoding, no Person (see book/person_view.hpp)
+                book::Reader reader;
+                book::PersonView view;
+                std::string_view record;
+                bool ok = reader.open(stream);
+                while (ok && reader.nextRaw(&record)) {
+                  ok = book::decodePerson(record, book::kFieldAll, &view);
+                  (*records)++;
+                }
+                return ok && reader.error().empty();
+              }) &&
+      runCase("parse_blocked", blocked, none,
+              [&](uint64_t* records) { return readStream(blocked, book::Input::kMmap, records); });
+  printf("\n  ],\n  \"formats\": {");
+  const char* sep = "";
+  for (const auto& f : {std::make_pair("legacy", legacy), std::make_pair("stream", stream),
+                        std::make_pair("blocked", blocked)}) {
+    int64_t bytes = fileSize(f.second);
+    printf("%s\n    \"%s\": {\"bytes\": %lld, \"bytes_per_record\": %.1f}", sep, f.first,
+           static_cast<long long>(bytes), static_cast<double>(bytes) / people);
+    sep = ",";
+  }
+  printf("\n  }}\n");
+
+  for (const auto& path : {legacy, stream, blocked}) {
+    unlink(path.c_str());
+  }
+  rmdir(dir);
+  google::protobuf::ShutdownProtobufLibrary();
+  return ok ? 0 : -1;
+}
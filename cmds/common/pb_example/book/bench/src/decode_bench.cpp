@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "addressbook.pb.h"
+#include "book/person_ref.hpp"
+#include "book/person_view.hpp"
+#include "book/synthetic.hpp"
+
+/*
+ * Decode throughput of serialized people held in memory, printed as one
+ * JSON document (stdout). The records are back to back in one buffer, as in
+ * a book:
+ *
+ *   {"people": N, "bytes": ...,
+ *    "results": [{"name": ..., "ms": ..., "ns_per_record": ...,
+ *                 "records_per_sec": ..., "mb_per_sec": ...}, ...]}
+ *
+ * parse_from_array is the generated Person::ParseFromArray() into a reused
+ * Person, decode_person_view is book::decodePerson() of all fields and the
+ * decode_person_ref cases are book::decodePersonRef(), without and with
+ * iterating the phones. Every case reads each field it decoded, and the
+ * best of kRuns runs is reported.
+ */
+
+namespace {
+
+constexpr long kDefaultPeople = 500 * 1000;
+constexpr int kRuns = 3;
+
+int nresults;
+
+// Keeps the reads of the decoded fields from being optimized out
+volatile uint64_t sink;
+
+template <typename F>
+void run(const char* name, const std::vector<std::string_view>& records, uint64_t bytes, F&& decode) {
+  double best = 0;
+  for (int i = 0; i < kRuns; i++) {
+    uint64_t sum = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (const auto& record : records) {
+      sum += decode(record);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    best = i == 0 ? ms : std::min(best, ms);
+    sink = sum;
+  }
+  printf("%s\n    {\"name\": \"%s\", \"ms\": %.1f, \"ns_per_record\": %.1f, \"records_per_sec\": %.0f, "
+         "\"mb_per_sec\": %.1f}",
+         nresults++ ? "," : "", name, best, best * 1e6 / records.size(), records.size() * 1e3 / best,
+         bytes / 1e3 / best);
+  fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+  long npeople = argc > 1 ? strtol(argv[1], nullptr, 0) : kDefaultPeople;
+  if (npeople <= 0) {
+    fprintf(stderr, "Usage: %s [PEOPLE]\n", argv[0]);
+    return -1;
+  }
+
+  // Back to back, as in a book
+  std::string book;
+  std::vector<size_t> ends;
+  tutorial::Person person;
+  for (long i = 0; i < npeople; i++) {
+    book::syntheticPerson(i, &person);
+    book += person.SerializeAsString();
+    ends.push_back(book.size());
+  }
+  std::vector<std::string_view> records;
+  for (size_t i = 0; i < ends.size(); i++) {
+    size_t begin = i ? ends[i - 1] : 0;
+    records.push_back(std::string_view(book).substr(begin, ends[i] - begin));
+  }
+  uint64_t bytes = book.size();
+
+  printf("{\"people\": %ld, \"bytes\": %llu,\n  \"results\": [", npeople, static_cast<unsigned long long>(bytes));
+  bool ok = true;
+  run("parse_from_array", records, bytes, [&](std::string_view record) {
+    ok = person.ParseFromArray(record.data(), static_cast<int>(record.size())) && ok;
+    uint64_t sum = person.id() + person.name().size() + person.email().size() + person.last_updated().seconds();
+    for (const auto& phone : person.phones()) {
+      sum += phone.number().size() + phone.type();
+    }
+    return sum;
+  });
+  book::PersonView view;
+  run("decode_person_view", records, bytes, [&](std::string_view record) {
+    ok = book::decodePerson(record, book::kFieldAll, &view) && ok;
+    uint64_t sum = view.id + view.name.size() + view.email.size() + view.updated_seconds;
+    for (const auto& phone : view.phones) {
+      sum += phone.number.size() + phone.type;
+    }
+    return sum;
+  });
+  book::PersonRef ref;
+  run("decode_person_ref", records, bytes, [&](std::string_view record) {
+    ok = book::decodePersonRef(record, &ref) && ok;
+    return ref.id + ref.name.size() + ref.email.size() + ref.updated_seconds + ref.phones_size;
+  });
+  book::PhoneView phone;
+  run("decode_person_ref_phones", records, bytes, [&](std::string_view record) {
+    ok = book::decodePersonRef(record, &ref) && ok;
+    uint64_t sum = ref.id + ref.name.size() + ref.email.size() + ref.updated_seconds;
+    for (book::PhoneCursor phones = ref.phones; phones.next(&phone);) {
+      sum += phone.number.size() + phone.type;
+    }
+    return sum;
+  });
+  printf("\n  ]}\n");
+
+  google::protobuf::ShutdownProtobufLibrary();
+  if (!ok) {
+    fprintf(stderr, "decoding failed\n");
+    return -1;
+  }
+  return 0;
+}
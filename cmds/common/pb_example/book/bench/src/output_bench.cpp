@@ -0,0 +1,169 @@
+#include <fcntl.h>
+#include <google/protobuf/util/time_util.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "addressbook.pb.h"
+#include "book/output.hpp"
+#include "book/print.hpp"
+#include "book/synthetic.hpp"
+
+/*
+ * Output throughput of listing people, printed as one JSON document
+ * (stderr, as stdout is what's benchmarked):
+ *
+ *   {"people": N,
+ *    "results": [{"name": ..., "target": "file"|"null", "ms": ...,
+ *                 "bytes": ..., "lines": ..., "lines_per_sec": ...,
+ *                 "people_per_sec": ...}, ...]}
+ *
+ * endl is the protobuf tutorial's list_people (std::endl after every
+ * line), cout is book::printPerson() to std::cout, and the others are
+ * book::OutputWriter in each format. The people are generated up front, so
+ * only formatting and writing is timed. The file is a temporary one, so
+ * writes go to the page cache.
+ */
+
+namespace {
+
+constexpr long kDefaultPeople = 500 * 1000;
+
+enum Mode { kEndl, kCout, kWriter };
+
+int nresults;
+
+// list_people of the protobuf tutorial
+void tutorialPrint(const tutorial::Person& person) {
+  std::cout << "Person ID: " << person.id() << std::endl;
+  std::cout << "  Name: " << person.name() << std::endl;
+  if (person.email() != "") {
+    std::cout << "  E-mail address: " << person.email() << std::endl;
+  }
+  for (const auto& phone : person.phones()) {
+    switch (phone.type()) {
+      case tutorial::Person::MOBILE:
+        std::cout << "  Mobile phone #: ";
+        break;
+      case tutorial::Person::HOME:
+        std::cout << "  Home phone #: ";
+        break;
+      case tutorial::Person::WORK:
+        std::cout << "  Work phone #: ";
+        break;
+      default:
+        std::cout << "  Unknown phone #: ";
+        break;
+    }
+    std::cout << phone.number() << std::endl;
+  }
+  if (person.has_last_updated()) {
+    std::cout << "  Updated: " << google::protobuf::util::TimeUtil::ToString(person.last_updated()) << std::endl;
+  }
+}
+
+// Lines and bytes of the output of a format
+void measure(const std::vector<tutorial::Person>& people, book::OutputFormat format, uint64_t* lines,
+             uint64_t* bytes) {
+  book::Formatter formatter(format);
+  std::string out;
+  formatter.begin(&out);
+  for (const auto& p : people) {
+    formatter.append(p, &out);
+  }
+  formatter.end(&out);
+  *lines = format == book::OutputFormat::kColumnar ? 0 : std::count(out.begin(), out.end(), '\n');
+  *bytes = out.size();
+}
+
+// List people to stdout, redirected to fd
+double run(const std::vector<tutorial::Person>& people, Mode mode, book::OutputFormat format, int fd) {
+  fflush(stdout);
+  int saved = dup(STDOUT_FILENO);
+  dup2(fd, STDOUT_FILENO);
+  auto t0 = std::chrono::steady_clock::now();
+  if (mode == kWriter) {
+    book::OutputWriter out(STDOUT_FILENO, format);
+    for (const auto& p : people) {
+      out.write(p);
+    }
+    out.close();
+  } else {
+    for (const auto& p : people) {
+      if (mode == kEndl) {
+        tutorialPrint(p);
+      } else {
+        book::printPerson(std::cout, p);
+      }
+    }
+    std::cout.flush();
+  }
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+  return ms;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  long npeople = argc > 1 ? strtol(argv[1], nullptr, 0) : kDefaultPeople;
+  if (npeople <= 0) {
+    fprintf(stderr, "Usage: %s [PEOPLE]\n", argv[0]);
+    return -1;
+  }
+
+  std::vector<tutorial::Person> people(npeople);
+  for (long i = 0; i < npeople; i++) {
+    book::syntheticPerson(i, &people[i]);
+  }
+  char path[] = "/tmp/book_output_bench.XXXXXX";
+  int file = mkstemp(path);
+  int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+  if (file < 0 || null < 0) {
+    perror("open");
+    return -1;
+  }
+  unlink(path);
+
+  static const struct {
+    const char* name;
+    Mode mode;
+    book::OutputFormat format;
+  } runs[] = {{"endl", kEndl, book::OutputFormat::kText},
+              {"cout", kCout, book::OutputFormat::kText},
+              {"text", kWriter, book::OutputFormat::kText},
+              {"csv", kWriter, book::OutputFormat::kCsv},
+              {"ndjson", kWriter, book::OutputFormat::kNdjson},
+              {"columnar", kWriter, book::OutputFormat::kColumnar}};
+  fprintf(stderr, "{\"people\": %ld,\n  \"results\": [", npeople);
+  for (const auto& r : runs) {
+    uint64_t lines, bytes;
+    measure(people, r.format, &lines, &bytes);
+    for (int target : {file, null}) {
+      if (ftruncate(file, 0) != 0 || lseek(file, 0, SEEK_SET) != 0) {
+        perror("ftruncate");
+        return -1;
+      }
+      double ms = run(people, r.mode, r.format, target);
+      fprintf(stderr,
+              "%s\n    {\"name\": \"%s\", \"target\": \"%s\", \"ms\": %.1f, \"bytes\": %llu, \"lines\": %llu, "
+              "\"lines_per_sec\": %.0f, \"people_per_sec\": %.0f}",
+              nresults++ ? "," : "", r.name, target == file ? "file" : "null", ms,
+              static_cast<unsigned long long>(bytes), static_cast<unsigned long long>(lines), lines * 1e3 / ms,
+              npeople * 1e3 / ms);
+    }
+  }
+  fprintf(stderr, "\n  ]}\n");
+
+  close(file);
+  close(null);
+  google::protobuf::ShutdownProtobufLibrary();
+  return 0;
+}
@@ -0,0 +1,131 @@
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "addressbook.pb.h"
+#include "book/output.hpp"
+#include "book/parallel.hpp"
+#include "book/stream.hpp"
+#include "book/synthetic.hpp"
+#include "cutils/tpool.hpp"
+
+/*
+ * Decode throughput of a synthetic stream book against the number of
+ * threads, printed as one JSON document (stdout):
+ *
+ *   {"people": N, "book_bytes": B, "chunk_bytes": C, "chunks": n,
+ *    "results": [{"name": ..., "threads": ..., "ms": ...,
+ *                 "records_per_sec": ...}, ...]}
+ *
+ * sequential_decode is one Reader over the whole book (what list_people
+ * does without --threads). parallel_decode only decodes the chunks;
+ * parallel_print also formats every person into the output of its chunk.
+ */
+
+namespace {
+
+constexpr long kDefaultPeople = 1000 * 1000;
+constexpr long kDefaultChunkKb = 1024;
+
+int nresults;
+
+double msSince(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+void report(const char* name, long threads, uint64_t records, double ms) {
+  printf("%s\n    {\"name\": \"%s\", \"threads\": %ld, \"ms\": %.1f, \"records_per_sec\": %.0f}",
+         nresults++ ? "," : "", name, threads, ms, ms > 0 ? records * 1e3 / ms : 0.0);
+  fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  long people = argc > 1 ? strtol(argv[1], nullptr, 0) : kDefaultPeople;
+  long max_threads = argc > 2 ? strtol(argv[2], nullptr, 0) : sysconf(_SC_NPROCESSORS_ONLN);
+  long chunk_kb = argc > 3 ? strtol(argv[3], nullptr, 0) : kDefaultChunkKb;
+  if (people <= 0 || max_threads <= 0 || chunk_kb <= 0) {
+    fprintf(stderr, "Usage: %s [PEOPLE] [MAX_THREADS] [CHUNK_KB]\n", argv[0]);
+    return -1;
+  }
+
+  char path[] = "/tmp/book_parallel_bench.XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return -1;
+  }
+  close(fd);
+  book::Writer writer;
+  tutorial::Person person;
+  bool ok = writer.open(path, true);
+  for (long i = 0; ok && i < people; i++) {
+    book::syntheticPerson(i, &person);
+    ok = writer.append(person);
+  }
+  int64_t book_bytes = writer.offset();
+  if (!writer.close() || !ok) {
+    fprintf(stderr, "%s: %s\n", path, writer.error().c_str());
+    unlink(path);
+    return -1;
+  }
+
+  std::vector<book::Chunk> chunks;
+  std::string error;
+  auto t0 = std::chrono::steady_clock::now();
+  if (!book::splitBook(path, chunk_kb << 10, &chunks, &error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    unlink(path);
+    return -1;
+  }
+  double split_ms = msSince(t0);
+
+  printf("{\"people\": %ld, \"book_bytes\": %lld, \"chunk_bytes\": %ld, \"chunks\": %zu, \"split_ms\": %.1f,"
+         "\n  \"results\": [",
+         people, static_cast<long long>(book_bytes), chunk_kb << 10, chunks.size(), split_ms);
+
+  book::Reader reader;
+  uint64_t count = 0;
+  t0 = std::chrono::steady_clock::now();
+  reader.open(path);
+  while (reader.next(&person)) {
+    count++;
+  }
+  report("sequential_decode", 1, count, msSince(t0));
+
+  auto nop = [](const tutorial::Person&, std::string*) {};
+  auto print = [](const tutorial::Person& p, std::string* s) {
+    thread_local book::Formatter formatter(book::OutputFormat::kText);
+    formatter.append(p, s);
+  };
+  auto emit = [](const std::string&) {};
+  // 1, 2, 4, ... and max_threads threads
+  for (long n = 1;; n = n * 2 > max_threads ? max_threads : n * 2) {
+    cutils::ThreadPool pool(n);
+    for (auto mode : {0, 1}) {
+      t0 = std::chrono::steady_clock::now();
+      ok = book::decodeParallel(pool, chunks, mode ? book::DecodeFn(print) : book::DecodeFn(nop), emit, &count,
+                                &error);
+      double ms = msSince(t0);
+      if (!ok || count != static_cast<uint64_t>(people)) {
+        fprintf(stderr, "\n%s\n", error.c_str());
+        unlink(path);
+        return -1;
+      }
+      report(mode ? "parallel_print" : "parallel_decode", n, count, ms);
+    }
+    if (n == max_threads) {
+      break;
+    }
+  }
+  printf("\n  ]}\n");
+
+  unlink(path);
+  google::protobuf::ShutdownProtobufLibrary();
+  return 0;
+}
@@ -0,0 +1,241 @@
+#include <cutils/hist.h>
+#include <getopt.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "addressbook.pb.h"
+#include "query.pb.h"
+
+/*
+ * Load generator of addressbook_server: each of -t threads sends batches of
+ * -b queries over its own connection, one batch at a time, for -d seconds,
+ * and the totals are printed as one JSON document (stdout):
+ *
+ *   {"threads": T, "batch": B, "seconds": ..., "batches": ..., "queries": ...,
+ *    "people": ..., "errors": ..., "qps": ...,
+ *    "latency": {"name":"batch_ns","count":...,"p50":...,"p99":...,...}}
+ *
+ * The latency is of a batch, from sending it to its last byte of response.
+ * Queries are of ids drawn from [0, -n) or, for -p percent of them, of the
+ * name of a person an earlier query returned as a prefix (so any book does).
+ */
+
+namespace {
+
+struct Options {
+  std::string socket;
+  int threads = 1;
+  int batch = 16;
+  double seconds = 5;
+  int32_t max_id = 1000 * 1000;  // ids of the book, as of gen_book
+  int name_percent = 20;
+  uint32_t limit = 0;
+};
+
+struct Totals {
+  uint64_t batches = 0;
+  uint64_t queries = 0;
+  uint64_t people = 0;
+  uint64_t errors = 0;
+  hist_t latency;
+};
+
+void usage(const char* prog) {
+  fprintf(stderr,
+          "Usage: %s -s SOCKET [-t THREADS] [-b BATCH] [-d SECONDS] [-n MAX_ID] [-p NAME_PERCENT] [-l LIMIT]\n",
+          prog);
+}
+
+bool writeAll(int fd, const std::string& buf) {
+  for (size_t pos = 0; pos < buf.size();) {
+    ssize_t n = send(fd, buf.data() + pos, buf.size() - pos, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    pos += n;
+  }
+  return true;
+}
+
+// Names of people returned, for the name queries
+constexpr size_t kNames = 4096;
+
+// One framed ResultBatch (in may hold the start of the next one)
+bool readFrame(int fd, std::string* in, std::string* frame) {
+  for (;;) {
+    google::protobuf::io::CodedInputStream cin(reinterpret_cast<const uint8_t*>(in->data()),
+                                               static_cast<int>(std::min<size_t>(in->size(), INT_MAX)));
+    uint32_t size;
+    if (cin.ReadVarint32(&size) && in->size() - cin.CurrentPosition() >= size) {
+      frame->assign(*in, cin.CurrentPosition(), size);
+      in->erase(0, cin.CurrentPosition() + size);
+      return true;
+    }
+    char buf[64 << 10];
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0) {
+      return false;
+    }
+    in->append(buf, n);
+  }
+}
+
+void client(const Options& options, int seed, const std::atomic<bool>& stop, Totals* totals) {
+  hist_init(&totals->latency);
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  struct sockaddr_un addr {};
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, options.socket.c_str(), sizeof(addr.sun_path) - 1);
+  if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+    perror(options.socket.c_str());
+    totals->errors++;
+    if (fd >= 0) {
+      close(fd);
+    }
+    return;
+  }
+
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int32_t> ids(0, options.max_id - 1);
+  std::uniform_int_distribution<int> percent(0, 99);
+  tutorial::QueryBatch batch;
+  tutorial::ResultBatch results;
+  std::vector<std::string> names;
+  std::string out, in, frame;
+  while (!stop.load(std::memory_order_relaxed)) {
+    batch.Clear();
+    for (int i = 0; i < options.batch; i++) {
+      tutorial::Query* query = batch.add_queries();
+      if (!names.empty() && percent(rng) < options.name_percent) {
+        query->set_name_prefix(names[rng() % names.size()]);
+      } else {
+        query->set_id(ids(rng));
+      }
+      query->set_limit(options.limit);
+    }
+    out.clear();
+    google::protobuf::io::StringOutputStream sout(&out);
+    {
+      google::protobuf::io::CodedOutputStream cout(&sout);
+      cout.WriteVarint32(static_cast<uint32_t>(batch.ByteSizeLong()));
+      batch.SerializeToCodedStream(&cout);
+    }
+
+    uint64_t t0 = gettsc();
+    if (!writeAll(fd, out) || !readFrame(fd, &in, &frame)) {
+      fprintf(stderr, "%s: connection lost\n", options.socket.c_str());
+      totals->errors++;
+      break;
+    }
+    hist_record_since(&totals->latency, t0);
+    if (!results.ParseFromString(frame) || !results.error().empty() || results.results_size() != options.batch) {
+      totals->errors++;
+      continue;
+    }
+    totals->batches++;
+    totals->queries += options.batch;
+    for (const auto& result : results.results()) {
+      totals->people += result.people_size();
+      if (result.people_size() > 0) {
+        const std::string& name = result.people(0).name();
+        if (names.size() < kNames) {
+          names.push_back(name);
+        } else {
+          names[rng() % kNames] = name;
+        }
+      }
+    }
+  }
+  close(fd);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+  Options options;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:t:b:d:n:p:l:")) != -1) {
+    switch (opt) {
+      case 's':
+        options.socket = optarg;
+        break;
+      case 't':
+        options.threads = atoi(optarg);
+        break;
+      case 'b':
+        options.batch = atoi(optarg);
+        break;
+      case 'd':
+        options.seconds = atof(optarg);
+        break;
+      case 'n':
+        options.max_id = atoi(optarg);
+        break;
+      case 'p':
+        options.name_percent = atoi(optarg);
+        break;
+      case 'l':
+        options.limit = static_cast<uint32_t>(atoi(optarg));
+        break;
+      default:
+        usage(argv[0]);
+        return -1;
+    }
+  }
+  if (options.socket.empty() || options.threads <= 0 || options.batch <= 0 || options.seconds <= 0 ||
+      options.max_id <= 0 || options.name_percent < 0 || options.name_percent > 100) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  std::atomic<bool> stop(false);
+  std::vector<Totals> totals(options.threads);
+  std::vector<std::thread> threads;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < options.threads; i++) {
+    threads.emplace_back(client, std::cref(options), i + 1, std::cref(stop), &totals[i]);
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(options.seconds));
+  stop = true;
+  for (auto& t : threads) {
+    t.join();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  Totals all;
+  hist_init(&all.latency);
+  for (const auto& t : totals) {
+    all.batches += t.batches;
+    all.queries += t.queries;
+    all.people += t.people;
+    all.errors += t.errors;
+    hist_merge(&all.latency, &t.latency);
+  }
+  printf("{\"threads\": %d, \"batch\": %d, \"seconds\": %.2f, \"batches\": %llu, \"queries\": %llu, "
+         "\"people\": %llu, \"errors\": %llu, \"qps\": %.0f,\n \"latency\": ",
+         options.threads, options.batch, seconds, static_cast<unsigned long long>(all.batches),
+         static_cast<unsigned long long>(all.queries), static_cast<unsigned long long>(all.people),
+         static_cast<unsigned long long>(all.errors), all.queries / seconds);
+  fflush(stdout);
+  hist_dump(&all.latency, stdout, "batch_ns", HIST_FMT_JSON);
+  printf("}\n");
+
+  google::protobuf::ShutdownProtobufLibrary();
+  return all.errors ? -1 : 0;
+}
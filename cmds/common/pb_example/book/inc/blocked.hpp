@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "addressbook.pb.h"
+#include "book/mapped_file.hpp"
+#include "book/stream.hpp"
+
+namespace book {
+
+/*
+ * Block-compressed address book (Format::kBlocked): the people are cut into
+ * blocks of about block_bytes of kStream records, and each block is
+ * compressed (zlib) and framed like a record:
+ *
+ *   kBlockedMagic
+ *   varint size + compressed block     one per block
+ *   zero padding                       to alignof(BlockInfo)
+ *   BlockInfo blocks[nblocks]
+ *   BlockKey ids[nids]                 sorted by (id, block)
+ *   BlockKey names[npeople]            sorted by (hash of name, block)
+ *   BlockedFooter
+ *
+ * The ids table is left out (nids is 0) when the people are sorted by id, as
+ * compact_book leaves them: the id ranges of the blocks are enough then.
+ * Reader reads the people of a blocked book like any other, one block in
+ * memory at a time, and splitBook() cuts it at block boundaries so blocks
+ * decompress in parallel. BlockedBook finds the blocks holding an id or name
+ * from the tables at the end (binary searched off an mmap), so a lookup
+ * reads and decompresses only those.
+ *
+ * A blocked book is written whole (see convert_book --blocked) and can't be
+ * appended to; its change log (book/lsm.hpp) still applies.
+ */
+
+// Uncompressed bytes of a block by default
+constexpr size_t kDefaultBlockBytes = 64 << 10;
+// Most uncompressed bytes a block may hold: the writer doesn't go past it
+// and readers don't inflate past it
+constexpr size_t kMaxBlockBytes = 16 << 20;
+
+struct BlockInfo {
+  uint64_t offset;    // of the framed block in the file
+  uint32_t raw_size;  // uncompressed
+  uint32_t people;
+  int32_t min_id;
+  int32_t max_id;
+};
+
+struct BlockKey {
+  uint32_t key;  // id (as uint32) or hash of name
+  uint32_t block;
+};
+
+struct BlockedFooter {
+  uint64_t nblocks;
+  uint64_t npeople;
+  uint64_t nids;        // npeople, or 0 if sorted by id
+  uint64_t blocks_end;  // where the framed blocks end and the tables start
+  char magic[8];  // kBlockedMagic again, to tell a truncated file
+};
+
+// 32 bits of Index::nameKey()
+uint32_t blockNameKey(std::string_view name);
+
+// Read the footer of a blocked book, checking it against the file size
+bool readBlockedFooter(int fd, BlockedFooter* footer);
+
+// Where the tables start: blocks_end padded to alignof(BlockInfo)
+uint64_t blockTablesStart(uint64_t blocks_end);
+
+// Decompress a block of raw_size bytes (as its BlockInfo says) into raw
+// (replacing its contents); false if it inflates to any other size or
+// raw_size is over kMaxBlockBytes
+bool inflateBlock(std::string_view block, uint32_t raw_size, std::string* raw);
+
+// Writes a new blocked book
+class BlockedWriter {
+ public:
+  BlockedWriter() = default;
+  ~BlockedWriter();
+  BlockedWriter(const BlockedWriter&) = delete;
+  BlockedWriter& operator=(const BlockedWriter&) = delete;
+
+  // Create (or truncate) a book; level is a zlib compression level. A block
+  // holds block_bytes (up to kMaxBlockBytes) or a single bigger person.
+  bool open(const std::string& path, size_t block_bytes = kDefaultBlockBytes, int level = -1);
+  bool append(const tutorial::Person& person);
+  // Append a serialized person as is
+  bool appendRaw(std::string_view record);
+  // Write out the last block and the tables, and close the file
+  bool close();
+
+  uint64_t blocks() const { return blocks_.size(); }
+  // Compressed bytes written so far
+  int64_t offset() const { return offset_; }
+  const std::string& error() const { return error_; }
+
+ private:
+  bool flushBlock();
+  bool writeAll(const void* data, size_t size);
+
+  int fd_ = -1;
+  size_t block_bytes_ = kDefaultBlockBytes;
+  int level_ = -1;
+  int64_t offset_ = 0;
+  std::string raw_;         // records of the current block
+  uint32_t raw_people_ = 0;
+  std::string compressed_;  // framed block
+  std::string record_;
+  bool sorted_ = true;  // by id so far
+  std::vector<BlockInfo> blocks_;
+  std::vector<BlockKey> ids_, names_;
+  std::string error_;
+};
+
+// The block tables of a blocked book, for lookups
+class BlockedBook {
+ public:
+  BlockedBook() = default;
+  BlockedBook(const BlockedBook&) = delete;
+  BlockedBook& operator=(const BlockedBook&) = delete;
+
+  bool open(const std::string& path);
+  void close();
+
+  uint64_t size() const { return nblocks_; }
+  const BlockInfo& block(uint32_t i) const { return blocks_[i]; }
+  // Where the blocks end (the offset after the last one)
+  int64_t blocksEnd() const { return blocks_end_; }
+  // Blocks that may hold people with an id or name, in book order
+  std::vector<uint32_t> findId(int32_t id) const;
+  std::vector<uint32_t> findName(const std::string& name) const;
+  const std::string& error() const { return error_; }
+
+ private:
+  std::vector<uint32_t> find(const BlockKey* sorted, uint64_t n, uint32_t key) const;
+
+  MappedFile map_;
+  uint64_t nblocks_ = 0, npeople_ = 0, nids_ = 0;
+  int64_t blocks_end_ = 0;
+  const BlockInfo* blocks_ = nullptr;
+  const BlockKey* ids_ = nullptr;
+  const BlockKey* names_ = nullptr;
+  std::string error_;
+};
+
+}  // namespace book
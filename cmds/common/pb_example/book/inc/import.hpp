@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "addressbook.pb.h"
+#include "book/stream.hpp"
+#include "cutils/tpool.hpp"
+
+namespace book {
+
+/*
+ * Bulk import of people in the formats list_people writes (see
+ * book/output.hpp), so its output imports back as is:
+ *
+ * kCsv     RFC 4180, a header line naming the columns (id, name, email,
+ *          phones as TYPE:number;..., updated as RFC 3339; other columns
+ *          are ignored), then one record per person
+ * kNdjson  One JSON object per line with the keys id, name, email, phones
+ *          ([{"type": "MOBILE" or a number, "number": ...}]) and updated;
+ *          other keys are ignored
+ *
+ * importPeople() runs it as a pipeline: the calling thread reads the input
+ * in large reads and cuts it into batches of whole records, the batches are
+ * converted into serialized people on a thread pool, and the calling thread
+ * appends the converted batches in input order, one write per batch.
+ */
+enum class ImportFormat { kCsv, kNdjson };
+
+// Input bytes of a batch by default
+constexpr size_t kImportBatchBytes = 1 << 20;
+// Longest record: input isn't buffered past it looking for the end of one
+// (e.g. of a quoted CSV field that isn't closed), the import fails instead
+constexpr size_t kMaxImportRecordBytes = 1 << 20;
+
+// Format of a name (csv, ndjson); false if unknown
+bool parseImportFormat(const std::string& name, ImportFormat* format);
+
+// Converts records into people
+class PersonParser {
+ public:
+  explicit PersonParser(ImportFormat format) : format_(format) {}
+
+  // CSV: the header line naming the columns
+  bool setHeader(std::string_view header, std::string* error);
+  // Parse a record (without its line end) into person
+  bool parse(std::string_view record, tutorial::Person* person, std::string* error) const;
+
+ private:
+  bool parseCsv(std::string_view record, tutorial::Person* person, std::string* error) const;
+  bool parseNdjson(std::string_view record, tutorial::Person* person, std::string* error) const;
+
+  ImportFormat format_;
+  std::vector<uint32_t> columns_;  // field of each CSV column (0: ignored)
+};
+
+struct ImportStats {
+  uint64_t people = 0;
+  uint64_t bytes_read = 0;
+  uint64_t batches = 0;
+};
+
+// Import the people of the input on fd into writer (see above); on a bad
+// record, error names it (1-based, in input order) and nothing after the
+// batch before it is written
+bool importPeople(int fd, ImportFormat format, cutils::ThreadPool& pool, Writer* writer, ImportStats* stats,
+                  std::string* error, size_t batch_bytes = kImportBatchBytes);
+
+}  // namespace book
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "book/mapped_file.hpp"
+
+namespace book {
+
+/*
+ * Sidecar index of a stream address book (<book>.idx) mapping Person.id and
+ * name to byte offsets of records in the book:
+ *
+ *   IndexHeader
+ *   IndexEntry ids[nsorted]     sorted by (id, offset)
+ *   IndexEntry names[nsorted]   sorted by (hash of name, offset)
+ *   IndexEntry tail[][2]        (id, name) pairs of records appended since,
+ *                               in book order
+ *
+ * The sorted arrays are binary searched straight off an mmap of the file.
+ * update() appends the records added to the book since the last update to
+ * the tail, and merges the tail into the sorted arrays (rewriting the index)
+ * once it outgrows a fraction of them, so appends stay cheap and lookups stay
+ * O(log n) plus a short linear scan. It rebuilds the index from scratch if
+ * the book isn't the one indexed: another inode, or the last record indexed
+ * isn't at its offset with its id and name.
+ */
+
+constexpr char kIndexMagic[] = "ABIDX1\n";
+
+struct IndexEntry {
+  uint64_t key;  // id (as uint32) or hash of name
+  uint64_t offset;
+};
+
+struct IndexHeader {
+  char magic[8];
+  uint64_t nsorted;   // entries in each sorted array
+  uint64_t book_end;  // book bytes covered by the sorted arrays
+  uint64_t book_ino;  // inode of the book (compaction and replacing make another)
+  // (id, name) pair of the last record covered by the sorted arrays, checked
+  // against the book as the last tail pair is when there's a tail
+  IndexEntry last[2];
+};
+
+class Index {
+ public:
+  Index() = default;
+  Index(const Index&) = delete;
+  Index& operator=(const Index&) = delete;
+
+  static std::string pathFor(const std::string& book_path) { return book_path + ".idx"; }
+  static uint64_t nameKey(std::string_view name);
+
+  // Index the records appended to a book since the last update, creating the
+  // index if missing. Updates of one book must not run concurrently.
+  bool update(const std::string& book_path);
+
+  // Map the index of a book for lookups
+  bool open(const std::string& book_path);
+  void close();
+
+  // Offsets of the records with an id, in book order
+  std::vector<int64_t> findId(int32_t id) const;
+  // Offsets of the records whose name may be name (hashes match: check the
+  // name of the record), in book order
+  std::vector<int64_t> findName(const std::string& name) const;
+
+  // Number of indexed records
+  uint64_t size() const { return nsorted_ + ntail_; }
+  const std::string& error() const { return error_; }
+
+ private:
+  std::vector<int64_t> find(const IndexEntry* sorted, int col, uint64_t key) const;
+
+  MappedFile map_;
+  uint64_t nsorted_ = 0;
+  uint64_t ntail_ = 0;
+  const IndexEntry* ids_ = nullptr;
+  const IndexEntry* names_ = nullptr;
+  const IndexEntry* tail_ = nullptr;
+  std::string error_;
+};
+
+}  // namespace book
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace book {
+
+/*
+ * In-memory index of a stream address book that follows the book as people
+ * are appended to it, for addressbook_server. The people are served as the
+ * serialized bytes they are in the book, never parsed: only their ids and
+ * names are decoded (see book/person_ref.hpp), and the names are kept.
+ *
+ * Like Index, it keeps sorted arrays, by (id, offset) and by (name, offset),
+ * plus a short tail of the people appended since in book order, which
+ * update() merges into the sorted arrays once it outgrows kLiveTail. So a
+ * lookup is a binary search plus a scan of at most kLiveTail entries, and an
+ * append costs O(1) amortized over kLiveTail of them.
+ *
+ * The book is read with pread(2) rather than mapped: one truncated under
+ * the index then reads short, where a mapping would fault (SIGBUS) on the
+ * pages past its new end.
+ */
+
+// Entries of the tail merged into the sorted arrays at once
+constexpr size_t kLiveTail = 1024;
+// Bytes of the book read at once by update()
+constexpr size_t kLiveReadBytes = 1 << 20;
+
+// A serialized person in the book
+struct LiveRecord {
+  uint64_t offset;  // of the message, after its varint size
+  uint32_t size;
+};
+
+class LiveIndex {
+ public:
+  LiveIndex() = default;
+  ~LiveIndex() { close(); }
+  LiveIndex(const LiveIndex&) = delete;
+  LiveIndex& operator=(const LiveIndex&) = delete;
+
+  // Map and index a stream book
+  bool open(const std::string& path);
+  // Index the people appended since the last update; a record still being
+  // written at the end waits for the next one. False if the book shrank or
+  // a record is malformed (open it again then).
+  bool update();
+  void close();
+  bool isOpen() const { return fd_ >= 0; }
+  // Whether the book is now shorter than the bytes indexed, so the records
+  // past its end can't be read: open it again then
+  bool truncated() const;
+
+  // Up to limit records of the people with an id, in book order; false if
+  // there were more
+  bool findId(int32_t id, size_t limit, std::vector<LiveRecord>* records) const;
+  // Up to limit records of the people whose name starts with prefix, by
+  // (name, offset); false if there were more
+  bool findNamePrefix(std::string_view prefix, size_t limit, std::vector<LiveRecord>* records) const;
+  // Append the serialized person of a record to out; false (and out as it
+  // was) if the book no longer holds it, truncated since it was indexed
+  bool record(const LiveRecord& r, std::string* out) const;
+
+  // People indexed
+  uint64_t size() const { return ids_.size(); }
+  // Bytes of the book indexed
+  int64_t end() const { return end_; }
+  const std::string& error() const { return error_; }
+
+ private:
+  struct IdEntry {
+    int32_t id;
+    uint32_t size;
+    uint64_t offset;
+  };
+  struct NameEntry {
+    uint64_t offset;
+    uint64_t name_pos;  // of the name in names_data_
+    uint32_t size;
+    uint32_t name_size;
+  };
+
+  std::string_view nameOf(const NameEntry& e) const {
+    return std::string_view(names_data_).substr(e.name_pos, e.name_size);
+  }
+  bool nameLess(const NameEntry& a, const NameEntry& b) const;
+  void mergeTail();
+
+  std::string path_;
+  int fd_ = -1;
+  int64_t end_ = 0;
+  // Sorted, then the tail from sorted_ on, in book order
+  std::vector<IdEntry> ids_;
+  std::vector<NameEntry> names_;
+  std::string names_data_;
+  size_t sorted_ = 0;
+  std::string error_;
+};
+
+}  // namespace book
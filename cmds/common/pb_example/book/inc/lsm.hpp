@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "addressbook.pb.h"
+#include "book/stream.hpp"
+#include "changelog.pb.h"
+
+namespace book {
+
+/*
+ * Log-structured address book: the book file is the base, and
+ * <book>.log (a Format::kLog file) holds the tutorial::PersonChange
+ * records appended since: upserts (add a person, replacing the people with
+ * its id) and deletes (tombstones) keyed by Person.id. An update or delete
+ * costs one appended record, whatever the size of the book.
+ *
+ * MergedReader applies the log to the base on the fly, holding only the
+ * changes in memory. compactBook() folds the log into a new base sorted by
+ * id with one person per id, as an external merge sort in bounded memory,
+ * and removes the log. Neither parses people: records are moved around as
+ * bytes and only their ids are decoded (see book/person_view.hpp).
+ *
+ * Compaction must not run concurrently with writers of the book.
+ */
+
+inline std::string logPathFor(const std::string& book_path) { return book_path + ".log"; }
+
+// A PersonChange, pointing into its serialized bytes
+struct Change {
+  int32_t id = 0;
+  bool deleted = false;
+  std::string_view person;  // serialized Person of an upsert
+};
+
+// Decode a serialized PersonChange (and the id of an upserted person)
+bool decodeChange(std::string_view record, Change* change);
+// Append a serialized PersonChange upserting a serialized person
+void encodeUpsert(std::string_view person, std::string* out);
+// Append a serialized PersonChange deleting an id
+void encodeDelete(int32_t id, std::string* out);
+
+// Appends changes to the log of a book
+class ChangeLog {
+ public:
+  bool open(const std::string& book_path);
+  bool upsert(const tutorial::Person& person);
+  bool remove(int32_t id);
+  bool close();
+
+  const std::string& error() const { return error_; }
+
+ private:
+  Writer writer_;
+  tutorial::PersonChange change_;
+  std::string error_;
+};
+
+// The latest change of every id in the log of a book
+class ChangeSet {
+ public:
+  struct Entry {
+    bool deleted;
+    std::string person;  // serialized
+  };
+
+  // Load the log of a book; no log is no changes
+  bool load(const std::string& book_path);
+
+  bool empty() const { return entries_.empty(); }
+  // Latest change of an id, or nullptr
+  const Entry* find(int32_t id) const;
+  // Changed ids, in order of their first change
+  const std::vector<int32_t>& ids() const { return ids_; }
+  // Number of records in the log
+  uint64_t records() const { return records_; }
+  const std::string& error() const { return error_; }
+
+ private:
+  std::unordered_map<int32_t, Entry> entries_;
+  std::vector<int32_t> ids_;
+  uint64_t records_ = 0;
+  std::string error_;
+};
+
+// Reads the people of a book with the changes of its log applied: changed
+// people where they were in the base, then the people added by the log (in
+// order of their first change). A drop-in for Reader.
+class MergedReader {
+ public:
+  bool open(const std::string& book_path, Input input = Input::kMmap);
+  bool next(tutorial::Person* person);
+  bool nextRaw(std::string_view* record);
+
+  bool hasLog() const { return !changes_.empty(); }
+  int64_t offset() const { return reader_.offset(); }
+  const std::string& error() const { return error_.empty() ? reader_.error() : error_; }
+
+ private:
+  bool read(std::string_view* record);
+
+  Reader reader_;
+  ChangeSet changes_;
+  std::unordered_set<int32_t> done_;  // changed ids already read
+  size_t added_ = 0;                  // next of changes_.ids() to read
+  bool base_done_ = false;
+  std::string error_;
+};
+
+struct CompactStats {
+  uint64_t people = 0;   // in the new base
+  uint64_t changes = 0;  // log records folded in
+  uint64_t runs = 0;     // sorted runs spilled to disk
+  bool base_sorted = false;  // the base was merged in place of being sorted
+  int64_t bytes_written = 0;
+};
+
+// Fold the log of a book into a new base sorted by id, using about
+// memory_bytes for sorting; the index of the book (book/index.hpp) is
+// removed. A base already sorted by id (e.g. compacted before) is merged as
+// is, so only the log is sorted. A blocked base (book/blocked.hpp) is
+// rewritten blocked. The new base is synced and renamed over the book (with
+// its directory synced) before the log is removed, so a crash or power loss
+// leaves either the old base and log or the new base.
+bool compactBook(const std::string& book_path, size_t memory_bytes, CompactStats* stats, std::string* error);
+
+}  // namespace book
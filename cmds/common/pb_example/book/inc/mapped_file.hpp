@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace book {
+
+// Read-only mmap of a whole file
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile() { close(); }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Map a file; sequential hints the kernel to read ahead aggressively and
+  // drop pages behind (MADV_SEQUENTIAL) for one-pass scans, otherwise to read
+  // only the pages touched (MADV_RANDOM) for lookups
+  bool open(const std::string& path, bool sequential = true);
+  // Map an open file descriptor (not closed by this class)
+  bool open(int fd, bool sequential = true);
+  void close();
+
+  // For sequential scans: drop the pages before off from the mapping (they
+  // stay in the page cache) and prefetch the window after it
+  void advance(size_t off, size_t window);
+
+  // nullptr for an empty file
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+  const std::string& error() const { return error_; }
+
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  std::string error_;
+};
+
+}  // namespace book
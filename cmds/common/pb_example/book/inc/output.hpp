@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "addressbook.pb.h"
+#include "book/person_view.hpp"
+
+namespace book {
+
+/*
+ * Output formats of people (each only with the fields asked for):
+ *
+ * kText      What the protobuf tutorial's list_people prints
+ * kCsv       A header line, then one line per person: id, name, email,
+ *            phones (TYPE:number;...), updated (RFC 3339), RFC 4180 quoted
+ * kNdjson    One JSON object per line: {"id":..,"name":..,"email":..,
+ *            "phones":[{"type":..,"number":..}],"updated":..}, leaving out
+ *            an empty email, no phones and no updated like the text
+ * kColumnar  Blocks of up to kColumnarRows people, column by column
+ *            (native byte order, for loading into arrays):
+ *
+ *              char     magic[8]         kColumnarMagic
+ *              uint32_t rows, fields     fields: mask of the columns below
+ *              then the columns in fields, in this order:
+ *              id       int32_t id[rows]
+ *              name     uint32_t end[rows], then the names back to back
+ *                       (name i is [end[i - 1], end[i]))
+ *              email    same as name
+ *              phones   uint32_t end[rows] (end of the phones of each
+ *                       person), int32_t type[nphones], then the numbers
+ *                       like names (uint32_t end[nphones], bytes)
+ *              updated  int64_t seconds[rows], int32_t nanos[rows]
+ *                       (0 for people without it)
+ */
+enum class OutputFormat { kText, kCsv, kNdjson, kColumnar };
+
+constexpr char kColumnarMagic[] = "ABCOL1\n";
+constexpr size_t kColumnarRows = 64 * 1024;
+
+// Format of a name (text, csv, ndjson, columnar); false if unknown
+bool parseOutputFormat(const std::string& name, OutputFormat* format);
+
+// Formats people into bytes appended to a string
+class Formatter {
+ public:
+  explicit Formatter(OutputFormat format, uint32_t fields = kFieldAll);
+
+  // Output before the first person (the CSV header)
+  void begin(std::string* out);
+  void append(const PersonView& person, std::string* out);
+  void append(const tutorial::Person& person, std::string* out);
+  // Output after the last person (the last columnar block)
+  void end(std::string* out);
+
+ private:
+  void appendText(const PersonView& person, std::string* out);
+  void appendCsv(const PersonView& person, std::string* out);
+  void appendNdjson(const PersonView& person, std::string* out);
+  void appendColumnar(const PersonView& person, std::string* out);
+
+  OutputFormat format_;
+  uint32_t fields_;
+  PersonView view_;      // of the tutorial::Person being appended
+  std::string scratch_;  // CSV phones
+
+  // Columns of the pending columnar block
+  uint32_t rows_ = 0;
+  std::vector<int32_t> ids_;
+  std::vector<uint32_t> name_ends_, email_ends_, phone_ends_, number_ends_;
+  std::string names_, emails_, numbers_;
+  std::vector<int32_t> phone_types_;
+  std::vector<int64_t> seconds_;
+  std::vector<int32_t> nanos_;
+};
+
+// Writes formatted people to a file descriptor through a large buffer, only
+// writing when it fills up (never per person)
+class OutputWriter {
+ public:
+  static constexpr size_t kDefaultBufferBytes = 1 << 20;
+
+  OutputWriter(int fd, OutputFormat format, uint32_t fields = kFieldAll,
+               size_t buffer_bytes = kDefaultBufferBytes);
+  ~OutputWriter() { close(); }
+  OutputWriter(const OutputWriter&) = delete;
+  OutputWriter& operator=(const OutputWriter&) = delete;
+
+  void write(const PersonView& person);
+  void write(const tutorial::Person& person);
+  // Output formatted elsewhere (e.g. by a Formatter on another thread)
+  void writeRaw(std::string_view bytes);
+  // Finish the output and write out the buffer (the fd is left open)
+  bool close();
+
+  const std::string& error() const { return error_; }
+
+ private:
+  void maybeFlush();
+  bool flush();
+
+  int fd_;
+  Formatter formatter_;
+  size_t buffer_bytes_;
+  std::string buf_;
+  bool closed_ = false;
+  std::string error_;
+};
+
+}  // namespace book
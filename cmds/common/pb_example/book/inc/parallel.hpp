@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "addressbook.pb.h"
+#include "cutils/tpool.hpp"
+
+namespace book {
+
+// Whole records of a book file, [begin, end) in bytes
+struct Chunk {
+  std::string path;
+  int64_t begin;
+  int64_t end;
+};
+
+// Split the records of a book (of any format but kLog) into chunks of about
+// chunk_bytes and append them to chunks. Only the record headers are read (or
+// the block index of a kBlocked book, which is split into whole blocks).
+bool splitBook(const std::string& path, size_t chunk_bytes, std::vector<Chunk>* chunks, std::string* error);
+
+// Run on a worker for every person of a chunk, in order, to append its
+// output to the output of the chunk
+using DecodeFn = std::function<void(const tutorial::Person& person, std::string* out)>;
+// Run on the calling thread with the output of every chunk, in order
+using EmitFn = std::function<void(const std::string& out)>;
+
+// Decode chunks on a thread pool, a few chunks per thread in flight, and
+// emit their output in the order of chunks. The calling thread decodes too
+// while it waits. count (if not null) is the number of people decoded.
+bool decodeParallel(cutils::ThreadPool& pool, const std::vector<Chunk>& chunks, const DecodeFn& decode,
+                    const EmitFn& emit, uint64_t* count, std::string* error);
+
+}  // namespace book
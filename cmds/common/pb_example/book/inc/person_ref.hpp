@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include "book/person_view.hpp"
+
+namespace book {
+
+/*
+ * Decoder of a serialized tutorial::Person specialized to its schema, for the
+ * hottest read paths: PersonRef points into the record, nothing is copied and
+ * nothing is allocated, and phones are decoded only as they're iterated.
+ *
+ * It takes what Person::ParseFromArray() takes and nothing else (book_test
+ * checks the two against each other on mutated records): unknown fields and
+ * groups are skipped, the last of repeated scalars wins, strings must be
+ * UTF-8. A malformed phone only shows once it's iterated, as
+ * PhoneCursor::error().
+ */
+
+// Phones of a PersonRef, decoded one at a time
+class PhoneCursor {
+ public:
+  PhoneCursor() = default;
+  PhoneCursor(const char* begin, const char* end) : p_(begin), end_(end) {}
+
+  // The next phone; false at the end, or on a malformed one (error())
+  bool next(PhoneView* phone);
+  bool error() const { return error_; }
+
+ private:
+  const char* p_ = nullptr;
+  const char* end_ = nullptr;
+  bool error_ = false;
+};
+
+struct PersonRef {
+  std::string_view name;
+  int32_t id = 0;
+  std::string_view email;
+  uint32_t phones_size = 0;
+  // From the first phone on; copy it to iterate the phones more than once
+  PhoneCursor phones;
+  bool has_updated = false;
+  int64_t updated_seconds = 0;
+  int32_t updated_nanos = 0;
+};
+
+// Decode a serialized Person into person (valid as long as record is). False
+// if malformed.
+bool decodePersonRef(std::string_view record, PersonRef* person);
+
+}  // namespace book
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "addressbook.pb.h"
+
+namespace book {
+
+// Fields of a Person as bits of a mask (bit n - 1 for field number n)
+enum Field : uint32_t {
+  kFieldName = 1 << 0,
+  kFieldId = 1 << 1,
+  kFieldEmail = 1 << 2,
+  kFieldPhones = 1 << 3,
+  kFieldUpdated = 1 << 4,
+  kFieldAll = (1 << 5) - 1,
+};
+
+// Mask of a comma separated list of field names (name, id, email, phones,
+// updated); 0 if a name is unknown
+uint32_t parseFields(const std::string& list);
+
+struct PhoneView {
+  std::string_view number;
+  int type = 0;
+};
+
+// Fields of a serialized tutorial::Person, pointing into the serialized bytes
+struct PersonView {
+  std::string_view name;
+  int32_t id = 0;
+  std::string_view email;
+  std::vector<PhoneView> phones;
+  bool has_updated = false;
+  int64_t updated_seconds = 0;
+  int32_t updated_nanos = 0;
+};
+
+// Decode the fields in mask fields of a serialized Person into view, reading
+// the CodedInputStream wire format directly: the other fields are skipped,
+// strings aren't copied and nothing is allocated (phones reuses its memory).
+// The fields of view not in the mask are left alone. False if malformed.
+bool decodePerson(std::string_view record, uint32_t fields, PersonView* view);
+
+// View of the fields of a parsed person (valid as long as person is)
+void viewPerson(const tutorial::Person& person, PersonView* view);
+
+// Predicates on a person, all of which must hold
+struct Filter {
+  int64_t id_min = INT32_MIN;
+  int64_t id_max = INT32_MAX;
+  std::string name_prefix;
+  bool has_email = false;
+
+  // Add a predicate: id=N, id=LO:HI (either bound may be left out),
+  // name=PREFIX or has_email. Id ranges and prefixes added more than once are
+  // intersected. False (and no change) if malformed.
+  bool add(const std::string& spec);
+  // Fields the predicates look at
+  uint32_t fields() const;
+  bool matches(const PersonView& person) const;
+};
+
+}  // namespace book
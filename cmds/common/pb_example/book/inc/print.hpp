@@ -0,0 +1,16 @@
+#pragma once
+
+#include <ostream>
+
+#include "addressbook.pb.h"
+#include "book/person_view.hpp"
+
+namespace book {
+
+// Print a person the way the protobuf tutorial's list_people does (see
+// OutputWriter for listing many)
+void printPerson(std::ostream& out, const tutorial::Person& person);
+// Print the fields in mask fields of a person the same way
+void printPersonView(std::ostream& out, const PersonView& person, uint32_t fields);
+
+}  // namespace book
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/message_lite.h>
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "addressbook.pb.h"
+#include "book/mapped_file.hpp"
+
+namespace book {
+
+/*
+ * Address book files come in three formats:
+ *
+ * kLegacy  One serialized tutorial::AddressBook (the protobuf tutorial
+ *          format). Adding a person means rewriting the whole file.
+ * kStream  kStreamMagic followed by length-delimited tutorial::Person
+ *          records (varint size + message), so a person is appended in O(1)
+ *          and the file is read one record at a time in constant memory.
+ * kBlocked kBlockedMagic followed by zlib-compressed blocks of kStream
+ *          records and a block index (see book/blocked.hpp). Written whole.
+ *
+ * kLog is the kStream framing of tutorial::PersonChange records instead,
+ * for the change log of a book (see book/lsm.hpp).
+ */
+enum class Format { kLegacy, kStream, kLog, kBlocked };
+
+constexpr char kStreamMagic[] = "ABOOKS1\n";
+constexpr char kLogMagic[] = "ABLOGS1\n";
+constexpr char kBlockedMagic[] = "ABZBLK1\n";
+constexpr size_t kStreamMagicLen = sizeof(kStreamMagic) - 1;
+static_assert(sizeof(kLogMagic) == sizeof(kStreamMagic) && sizeof(kBlockedMagic) == sizeof(kStreamMagic),
+              "magics differ in length");
+
+// How a Reader gets at the bytes of the file
+enum class Input {
+  kMmap,     // CodedInputStream straight over an mmap of the file (no copies)
+  kFd,       // FileInputStream: read(2) into a buffer
+  kFstream,  // std::ifstream through IstreamInputStream (iostream buffers)
+};
+
+// Reads the people of an address book file (of any format) one at a time
+class Reader {
+ public:
+  Reader() = default;
+  ~Reader();
+  Reader(const Reader&) = delete;
+  Reader& operator=(const Reader&) = delete;
+
+  // Open a file and detect its format. kMmap falls back to kFd for files
+  // that can't be mapped (e.g. pipes).
+  bool open(const std::string& path, Input input = Input::kMmap);
+  // Read the next person; false at end of file or on error (see error())
+  bool next(tutorial::Person* person);
+  // Like next(), but get the serialized record (of any format) without
+  // parsing it. record is valid until the next call.
+  bool nextRaw(std::string_view* record);
+  // Move to the record at a byte offset (e.g. from an Index), or to the
+  // block at an offset of a kBlocked book
+  bool seek(int64_t offset);
+  void close();
+
+  Format format() const { return format_; }
+  Input input() const { return input_; }
+  // Byte offset of the next record in the file; in a kBlocked book, of the
+  // block of the next record
+  int64_t offset() const { return block_pos_ < block_.size() ? block_offset_ : offset_; }
+  // Empty unless open() or next() failed
+  const std::string& error() const { return error_; }
+
+ private:
+  // Parse the next record into person, or point record at it
+  bool read(tutorial::Person* person, std::string_view* record);
+  bool readFrame(tutorial::Person* person, std::string_view* record);
+  bool readBlocked(tutorial::Person* person, std::string_view* record);
+  bool parse(google::protobuf::io::CodedInputStream* cin, tutorial::Person* person, std::string_view* record);
+
+  bool open_ = false;
+  int fd_ = -1;
+  Format format_ = Format::kStream;
+  Input input_ = Input::kMmap;
+  int64_t offset_ = 0;
+  std::string error_;
+  MappedFile map_;
+  size_t next_advance_ = 0;
+  std::ifstream fstream_;
+  std::unique_ptr<google::protobuf::io::ZeroCopyInputStream> in_;
+  std::string raw_;  // nextRaw() record not in the buffer of in_
+  bool findBlock(int64_t offset, uint32_t* raw_size);
+
+  // kBlocked: where the BlockInfo table is, the entry of the block after the
+  // one read last, and the block being read, decompressed
+  uint64_t block_table_ = 0;
+  uint64_t nblocks_ = 0;
+  uint64_t next_block_ = 0;
+  int64_t blocks_end_ = 0;
+  int64_t block_offset_ = 0;
+  std::string block_;
+  size_t block_pos_ = 0;
+};
+
+// Appends records to a kStream (people) or kLog (changes) file (see
+// BlockedWriter for kBlocked)
+class Writer {
+ public:
+  Writer() = default;
+  ~Writer();
+  Writer(const Writer&) = delete;
+  Writer& operator=(const Writer&) = delete;
+
+  // Open (or create) a file of a format for appending; truncate empties it
+  // first. Fails on a file of another format (see convert_book).
+  bool open(const std::string& path, bool truncate = false, Format format = Format::kStream);
+  bool append(const google::protobuf::MessageLite& record);
+  // Append a serialized record as is
+  bool appendRaw(std::string_view record);
+  // Append records already framed (varint size + record each) in one write
+  bool appendFramed(std::string_view records);
+  // Flush buffered records and close the file
+  bool close();
+
+  // Byte offset the next record will be written at
+  int64_t offset() const { return offset_; }
+  const std::string& error() const { return error_; }
+
+ private:
+  int fd_ = -1;
+  int64_t offset_ = 0;
+  std::string error_;
+  std::unique_ptr<google::protobuf::io::FileOutputStream> out_;
+};
+
+}  // namespace book
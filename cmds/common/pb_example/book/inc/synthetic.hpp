@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+#include "addressbook.pb.h"
+
+namespace book {
+
+// Shape of a synthetic book
+struct SyntheticOptions {
+  uint64_t seed = 0;            // another seed gives other people
+  uint32_t email_percent = 67;  // of people with an email
+  uint32_t min_phones = 0;      // phones per person, uniformly distributed
+  uint32_t max_phones = 3;
+};
+
+// Fill person with the i-th person of a synthetic book: the same i (and
+// options) always gives the same person, with name/email lengths and number
+// of phones varying from person to person (for tests and benchmarks)
+void syntheticPerson(uint64_t i, tutorial::Person* person);
+void syntheticPerson(uint64_t i, const SyntheticOptions& options, tutorial::Person* person);
+
+}  // namespace book
@@ -0,0 +1,303 @@
+#include "book/blocked.hpp"
+
+#include <fcntl.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/gzip_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "book/index.hpp"
+#include "book/person_view.hpp"
+
+namespace book {
+
+using google::protobuf::io::ArrayInputStream;
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::io::GzipInputStream;
+using google::protobuf::io::GzipOutputStream;
+using google::protobuf::io::StringOutputStream;
+
+namespace {
+
+bool keyLess(const BlockKey& a, const BlockKey& b) { return a.key < b.key || (a.key == b.key && a.block < b.block); }
+
+// Append a varint size + bytes record to out
+void frame(std::string_view bytes, std::string* out) {
+  uint8_t hdr[10];
+  uint8_t* end = CodedOutputStream::WriteVarint32ToArray(static_cast<uint32_t>(bytes.size()), hdr);
+  out->append(reinterpret_cast<char*>(hdr), end - hdr);
+  out->append(bytes);
+}
+
+}  // namespace
+
+// The tables start at the end of the blocks, padded so they can be read in
+// place off an mmap
+uint64_t blockTablesStart(uint64_t blocks_end) {
+  return (blocks_end + alignof(BlockInfo) - 1) / alignof(BlockInfo) * alignof(BlockInfo);
+}
+
+uint32_t blockNameKey(std::string_view name) {
+  uint64_t h = Index::nameKey(name);
+  return static_cast<uint32_t>(h ^ (h >> 32));
+}
+
+bool readBlockedFooter(int fd, BlockedFooter* footer) {
+  struct stat st {};
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < kStreamMagicLen + sizeof(*footer) ||
+      pread(fd, footer, sizeof(*footer), st.st_size - sizeof(*footer)) != static_cast<ssize_t>(sizeof(*footer)) ||
+      memcmp(footer->magic, kBlockedMagic, sizeof(footer->magic)) != 0) {
+    return false;
+  }
+  // The tables must fill the file up to the footer exactly. Each count is
+  // checked against the bytes left before it's multiplied, so none overflows.
+  uint64_t end = static_cast<uint64_t>(st.st_size) - sizeof(*footer);
+  if (footer->blocks_end < kStreamMagicLen || footer->blocks_end > end || blockTablesStart(footer->blocks_end) > end) {
+    return false;
+  }
+  uint64_t left = end - blockTablesStart(footer->blocks_end);
+  if (footer->nblocks > left / sizeof(BlockInfo)) {
+    return false;
+  }
+  left -= footer->nblocks * sizeof(BlockInfo);
+  return footer->nids <= footer->npeople && footer->npeople <= left / sizeof(BlockKey) &&
+         (footer->nids + footer->npeople) * sizeof(BlockKey) == left;
+}
+
+bool inflateBlock(std::string_view block, uint32_t raw_size, std::string* raw) {
+  raw->clear();
+  if (raw_size > kMaxBlockBytes) {
+    return false;
+  }
+  raw->reserve(raw_size);
+  ArrayInputStream array(block.data(), static_cast<int>(block.size()));
+  GzipInputStream in(&array, GzipInputStream::ZLIB);
+  const void* data;
+  int size;
+  while (in.Next(&data, &size)) {
+    // Stop at the first byte past raw_size, whatever the block inflates to
+    if (static_cast<size_t>(size) > raw_size - raw->size()) {
+      return false;
+    }
+    raw->append(static_cast<const char*>(data), size);
+  }
+  return in.ZlibErrorCode() == Z_STREAM_END && raw->size() == raw_size;
+}
+
+BlockedWriter::~BlockedWriter() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+bool BlockedWriter::open(const std::string& path, size_t block_bytes, int level) {
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+  if (block_bytes == 0 || block_bytes > kMaxBlockBytes) {
+    error_ = path + ": block size must be 1 to " + std::to_string(kMaxBlockBytes) + " bytes";
+    return false;
+  }
+  fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    error_ = path + ": " + strerror(errno);
+    return false;
+  }
+  block_bytes_ = block_bytes;
+  level_ = level;
+  offset_ = 0;
+  raw_.clear();
+  raw_people_ = 0;
+  sorted_ = true;
+  blocks_.clear();
+  ids_.clear();
+  names_.clear();
+  return writeAll(kBlockedMagic, kStreamMagicLen);
+}
+
+bool BlockedWriter::append(const tutorial::Person& person) {
+  record_.clear();
+  person.AppendToString(&record_);
+  return appendRaw(record_);
+}
+
+bool BlockedWriter::appendRaw(std::string_view record) {
+  if (fd_ < 0) {
+    return false;
+  }
+  PersonView view;
+  if (!decodePerson(record, kFieldId | kFieldName, &view)) {
+    error_ = "malformed person";
+    return false;
+  }
+  if (raw_people_ && raw_.size() + record.size() > block_bytes_ && !flushBlock()) {
+    return false;
+  }
+  if (raw_.size() + CodedOutputStream::VarintSize32(static_cast<uint32_t>(record.size())) + record.size() >
+      kMaxBlockBytes) {
+    error_ = "person too large for a block";
+    return false;
+  }
+  if (!raw_people_) {
+    blocks_.push_back({0, 0, 0, view.id, view.id});
+  }
+  auto block = static_cast<uint32_t>(blocks_.size() - 1);
+  BlockInfo& info = blocks_.back();
+  sorted_ = sorted_ && (ids_.empty() || view.id > static_cast<int32_t>(ids_.back().key));
+  info.min_id = std::min(info.min_id, view.id);
+  info.max_id = std::max(info.max_id, view.id);
+  ids_.push_back({static_cast<uint32_t>(view.id), block});
+  names_.push_back({blockNameKey(view.name), block});
+  frame(record, &raw_);
+  raw_people_++;
+  return true;
+}
+
+bool BlockedWriter::flushBlock() {
+  std::string deflated;
+  {
+    StringOutputStream str(&deflated);
+    GzipOutputStream::Options opts;
+    opts.format = GzipOutputStream::ZLIB;
+    opts.compression_level = level_;
+    GzipOutputStream out(&str, opts);
+    {
+      CodedOutputStream cout(&out);
+      cout.WriteRaw(raw_.data(), static_cast<int>(raw_.size()));
+    }
+    if (!out.Close()) {
+      error_ = "compression error";
+      return false;
+    }
+  }
+  blocks_.back().offset = static_cast<uint64_t>(offset_);
+  blocks_.back().raw_size = static_cast<uint32_t>(raw_.size());
+  blocks_.back().people = raw_people_;
+  compressed_.clear();
+  frame(deflated, &compressed_);
+  raw_.clear();
+  raw_people_ = 0;
+  return writeAll(compressed_.data(), compressed_.size());
+}
+
+bool BlockedWriter::writeAll(const void* data, size_t size) {
+  const auto* p = static_cast<const char*>(data);
+  while (size) {
+    ssize_t n = write(fd_, p, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      error_ = std::string("write error: ") + strerror(errno);
+      return false;
+    }
+    p += n;
+    size -= n;
+    offset_ += n;
+  }
+  return true;
+}
+
+bool BlockedWriter::close() {
+  if (fd_ < 0) {
+    return true;
+  }
+  BlockedFooter footer{};
+  bool ok = !raw_people_ || flushBlock();
+  footer.nblocks = blocks_.size();
+  footer.npeople = ids_.size();
+  footer.nids = sorted_ ? 0 : ids_.size();
+  footer.blocks_end = offset_;
+  memcpy(footer.magic, kBlockedMagic, sizeof(footer.magic));
+  std::sort(ids_.begin(), ids_.end(), keyLess);
+  std::sort(names_.begin(), names_.end(), keyLess);
+  static const char padding[alignof(BlockInfo)] = {};
+  ok = ok && writeAll(padding, blockTablesStart(footer.blocks_end) - footer.blocks_end) &&
+       writeAll(blocks_.data(), blocks_.size() * sizeof(BlockInfo)) &&
+       writeAll(ids_.data(), footer.nids * sizeof(BlockKey)) &&
+       writeAll(names_.data(), names_.size() * sizeof(BlockKey)) && writeAll(&footer, sizeof(footer));
+  if (::close(fd_) != 0 && ok) {
+    error_ = std::string("write error: ") + strerror(errno);
+    ok = false;
+  }
+  fd_ = -1;
+  return ok;
+}
+
+bool BlockedBook::open(const std::string& path) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    error_ = path + ": " + strerror(errno);
+    return false;
+  }
+  char magic[kStreamMagicLen];
+  BlockedFooter footer;
+  bool ok = pread(fd, magic, sizeof(magic), 0) == static_cast<ssize_t>(sizeof(magic)) &&
+            memcmp(magic, kBlockedMagic, sizeof(magic)) == 0 && readBlockedFooter(fd, &footer);
+  // Lookups touch a few pages of the tables: no readahead
+  ok = ok && map_.open(fd, false);
+  ::close(fd);
+  if (!ok) {
+    error_ = path + ": not a blocked address book";
+    close();
+    return false;
+  }
+  nblocks_ = footer.nblocks;
+  npeople_ = footer.npeople;
+  nids_ = footer.nids;
+  blocks_end_ = static_cast<int64_t>(footer.blocks_end);
+  blocks_ = reinterpret_cast<const BlockInfo*>(map_.data() + blockTablesStart(footer.blocks_end));
+  ids_ = reinterpret_cast<const BlockKey*>(blocks_ + nblocks_);
+  names_ = ids_ + nids_;
+  return true;
+}
+
+void BlockedBook::close() {
+  map_.close();
+  nblocks_ = npeople_ = nids_ = 0;
+  blocks_end_ = 0;
+  blocks_ = nullptr;
+  ids_ = names_ = nullptr;
+}
+
+std::vector<uint32_t> BlockedBook::find(const BlockKey* sorted, uint64_t n, uint32_t key) const {
+  std::vector<uint32_t> blocks;
+  if (!sorted) {
+    return blocks;
+  }
+  const BlockKey* it = std::lower_bound(sorted, sorted + n, key, [](const BlockKey& e, uint32_t k) { return e.key < k; });
+  for (; it != sorted + n && it->key == key; ++it) {
+    if (blocks.empty() || blocks.back() != it->block) {
+      blocks.push_back(it->block);
+    }
+  }
+  return blocks;
+}
+
+std::vector<uint32_t> BlockedBook::findId(int32_t id) const {
+  if (nids_ || !blocks_) {
+    return find(ids_, nids_, static_cast<uint32_t>(id));
+  }
+  // Sorted by id: the first block not all below id
+  const BlockInfo* it =
+      std::lower_bound(blocks_, blocks_ + nblocks_, id, [](const BlockInfo& b, int32_t i) { return b.max_id < i; });
+  if (it == blocks_ + nblocks_ || it->min_id > id) {
+    return {};
+  }
+  return {static_cast<uint32_t>(it - blocks_)};
+}
+
+std::vector<uint32_t> BlockedBook::findName(const std::string& name) const {
+  return find(names_, npeople_, blockNameKey(name));
+}
+
+}  // namespace book
@@ -0,0 +1,690 @@
+#include "book/import.hpp"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/util/time_util.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "book/person_view.hpp"
+#include "wire_format.hpp"
+
+namespace book {
+
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::util::TimeUtil;
+
+namespace {
+
+// Batches in flight per thread, like decodeParallel()
+constexpr size_t kBatchesPerThread = 4;
+
+// Input read at a time
+constexpr size_t kReadBytes = 4 << 20;
+
+// Nesting of JSON values skipped over
+constexpr int kMaxJsonDepth = 64;
+
+bool parseInt32(std::string_view s, int32_t* v) {
+  auto res = std::from_chars(s.data(), s.data() + s.size(), *v);
+  return res.ec == std::errc() && res.ptr == s.data() + s.size();
+}
+
+bool parsePhoneType(std::string_view s, int32_t* type) {
+  static const struct {
+    const char* name;
+    tutorial::Person::PhoneType type;
+  } types[] = {
+      {"MOBILE", tutorial::Person::MOBILE}, {"HOME", tutorial::Person::HOME}, {"WORK", tutorial::Person::WORK}};
+  for (const auto& t : types) {
+    if (s == t.name) {
+      *type = t.type;
+      return true;
+    }
+  }
+  return parseInt32(s, type);
+}
+
+bool parseUpdated(const std::string& s, tutorial::Person* person) {
+  return TimeUtil::FromString(s, person->mutable_last_updated());
+}
+
+// "TYPE:number;..." of the CSV phones column
+bool parseCsvPhones(std::string_view s, tutorial::Person* person) {
+  while (!s.empty()) {
+    size_t end = std::min(s.find(';'), s.size());
+    std::string_view phone = s.substr(0, end);
+    size_t colon = phone.find(':');
+    int32_t type;
+    if (colon == std::string_view::npos || !parsePhoneType(phone.substr(0, colon), &type)) {
+      return false;
+    }
+    auto* number = person->add_phones();
+    number->set_type(static_cast<tutorial::Person::PhoneType>(type));
+    number->set_number(std::string(phone.substr(colon + 1)));
+    s.remove_prefix(std::min(end + 1, s.size()));
+  }
+  return true;
+}
+
+// Next field of a CSV record at *pos (moved past it and its comma); quoted
+// fields are unquoted into scratch. false on a malformed quoted field.
+bool nextCsvField(std::string_view record, size_t* pos, std::string* scratch, std::string_view* field) {
+  size_t p = *pos;
+  if (p < record.size() && record[p] == '"') {
+    scratch->clear();
+    for (p++;; p++) {
+      if (p == record.size()) {
+        return false;
+      }
+      if (record[p] == '"') {
+        if (p + 1 < record.size() && record[p + 1] == '"') {
+          p++;
+        } else {
+          break;
+        }
+      }
+      *scratch += record[p];
+    }
+    *field = *scratch;
+    p++;
+    if (p < record.size() && record[p] != ',') {
+      return false;
+    }
+  } else {
+    size_t end = std::min(record.find(',', p), record.size());
+    *field = record.substr(p, end - p);
+    p = end;
+  }
+  *pos = p + 1;  // past the comma, or past the end after the last field
+  return true;
+}
+
+// A JSON object of a line of NDJSON
+class JsonParser {
+ public:
+  explicit JsonParser(std::string_view s) : p_(s.data()), end_(s.data() + s.size()) {}
+
+  // Whether parsePerson() failed on a string that isn't UTF-8
+  bool badUtf8() const { return bad_utf8_; }
+
+  bool parsePerson(tutorial::Person* person) {
+    if (!consume('{')) {
+      return false;
+    }
+    if (consume('}')) {
+      return atEnd();
+    }
+    do {
+      if (!string(&key_) || !consume(':')) {
+        return false;
+      }
+      bool ok;
+      if (key_ == "id") {
+        int32_t id;
+        ok = number(&id);
+        person->set_id(id);
+      } else if (key_ == "name") {
+        ok = string(person->mutable_name());
+      } else if (key_ == "email") {
+        ok = string(person->mutable_email());
+      } else if (key_ == "phones") {
+        ok = phones(person);
+      } else if (key_ == "updated") {
+        ok = string(&value_) && parseUpdated(value_, person);
+      } else {
+        ok = skipValue(0);
+      }
+      if (!ok) {
+        return false;
+      }
+    } while (consume(','));
+    return consume('}') && atEnd();
+  }
+
+ private:
+  void skipWs() {
+    while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\r' || *p_ == '\n')) {
+      p_++;
+    }
+  }
+
+  bool consume(char c) {
+    skipWs();
+    if (p_ < end_ && *p_ == c) {
+      p_++;
+      return true;
+    }
+    return false;
+  }
+
+  bool atEnd() {
+    skipWs();
+    return p_ == end_;
+  }
+
+  bool peek(char c) {
+    skipWs();
+    return p_ < end_ && *p_ == c;
+  }
+
+  bool hex4(uint32_t* v) {
+    *v = 0;
+    for (int i = 0; i < 4; i++, p_++) {
+      if (p_ == end_) {
+        return false;
+      }
+      char c = *p_;
+      int d = c >= '0' && c <= '9'   ? c - '0'
+              : c >= 'a' && c <= 'f' ? c - 'a' + 10
+              : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                     : -1;
+      if (d < 0) {
+        return false;
+      }
+      *v = *v << 4 | d;
+    }
+    return true;
+  }
+
+  static void appendUtf8(uint32_t cp, std::string* out) {
+    if (cp < 0x80) {
+      *out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+      *out += static_cast<char>(0xc0 | cp >> 6);
+      *out += static_cast<char>(0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+      *out += static_cast<char>(0xe0 | cp >> 12);
+      *out += static_cast<char>(0x80 | (cp >> 6 & 0x3f));
+      *out += static_cast<char>(0x80 | (cp & 0x3f));
+    } else {
+      *out += static_cast<char>(0xf0 | cp >> 18);
+      *out += static_cast<char>(0x80 | (cp >> 12 & 0x3f));
+      *out += static_cast<char>(0x80 | (cp >> 6 & 0x3f));
+      *out += static_cast<char>(0x80 | (cp & 0x3f));
+    }
+  }
+
+  bool string(std::string* out) {
+    if (!consume('"')) {
+      return false;
+    }
+    out->clear();
+    while (p_ < end_) {
+      // Copy up to the next quote or escape at once
+      const char* stop = p_;
+      while (stop < end_ && *stop != '"' && *stop != '\\') {
+        stop++;
+      }
+      // A quote or backslash can't be part of a multibyte character, so the
+      // runs between them are checked on their own
+      if (!validUtf8(std::string_view(p_, stop - p_))) {
+        bad_utf8_ = true;
+        return false;
+      }
+      out->append(p_, stop - p_);
+      p_ = stop;
+      if (p_ == end_) {
+        break;
+      }
+      if (*p_++ == '"') {
+        return true;
+      }
+      if (p_ == end_) {
+        break;
+      }
+      char c = *p_++;
+      uint32_t cp, lo;
+      switch (c) {
+        case '"':
+        case '\\':
+        case '/':
+          *out += c;
+          break;
+        case 'b':
+          *out += '\b';
+          break;
+        case 'f':
+          *out += '\f';
+          break;
+        case 'n':
+          *out += '\n';
+          break;
+        case 'r':
+          *out += '\r';
+          break;
+        case 't':
+          *out += '\t';
+          break;
+        case 'u':
+          if (!hex4(&cp)) {
+            return false;
+          }
+          // a surrogate pair; a low surrogate alone isn't a character
+          if (cp >= 0xdc00 && cp < 0xe000) {
+            bad_utf8_ = true;
+            return false;
+          }
+          if (cp >= 0xd800 && cp < 0xdc00) {
+            if (end_ - p_ < 6 || p_[0] != '\\' || p_[1] != 'u') {
+              bad_utf8_ = true;
+              return false;
+            }
+            p_ += 2;
+            if (!hex4(&lo) || lo < 0xdc00 || lo >= 0xe000) {
+              bad_utf8_ = true;
+              return false;
+            }
+            cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+          }
+          appendUtf8(cp, out);
+          break;
+        default:
+          return false;
+      }
+    }
+    return false;
+  }
+
+  bool number(int32_t* v) {
+    skipWs();
+    const char* start = p_;
+    while (p_ < end_ && (*p_ == '-' || (*p_ >= '0' && *p_ <= '9'))) {
+      p_++;
+    }
+    return parseInt32(std::string_view(start, p_ - start), v);
+  }
+
+  bool phones(tutorial::Person* person) {
+    if (!consume('[')) {
+      return false;
+    }
+    if (consume(']')) {
+      return true;
+    }
+    do {
+      auto* phone = person->add_phones();
+      if (!consume('{')) {
+        return false;
+      }
+      if (consume('}')) {
+        continue;
+      }
+      do {
+        if (!string(&key_) || !consume(':')) {
+          return false;
+        }
+        bool ok;
+        int32_t type = 0;
+        if (key_ == "type") {
+          ok = peek('"') ? string(&value_) && parsePhoneType(value_, &type) : number(&type);
+          phone->set_type(static_cast<tutorial::Person::PhoneType>(type));
+        } else if (key_ == "number") {
+          ok = string(phone->mutable_number());
+        } else {
+          ok = skipValue(0);
+        }
+        if (!ok) {
+          return false;
+        }
+      } while (consume(','));
+      if (!consume('}')) {
+        return false;
+      }
+    } while (consume(','));
+    return consume(']');
+  }
+
+  bool skipValue(int depth) {
+    if (depth > kMaxJsonDepth) {
+      return false;
+    }
+    skipWs();
+    if (p_ == end_) {
+      return false;
+    }
+    if (*p_ == '"') {
+      return string(&value_);
+    }
+    char open = *p_;
+    if (open == '{' || open == '[') {
+      p_++;
+      char close = open == '{' ? '}' : ']';
+      if (consume(close)) {
+        return true;
+      }
+      do {
+        if (open == '{' && (!string(&value_) || !consume(':'))) {
+          return false;
+        }
+        if (!skipValue(depth + 1)) {
+          return false;
+        }
+      } while (consume(','));
+      return consume(close);
+    }
+    // a number, true, false or null
+    const char* start = p_;
+    while (p_ < end_ && *p_ != ',' && *p_ != '}' && *p_ != ']' && *p_ != ' ' && *p_ != '\t') {
+      p_++;
+    }
+    return p_ > start;
+  }
+
+  const char* p_;
+  const char* end_;
+  std::string key_, value_;
+  bool bad_utf8_ = false;
+};
+
+// End of the record starting at p: its '\n', or the end of s if there's
+// none. In CSV a quote opens a quoted field only at the start of a field
+// (RFC 4180), where '\n' doesn't end the record; elsewhere it's just a byte.
+size_t recordEnd(std::string_view s, size_t p, bool csv) {
+  if (!csv) {
+    const auto* nl = static_cast<const char*>(memchr(s.data() + p, '\n', s.size() - p));
+    return nl ? nl - s.data() : s.size();
+  }
+  bool field_start = true;
+  while (p < s.size()) {
+    char c = s[p++];
+    if (c == '\n') {
+      return p - 1;
+    }
+    if (c == '"' && field_start) {
+      // Up to the closing quote; a doubled one is an escaped quote
+      for (;;) {
+        const auto* q = static_cast<const char*>(memchr(s.data() + p, '"', s.size() - p));
+        if (!q) {
+          return s.size();
+        }
+        p = q - s.data() + 1;
+        if (p == s.size() || s[p] != '"') {
+          break;
+        }
+        p++;
+      }
+    }
+    field_start = c == ',';
+  }
+  return s.size();
+}
+
+struct Slot {
+  tpool_group_t group = TPOOL_GROUP_INIT;
+  const PersonParser* parser = nullptr;
+  bool csv = false;
+  std::string in;      // whole records
+  uint64_t first = 0;  // number of the first record
+  std::string out;     // framed serialized people
+  uint64_t count = 0;
+  std::string error;
+};
+
+void convertBatch(void* arg) {
+  auto* slot = static_cast<Slot*>(arg);
+  std::string_view in = slot->in;
+  tutorial::Person person;
+  uint64_t record = slot->first;
+  for (size_t p = 0; p < in.size(); record++) {
+    size_t end = recordEnd(in, p, slot->csv);
+    std::string_view line = in.substr(p, end - p);
+    p = end + 1;
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    if (line.empty()) {
+      continue;
+    }
+    person.Clear();
+    if (!slot->parser->parse(line, &person, &slot->error)) {
+      slot->error = "record " + std::to_string(record) + ": " + slot->error;
+      return;
+    }
+    // varint size + message, straight into the batch output
+    size_t size = person.ByteSizeLong();
+    size_t at = slot->out.size();
+    slot->out.resize(at + CodedOutputStream::VarintSize32(static_cast<uint32_t>(size)) + size);
+    auto* p_out = reinterpret_cast<uint8_t*>(&slot->out[at]);
+    p_out = CodedOutputStream::WriteVarint32ToArray(static_cast<uint32_t>(size), p_out);
+    person.SerializeWithCachedSizesToArray(p_out);
+    slot->count++;
+  }
+}
+
+}  // namespace
+
+bool parseImportFormat(const std::string& name, ImportFormat* format) {
+  if (name == "csv") {
+    *format = ImportFormat::kCsv;
+  } else if (name == "ndjson") {
+    *format = ImportFormat::kNdjson;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool PersonParser::setHeader(std::string_view header, std::string* error) {
+  columns_.clear();
+  std::string scratch;
+  std::string_view name;
+  uint32_t seen = 0;
+  for (size_t pos = 0; pos <= header.size();) {
+    if (!nextCsvField(header, &pos, &scratch, &name)) {
+      *error = "malformed header";
+      return false;
+    }
+    uint32_t field = parseFields(std::string(name));
+    field = field == kFieldAll ? 0 : field;
+    if (field & seen) {
+      *error = "column " + std::string(name) + " given twice";
+      return false;
+    }
+    seen |= field;
+    columns_.push_back(field);
+  }
+  return true;
+}
+
+bool PersonParser::parse(std::string_view record, tutorial::Person* person, std::string* error) const {
+  return format_ == ImportFormat::kCsv ? parseCsv(record, person, error) : parseNdjson(record, person, error);
+}
+
+bool PersonParser::parseCsv(std::string_view record, tutorial::Person* person, std::string* error) const {
+  std::string scratch;
+  std::string_view field;
+  size_t pos = 0;
+  for (size_t col = 0; col < columns_.size(); col++) {
+    if (pos > record.size()) {
+      *error = "expected " + std::to_string(columns_.size()) + " columns";
+      return false;
+    }
+    if (!nextCsvField(record, &pos, &scratch, &field)) {
+      *error = "malformed quoted field in column " + std::to_string(col + 1);
+      return false;
+    }
+    uint32_t column = columns_[col];
+    if ((column & (kFieldName | kFieldEmail | kFieldPhones)) && !validUtf8(field)) {
+      *error = "invalid UTF-8 in column " + std::to_string(col + 1);
+      return false;
+    }
+    bool ok = true;
+    int32_t id;
+    switch (column) {
+      case kFieldId:
+        ok = parseInt32(field, &id);
+        person->set_id(id);
+        break;
+      case kFieldName:
+        person->set_name(std::string(field));
+        break;
+      case kFieldEmail:
+        person->set_email(std::string(field));
+        break;
+      case kFieldPhones:
+        ok = parseCsvPhones(field, person);
+        break;
+      case kFieldUpdated:
+        ok = field.empty() || parseUpdated(std::string(field), person);
+        break;
+      default:
+        break;
+    }
+    if (!ok) {
+      *error = "bad value in column " + std::to_string(col + 1);
+      return false;
+    }
+  }
+  if (pos <= record.size()) {
+    *error = "expected " + std::to_string(columns_.size()) + " columns";
+    return false;
+  }
+  return true;
+}
+
+bool PersonParser::parseNdjson(std::string_view record, tutorial::Person* person, std::string* error) const {
+  JsonParser json(record);
+  if (!json.parsePerson(person)) {
+    *error = json.badUtf8() ? "invalid UTF-8 in a string" : "malformed JSON object";
+    return false;
+  }
+  return true;
+}
+
+bool importPeople(int fd, ImportFormat format, cutils::ThreadPool& pool, Writer* writer, ImportStats* stats,
+                  std::string* error, size_t batch_bytes) {
+  const bool csv = format == ImportFormat::kCsv;
+  PersonParser parser(format);
+  const size_t window = kBatchesPerThread * (pool.size() + 1);
+  std::vector<std::unique_ptr<Slot>> slots(window);
+  for (auto& slot : slots) {
+    slot = std::make_unique<Slot>();
+    slot->parser = &parser;
+    slot->csv = csv;
+  }
+
+  // Batches go out in input order: the oldest one is written before its
+  // slot takes the next
+  size_t submitted = 0, written = 0;
+  auto writeOldest = [&]() {
+    Slot* slot = slots[written++ % window].get();
+    tpool_group_wait(pool.get(), &slot->group);
+    if (!slot->error.empty()) {
+      *error = slot->error;
+      return false;
+    }
+    if (!writer->appendFramed(slot->out)) {
+      *error = writer->error();
+      return false;
+    }
+    stats->people += slot->count;
+    return true;
+  };
+  uint64_t next_record = 1;
+  auto submit = [&](std::string_view records, uint64_t nrecords) {
+    if (submitted - written == window && !writeOldest()) {
+      return false;
+    }
+    Slot* slot = slots[submitted++ % window].get();
+    slot->in.assign(records);
+    slot->first = next_record;
+    slot->out.clear();
+    slot->count = 0;
+    next_record += nrecords;
+    stats->batches++;
+    if (tpool_submit(pool.get(), &slot->group, convertBatch, slot) != 0) {
+      convertBatch(slot);
+    }
+    return true;
+  };
+
+  // pending holds input from the start of a record: [0, batch_end) are whole
+  // records of the next batch, scanned up to batch_end
+  std::string pending;
+  size_t batch_end = 0;
+  uint64_t batch_records = 0;
+  bool header = csv;
+  bool ok = true;
+  std::string too_long;  // error of a record too long, once found
+  for (bool eof = false; ok && !eof && too_long.empty();) {
+    size_t at = pending.size();
+    pending.resize(at + kReadBytes);
+    ssize_t n = read(fd, &pending[at], kReadBytes);
+    if (n < 0 && errno == EINTR) {
+      pending.resize(at);
+      continue;
+    }
+    if (n < 0) {
+      *error = std::string("read error: ") + strerror(errno);
+      ok = false;
+      break;
+    }
+    pending.resize(at + n);
+    stats->bytes_read += n;
+    eof = n == 0;
+
+    size_t begin = 0;  // of the batch in pending
+    while (ok && batch_end < pending.size()) {
+      size_t end = recordEnd(pending, batch_end, csv);
+      if (end - batch_end > kMaxImportRecordBytes) {
+        // Like a bad record: the ones before it are imported
+        too_long = (header ? std::string("header") : "record " + std::to_string(next_record + batch_records)) +
+                   ": longer than " + std::to_string(kMaxImportRecordBytes) + " bytes" +
+                   (csv ? " (unbalanced quotes?)" : "");
+        if (batch_end > begin) {
+          ok = submit(std::string_view(pending).substr(begin, batch_end - begin), batch_records);
+          begin = batch_end;
+        }
+        break;
+      }
+      if (end == pending.size() && !eof) {
+        break;  // the rest of the record is yet to be read
+      }
+      if (header) {
+        std::string_view line = std::string_view(pending).substr(batch_end, end - batch_end);
+        if (!line.empty() && line.back() == '\r') {
+          line.remove_suffix(1);
+        }
+        ok = parser.setHeader(line, error);
+        header = false;
+        begin = batch_end = std::min(end + 1, pending.size());
+        continue;
+      }
+      batch_end = std::min(end + 1, pending.size());
+      batch_records++;
+      if (batch_end - begin >= batch_bytes) {
+        ok = submit(std::string_view(pending).substr(begin, batch_end - begin), batch_records);
+        begin = batch_end;
+        batch_records = 0;
+      }
+    }
+    if (ok && eof && too_long.empty() && batch_end > begin) {
+      ok = submit(std::string_view(pending).substr(begin, batch_end - begin), batch_records);
+      begin = batch_end;
+    }
+    // Keep the partial record (and the records of the next batch)
+    pending.erase(0, begin);
+    batch_end -= begin;
+  }
+  while (ok && written < submitted) {
+    ok = writeOldest();
+  }
+  if (ok && !too_long.empty()) {
+    *error = too_long;
+    ok = false;
+  }
+  // after an error, let the batches in flight finish before freeing them
+  for (auto& slot : slots) {
+    tpool_group_wait(pool.get(), &slot->group);
+  }
+  return ok;
+}
+
+}  // namespace book
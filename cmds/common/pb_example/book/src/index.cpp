@@ -0,0 +1,284 @@
+#include "book/index.hpp"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "book/stream.hpp"
+
+namespace book {
+
+namespace {
+
+// The tail is merged into the sorted arrays once it has this many records,
+// or 1/kCompactRatio of the sorted ones if more, up to kMaxTail
+constexpr uint64_t kMinTail = 1024;
+constexpr uint64_t kMaxTail = 64 * 1024;
+constexpr uint64_t kCompactRatio = 8;
+
+constexpr size_t kPairSize = 2 * sizeof(IndexEntry);
+
+// Closes a file descriptor (and so drops its flock) when going out of scope
+struct FdGuard {
+  int fd;
+  ~FdGuard() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+};
+
+bool preadAll(int fd, void* buf, size_t len, off_t off) {
+  auto* p = static_cast<char*>(buf);
+  while (len) {
+    ssize_t n = pread(fd, p, len, off);
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    off += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool pwriteAll(int fd, const void* buf, size_t len, off_t off) {
+  const auto* p = static_cast<const char*>(buf);
+  while (len) {
+    ssize_t n = pwrite(fd, p, len, off);
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    off += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool entryLess(const IndexEntry& a, const IndexEntry& b) {
+  return a.key < b.key || (a.key == b.key && a.offset < b.offset);
+}
+
+IndexHeader emptyHeader(uint64_t book_ino) {
+  IndexHeader hdr{};
+  memcpy(hdr.magic, kIndexMagic, sizeof(hdr.magic));
+  hdr.book_end = kStreamMagicLen;
+  hdr.book_ino = book_ino;
+  return hdr;
+}
+
+// Whether the record at the offset of an index pair is the one indexed
+// there; reader is left past it
+bool indexedAt(Reader* reader, const IndexEntry pair[2], tutorial::Person* person) {
+  return pair[0].offset == pair[1].offset && reader->seek(static_cast<int64_t>(pair[0].offset)) &&
+         reader->next(person) && static_cast<uint32_t>(person->id()) == pair[0].key &&
+         Index::nameKey(person->name()) == pair[1].key;
+}
+
+/*
+ * Merge the tail into the sorted arrays: the new index is written next to
+ * the old one and renamed over it, so readers see either.
+ */
+bool compact(int fd, const std::string& path, const IndexHeader& hdr, uint64_t ntail, uint64_t book_end) {
+  uint64_t n = hdr.nsorted + ntail;
+  std::vector<IndexEntry> ids(n), names(n), tail(2 * ntail);
+  size_t sorted_bytes = hdr.nsorted * sizeof(IndexEntry);
+  if (!preadAll(fd, ids.data(), sorted_bytes, sizeof(hdr)) ||
+      !preadAll(fd, names.data(), sorted_bytes, sizeof(hdr) + sorted_bytes) ||
+      !preadAll(fd, tail.data(), ntail * kPairSize, sizeof(hdr) + 2 * sorted_bytes)) {
+    return false;
+  }
+  for (uint64_t i = 0; i < ntail; i++) {
+    ids[hdr.nsorted + i] = tail[2 * i];
+    names[hdr.nsorted + i] = tail[2 * i + 1];
+  }
+  for (auto* v : {&ids, &names}) {
+    std::sort(v->begin() + hdr.nsorted, v->end(), entryLess);
+    std::inplace_merge(v->begin(), v->begin() + hdr.nsorted, v->end(), entryLess);
+  }
+
+  IndexHeader out = emptyHeader(hdr.book_ino);
+  out.nsorted = n;
+  out.book_end = book_end;
+  out.last[0] = tail[2 * ntail - 2];
+  out.last[1] = tail[2 * ntail - 1];
+  std::string tmp = path + ".tmp";
+  FdGuard tfd{::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)};
+  bool ok = tfd.fd >= 0 && pwriteAll(tfd.fd, &out, sizeof(out), 0) &&
+            pwriteAll(tfd.fd, ids.data(), n * sizeof(IndexEntry), sizeof(out)) &&
+            pwriteAll(tfd.fd, names.data(), n * sizeof(IndexEntry), sizeof(out) + n * sizeof(IndexEntry)) &&
+            rename(tmp.c_str(), path.c_str()) == 0;
+  if (!ok) {
+    unlink(tmp.c_str());
+  }
+  return ok;
+}
+
+}  // namespace
+
+uint64_t Index::nameKey(std::string_view name) {
+  // FNV-1a: stable across builds, unlike std::hash
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (unsigned char c : name) {
+    h = (h ^ c) * 0x100000001b3ULL;
+  }
+  return h;
+}
+
+bool Index::update(const std::string& book_path) {
+  std::string path = pathFor(book_path);
+  FdGuard fd{::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)};
+  if (fd.fd < 0 || flock(fd.fd, LOCK_EX) != 0) {
+    error_ = path + ": " + strerror(errno);
+    return false;
+  }
+
+  // The inode is taken before the book is read: if it's replaced meanwhile,
+  // the next update finds another one
+  struct stat book_st {};
+  if (::stat(book_path.c_str(), &book_st) != 0) {
+    error_ = book_path + ": " + strerror(errno);
+    return false;
+  }
+  Reader reader;
+  if (!reader.open(book_path)) {
+    error_ = reader.error();
+    return false;
+  }
+  if (reader.format() != Format::kStream) {
+    error_ = book_path + ": not a stream address book (convert it with convert_book)";
+    return false;
+  }
+
+  // Find where the index leaves off in the book. Start over if the index is
+  // unreadable or doesn't match the book (e.g. the book was replaced or
+  // compacted): the last record it indexed must be where it says.
+  IndexHeader hdr{};
+  struct stat st {};
+  uint64_t sorted_end = 0, ntail = 0;
+  int64_t covered = -1;
+  tutorial::Person person;
+  if (fstat(fd.fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(hdr) &&
+      preadAll(fd.fd, &hdr, sizeof(hdr), 0) && memcmp(hdr.magic, kIndexMagic, sizeof(hdr.magic)) == 0 &&
+      hdr.book_ino == static_cast<uint64_t>(book_st.st_ino) &&
+      static_cast<uint64_t>(st.st_size) >= sizeof(hdr) + 2 * hdr.nsorted * sizeof(IndexEntry)) {
+    sorted_end = sizeof(hdr) + 2 * hdr.nsorted * sizeof(IndexEntry);
+    ntail = (st.st_size - sorted_end) / kPairSize;
+    IndexEntry last[2] = {hdr.last[0], hdr.last[1]};
+    if (ntail) {
+      covered = preadAll(fd.fd, last, sizeof(last), sorted_end + (ntail - 1) * kPairSize) &&
+                        indexedAt(&reader, last, &person)
+                    ? reader.offset()
+                    : -1;
+    } else if (hdr.nsorted) {
+      covered = indexedAt(&reader, last, &person) && reader.offset() == static_cast<int64_t>(hdr.book_end)
+                    ? reader.offset()
+                    : -1;
+    } else {
+      covered = static_cast<int64_t>(hdr.book_end);
+    }
+  }
+  if (covered < 0 || !reader.seek(covered)) {
+    hdr = emptyHeader(book_st.st_ino);
+    sorted_end = sizeof(hdr);
+    ntail = 0;
+    if (ftruncate(fd.fd, 0) != 0 || !pwriteAll(fd.fd, &hdr, sizeof(hdr), 0) || !reader.seek(kStreamMagicLen)) {
+      error_ = path + ": " + strerror(errno);
+      return false;
+    }
+  } else if (static_cast<uint64_t>(st.st_size) != sorted_end + ntail * kPairSize) {
+    // drop a torn trailing pair
+    if (ftruncate(fd.fd, sorted_end + ntail * kPairSize) != 0) {
+      error_ = path + ": " + strerror(errno);
+      return false;
+    }
+  }
+
+  // Append the new records
+  std::vector<IndexEntry> pairs;
+  int64_t off = reader.offset();
+  while (reader.next(&person)) {
+    pairs.push_back({static_cast<uint32_t>(person.id()), static_cast<uint64_t>(off)});
+    pairs.push_back({nameKey(person.name()), static_cast<uint64_t>(off)});
+    off = reader.offset();
+  }
+  if (!reader.error().empty()) {
+    error_ = book_path + ": " + reader.error();
+    return false;
+  }
+  if (!pwriteAll(fd.fd, pairs.data(), pairs.size() * sizeof(IndexEntry), sorted_end + ntail * kPairSize)) {
+    error_ = path + ": " + strerror(errno);
+    return false;
+  }
+  ntail += pairs.size() / 2;
+
+  uint64_t max_tail = std::max(kMinTail, std::min(hdr.nsorted / kCompactRatio, kMaxTail));
+  if (ntail >= max_tail && !compact(fd.fd, path, hdr, ntail, off)) {
+    error_ = path + ": failed to merge index";
+    return false;
+  }
+  return true;
+}
+
+bool Index::open(const std::string& book_path) {
+  close();
+  std::string path = pathFor(book_path);
+  if (!map_.open(path, false)) {
+    error_ = map_.error();
+    return false;
+  }
+
+  const auto* hdr = reinterpret_cast<const IndexHeader*>(map_.data());
+  if (map_.size() < sizeof(*hdr) || memcmp(hdr->magic, kIndexMagic, sizeof(hdr->magic)) != 0 ||
+      map_.size() < sizeof(*hdr) + 2 * hdr->nsorted * sizeof(IndexEntry)) {
+    error_ = path + ": not an address book index";
+    close();
+    return false;
+  }
+  nsorted_ = hdr->nsorted;
+  ids_ = reinterpret_cast<const IndexEntry*>(hdr + 1);
+  names_ = ids_ + nsorted_;
+  tail_ = names_ + nsorted_;
+  ntail_ = (map_.size() - sizeof(*hdr) - 2 * nsorted_ * sizeof(IndexEntry)) / kPairSize;
+  return true;
+}
+
+void Index::close() {
+  map_.close();
+  nsorted_ = ntail_ = 0;
+  ids_ = names_ = tail_ = nullptr;
+}
+
+std::vector<int64_t> Index::find(const IndexEntry* sorted, int col, uint64_t key) const {
+  std::vector<int64_t> offsets;
+  if (!sorted) {
+    return offsets;
+  }
+  // Equal keys are sorted by offset and the tail is newer than the sorted
+  // arrays, so offsets come out in book order
+  const IndexEntry* it = std::lower_bound(sorted, sorted + nsorted_, key,
+                                          [](const IndexEntry& e, uint64_t k) { return e.key < k; });
+  for (; it != sorted + nsorted_ && it->key == key; ++it) {
+    offsets.push_back(static_cast<int64_t>(it->offset));
+  }
+  for (uint64_t i = 0; i < ntail_; i++) {
+    if (tail_[2 * i + col].key == key) {
+      offsets.push_back(static_cast<int64_t>(tail_[2 * i + col].offset));
+    }
+  }
+  return offsets;
+}
+
+std::vector<int64_t> Index::findId(int32_t id) const { return find(ids_, 0, static_cast<uint32_t>(id)); }
+
+std::vector<int64_t> Index::findName(const std::string& name) const { return find(names_, 1, nameKey(name)); }
+
+}  // namespace book
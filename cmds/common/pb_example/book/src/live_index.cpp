@@ -0,0 +1,209 @@
+#include "book/live_index.hpp"
+
+#include <fcntl.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <string>
+
+#include "book/person_ref.hpp"
+#include "book/stream.hpp"
+
+namespace book {
+
+using google::protobuf::io::CodedInputStream;
+
+bool LiveIndex::open(const std::string& path) {
+  close();
+  Reader probe;
+  if (!probe.open(path)) {
+    error_ = probe.error();
+    return false;
+  }
+  if (probe.format() != Format::kStream) {
+    error_ = path + ": not a stream address book (convert it with convert_book)";
+    return false;
+  }
+  probe.close();
+
+  fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd_ < 0) {
+    error_ = path + ": " + strerror(errno);
+    return false;
+  }
+  path_ = path;
+  end_ = kStreamMagicLen;
+  if (!update()) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool LiveIndex::update() {
+  struct stat st {};
+  if (fd_ < 0 || fstat(fd_, &st) != 0) {
+    error_ = path_ + ": " + strerror(errno);
+    return false;
+  }
+  if (st.st_size < end_) {
+    error_ = path_ + ": shrank from " + std::to_string(end_) + " to " + std::to_string(st.st_size) + " bytes";
+    return false;
+  }
+  if (st.st_size == end_) {
+    return true;
+  }
+  // Read what was appended, a chunk (or a record longer than that) at a time
+  std::string buf;
+  size_t at = 0;  // of end_ in buf
+  PersonRef person;
+  for (;;) {
+    const size_t avail = buf.size() - at;
+    CodedInputStream cin(reinterpret_cast<const uint8_t*>(buf.data()) + at,
+                         static_cast<int>(std::min<size_t>(avail, INT_MAX)));
+    uint32_t len = 0;
+    bool sized = cin.ReadVarint32(&len);
+    if (sized && len <= avail - cin.CurrentPosition()) {
+      uint64_t offset = end_ + cin.CurrentPosition();
+      std::string_view record(buf.data() + at + cin.CurrentPosition(), len);
+      if (!decodePersonRef(record, &person)) {
+        error_ = path_ + ": malformed record at offset " + std::to_string(end_);
+        return false;
+      }
+      ids_.push_back({person.id, len, offset});
+      names_.push_back({offset, names_data_.size(), len, static_cast<uint32_t>(person.name.size())});
+      names_data_.append(person.name.data(), person.name.size());
+      at += cin.CurrentPosition() + len;
+      end_ = offset + len;
+      continue;
+    }
+    buf.erase(0, at);
+    at = 0;
+    const int64_t from = end_ + static_cast<int64_t>(buf.size());
+    size_t want = std::max<size_t>(kLiveReadBytes, sized ? cin.CurrentPosition() + len - buf.size() : 0);
+    want = static_cast<size_t>(std::min<int64_t>(want, st.st_size - from));
+    if (want == 0) {
+      break;  // the rest is yet to be written
+    }
+    size_t have = buf.size();
+    buf.resize(have + want);
+    ssize_t n;
+    while ((n = pread(fd_, &buf[have], want, from)) < 0 && errno == EINTR) {
+    }
+    if (n < 0) {
+      error_ = path_ + ": " + strerror(errno);
+      return false;
+    }
+    buf.resize(have + n);
+    if (n == 0) {
+      break;  // truncated meanwhile, which the next update() finds
+    }
+  }
+  if (ids_.size() - sorted_ > kLiveTail) {
+    mergeTail();
+  }
+  return true;
+}
+
+bool LiveIndex::record(const LiveRecord& r, std::string* out) const {
+  size_t at = out->size();
+  out->resize(at + r.size);
+  size_t done = 0;
+  while (done < r.size) {
+    ssize_t n = pread(fd_, &(*out)[at + done], r.size - done, static_cast<off_t>(r.offset + done));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      out->resize(at);
+      return false;
+    }
+    done += n;
+  }
+  return true;
+}
+
+bool LiveIndex::truncated() const {
+  struct stat st {};
+  return fd_ >= 0 && fstat(fd_, &st) == 0 && st.st_size < end_;
+}
+
+bool LiveIndex::nameLess(const NameEntry& a, const NameEntry& b) const {
+  int c = nameOf(a).compare(nameOf(b));
+  return c < 0 || (c == 0 && a.offset < b.offset);
+}
+
+void LiveIndex::mergeTail() {
+  // The tail is in book order, after all the sorted entries
+  auto id_less = [](const IdEntry& a, const IdEntry& b) {
+    return a.id < b.id || (a.id == b.id && a.offset < b.offset);
+  };
+  auto name_less = [this](const NameEntry& a, const NameEntry& b) { return nameLess(a, b); };
+  std::sort(ids_.begin() + sorted_, ids_.end(), id_less);
+  std::inplace_merge(ids_.begin(), ids_.begin() + sorted_, ids_.end(), id_less);
+  std::sort(names_.begin() + sorted_, names_.end(), name_less);
+  std::inplace_merge(names_.begin(), names_.begin() + sorted_, names_.end(), name_less);
+  sorted_ = ids_.size();
+}
+
+bool LiveIndex::findId(int32_t id, size_t limit, std::vector<LiveRecord>* records) const {
+  auto it = std::lower_bound(ids_.begin(), ids_.begin() + sorted_, id,
+                             [](const IdEntry& e, int32_t key) { return e.id < key; });
+  size_t found = 0;
+  for (; it != ids_.begin() + sorted_ && it->id == id; ++it, found++) {
+    if (found < limit) {
+      records->push_back({it->offset, it->size});
+    }
+  }
+  for (it = ids_.begin() + sorted_; it != ids_.end(); ++it) {
+    if (it->id == id && found++ < limit) {
+      records->push_back({it->offset, it->size});
+    }
+  }
+  return found <= limit;
+}
+
+bool LiveIndex::findNamePrefix(std::string_view prefix, size_t limit, std::vector<LiveRecord>* records) const {
+  auto starts = [&prefix](std::string_view name) { return name.substr(0, prefix.size()) == prefix; };
+  auto it = std::lower_bound(names_.begin(), names_.begin() + sorted_, prefix,
+                             [this](const NameEntry& e, std::string_view key) { return nameOf(e) < key; });
+  // Up to limit from the sorted entries, merged with the matches in the tail
+  std::vector<NameEntry> found;
+  for (; it != names_.begin() + sorted_ && starts(nameOf(*it)) && found.size() <= limit; ++it) {
+    found.push_back(*it);
+  }
+  size_t from_sorted = found.size();
+  for (it = names_.begin() + sorted_; it != names_.end(); ++it) {
+    if (starts(nameOf(*it))) {
+      found.push_back(*it);
+    }
+  }
+  if (found.size() > from_sorted) {
+    auto name_less = [this](const NameEntry& a, const NameEntry& b) { return nameLess(a, b); };
+    std::sort(found.begin() + from_sorted, found.end(), name_less);
+    std::inplace_merge(found.begin(), found.begin() + from_sorted, found.end(), name_less);
+  }
+  for (size_t i = 0; i < found.size() && i < limit; i++) {
+    records->push_back({found[i].offset, found[i].size});
+  }
+  return found.size() <= limit;
+}
+
+void LiveIndex::close() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+  end_ = 0;
+  ids_.clear();
+  names_.clear();
+  names_data_.clear();
+  sorted_ = 0;
+}
+
+}  // namespace book
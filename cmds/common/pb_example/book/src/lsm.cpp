@@ -0,0 +1,519 @@
+#include "book/lsm.hpp"
+
+#include <fcntl.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "book/blocked.hpp"
+#include "book/index.hpp"
+#include "book/person_view.hpp"
+
+namespace book {
+
+using google::protobuf::internal::WireFormatLite;
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::CodedOutputStream;
+
+namespace {
+
+constexpr uint32_t kUpsertTag =
+    WireFormatLite::MakeTag(tutorial::PersonChange::kUpsertFieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+constexpr uint32_t kDeleteTag =
+    WireFormatLite::MakeTag(tutorial::PersonChange::kDeleteIdFieldNumber, WireFormatLite::WIRETYPE_VARINT);
+
+constexpr size_t kMaxVarintBytes = 10;
+
+// Memory taken by a record in a run besides its bytes
+constexpr size_t kEntryOverhead = 32;
+
+bool decodeId(std::string_view person, int32_t* id) {
+  PersonView view;
+  if (!decodePerson(person, kFieldId, &view)) {
+    return false;
+  }
+  *id = view.id;
+  return true;
+}
+
+// Directory holding a file, to sync renames and unlinks in it
+std::string parentDir(const std::string& path) {
+  size_t slash = path.rfind('/');
+  return slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+}
+
+bool syncFile(const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  bool ok = fd >= 0 && fsync(fd) == 0;
+  if (fd >= 0) {
+    ::close(fd);
+  }
+  return ok;
+}
+
+/*
+ * Sorted runs of changes: changes are added in the order they were made,
+ * and spilled to a run file (kLog, sorted by id, latest change per id)
+ * whenever they take more than memory_bytes. So a later run always holds
+ * later changes.
+ */
+class RunBuilder {
+ public:
+  RunBuilder(std::string prefix, size_t memory_bytes) : prefix_(std::move(prefix)), memory_bytes_(memory_bytes) {}
+
+  bool add(const Change& change, std::string* error) {
+    entries_.push_back({change.id, change.deleted, bytes_.size(), change.person.size()});
+    bytes_ += change.person;
+    if (bytes_.size() + entries_.size() * kEntryOverhead >= memory_bytes_) {
+      return spill(error);
+    }
+    return true;
+  }
+
+  bool spill(std::string* error) {
+    if (entries_.empty()) {
+      return true;
+    }
+    // stable: the changes of an id stay in order, the last one wins
+    std::stable_sort(entries_.begin(), entries_.end(),
+                     [](const Entry& a, const Entry& b) { return a.id < b.id; });
+    std::string path = prefix_ + std::to_string(runs_.size());
+    runs_.push_back(path);
+    Writer writer;
+    bool ok = writer.open(path, true, Format::kLog);
+    std::string record;
+    for (size_t i = 0; ok && i < entries_.size(); i++) {
+      const Entry& e = entries_[i];
+      if (i + 1 < entries_.size() && entries_[i + 1].id == e.id) {
+        continue;
+      }
+      record.clear();
+      if (e.deleted) {
+        encodeDelete(e.id, &record);
+      } else {
+        encodeUpsert(std::string_view(bytes_).substr(e.off, e.len), &record);
+      }
+      ok = writer.appendRaw(record);
+    }
+    ok = writer.close() && ok;
+    if (!ok) {
+      *error = path + ": " + writer.error();
+    }
+    entries_.clear();
+    bytes_.clear();
+    return ok;
+  }
+
+  const std::vector<std::string>& runs() const { return runs_; }
+
+ private:
+  struct Entry {
+    int32_t id;
+    bool deleted;
+    size_t off, len;
+  };
+
+  std::string prefix_;
+  size_t memory_bytes_;
+  std::vector<Entry> entries_;
+  std::string bytes_;
+  std::vector<std::string> runs_;
+};
+
+// A file of records sorted by id, read one change at a time
+struct Source {
+  Reader reader;
+  bool log = false;
+  Change cur;
+
+  // false at the end or on error (see reader.error())
+  bool advance(std::string* error) {
+    std::string_view record;
+    if (!reader.nextRaw(&record)) {
+      return false;
+    }
+    bool ok = log ? decodeChange(record, &cur) : decodeId(record, &cur.id);
+    if (!log) {
+      cur.deleted = false;
+      cur.person = record;
+    }
+    if (!ok) {
+      *error = "malformed record before offset " + std::to_string(reader.offset());
+    }
+    return ok;
+  }
+};
+
+}  // namespace
+
+bool decodeChange(std::string_view record, Change* change) {
+  CodedInputStream cin(reinterpret_cast<const uint8_t*>(record.data()), static_cast<int>(record.size()));
+  bool found = false;
+  uint32_t tag;
+  while ((tag = cin.ReadTag()) != 0) {
+    if (tag == kUpsertTag) {
+      uint32_t len;
+      const void* data = nullptr;
+      int avail = 0;
+      if (!cin.ReadVarint32(&len) || (len && !cin.GetDirectBufferPointer(&data, &avail)) ||
+          static_cast<uint32_t>(avail) < len || !cin.Skip(static_cast<int>(len))) {
+        return false;
+      }
+      change->person = std::string_view(static_cast<const char*>(data), len);
+      change->deleted = false;
+      found = decodeId(change->person, &change->id);
+      if (!found) {
+        return false;
+      }
+    } else if (tag == kDeleteTag) {
+      uint32_t id;
+      if (!cin.ReadVarint32(&id)) {
+        return false;
+      }
+      change->id = static_cast<int32_t>(id);
+      change->deleted = true;
+      change->person = {};
+      found = true;
+    } else if (!WireFormatLite::SkipField(&cin, tag)) {
+      return false;
+    }
+  }
+  return found && cin.ConsumedEntireMessage();
+}
+
+void encodeUpsert(std::string_view person, std::string* out) {
+  char hdr[1 + kMaxVarintBytes];
+  uint8_t* end = CodedOutputStream::WriteTagToArray(kUpsertTag, reinterpret_cast<uint8_t*>(hdr));
+  end = CodedOutputStream::WriteVarint32ToArray(static_cast<uint32_t>(person.size()), end);
+  out->append(hdr, reinterpret_cast<char*>(end) - hdr);
+  out->append(person);
+}
+
+void encodeDelete(int32_t id, std::string* out) {
+  char buf[1 + kMaxVarintBytes];
+  uint8_t* end = CodedOutputStream::WriteTagToArray(kDeleteTag, reinterpret_cast<uint8_t*>(buf));
+  // int32 is sign extended on the wire
+  end = CodedOutputStream::WriteVarint64ToArray(static_cast<uint64_t>(static_cast<int64_t>(id)), end);
+  out->append(buf, reinterpret_cast<char*>(end) - buf);
+}
+
+bool ChangeLog::open(const std::string& book_path) {
+  if (!writer_.open(logPathFor(book_path), false, Format::kLog)) {
+    error_ = writer_.error();
+    return false;
+  }
+  return true;
+}
+
+bool ChangeLog::upsert(const tutorial::Person& person) {
+  *change_.mutable_upsert() = person;
+  if (!writer_.append(change_)) {
+    error_ = writer_.error();
+    return false;
+  }
+  return true;
+}
+
+bool ChangeLog::remove(int32_t id) {
+  change_.set_delete_id(id);
+  if (!writer_.append(change_)) {
+    error_ = writer_.error();
+    return false;
+  }
+  return true;
+}
+
+bool ChangeLog::close() {
+  if (!writer_.close()) {
+    error_ = writer_.error();
+    return false;
+  }
+  return true;
+}
+
+bool ChangeSet::load(const std::string& book_path) {
+  entries_.clear();
+  ids_.clear();
+  records_ = 0;
+  std::string path = logPathFor(book_path);
+  if (access(path.c_str(), F_OK) != 0) {
+    return true;
+  }
+
+  Reader reader;
+  if (!reader.open(path)) {
+    error_ = reader.error();
+    return false;
+  }
+  if (reader.format() != Format::kLog) {
+    error_ = path + ": not an address book change log";
+    return false;
+  }
+  std::string_view record;
+  Change change;
+  while (reader.nextRaw(&record)) {
+    if (!decodeChange(record, &change)) {
+      error_ = path + ": malformed change before offset " + std::to_string(reader.offset());
+      return false;
+    }
+    auto res = entries_.try_emplace(change.id);
+    if (res.second) {
+      ids_.push_back(change.id);
+    }
+    res.first->second.deleted = change.deleted;
+    res.first->second.person.assign(change.person);
+    records_++;
+  }
+  if (!reader.error().empty()) {
+    error_ = path + ": " + reader.error();
+    return false;
+  }
+  return true;
+}
+
+const ChangeSet::Entry* ChangeSet::find(int32_t id) const {
+  auto it = entries_.find(id);
+  return it == entries_.end() ? nullptr : &it->second;
+}
+
+bool MergedReader::open(const std::string& book_path, Input input) {
+  done_.clear();
+  added_ = 0;
+  base_done_ = false;
+  error_.clear();
+  if (!changes_.load(book_path)) {
+    error_ = changes_.error();
+    return false;
+  }
+  return reader_.open(book_path, input);
+}
+
+bool MergedReader::next(tutorial::Person* person) {
+  if (changes_.empty()) {
+    return reader_.next(person);
+  }
+  std::string_view record;
+  if (!read(&record)) {
+    return false;
+  }
+  if (!person->ParseFromArray(record.data(), static_cast<int>(record.size()))) {
+    error_ = "malformed person before offset " + std::to_string(reader_.offset());
+    return false;
+  }
+  return true;
+}
+
+bool MergedReader::nextRaw(std::string_view* record) {
+  return changes_.empty() ? reader_.nextRaw(record) : read(record);
+}
+
+bool MergedReader::read(std::string_view* record) {
+  while (!base_done_) {
+    int32_t id;
+    if (!reader_.nextRaw(record)) {
+      base_done_ = true;
+      if (!reader_.error().empty()) {
+        return false;
+      }
+      break;
+    }
+    if (!decodeId(*record, &id)) {
+      error_ = "malformed person before offset " + std::to_string(reader_.offset());
+      return false;
+    }
+    const ChangeSet::Entry* change = changes_.find(id);
+    if (!change) {
+      return true;
+    }
+    // The change takes the place of the first person with its id
+    if (!change->deleted && done_.insert(id).second) {
+      *record = change->person;
+      return true;
+    }
+  }
+
+  // then the people the log added
+  const auto& ids = changes_.ids();
+  while (added_ < ids.size()) {
+    int32_t id = ids[added_++];
+    const ChangeSet::Entry* change = changes_.find(id);
+    if (!change->deleted && !done_.count(id)) {
+      *record = change->person;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool compactBook(const std::string& book_path, size_t memory_bytes, CompactStats* stats, std::string* error) {
+  *stats = CompactStats();
+  std::string log_path = logPathFor(book_path);
+  std::string tmp_path = book_path + ".compact";
+  RunBuilder runs(book_path + ".run", memory_bytes);
+  auto cleanup = [&]() {
+    for (const auto& run : runs.runs()) {
+      unlink(run.c_str());
+    }
+  };
+
+  // Is the base sorted by id, one person per id? Only the ids are decoded.
+  Reader reader;
+  if (!reader.open(book_path)) {
+    *error = reader.error();
+    return false;
+  }
+  std::string_view record;
+  bool sorted = true;
+  int64_t prev = INT64_MIN;
+  int32_t id;
+  while (sorted && reader.nextRaw(&record)) {
+    if (!decodeId(record, &id)) {
+      *error = book_path + ": malformed person before offset " + std::to_string(reader.offset());
+      return false;
+    }
+    sorted = id > prev;
+    prev = id;
+  }
+  if (!reader.error().empty()) {
+    *error = book_path + ": " + reader.error();
+    return false;
+  }
+  stats->base_sorted = sorted;
+
+  // Sort what needs it into runs: the base (unless sorted), then the log
+  std::vector<std::string> inputs;
+  if (!sorted) {
+    inputs.push_back(book_path);
+  }
+  if (access(log_path.c_str(), F_OK) == 0) {
+    inputs.push_back(log_path);
+  }
+  for (const auto& path : inputs) {
+    Source src;
+    src.log = path == log_path;
+    if (!src.reader.open(path)) {
+      *error = src.reader.error();
+      cleanup();
+      return false;
+    }
+    if (src.log && src.reader.format() != Format::kLog) {
+      *error = path + ": not an address book change log";
+      cleanup();
+      return false;
+    }
+    std::string err;
+    while (src.advance(&err)) {
+      stats->changes += src.log;
+      if (!runs.add(src.cur, error)) {
+        cleanup();
+        return false;
+      }
+    }
+    if (!err.empty() || !src.reader.error().empty()) {
+      *error = path + ": " + (err.empty() ? src.reader.error() : err);
+      cleanup();
+      return false;
+    }
+  }
+  if (!runs.spill(error)) {
+    cleanup();
+    return false;
+  }
+  stats->runs = runs.runs().size();
+
+  // Merge the sorted base (lowest precedence) and the runs (later ones
+  // first): of the changes of an id, the one from the last source wins
+  std::vector<std::unique_ptr<Source>> sources;
+  auto addSource = [&](const std::string& path, bool log) {
+    sources.push_back(std::make_unique<Source>());
+    sources.back()->log = log;
+    if (!sources.back()->reader.open(path)) {
+      *error = sources.back()->reader.error();
+      return false;
+    }
+    return true;
+  };
+  if (sorted && !addSource(book_path, false)) {
+    cleanup();
+    return false;
+  }
+  for (const auto& run : runs.runs()) {
+    if (!addSource(run, true)) {
+      cleanup();
+      return false;
+    }
+  }
+  using Head = std::pair<int32_t, size_t>;  // (id, source)
+  std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+  std::string err;
+  for (size_t i = 0; i < sources.size(); i++) {
+    if (sources[i]->advance(&err)) {
+      heads.push({sources[i]->cur.id, i});
+    }
+  }
+
+  // A blocked book stays blocked
+  bool blocked = reader.format() == Format::kBlocked;
+  Writer writer;
+  BlockedWriter blocked_writer;
+  bool ok = err.empty() && (blocked ? blocked_writer.open(tmp_path) : writer.open(tmp_path, true));
+  std::vector<size_t> same;
+  while (ok && !heads.empty()) {
+    same.clear();
+    int32_t min_id = heads.top().first;
+    while (!heads.empty() && heads.top().first == min_id) {
+      same.push_back(heads.top().second);
+      heads.pop();
+    }
+    // same is in source order: the last one wins
+    const Change& winner = sources[same.back()]->cur;
+    if (!winner.deleted) {
+      ok = blocked ? blocked_writer.appendRaw(winner.person) : writer.appendRaw(winner.person);
+      stats->people++;
+    }
+    for (size_t i : same) {
+      if (sources[i]->advance(&err)) {
+        heads.push({sources[i]->cur.id, i});
+      }
+    }
+    ok = ok && err.empty();
+  }
+  for (const auto& src : sources) {
+    if (ok && !src->reader.error().empty()) {
+      err = src->reader.error();
+      ok = false;
+    }
+  }
+  ok = (blocked ? blocked_writer.close() : writer.close()) && ok;
+  stats->bytes_written = blocked ? blocked_writer.offset() : writer.offset();
+  cleanup();
+
+  // The index of the old base goes before the new base is in place, and the
+  // log after the rename is on disk: if interrupted in between, the log
+  // applies to the new base again, which changes nothing
+  std::string index_path = Index::pathFor(book_path);
+  if (!ok || !syncFile(tmp_path) || (unlink(index_path.c_str()) != 0 && errno != ENOENT) ||
+      rename(tmp_path.c_str(), book_path.c_str()) != 0 || !syncFile(parentDir(book_path))) {
+    *error = !err.empty()                      ? err
+             : !writer.error().empty()         ? tmp_path + ": " + writer.error()
+             : !blocked_writer.error().empty() ? tmp_path + ": " + blocked_writer.error()
+                                               : tmp_path + ": " + strerror(errno);
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  unlink(log_path.c_str());
+  return true;
+}
+
+}  // namespace book
@@ -0,0 +1,74 @@
+#include "book/mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+namespace book {
+
+bool MappedFile::open(const std::string& path, bool sequential) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    error_ = path + ": " + strerror(errno);
+    return false;
+  }
+  bool ok = open(fd, sequential);
+  if (!ok) {
+    error_ = path + ": " + error_;
+  }
+  ::close(fd);
+  return ok;
+}
+
+bool MappedFile::open(int fd, bool sequential) {
+  close();
+  struct stat st {};
+  if (fstat(fd, &st) != 0) {
+    error_ = strerror(errno);
+    return false;
+  }
+  if (!S_ISREG(st.st_mode)) {
+    error_ = "not a regular file";
+    return false;
+  }
+  if (st.st_size == 0) {
+    return true;
+  }
+
+  void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (p == MAP_FAILED) {
+    error_ = strerror(errno);
+    return false;
+  }
+  madvise(p, st.st_size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+  data_ = static_cast<const uint8_t*>(p);
+  size_ = st.st_size;
+  return true;
+}
+
+void MappedFile::advance(size_t off, size_t window) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t start = off & ~(page - 1);
+  if (!data_ || start > size_) {
+    return;
+  }
+  auto* base = const_cast<uint8_t*>(data_);
+  madvise(base, start, MADV_DONTNEED);
+  madvise(base + start, std::min(window, size_ - start), MADV_WILLNEED);
+}
+
+void MappedFile::close() {
+  if (data_) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+}
+
+}  // namespace book
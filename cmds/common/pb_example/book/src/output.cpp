@@ -0,0 +1,481 @@
+#include "book/output.hpp"
+
+#include <google/protobuf/util/time_util.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <string>
+
+namespace book {
+
+namespace {
+
+// Seconds of 0001-01-01T00:00:00Z and 9999-12-31T23:59:59Z
+constexpr int64_t kMinSeconds = -62135596800LL;
+constexpr int64_t kMaxSeconds = 253402300799LL;
+
+template <typename T>
+void appendInt(T v, std::string* out) {
+  char buf[24];
+  auto res = std::to_chars(buf, buf + sizeof(buf), v);
+  out->append(buf, res.ptr - buf);
+}
+
+// Zero padded to width digits
+void appendDigits(int64_t v, int width, std::string* out) {
+  char buf[24];
+  for (int i = width - 1; i >= 0; i--, v /= 10) {
+    buf[i] = static_cast<char>('0' + v % 10);
+  }
+  out->append(buf, width);
+}
+
+// RFC 3339 like TimeUtil::ToString(), without building a Timestamp or going
+// through strftime
+void appendTimestamp(int64_t seconds, int32_t nanos, std::string* out) {
+  if (seconds < kMinSeconds || seconds > kMaxSeconds || nanos < 0 || nanos > 999999999) {
+    google::protobuf::Timestamp ts;
+    ts.set_seconds(seconds);
+    ts.set_nanos(nanos);
+    *out += google::protobuf::util::TimeUtil::ToString(ts);
+    return;
+  }
+  int64_t days = seconds / 86400;
+  int64_t secs = seconds % 86400;
+  if (secs < 0) {
+    secs += 86400;
+    days--;
+  }
+  // civil_from_days() of https://howardhinnant.github.io/date_algorithms.html
+  int64_t z = days + 719468;
+  int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  int64_t doe = z - era * 146097;
+  int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  int64_t mp = (5 * doy + 2) / 153;
+  int64_t day = doy - (153 * mp + 2) / 5 + 1;
+  int64_t month = mp < 10 ? mp + 3 : mp - 9;
+  int64_t year = yoe + era * 400 + (month <= 2);
+
+  appendDigits(year, 4, out);
+  *out += '-';
+  appendDigits(month, 2, out);
+  *out += '-';
+  appendDigits(day, 2, out);
+  *out += 'T';
+  appendDigits(secs / 3600, 2, out);
+  *out += ':';
+  appendDigits(secs / 60 % 60, 2, out);
+  *out += ':';
+  appendDigits(secs % 60, 2, out);
+  // 3, 6 or 9 digits of fraction, as many as needed
+  if (nanos) {
+    *out += '.';
+    if (nanos % 1000000 == 0) {
+      appendDigits(nanos / 1000000, 3, out);
+    } else if (nanos % 1000 == 0) {
+      appendDigits(nanos / 1000, 6, out);
+    } else {
+      appendDigits(nanos, 9, out);
+    }
+  }
+  *out += 'Z';
+}
+
+const char* phoneTypeName(int type) {
+  switch (type) {
+    case tutorial::Person::MOBILE:
+      return "MOBILE";
+    case tutorial::Person::HOME:
+      return "HOME";
+    case tutorial::Person::WORK:
+      return "WORK";
+    default:
+      return nullptr;
+  }
+}
+
+void appendPhoneType(int type, std::string* out) {
+  const char* name = phoneTypeName(type);
+  if (name) {
+    *out += name;
+  } else {
+    appendInt(type, out);
+  }
+}
+
+void appendCsvField(std::string_view s, std::string* out) {
+  if (s.find_first_of(",\"\r\n") == std::string_view::npos) {
+    *out += s;
+    return;
+  }
+  *out += '"';
+  for (char c : s) {
+    if (c == '"') {
+      *out += '"';
+    }
+    *out += c;
+  }
+  *out += '"';
+}
+
+void appendJsonString(std::string_view s, std::string* out) {
+  static const char kHex[] = "0123456789abcdef";
+  *out += '"';
+  for (char c : s) {
+    auto u = static_cast<unsigned char>(c);
+    if (c == '"' || c == '\\') {
+      *out += '\\';
+      *out += c;
+    } else if (c == '\n') {
+      *out += "\\n";
+    } else if (c == '\t') {
+      *out += "\\t";
+    } else if (u < 0x20) {
+      *out += "\\u00";
+      *out += kHex[u >> 4];
+      *out += kHex[u & 0xf];
+    } else {
+      *out += c;
+    }
+  }
+  *out += '"';
+}
+
+template <typename T>
+void appendColumn(const std::vector<T>& v, std::string* out) {
+  out->append(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+}
+
+}  // namespace
+
+bool parseOutputFormat(const std::string& name, OutputFormat* format) {
+  static const struct {
+    const char* name;
+    OutputFormat format;
+  } formats[] = {{"text", OutputFormat::kText},
+                 {"csv", OutputFormat::kCsv},
+                 {"ndjson", OutputFormat::kNdjson},
+                 {"columnar", OutputFormat::kColumnar}};
+  for (const auto& f : formats) {
+    if (name == f.name) {
+      *format = f.format;
+      return true;
+    }
+  }
+  return false;
+}
+
+Formatter::Formatter(OutputFormat format, uint32_t fields) : format_(format), fields_(fields) {}
+
+void Formatter::begin(std::string* out) {
+  if (format_ != OutputFormat::kCsv) {
+    return;
+  }
+  static const struct {
+    uint32_t field;
+    const char* name;
+  } columns[] = {{kFieldId, "id"},
+                 {kFieldName, "name"},
+                 {kFieldEmail, "email"},
+                 {kFieldPhones, "phones"},
+                 {kFieldUpdated, "updated"}};
+  bool first = true;
+  for (const auto& c : columns) {
+    if (fields_ & c.field) {
+      *out += first ? "" : ",";
+      *out += c.name;
+      first = false;
+    }
+  }
+  *out += '\n';
+}
+
+void Formatter::append(const tutorial::Person& person, std::string* out) {
+  viewPerson(person, &view_);
+  append(view_, out);
+}
+
+void Formatter::append(const PersonView& person, std::string* out) {
+  switch (format_) {
+    case OutputFormat::kText:
+      appendText(person, out);
+      break;
+    case OutputFormat::kCsv:
+      appendCsv(person, out);
+      break;
+    case OutputFormat::kNdjson:
+      appendNdjson(person, out);
+      break;
+    case OutputFormat::kColumnar:
+      appendColumnar(person, out);
+      break;
+  }
+}
+
+void Formatter::appendText(const PersonView& person, std::string* out) {
+  if (fields_ & kFieldId) {
+    *out += "Person ID: ";
+    appendInt(person.id, out);
+    *out += '\n';
+  }
+  if (fields_ & kFieldName) {
+    *out += "  Name: ";
+    *out += person.name;
+    *out += '\n';
+  }
+  if ((fields_ & kFieldEmail) && !person.email.empty()) {
+    *out += "  E-mail address: ";
+    *out += person.email;
+    *out += '\n';
+  }
+  if (fields_ & kFieldPhones) {
+    for (const auto& phone : person.phones) {
+      switch (phone.type) {
+        case tutorial::Person::MOBILE:
+          *out += "  Mobile phone #: ";
+          break;
+        case tutorial::Person::HOME:
+          *out += "  Home phone #: ";
+          break;
+        case tutorial::Person::WORK:
+          *out += "  Work phone #: ";
+          break;
+        default:
+          *out += "  Unknown phone #: ";
+          break;
+      }
+      *out += phone.number;
+      *out += '\n';
+    }
+  }
+  if ((fields_ & kFieldUpdated) && person.has_updated) {
+    *out += "  Updated: ";
+    appendTimestamp(person.updated_seconds, person.updated_nanos, out);
+    *out += '\n';
+  }
+}
+
+void Formatter::appendCsv(const PersonView& person, std::string* out) {
+  const char* sep = "";
+  if (fields_ & kFieldId) {
+    appendInt(person.id, out);
+    sep = ",";
+  }
+  if (fields_ & kFieldName) {
+    *out += sep;
+    appendCsvField(person.name, out);
+    sep = ",";
+  }
+  if (fields_ & kFieldEmail) {
+    *out += sep;
+    appendCsvField(person.email, out);
+    sep = ",";
+  }
+  if (fields_ & kFieldPhones) {
+    *out += sep;
+    scratch_.clear();
+    for (const auto& phone : person.phones) {
+      scratch_ += scratch_.empty() ? "" : ";";
+      appendPhoneType(phone.type, &scratch_);
+      scratch_ += ':';
+      scratch_ += phone.number;
+    }
+    appendCsvField(scratch_, out);
+    sep = ",";
+  }
+  if (fields_ & kFieldUpdated) {
+    *out += sep;
+    if (person.has_updated) {
+      appendTimestamp(person.updated_seconds, person.updated_nanos, out);
+    }
+  }
+  *out += '\n';
+}
+
+void Formatter::appendNdjson(const PersonView& person, std::string* out) {
+  char sep = '{';
+  if (fields_ & kFieldId) {
+    *out += sep;
+    *out += "\"id\":";
+    appendInt(person.id, out);
+    sep = ',';
+  }
+  if (fields_ & kFieldName) {
+    *out += sep;
+    *out += "\"name\":";
+    appendJsonString(person.name, out);
+    sep = ',';
+  }
+  if ((fields_ & kFieldEmail) && !person.email.empty()) {
+    *out += sep;
+    *out += "\"email\":";
+    appendJsonString(person.email, out);
+    sep = ',';
+  }
+  if ((fields_ & kFieldPhones) && !person.phones.empty()) {
+    *out += sep;
+    *out += "\"phones\":[";
+    for (size_t i = 0; i < person.phones.size(); i++) {
+      *out += i ? ",{\"type\":" : "{\"type\":";
+      const char* name = phoneTypeName(person.phones[i].type);
+      if (name) {
+        *out += '"';
+        *out += name;
+        *out += '"';
+      } else {
+        appendInt(person.phones[i].type, out);
+      }
+      *out += ",\"number\":";
+      appendJsonString(person.phones[i].number, out);
+      *out += '}';
+    }
+    *out += ']';
+    sep = ',';
+  }
+  if ((fields_ & kFieldUpdated) && person.has_updated) {
+    *out += sep;
+    *out += "\"updated\":\"";
+    appendTimestamp(person.updated_seconds, person.updated_nanos, out);
+    *out += '"';
+    sep = ',';
+  }
+  if (sep == '{') {
+    *out += '{';
+  }
+  *out += "}\n";
+}
+
+void Formatter::appendColumnar(const PersonView& person, std::string* out) {
+  if (fields_ & kFieldId) {
+    ids_.push_back(person.id);
+  }
+  if (fields_ & kFieldName) {
+    names_ += person.name;
+    name_ends_.push_back(static_cast<uint32_t>(names_.size()));
+  }
+  if (fields_ & kFieldEmail) {
+    emails_ += person.email;
+    email_ends_.push_back(static_cast<uint32_t>(emails_.size()));
+  }
+  if (fields_ & kFieldPhones) {
+    for (const auto& phone : person.phones) {
+      phone_types_.push_back(phone.type);
+      numbers_ += phone.number;
+      number_ends_.push_back(static_cast<uint32_t>(numbers_.size()));
+    }
+    phone_ends_.push_back(static_cast<uint32_t>(phone_types_.size()));
+  }
+  if (fields_ & kFieldUpdated) {
+    seconds_.push_back(person.has_updated ? person.updated_seconds : 0);
+    nanos_.push_back(person.has_updated ? person.updated_nanos : 0);
+  }
+  // Keep the string offsets of a block within 32 bits too
+  if (++rows_ == kColumnarRows || names_.size() > (1U << 31) || emails_.size() > (1U << 31) ||
+      numbers_.size() > (1U << 31)) {
+    end(out);
+  }
+}
+
+void Formatter::end(std::string* out) {
+  if (format_ != OutputFormat::kColumnar || rows_ == 0) {
+    return;
+  }
+  out->append(kColumnarMagic, sizeof(kColumnarMagic));
+  uint32_t hdr[2] = {rows_, fields_ & kFieldAll};
+  out->append(reinterpret_cast<const char*>(hdr), sizeof(hdr));
+  if (fields_ & kFieldId) {
+    appendColumn(ids_, out);
+  }
+  if (fields_ & kFieldName) {
+    appendColumn(name_ends_, out);
+    *out += names_;
+  }
+  if (fields_ & kFieldEmail) {
+    appendColumn(email_ends_, out);
+    *out += emails_;
+  }
+  if (fields_ & kFieldPhones) {
+    appendColumn(phone_ends_, out);
+    appendColumn(phone_types_, out);
+    appendColumn(number_ends_, out);
+    *out += numbers_;
+  }
+  if (fields_ & kFieldUpdated) {
+    appendColumn(seconds_, out);
+    appendColumn(nanos_, out);
+  }
+
+  rows_ = 0;
+  for (auto* v : {&name_ends_, &email_ends_, &phone_ends_, &number_ends_}) {
+    v->clear();
+  }
+  for (auto* v : {&ids_, &phone_types_, &nanos_}) {
+    v->clear();
+  }
+  names_.clear();
+  emails_.clear();
+  numbers_.clear();
+  seconds_.clear();
+}
+
+OutputWriter::OutputWriter(int fd, OutputFormat format, uint32_t fields, size_t buffer_bytes)
+    : fd_(fd), formatter_(format, fields), buffer_bytes_(buffer_bytes) {
+  // room for the person that goes over buffer_bytes
+  buf_.reserve(buffer_bytes_ + buffer_bytes_ / 4);
+  formatter_.begin(&buf_);
+}
+
+void OutputWriter::write(const PersonView& person) {
+  formatter_.append(person, &buf_);
+  maybeFlush();
+}
+
+void OutputWriter::write(const tutorial::Person& person) {
+  formatter_.append(person, &buf_);
+  maybeFlush();
+}
+
+void OutputWriter::writeRaw(std::string_view bytes) {
+  buf_ += bytes;
+  maybeFlush();
+}
+
+void OutputWriter::maybeFlush() {
+  if (buf_.size() >= buffer_bytes_) {
+    flush();
+  }
+}
+
+bool OutputWriter::flush() {
+  const char* p = buf_.data();
+  size_t left = buf_.size();
+  while (left && error_.empty()) {
+    ssize_t n = ::write(fd_, p, left);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      error_ = std::string("write error: ") + strerror(errno);
+      break;
+    }
+    p += n;
+    left -= n;
+  }
+  // after an error the output is dropped
+  buf_.clear();
+  return error_.empty();
+}
+
+bool OutputWriter::close() {
+  if (!closed_) {
+    closed_ = true;
+    formatter_.end(&buf_);
+    flush();
+  }
+  return error_.empty();
+}
+
+}  // namespace book
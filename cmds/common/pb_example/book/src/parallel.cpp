@@ -0,0 +1,159 @@
+#include "book/parallel.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "book/blocked.hpp"
+#include "book/mapped_file.hpp"
+#include "book/stream.hpp"
+#include "wire_format.hpp"
+
+namespace book {
+
+namespace {
+
+// Chunks in flight per thread: enough to keep the workers busy while the
+// calling thread waits on the oldest one
+constexpr size_t kChunksPerThread = 4;
+
+struct Slot {
+  tpool_group_t group = TPOOL_GROUP_INIT;
+  const Chunk* chunk = nullptr;
+  const DecodeFn* decode = nullptr;
+  std::string out;
+  uint64_t count = 0;
+  std::string error;
+};
+
+void decodeChunk(void* arg) {
+  auto* slot = static_cast<Slot*>(arg);
+  const Chunk& chunk = *slot->chunk;
+  Reader reader;
+  if (!reader.open(chunk.path) || !reader.seek(chunk.begin)) {
+    slot->error = reader.error().empty() ? chunk.path + ": read error" : reader.error();
+    return;
+  }
+  tutorial::Person person;
+  while (reader.offset() < chunk.end && reader.next(&person)) {
+    (*slot->decode)(person, &slot->out);
+    slot->count++;
+  }
+  if (!reader.error().empty()) {
+    slot->error = chunk.path + ": " + reader.error();
+  }
+}
+
+// Chunks of whole blocks of a blocked book, by compressed size
+bool splitBlocked(const std::string& path, size_t chunk_bytes, std::vector<Chunk>* chunks, std::string* error) {
+  BlockedBook book;
+  if (!book.open(path)) {
+    *error = book.error();
+    return false;
+  }
+  for (uint32_t i = 0; i < book.size();) {
+    int64_t begin = static_cast<int64_t>(book.block(i).offset);
+    int64_t end = begin;
+    while (i < book.size() && end - begin < static_cast<int64_t>(chunk_bytes)) {
+      end = ++i < book.size() ? static_cast<int64_t>(book.block(i).offset) : book.blocksEnd();
+    }
+    chunks->push_back({path, begin, end});
+  }
+  return true;
+}
+
+}  // namespace
+
+bool splitBook(const std::string& path, size_t chunk_bytes, std::vector<Chunk>* chunks, std::string* error) {
+  MappedFile map;
+  if (!map.open(path)) {
+    *error = map.error();
+    return false;
+  }
+  const char* base = reinterpret_cast<const char*>(map.data());
+  const char* end = base + map.size();
+  bool stream = map.size() >= kStreamMagicLen && memcmp(base, kStreamMagic, kStreamMagicLen) == 0;
+  if (map.size() >= kStreamMagicLen && memcmp(base, kLogMagic, kStreamMagicLen) == 0) {
+    *error = path + ": a change log has no people (see book/lsm.hpp)";
+    return false;
+  }
+  if (map.size() >= kStreamMagicLen && memcmp(base, kBlockedMagic, kStreamMagicLen) == 0) {
+    return splitBlocked(path, chunk_bytes, chunks, error);
+  }
+
+  // Chunks end right after a record, so a chunk of a legacy book carries any
+  // other fields before its first person (Reader skips them)
+  const char* p = stream ? base + kStreamMagicLen : base;
+  const char* begin = p;
+  while (p < end) {
+    // A record of a stream book is framed like a length-delimited field
+    uint32_t tag = kPeopleTag;
+    const char* next = stream ? p : readTag(p, end, &tag);
+    bool person = tag == kPeopleTag;
+    std::string_view record;
+    if (next) {
+      next = person ? readBytes(next, end, &record) : skipField(next, end, tag, kMaxDepth);
+    }
+    if (!next) {
+      *error = path + ": malformed record at offset " + std::to_string(p - base);
+      return false;
+    }
+    p = next;
+    if (person && static_cast<size_t>(p - begin) >= chunk_bytes) {
+      chunks->push_back({path, begin - base, p - base});
+      begin = p;
+    }
+  }
+  if (p > begin) {
+    chunks->push_back({path, begin - base, p - base});
+  }
+  return true;
+}
+
+bool decodeParallel(cutils::ThreadPool& pool, const std::vector<Chunk>& chunks, const DecodeFn& decode,
+                    const EmitFn& emit, uint64_t* count, std::string* error) {
+  size_t window = std::min(chunks.size(), kChunksPerThread * (pool.size() + 1));
+  std::vector<std::unique_ptr<Slot>> slots(window);
+  auto submit = [&](size_t i) {
+    Slot* slot = slots[i % window].get();
+    slot->chunk = &chunks[i];
+    slot->out.clear();
+    slot->count = 0;
+    if (tpool_submit(pool.get(), &slot->group, decodeChunk, slot) != 0) {
+      decodeChunk(slot);
+    }
+  };
+  for (size_t i = 0; i < window; i++) {
+    slots[i] = std::make_unique<Slot>();
+    slots[i]->decode = &decode;
+    submit(i);
+  }
+
+  uint64_t total = 0;
+  size_t i = 0;
+  for (; i < chunks.size(); i++) {
+    Slot* slot = slots[i % window].get();
+    tpool_group_wait(pool.get(), &slot->group);
+    if (!slot->error.empty()) {
+      *error = slot->error;
+      break;
+    }
+    emit(slot->out);
+    total += slot->count;
+    if (i + window < chunks.size()) {
+      submit(i + window);
+    }
+  }
+  // after an error, let the chunks in flight finish before freeing them
+  for (auto& slot : slots) {
+    tpool_group_wait(pool.get(), &slot->group);
+  }
+  if (count) {
+    *count = total;
+  }
+  return i == chunks.size();
+}
+
+}  // namespace book
@@ -0,0 +1,124 @@
+#include "book/person_ref.hpp"
+
+#include <cstring>
+
+#include "wire_format.hpp"
+
+namespace book {
+
+namespace {
+
+// Whether s is ASCII, a word at a time
+inline bool isAscii(std::string_view s) {
+  uint64_t bits = 0, word;
+  size_t i = 0;
+  for (; i + 8 <= s.size(); i += 8) {
+    memcpy(&word, s.data() + i, 8);
+    bits |= word;
+  }
+  for (; i < s.size(); i++) {
+    bits |= static_cast<uint8_t>(s[i]);
+  }
+  return (bits & 0x8080808080808080ULL) == 0;
+}
+
+inline const char* readString(const char* p, const char* end, std::string_view* s) {
+  p = readBytes(p, end, s);
+  return p && (isAscii(*s) || validUtf8(*s)) ? p : nullptr;
+}
+
+}  // namespace
+
+bool PhoneCursor::next(PhoneView* phone) {
+  // Fields other than phones are skipped: decodePersonRef() checked them
+  while (p_ && p_ < end_) {
+    uint32_t tag = 0;
+    const char* p = readTag(p_, end_, &tag);
+    if (tag != kPhonesTag) {
+      p_ = skipField(p, end_, tag, kMaxDepth);
+      continue;
+    }
+    std::string_view bytes;
+    p_ = readBytes(p, end_, &bytes);
+    phone->number = {};
+    phone->type = 0;
+    bool ok = decodeMessage(bytes, kMaxDepth - 1, [phone](const char* q, const char* end, uint32_t ptag) {
+      uint64_t v = 0;
+      if (ptag == kNumberTag) {
+        return readString(q, end, &phone->number);
+      }
+      if (ptag == kTypeTag) {
+        q = readVarint(q, end, &v);
+        phone->type = static_cast<int32_t>(v);
+      }
+      return q;
+    });
+    if (!ok) {
+      error_ = true;
+      p_ = nullptr;
+    }
+    return ok;
+  }
+  return false;
+}
+
+bool decodePersonRef(std::string_view record, PersonRef* person) {
+  *person = PersonRef();
+  const char* p = record.data();
+  const char* end = p + record.size();
+  while (p < end) {
+    const char* field = p;
+    uint32_t tag;
+    uint64_t v = 0;
+    std::string_view bytes;
+    p = readTag(p, end, &tag);
+    if (!p) {
+      return false;
+    }
+    switch (tag) {
+      case kNameTag:
+        p = readString(p, end, &person->name);
+        break;
+      case kIdTag:
+        p = readVarint(p, end, &v);
+        person->id = static_cast<int32_t>(v);
+        break;
+      case kEmailTag:
+        p = readString(p, end, &person->email);
+        break;
+      case kPhonesTag:
+        if (person->phones_size++ == 0) {
+          person->phones = PhoneCursor(field, end);
+        }
+        p = readBytes(p, end, &bytes);
+        break;
+      case kUpdatedTag:
+        // Repeats of a submessage merge
+        person->has_updated = true;
+        p = readBytes(p, end, &bytes);
+        if (p && !decodeMessage(bytes, kMaxDepth - 1, [person](const char* q, const char* qend, uint32_t ttag) {
+              uint64_t tv = 0;
+              if (ttag == kSecondsTag) {
+                q = readVarint(q, qend, &tv);
+                person->updated_seconds = static_cast<int64_t>(tv);
+              } else if (ttag == kNanosTag) {
+                q = readVarint(q, qend, &tv);
+                person->updated_nanos = static_cast<int32_t>(tv);
+              }
+              return q;
+            })) {
+          return false;
+        }
+        break;
+      default:
+        p = tag != 0 ? skipField(p, end, tag, kMaxDepth) : nullptr;
+        break;
+    }
+    if (!p) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace book
@@ -0,0 +1,192 @@
+#include "book/person_view.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "wire_format.hpp"
+
+namespace book {
+
+uint32_t parseFields(const std::string& list) {
+  static const struct {
+    const char* name;
+    uint32_t field;
+  } names[] = {{"name", kFieldName},     {"id", kFieldId},           {"email", kFieldEmail},
+               {"phones", kFieldPhones}, {"updated", kFieldUpdated}, {"all", kFieldAll}};
+  uint32_t fields = 0;
+  std::istringstream in(list);
+  std::string name;
+  while (std::getline(in, name, ',')) {
+    uint32_t field = 0;
+    for (const auto& n : names) {
+      if (name == n.name) {
+        field = n.field;
+      }
+    }
+    if (!field) {
+      return 0;
+    }
+    fields |= field;
+  }
+  return fields;
+}
+
+bool decodePerson(std::string_view record, uint32_t fields, PersonView* view) {
+  if (fields & kFieldName) {
+    view->name = {};
+  }
+  if (fields & kFieldId) {
+    view->id = 0;
+  }
+  if (fields & kFieldEmail) {
+    view->email = {};
+  }
+  if (fields & kFieldPhones) {
+    view->phones.clear();
+  }
+  if (fields & kFieldUpdated) {
+    view->has_updated = false;
+    view->updated_seconds = 0;
+    view->updated_nanos = 0;
+  }
+
+  return decodeMessage(record, kMaxDepth, [&](const char* p, const char* end, uint32_t tag) -> const char* {
+    // Unwanted fields (and ones of the wrong wire type) are skipped
+    uint32_t field = WireFormatLite::GetTagFieldNumber(tag);
+    if (field < 1 || field > 5 || !(fields & (1U << (field - 1)))) {
+      return p;
+    }
+    uint64_t v = 0;
+    std::string_view sub;
+    switch (tag) {
+      case kNameTag:
+        return readBytes(p, end, &view->name);
+      case kIdTag:
+        p = readVarint(p, end, &v);
+        view->id = static_cast<int32_t>(v);
+        return p;
+      case kEmailTag:
+        return readBytes(p, end, &view->email);
+      case kPhonesTag: {
+        PhoneView& phone = view->phones.emplace_back();
+        p = readBytes(p, end, &sub);
+        bool ok = p && decodeMessage(sub, kMaxDepth - 1, [&phone](const char* q, const char* qend, uint32_t ptag) {
+          uint64_t pv = 0;
+          if (ptag == kNumberTag) {
+            return readBytes(q, qend, &phone.number);
+          }
+          if (ptag == kTypeTag) {
+            q = readVarint(q, qend, &pv);
+            phone.type = static_cast<int32_t>(pv);
+          }
+          return q;
+        });
+        return ok ? p : nullptr;
+      }
+      case kUpdatedTag: {
+        view->has_updated = true;
+        p = readBytes(p, end, &sub);
+        bool ok = p && decodeMessage(sub, kMaxDepth - 1, [view](const char* q, const char* qend, uint32_t ttag) {
+          uint64_t tv = 0;
+          if (ttag == kSecondsTag) {
+            q = readVarint(q, qend, &tv);
+            view->updated_seconds = static_cast<int64_t>(tv);
+          } else if (ttag == kNanosTag) {
+            q = readVarint(q, qend, &tv);
+            view->updated_nanos = static_cast<int32_t>(tv);
+          }
+          return q;
+        });
+        return ok ? p : nullptr;
+      }
+      default:
+        return p;
+    }
+  });
+}
+
+void viewPerson(const tutorial::Person& person, PersonView* view) {
+  view->name = person.name();
+  view->id = person.id();
+  view->email = person.email();
+  view->phones.clear();
+  for (const auto& phone : person.phones()) {
+    view->phones.push_back({phone.number(), phone.type()});
+  }
+  view->has_updated = person.has_last_updated();
+  view->updated_seconds = person.last_updated().seconds();
+  view->updated_nanos = person.last_updated().nanos();
+}
+
+bool Filter::add(const std::string& spec) {
+  if (spec == "has_email") {
+    has_email = true;
+    return true;
+  }
+  if (spec.rfind("name=", 0) == 0) {
+    // Both prefixes hold for names starting with the longer one, if it
+    // extends the other; otherwise for none, and no id either
+    std::string prefix = spec.substr(5);
+    if (prefix.size() < name_prefix.size()) {
+      std::swap(prefix, name_prefix);
+    }
+    if (prefix.compare(0, name_prefix.size(), name_prefix) == 0) {
+      name_prefix = std::move(prefix);
+    } else {
+      id_min = 1;
+      id_max = 0;
+    }
+    return true;
+  }
+  if (spec.rfind("id=", 0) != 0 || spec.size() == 3) {
+    return false;
+  }
+
+  // id=N or id=LO:HI, LO or HI optional
+  auto parse = [](const std::string& s, int64_t dflt, int64_t* v) {
+    if (s.empty()) {
+      *v = dflt;
+      return true;
+    }
+    char* end;
+    errno = 0;
+    *v = strtoll(s.c_str(), &end, 0);
+    return !*end && !errno && *v >= INT32_MIN && *v <= INT32_MAX;
+  };
+  std::string range = spec.substr(3);
+  size_t colon = range.find(':');
+  int64_t lo, hi;
+  bool ok = colon == std::string::npos
+                ? parse(range, 0, &lo) && parse(range, 0, &hi)
+                : parse(range.substr(0, colon), INT32_MIN, &lo) && parse(range.substr(colon + 1), INT32_MAX, &hi);
+  if (ok) {
+    id_min = std::max(id_min, lo);
+    id_max = std::min(id_max, hi);
+  }
+  return ok;
+}
+
+uint32_t Filter::fields() const {
+  uint32_t fields = 0;
+  if (id_min > INT32_MIN || id_max < INT32_MAX) {
+    fields |= kFieldId;
+  }
+  if (!name_prefix.empty()) {
+    fields |= kFieldName;
+  }
+  if (has_email) {
+    fields |= kFieldEmail;
+  }
+  return fields;
+}
+
+bool Filter::matches(const PersonView& person) const {
+  return person.id >= id_min && person.id <= id_max &&
+         person.name.substr(0, name_prefix.size()) == name_prefix && (!has_email || !person.email.empty());
+}
+
+}  // namespace book
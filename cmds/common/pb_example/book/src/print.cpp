@@ -0,0 +1,21 @@
+#include "book/print.hpp"
+
+#include <string>
+
+#include "book/output.hpp"
+
+namespace book {
+
+void printPerson(std::ostream& out, const tutorial::Person& person) {
+  std::string s;
+  Formatter(OutputFormat::kText).append(person, &s);
+  out << s;
+}
+
+void printPersonView(std::ostream& out, const PersonView& person, uint32_t fields) {
+  std::string s;
+  Formatter(OutputFormat::kText, fields).append(person, &s);
+  out << s;
+}
+
+}  // namespace book
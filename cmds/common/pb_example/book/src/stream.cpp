@@ -0,0 +1,411 @@
+#include "book/stream.hpp"
+
+#include <fcntl.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/util/delimited_message_util.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "book/blocked.hpp"
+
+namespace book {
+
+using google::protobuf::internal::WireFormatLite;
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::FileInputStream;
+using google::protobuf::io::FileOutputStream;
+
+namespace {
+
+// Bytes of an mapped file prefetched ahead of a Reader (and half of that is
+// how often it moves on)
+constexpr size_t kMmapWindow = 16 << 20;
+
+// Tag of AddressBook.people (field 1, length-delimited)
+constexpr uint32_t kPeopleTag = WireFormatLite::MakeTag(tutorial::AddressBook::kPeopleFieldNumber,
+                                                        WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+
+std::string errnoMsg(const std::string& what) { return what + ": " + strerror(errno); }
+
+const char* magicOf(Format format) {
+  return format == Format::kLog ? kLogMagic : format == Format::kBlocked ? kBlockedMagic : kStreamMagic;
+}
+
+Format detectFormat(int fd) {
+  char magic[kStreamMagicLen];
+  if (pread(fd, magic, sizeof(magic), 0) != static_cast<ssize_t>(sizeof(magic))) {
+    return Format::kLegacy;
+  }
+  for (auto format : {Format::kStream, Format::kLog, Format::kBlocked}) {
+    if (memcmp(magic, magicOf(format), sizeof(magic)) == 0) {
+      return format;
+    }
+  }
+  return Format::kLegacy;
+}
+
+}  // namespace
+
+Reader::~Reader() { close(); }
+
+bool Reader::open(const std::string& path, Input input) {
+  close();
+  fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd_ < 0) {
+    error_ = errnoMsg(path);
+    return false;
+  }
+
+  format_ = detectFormat(fd_);
+  offset_ = format_ == Format::kLegacy ? 0 : kStreamMagicLen;
+  BlockedFooter footer;
+  if (format_ == Format::kBlocked) {
+    if (!readBlockedFooter(fd_, &footer)) {
+      error_ = path + ": truncated or malformed blocked address book";
+      close();
+      return false;
+    }
+    blocks_end_ = static_cast<int64_t>(footer.blocks_end);
+    block_table_ = blockTablesStart(footer.blocks_end);
+    nblocks_ = footer.nblocks;
+    next_block_ = 0;
+  }
+
+  input_ = input;
+  if (input_ == Input::kMmap && !map_.open(fd_)) {
+    input_ = Input::kFd;
+  }
+  if (input_ == Input::kFstream) {
+    fstream_.open(path, std::ios::in | std::ios::binary);
+  }
+  open_ = true;
+  int64_t start = offset_;
+  offset_ = 0;
+  if (!seek(start)) {
+    error_ = path + ": read error";
+    close();
+    return false;
+  }
+  // scan from the start: let the mmap path prefetch right away
+  next_advance_ = 0;
+  return true;
+}
+
+bool Reader::seek(int64_t offset) {
+  if (!open_ || offset < 0) {
+    return false;
+  }
+  error_.clear();
+  block_.clear();
+  block_pos_ = 0;
+  if (input_ == Input::kMmap) {
+    if (static_cast<size_t>(offset) > map_.size()) {
+      return false;
+    }
+    // no prefetch for point reads; a scan from here gets it after a while
+    next_advance_ = offset + kMmapWindow / 2;
+  } else if (input_ == Input::kFd) {
+    in_.reset();
+    if (lseek(fd_, offset, SEEK_SET) != offset) {
+      return false;
+    }
+    in_ = std::make_unique<FileInputStream>(fd_);
+  } else {
+    in_.reset();
+    fstream_.clear();
+    if (!fstream_.seekg(offset)) {
+      return false;
+    }
+    in_ = std::make_unique<google::protobuf::io::IstreamInputStream>(&fstream_);
+  }
+  offset_ = offset;
+  return true;
+}
+
+bool Reader::next(tutorial::Person* person) {
+  if (format_ == Format::kLog) {
+    error_ = "a change log has no people (see book/lsm.hpp)";
+    return false;
+  }
+  // Parsing merges into the message
+  person->Clear();
+  return read(person, nullptr);
+}
+
+bool Reader::nextRaw(std::string_view* record) { return read(nullptr, record); }
+
+bool Reader::read(tutorial::Person* person, std::string_view* record) {
+  if (!open_) {
+    return false;
+  }
+  return format_ == Format::kBlocked ? readBlocked(person, record) : readFrame(person, record);
+}
+
+bool Reader::readBlocked(tutorial::Person* person, std::string_view* record) {
+  if (block_pos_ == block_.size()) {
+    // Decompress the next block (framed like a record)
+    std::string_view frame;
+    if (offset_ >= blocks_end_) {
+      return false;
+    }
+    block_offset_ = offset_;
+    if (!readFrame(nullptr, &frame)) {
+      error_ = "truncated block at offset " + std::to_string(block_offset_);
+      return false;
+    }
+    uint32_t raw_size;
+    if (!findBlock(block_offset_, &raw_size) || !inflateBlock(frame, raw_size, &block_)) {
+      error_ = "malformed block at offset " + std::to_string(block_offset_);
+      return false;
+    }
+    block_pos_ = 0;
+  }
+
+  CodedInputStream cin(reinterpret_cast<const uint8_t*>(block_.data()) + block_pos_,
+                       static_cast<int>(block_.size() - block_pos_));
+  uint32_t size;
+  bool ok = cin.ReadVarint32(&size);
+  size_t pos = block_pos_ + cin.CurrentPosition();
+  ok = ok && size <= block_.size() - pos;
+  if (ok && person) {
+    ok = person->ParseFromArray(block_.data() + pos, static_cast<int>(size));
+  } else if (ok) {
+    *record = std::string_view(block_.data() + pos, size);
+  }
+  if (!ok) {
+    error_ = "malformed record in block at offset " + std::to_string(block_offset_);
+    block_.clear();
+    block_pos_ = 0;
+    return false;
+  }
+  block_pos_ = pos + size;
+  return true;
+}
+
+bool Reader::findBlock(int64_t offset, uint32_t* raw_size) {
+  // The entry of the block at offset: the next one when reading on, binary
+  // searched (a pread a step) after a seek
+  BlockInfo info;
+  auto readInfo = [&](uint64_t i) {
+    return pread(fd_, &info, sizeof(info), block_table_ + i * sizeof(info)) == static_cast<ssize_t>(sizeof(info));
+  };
+  uint64_t lo = next_block_;
+  if (lo >= nblocks_ || !readInfo(lo) || static_cast<int64_t>(info.offset) != offset) {
+    lo = 0;
+    for (uint64_t hi = nblocks_; lo < hi;) {
+      uint64_t mid = lo + (hi - lo) / 2;
+      if (!readInfo(mid)) {
+        return false;
+      }
+      if (static_cast<int64_t>(info.offset) < offset) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    if (lo == nblocks_ || !readInfo(lo) || static_cast<int64_t>(info.offset) != offset) {
+      return false;
+    }
+  }
+  next_block_ = lo + 1;
+  *raw_size = info.raw_size;
+  return true;
+}
+
+bool Reader::readFrame(tutorial::Person* person, std::string_view* record) {
+  // A short-lived CodedInputStream per record keeps its 2GB total bytes
+  // limit from applying to the whole file
+  if (input_ == Input::kMmap) {
+    if (static_cast<size_t>(offset_) >= next_advance_) {
+      map_.advance(offset_, kMmapWindow);
+      next_advance_ = offset_ + kMmapWindow / 2;
+    }
+    size_t left = map_.size() - offset_;
+    CodedInputStream cin(map_.data() + offset_, static_cast<int>(std::min<size_t>(left, INT_MAX)));
+    return parse(&cin, person, record);
+  }
+  CodedInputStream cin(in_.get());
+  return parse(&cin, person, record);
+}
+
+bool Reader::parse(CodedInputStream* cin, tutorial::Person* person, std::string_view* record) {
+  bool clean_eof = true;
+  bool ok = false;
+  if (format_ == Format::kLegacy) {
+    // Walk the fields of the AddressBook up to the next person
+    uint32_t tag;
+    while ((tag = cin->ReadTag()) != 0 && tag != kPeopleTag) {
+      if (!WireFormatLite::SkipField(cin, tag)) {
+        break;
+      }
+    }
+    clean_eof = tag == 0 && cin->ConsumedEntireMessage();
+    if (tag != kPeopleTag) {
+      offset_ += cin->CurrentPosition();
+      if (!clean_eof) {
+        error_ = "malformed record at offset " + std::to_string(offset_);
+      }
+      return false;
+    }
+  }
+
+  // Both formats frame a person as varint size + message
+  int start = cin->CurrentPosition();
+  uint32_t size;
+  if (cin->ReadVarint32(&size)) {
+    if (person) {
+      auto limit = cin->PushLimit(static_cast<int>(size));
+      ok = person->MergeFromCodedStream(cin) && cin->ConsumedEntireMessage();
+      cin->PopLimit(limit);
+    } else {
+      // Point into the buffer of the stream when the record is all there
+      // (always so for kMmap), copy it otherwise
+      const void* data;
+      int avail;
+      if (cin->GetDirectBufferPointer(&data, &avail) && static_cast<uint32_t>(avail) >= size) {
+        *record = std::string_view(static_cast<const char*>(data), size);
+        ok = cin->Skip(static_cast<int>(size));
+      } else {
+        ok = cin->ReadString(&raw_, static_cast<int>(size));
+        *record = raw_;
+      }
+    }
+  }
+  clean_eof = format_ != Format::kLegacy && !ok && cin->CurrentPosition() == start;
+  offset_ += cin->CurrentPosition();
+  if (!ok && !clean_eof) {
+    error_ = "malformed record at offset " + std::to_string(offset_);
+  }
+  return ok;
+}
+
+void Reader::close() {
+  open_ = false;
+  block_.clear();
+  block_pos_ = 0;
+  in_.reset();
+  fstream_.close();
+  map_.close();
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+Writer::~Writer() { close(); }
+
+bool Writer::open(const std::string& path, bool truncate, Format format) {
+  close();
+  fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC | (truncate ? O_TRUNC : 0), 0644);
+  struct stat st {};
+  if (fd_ < 0 || fstat(fd_, &st) != 0) {
+    error_ = errnoMsg(path);
+    close();
+    return false;
+  }
+
+  if (format == Format::kLegacy || format == Format::kBlocked) {
+    error_ = path + (format == Format::kLegacy ? ": legacy address books can't be appended to"
+                                               : ": blocked address books are written by BlockedWriter");
+    close();
+    return false;
+  }
+  if (st.st_size == 0) {
+    if (write(fd_, magicOf(format), kStreamMagicLen) != static_cast<ssize_t>(kStreamMagicLen)) {
+      error_ = errnoMsg(path);
+      close();
+      return false;
+    }
+    offset_ = kStreamMagicLen;
+  } else {
+    Format found = detectFormat(fd_);
+    if (found != format) {
+      error_ = path + (found == Format::kBlocked    ? ": blocked address books can't be appended to"
+                       : format == Format::kStream ? ": not a stream address book (convert it with convert_book)"
+                                                   : ": not an address book change log");
+      close();
+      return false;
+    }
+    offset_ = st.st_size;
+  }
+  out_ = std::make_unique<FileOutputStream>(fd_);
+  return true;
+}
+
+bool Writer::append(const google::protobuf::MessageLite& record) {
+  if (!out_) {
+    return false;
+  }
+  int64_t before = out_->ByteCount();
+  if (!google::protobuf::util::SerializeDelimitedToZeroCopyStream(record, out_.get())) {
+    error_ = "write error";
+    return false;
+  }
+  offset_ += out_->ByteCount() - before;
+  return true;
+}
+
+bool Writer::appendRaw(std::string_view record) {
+  if (!out_) {
+    return false;
+  }
+  int64_t before = out_->ByteCount();
+  {
+    google::protobuf::io::CodedOutputStream cout(out_.get());
+    cout.WriteVarint32(static_cast<uint32_t>(record.size()));
+    cout.WriteRaw(record.data(), static_cast<int>(record.size()));
+    if (cout.HadError()) {
+      error_ = "write error";
+      return false;
+    }
+  }
+  offset_ += out_->ByteCount() - before;
+  return true;
+}
+
+bool Writer::appendFramed(std::string_view records) {
+  if (!out_) {
+    return false;
+  }
+  // What's buffered goes first, then the records straight to the file
+  if (!out_->Flush()) {
+    error_ = "write error: " + std::string(strerror(out_->GetErrno()));
+    return false;
+  }
+  for (size_t done = 0; done < records.size();) {
+    ssize_t n = write(fd_, records.data() + done, records.size() - done);
+    if (n < 0 && errno != EINTR) {
+      error_ = errnoMsg("write error");
+      return false;
+    }
+    done += n > 0 ? n : 0;
+  }
+  offset_ += records.size();
+  return true;
+}
+
+bool Writer::close() {
+  bool ok = true;
+  if (out_) {
+    ok = out_->Close();
+    if (!ok) {
+      error_ = "write error: " + std::string(strerror(out_->GetErrno()));
+    }
+    out_.reset();
+    fd_ = -1;
+  } else if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+  return ok;
+}
+
+}  // namespace book
@@ -0,0 +1,59 @@
+#include "book/synthetic.hpp"
+
+#include <string>
+
+namespace book {
+
+namespace {
+
+// splitmix64: a cheap, well mixed hash of the index
+uint64_t mix(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+const char* const kFirst[] = {"Ada", "Alan", "Barbara", "Dennis", "Edsger", "Frances", "Grace", "John",
+                              "Ken",  "Leslie", "Margaret", "Niklaus", "Radia", "Tony", "Whitfield", "Xiaowei"};
+const char* const kLast[] = {"Allen",    "Backus", "Dijkstra", "Hamilton", "Hoare",    "Hopper",
+                             "Kernighan", "Knuth", "Lamport",  "Liskov",   "Lovelace", "McCarthy",
+                             "Perlman",  "Ritchie", "Thompson", "Turing",   "Wirth",    "Zhuang"};
+
+}  // namespace
+
+void syntheticPerson(uint64_t i, tutorial::Person* person) { syntheticPerson(i, SyntheticOptions(), person); }
+
+void syntheticPerson(uint64_t i, const SyntheticOptions& options, tutorial::Person* person) {
+  uint64_t h = mix(i ^ (options.seed * 0xd1b54a32d192ed03ULL));
+  person->Clear();
+  person->set_id(static_cast<int32_t>(i));
+
+  std::string* name = person->mutable_name();
+  *name = kFirst[h % (sizeof(kFirst) / sizeof(kFirst[0]))];
+  *name += ' ';
+  *name += kLast[(h >> 8) % (sizeof(kLast) / sizeof(kLast[0]))];
+  *name += ' ';
+  *name += std::to_string(i);
+
+  // The default options keep the formulas books and benchmarks were made
+  // with: two in three people with an email, phone types off h
+  bool email = options.email_percent == SyntheticOptions().email_percent ? (h >> 16) % 3 != 0
+                                                                         : (h >> 16) % 100 < options.email_percent;
+  if (email) {
+    person->set_email(std::to_string(i) + "." + kLast[(h >> 8) % (sizeof(kLast) / sizeof(kLast[0]))] +
+                      "@example.com");
+  }
+  uint32_t span = options.max_phones > options.min_phones ? options.max_phones - options.min_phones + 1 : 1;
+  uint32_t phones = options.min_phones + static_cast<uint32_t>((h >> 24) % span);
+  for (uint64_t k = 0; k < phones; k++) {
+    uint64_t hk = mix(h + k);
+    auto* phone = person->add_phones();
+    phone->set_number("+1-555-" + std::to_string(1000000 + hk % 9000000));
+    uint64_t type = k < 4 ? h >> (32 + 2 * k) : hk >> 32;
+    phone->set_type(static_cast<tutorial::Person::PhoneType>(type % 3));
+  }
+  person->mutable_last_updated()->set_seconds(1600000000 + static_cast<int64_t>(h % 100000000));
+}
+
+}  // namespace book
@@ -0,0 +1,201 @@
+#pragma once
+
+// Protobuf wire format readers shared by the decoders of the book library
+// (person_ref.cpp, person_view.cpp, parallel.cpp, import.cpp). Internal: not
+// installed with the public headers.
+
+#include <google/protobuf/wire_format_lite.h>
+
+#include <cstdint>
+#include <string_view>
+
+#include "addressbook.pb.h"
+
+namespace book {
+
+using google::protobuf::internal::WireFormatLite;
+
+constexpr uint32_t tagOf(int field, WireFormatLite::WireType type) { return WireFormatLite::MakeTag(field, type); }
+
+constexpr uint32_t kNameTag = tagOf(tutorial::Person::kNameFieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+constexpr uint32_t kIdTag = tagOf(tutorial::Person::kIdFieldNumber, WireFormatLite::WIRETYPE_VARINT);
+constexpr uint32_t kEmailTag = tagOf(tutorial::Person::kEmailFieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+constexpr uint32_t kPhonesTag =
+    tagOf(tutorial::Person::kPhonesFieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+constexpr uint32_t kUpdatedTag =
+    tagOf(tutorial::Person::kLastUpdatedFieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+constexpr uint32_t kNumberTag =
+    tagOf(tutorial::Person::PhoneNumber::kNumberFieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+constexpr uint32_t kTypeTag = tagOf(tutorial::Person::PhoneNumber::kTypeFieldNumber, WireFormatLite::WIRETYPE_VARINT);
+constexpr uint32_t kSecondsTag =
+    tagOf(google::protobuf::Timestamp::kSecondsFieldNumber, WireFormatLite::WIRETYPE_VARINT);
+constexpr uint32_t kNanosTag = tagOf(google::protobuf::Timestamp::kNanosFieldNumber, WireFormatLite::WIRETYPE_VARINT);
+constexpr uint32_t kPeopleTag =
+    tagOf(tutorial::AddressBook::kPeopleFieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+
+// Nesting of submessages and groups libprotobuf allows by default
+constexpr int kMaxDepth = 100;
+
+// The readers below take [p, end) and return where the value ends, nullptr
+// where libprotobuf's parser fails
+
+// Up to 10 bytes, bits past 64 dropped
+inline const char* readVarint(const char* p, const char* end, uint64_t* v) {
+  if (p < end && static_cast<uint8_t>(*p) < 0x80) {
+    *v = static_cast<uint8_t>(*p);
+    return p + 1;
+  }
+  uint64_t r = 0;
+  for (int shift = 0; shift < 70 && p < end; shift += 7) {
+    uint64_t byte = static_cast<uint8_t>(*p++);
+    r |= (byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      *v = r;
+      return p;
+    }
+  }
+  return nullptr;
+}
+
+// Up to 5 bytes, bits past 32 dropped
+inline const char* readTag(const char* p, const char* end, uint32_t* tag) {
+  if (p < end && static_cast<uint8_t>(*p) < 0x80) {
+    *tag = static_cast<uint8_t>(*p);
+    return p + 1;
+  }
+  uint32_t r = 0;
+  for (int shift = 0; shift < 35 && p < end; shift += 7) {
+    uint32_t byte = static_cast<uint8_t>(*p++);
+    r |= (byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      *tag = r;
+      return p;
+    }
+  }
+  return nullptr;
+}
+
+// Length of a length-delimited field (up to 5 bytes, less than 2GB) and the
+// bytes of it
+inline const char* readBytes(const char* p, const char* end, std::string_view* bytes) {
+  uint32_t size = 0;
+  for (int shift = 0;; shift += 7) {
+    if (p == end || (shift == 28 && static_cast<uint8_t>(*p) >= 8)) {
+      return nullptr;
+    }
+    uint32_t byte = static_cast<uint8_t>(*p++);
+    size |= (byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      break;
+    }
+  }
+  if (size > static_cast<uint64_t>(end - p)) {
+    return nullptr;
+  }
+  *bytes = std::string_view(p, size);
+  return p + size;
+}
+
+// Skip an unknown field, its tag read; depth is the nesting left
+inline const char* skipField(const char* p, const char* end, uint32_t tag, int depth) {
+  uint64_t v;
+  std::string_view bytes;
+  if ((tag >> 3) == 0) {
+    return nullptr;
+  }
+  switch (tag & 7) {
+    case WireFormatLite::WIRETYPE_VARINT:
+      return readVarint(p, end, &v);
+    case WireFormatLite::WIRETYPE_FIXED64:
+      return end - p >= 8 ? p + 8 : nullptr;
+    case WireFormatLite::WIRETYPE_LENGTH_DELIMITED:
+      return readBytes(p, end, &bytes);
+    case WireFormatLite::WIRETYPE_START_GROUP:
+      if (--depth < 0) {
+        return nullptr;
+      }
+      for (;;) {
+        uint32_t inner;
+        p = readTag(p, end, &inner);
+        if (!p || inner == 0) {
+          return nullptr;
+        }
+        if ((inner & 7) == WireFormatLite::WIRETYPE_END_GROUP) {
+          return inner == tag + 1 ? p : nullptr;
+        }
+        p = skipField(p, end, inner, depth);
+        if (!p) {
+          return nullptr;
+        }
+      }
+    case WireFormatLite::WIRETYPE_FIXED32:
+      return end - p >= 4 ? p + 4 : nullptr;
+    default:
+      // an end of group outside of one, or no wire type at all
+      return nullptr;
+  }
+}
+
+// Fields of a message: fn(p, end, tag) reads the field of a tag it knows and
+// returns where it ends (nullptr if malformed), or p itself for others, which
+// are skipped
+template <typename F>
+bool decodeMessage(std::string_view bytes, int depth, F&& fn) {
+  const char* p = bytes.data();
+  const char* end = p + bytes.size();
+  while (p < end) {
+    uint32_t tag;
+    p = readTag(p, end, &tag);
+    if (!p || tag == 0) {
+      return false;
+    }
+    const char* next = fn(p, end, tag);
+    p = next != p ? next : skipField(p, end, tag, depth);
+    if (!p) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Whether s is well-formed UTF-8, as libprotobuf requires of proto3 strings:
+// no overlong forms, surrogates or code points past U+10FFFF
+inline bool validUtf8(std::string_view s) {
+  const auto* p = reinterpret_cast<const uint8_t*>(s.data());
+  const auto* end = p + s.size();
+  while (p < end) {
+    uint8_t c = *p;
+    if (c < 0x80) {
+      p++;
+      continue;
+    }
+    // The second byte of a sequence has tighter bounds for some leads
+    int n;
+    uint8_t lo = 0x80, hi = 0xbf;
+    if (c >= 0xc2 && c <= 0xdf) {
+      n = 1;
+    } else if (c >= 0xe0 && c <= 0xef) {
+      n = 2;
+      lo = c == 0xe0 ? 0xa0 : lo;
+      hi = c == 0xed ? 0x9f : hi;
+    } else if (c >= 0xf0 && c <= 0xf4) {
+      n = 3;
+      lo = c == 0xf0 ? 0x90 : lo;
+      hi = c == 0xf4 ? 0x8f : hi;
+    } else {
+      return false;
+    }
+    if (end - p <= n || p[1] < lo || p[1] > hi) {
+      return false;
+    }
+    for (int i = 2; i <= n; i++) {
+      if (p[i] < 0x80 || p[i] > 0xbf) {
+        return false;
+      }
+    }
+    p += n + 1;
+  }
+  return true;
+}
+
+}  // namespace book
@@ -0,0 +1,1258 @@
+#include <fcntl.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/gzip_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/util/time_util.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "addressbook.pb.h"
+#include "book/blocked.hpp"
+#include "book/import.hpp"
+#include "book/index.hpp"
+#include "book/live_index.hpp"
+#include "book/lsm.hpp"
+#include "book/output.hpp"
+#include "book/parallel.hpp"
+#include "book/person_ref.hpp"
+#include "book/person_view.hpp"
+#include "book/print.hpp"
+#include "book/stream.hpp"
+#include "book/synthetic.hpp"
+#include "cutils/tpool.hpp"
+
+namespace {
+
+// Allocations made so far (see operator new below)
+size_t allocations;
+
+}  // namespace
+
+void* operator new(size_t size) {
+  allocations++;
+  if (void* p = malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+namespace {
+
+tutorial::Person makePerson(int id) {
+  tutorial::Person p;
+  p.set_id(id);
+  p.set_name("Person " + std::to_string(id));
+  if (id % 2) {
+    p.set_email("p" + std::to_string(id) + "@example.com");
+  }
+  for (int i = 0; i < id % 3; i++) {
+    auto* phone = p.add_phones();
+    phone->set_number("555-" + std::to_string(id * 10 + i));
+    phone->set_type(static_cast<tutorial::Person::PhoneType>(i));
+  }
+  p.mutable_last_updated()->set_seconds(1600000000 + id);
+  return p;
+}
+
+std::vector<tutorial::Person> readAll(const std::string& path, book::Format* format) {
+  std::vector<tutorial::Person> people;
+  // Every input path reads the same records
+  for (auto input : {book::Input::kMmap, book::Input::kFd, book::Input::kFstream}) {
+    book::Reader reader;
+    bool ok = reader.open(path, input);
+    assert(ok && reader.input() == input);
+    std::vector<tutorial::Person> got;
+    tutorial::Person p;
+    while (reader.next(&p)) {
+      got.push_back(p);
+    }
+    assert(reader.error().empty());
+    if (input != book::Input::kMmap) {
+      assert(got.size() == people.size());
+      for (size_t i = 0; i < got.size(); i++) {
+        assert(got[i].SerializeAsString() == people[i].SerializeAsString());
+      }
+    }
+    people = std::move(got);
+    *format = reader.format();
+  }
+  return people;
+}
+
+void testStream(const std::string& path) {
+  // Records appended across several opens read back in order
+  for (int chunk = 0; chunk < 3; chunk++) {
+    book::Writer writer;
+    bool ok = writer.open(path, chunk == 0);
+    assert(ok);
+    for (int id = chunk * 100; id < (chunk + 1) * 100; id++) {
+      int64_t off = writer.offset();
+      ok = writer.append(makePerson(id));
+      assert(ok && writer.offset() > off);
+    }
+    ok = writer.close();
+    assert(ok);
+  }
+
+  book::Format format;
+  auto people = readAll(path, &format);
+  assert(format == book::Format::kStream);
+  assert(people.size() == 300);
+  for (int id = 0; id < 300; id++) {
+    assert(people[id].SerializeAsString() == makePerson(id).SerializeAsString());
+  }
+
+  // A truncated record is an error, not a clean end of file
+  int err = truncate(path.c_str(), book::kStreamMagicLen + 3);
+  assert(err == 0);
+  for (auto input : {book::Input::kMmap, book::Input::kFd, book::Input::kFstream}) {
+    book::Reader reader;
+    tutorial::Person p;
+    reader.open(path, input);
+    while (reader.next(&p)) {
+    }
+    assert(!reader.error().empty());
+  }
+}
+
+void testLegacy(const std::string& path) {
+  tutorial::AddressBook ab;
+  for (int id = 0; id < 50; id++) {
+    *ab.add_people() = makePerson(id);
+  }
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    ab.SerializeToOstream(&out);
+  }
+
+  book::Format format;
+  auto people = readAll(path, &format);
+  assert(format == book::Format::kLegacy);
+  assert(people.size() == 50);
+  for (int id = 0; id < 50; id++) {
+    assert(people[id].SerializeAsString() == ab.people(id).SerializeAsString());
+  }
+
+  // Legacy books aren't appended to
+  book::Writer writer;
+  bool ok = writer.open(path);
+  assert(!ok && !writer.error().empty());
+}
+
+// Check a lookup against the records of the book
+void checkLookup(const std::string& path, const book::Index& index, int id, int copies) {
+  book::Reader reader;
+  bool ok = reader.open(path);
+  assert(ok);
+  tutorial::Person p;
+  for (auto offsets : {index.findId(id), index.findName("Person " + std::to_string(id))}) {
+    assert(offsets.size() == static_cast<size_t>(copies));
+    for (size_t i = 0; i < offsets.size(); i++) {
+      assert(i == 0 || offsets[i] > offsets[i - 1]);
+      ok = reader.seek(offsets[i]) && reader.next(&p);
+      assert(ok && p.id() == id);
+    }
+  }
+}
+
+void testIndex(const std::string& path) {
+  book::Writer writer;
+  bool ok = writer.open(path, true);
+  assert(ok);
+  for (int id = 0; id < 100; id++) {
+    writer.append(makePerson(id));
+  }
+  writer.close();
+  unlink(book::Index::pathFor(path).c_str());
+
+  // Built from scratch, then appended to a few records at a time
+  book::Index index;
+  ok = index.update(path);
+  assert(ok);
+  for (int chunk = 0; chunk < 30; chunk++) {
+    ok = writer.open(path);
+    assert(ok);
+    for (int id = 100 + chunk * 100; id < 200 + chunk * 100; id++) {
+      writer.append(makePerson(id));
+    }
+    writer.append(makePerson(chunk));  // a duplicate id and name
+    writer.close();
+    ok = index.update(path);
+    assert(ok);
+  }
+  ok = index.update(path) && index.open(path);
+  assert(ok && index.size() == 3100 + 30);
+
+  // Past kMinTail records the tail was merged into the sorted arrays
+  book::IndexHeader hdr;
+  std::ifstream(book::Index::pathFor(path), std::ios::binary).read(reinterpret_cast<char*>(&hdr), sizeof(hdr));
+  assert(hdr.nsorted > 2000 && hdr.nsorted < index.size());
+
+  checkLookup(path, index, 0, 2);
+  checkLookup(path, index, 29, 2);
+  checkLookup(path, index, 30, 1);
+  checkLookup(path, index, 3099, 1);
+  assert(index.findId(3100).empty() && index.findId(-1).empty() && index.findName("nobody").empty());
+
+  // A replaced book gets a new index
+  ok = writer.open(path, true) && writer.append(makePerson(7)) && writer.close();
+  assert(ok);
+  ok = index.update(path) && index.open(path);
+  assert(ok && index.size() == 1);
+  checkLookup(path, index, 7, 1);
+  assert(index.findId(8).empty());
+
+  // So does one rewritten in place with other people, whether the last
+  // record indexed is in the sorted arrays (merged past kMinTail) or the tail
+  for (int base : {0, 1000000, 2000000}) {
+    ok = writer.open(path, true);
+    assert(ok);
+    for (int id = base; id < base + 2000; id++) {
+      writer.append(makePerson(id));
+    }
+    ok = writer.close() && index.update(path) && index.open(path);
+    assert(ok && index.size() == 2000);
+    checkLookup(path, index, base + 1999, 1);
+    assert(index.findId(base == 0 ? 1000000 : 0).empty());
+    if (base == 1000000) {
+      ok = writer.open(path) && writer.append(makePerson(7)) && writer.close() && index.update(path);
+      assert(ok);
+    }
+  }
+  unlink(book::Index::pathFor(path).c_str());
+}
+
+// Decode books in parallel and check the output against a sequential read
+void checkParallel(cutils::ThreadPool& pool, const std::vector<std::string>& paths, size_t chunk_bytes) {
+  std::string want;
+  uint64_t want_count = 0;
+  std::vector<book::Chunk> chunks;
+  std::string error;
+  for (const auto& path : paths) {
+    book::Format format;
+    for (const auto& p : readAll(path, &format)) {
+      want += p.SerializeAsString();
+      want_count++;
+    }
+    bool ok = book::splitBook(path, chunk_bytes, &chunks, &error);
+    assert(ok);
+  }
+  assert(chunks.size() > 1);
+  for (size_t i = 1; i < chunks.size(); i++) {
+    assert(chunks[i].path != chunks[i - 1].path || chunks[i].begin == chunks[i - 1].end);
+  }
+
+  std::string got;
+  uint64_t count;
+  bool ok = book::decodeParallel(
+      pool, chunks, [](const tutorial::Person& p, std::string* out) { *out += p.SerializeAsString(); },
+      [&got](const std::string& out) { got += out; }, &count, &error);
+  assert(ok && count == want_count && got == want);
+}
+
+void testParallel(const std::string& path) {
+  cutils::ThreadPool pool(3);
+  std::string shard = path + ".shard";
+
+  book::Writer writer;
+  bool ok = writer.open(path, true);
+  for (int id = 0; ok && id < 500; id++) {
+    ok = writer.append(makePerson(id));
+  }
+  ok = ok && writer.close();
+  assert(ok);
+  tutorial::AddressBook ab;
+  for (int id = 500; id < 700; id++) {
+    *ab.add_people() = makePerson(id);
+  }
+  {
+    std::ofstream out(shard, std::ios::binary | std::ios::trunc);
+    ab.SerializeToOstream(&out);
+  }
+
+  // Chunks of one record, a few records, and the whole book
+  for (size_t chunk_bytes : {1, 500, 1 << 20}) {
+    checkParallel(pool, {path, shard}, chunk_bytes);
+  }
+
+  // A truncated record is an error
+  int err = truncate(shard.c_str(), 100);
+  assert(err == 0);
+  std::vector<book::Chunk> chunks;
+  std::string error;
+  ok = book::splitBook(shard, 500, &chunks, &error);
+  assert(!ok && !error.empty());
+  unlink(shard.c_str());
+}
+
+void testPersonView(const std::string& path) {
+  book::Writer writer;
+  bool ok = writer.open(path, true);
+  for (int id = -5; ok && id < 100; id++) {
+    ok = writer.append(makePerson(id));
+  }
+  ok = ok && writer.close();
+  assert(ok);
+
+  // nextRaw() gets the serialized people on every input path, and decoding
+  // all their fields prints the same as the parsed people
+  for (auto input : {book::Input::kMmap, book::Input::kFd, book::Input::kFstream}) {
+    book::Reader reader;
+    ok = reader.open(path, input);
+    assert(ok);
+    std::string_view record;
+    book::PersonView view;
+    int id = -5;
+    for (; reader.nextRaw(&record); id++) {
+      tutorial::Person want = makePerson(id);
+      assert(record == want.SerializeAsString());
+      ok = book::decodePerson(record, book::kFieldAll, &view);
+      assert(ok && view.id == id && view.name == want.name());
+      assert(view.phones.size() == static_cast<size_t>(want.phones().size()));
+      std::ostringstream got_out, want_out;
+      book::printPersonView(got_out, view, book::kFieldAll);
+      book::printPerson(want_out, want);
+      assert(got_out.str() == want_out.str());
+
+      // Fields out of the mask are left alone
+      book::PersonView partial;
+      partial.email = "untouched";
+      ok = book::decodePerson(record, book::kFieldId | book::kFieldName, &partial);
+      assert(ok && partial.id == id && partial.name == want.name() && partial.email == "untouched");
+      assert(partial.phones.empty() && !partial.has_updated);
+    }
+    assert(id == 100 && reader.error().empty());
+  }
+
+  // Malformed people
+  std::string bytes = makePerson(7).SerializeAsString();
+  book::PersonView view;
+  ok = book::decodePerson(bytes.substr(0, bytes.size() - 1), book::kFieldAll, &view);
+  assert(!ok);
+  ok = book::decodePerson(std::string("\x0a\x05" "ab"), book::kFieldId, &view);
+  assert(!ok);
+
+  assert(book::parseFields("id,name") == (book::kFieldId | book::kFieldName));
+  assert(book::parseFields("id,nope") == 0 && book::parseFields("all") == book::kFieldAll);
+
+  book::Filter filter;
+  assert(filter.fields() == 0);
+  ok = filter.add("id=10:20") && filter.add("name=Person 1") && filter.add("has_email");
+  assert(ok && filter.fields() == (book::kFieldId | book::kFieldName | book::kFieldEmail));
+  assert(!filter.add("id=") && !filter.add("id=1:x") && !filter.add("id=99999999999") && !filter.add("age=3"));
+  int matched = 0;
+  for (int id = 0; id < 100; id++) {
+    bytes = makePerson(id).SerializeAsString();
+    ok = book::decodePerson(bytes, filter.fields(), &view);
+    assert(ok);
+    matched += filter.matches(view);
+  }
+  // odd ids 11-19 have an email
+  assert(matched == 5);
+
+  book::Filter one;
+  ok = one.add("id=:3");
+  assert(ok && one.id_min == INT32_MIN && one.id_max == 3);
+
+  // Repeated predicates all hold
+  book::Filter ids;
+  ok = ids.add("id=10:") && ids.add("id=:20") && ids.add("id=15:30");
+  assert(ok && ids.id_min == 15 && ids.id_max == 20);
+  ok = ids.add("id=42");
+  assert(ok && ids.id_min > ids.id_max);
+  book::Filter names;
+  ok = names.add("name=Person 1") && names.add("name=Person") && names.add("name=Person 12");
+  assert(ok && names.name_prefix == "Person 12");
+  tutorial::Person person = makePerson(12);
+  book::viewPerson(person, &view);
+  assert(names.matches(view));
+  ok = names.add("name=Person 2");
+  assert(ok && !names.matches(view));
+}
+
+std::string format(book::OutputFormat format, const tutorial::Person& p, uint32_t fields = book::kFieldAll) {
+  book::Formatter formatter(format, fields);
+  std::string out;
+  formatter.begin(&out);
+  formatter.append(p, &out);
+  formatter.end(&out);
+  return out;
+}
+
+void testOutput(const std::string& path) {
+  tutorial::Person p;
+  p.set_id(-3);
+  p.set_name("Doe, \"Jane\"\n\x01");
+  auto* phone = p.add_phones();
+  phone->set_number("555");
+  phone->set_type(tutorial::Person::WORK);
+  phone = p.add_phones();
+  phone->set_number("556");
+  phone->set_type(static_cast<tutorial::Person::PhoneType>(7));
+  p.mutable_last_updated()->set_seconds(1600000000);
+  p.mutable_last_updated()->set_nanos(5000000);
+
+  assert(format(book::OutputFormat::kCsv, p) ==
+         "id,name,email,phones,updated\n"
+         "-3,\"Doe, \"\"Jane\"\"\n\x01\",,WORK:555;7:556,2020-09-13T12:26:40.005Z\n");
+  assert(format(book::OutputFormat::kCsv, p, book::kFieldId | book::kFieldEmail) == "id,email\n-3,\n");
+  assert(format(book::OutputFormat::kNdjson, p) ==
+         "{\"id\":-3,\"name\":\"Doe, \\\"Jane\\\"\\n\\u0001\",\"phones\":[{\"type\":\"WORK\",\"number\":\"555\"},"
+         "{\"type\":7,\"number\":\"556\"}],\"updated\":\"2020-09-13T12:26:40.005Z\"}\n");
+  assert(format(book::OutputFormat::kNdjson, p, book::kFieldEmail) == "{}\n");
+
+  // Timestamps print like TimeUtil
+  for (int64_t seconds : {0LL, -1LL, 951782400LL, -62135596800LL, 253402300799LL, 4102444800LL}) {
+    for (int32_t nanos : {0, 1, 1000, 120000000, 999999999}) {
+      p.mutable_last_updated()->set_seconds(seconds);
+      p.mutable_last_updated()->set_nanos(nanos);
+      std::string want = "Person ID: -3\n  Updated: " +
+                         google::protobuf::util::TimeUtil::ToString(p.last_updated()) + "\n";
+      assert(format(book::OutputFormat::kText, p, book::kFieldId | book::kFieldUpdated) == want);
+    }
+  }
+
+  // Columnar blocks, read back
+  std::vector<tutorial::Person> people;
+  for (size_t id = 0; id < book::kColumnarRows + 10; id++) {
+    people.push_back(makePerson(id));
+  }
+  int fd = open(path.c_str(), O_WRONLY | O_TRUNC);
+  assert(fd >= 0);
+  {
+    book::OutputWriter out(fd, book::OutputFormat::kColumnar, book::kFieldId | book::kFieldName | book::kFieldPhones,
+                           4096);
+    for (const auto& person : people) {
+      out.write(person);
+    }
+    bool ok = out.close();
+    assert(ok);
+  }
+  close(fd);
+  std::ifstream in(path, std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  const char* q = bytes.data();
+  auto take = [&q](size_t n) {
+    const char* r = q;
+    q += n;
+    return r;
+  };
+  size_t row = 0;
+  for (size_t rows : {book::kColumnarRows, size_t{10}}) {
+    assert(memcmp(take(8), book::kColumnarMagic, 8) == 0);
+    uint32_t hdr[2];
+    memcpy(hdr, take(sizeof(hdr)), sizeof(hdr));
+    assert(hdr[0] == rows && hdr[1] == (book::kFieldId | book::kFieldName | book::kFieldPhones));
+    std::vector<int32_t> ids(rows);
+    std::vector<uint32_t> name_ends(rows), phone_ends(rows);
+    memcpy(ids.data(), take(rows * 4), rows * 4);
+    memcpy(name_ends.data(), take(rows * 4), rows * 4);
+    const char* names = take(name_ends.back());
+    memcpy(phone_ends.data(), take(rows * 4), rows * 4);
+    size_t nphones = phone_ends.back();
+    std::vector<int32_t> types(nphones);
+    std::vector<uint32_t> number_ends(nphones);
+    memcpy(types.data(), take(nphones * 4), nphones * 4);
+    memcpy(number_ends.data(), take(nphones * 4), nphones * 4);
+    const char* numbers = take(nphones ? number_ends.back() : 0);
+    for (size_t i = 0; i < rows; i++, row++) {
+      const auto& want = people[row];
+      uint32_t name_begin = i ? name_ends[i - 1] : 0;
+      assert(ids[i] == want.id() && std::string(names + name_begin, name_ends[i] - name_begin) == want.name());
+      uint32_t first = i ? phone_ends[i - 1] : 0;
+      assert(phone_ends[i] - first == static_cast<uint32_t>(want.phones_size()));
+      for (uint32_t k = first; k < phone_ends[i]; k++) {
+        uint32_t begin = k ? number_ends[k - 1] : 0;
+        assert(types[k] == want.phones(k - first).type());
+        assert(std::string(numbers + begin, number_ends[k] - begin) == want.phones(k - first).number());
+      }
+    }
+  }
+  assert(q == bytes.data() + bytes.size());
+}
+
+// Reads a book with its log applied, checking there's one person per id
+std::map<int32_t, std::string> readMerged(const std::string& path) {
+  std::map<int32_t, std::string> people;
+  book::MergedReader reader;
+  bool ok = reader.open(path);
+  assert(ok);
+  tutorial::Person p;
+  while (reader.next(&p)) {
+    ok = people.emplace(p.id(), p.SerializeAsString()).second;
+    assert(ok);
+  }
+  assert(reader.error().empty());
+  return people;
+}
+
+void checkCompacted(const std::string& path, const std::map<int32_t, std::string>& expected) {
+  assert(access(book::logPathFor(path).c_str(), F_OK) != 0);
+  book::Reader reader;
+  bool ok = reader.open(path);
+  assert(ok && reader.format() == book::Format::kStream);
+  auto it = expected.begin();
+  tutorial::Person p;
+  while (reader.next(&p)) {
+    assert(it != expected.end() && it->first == p.id() && it->second == p.SerializeAsString());
+    ++it;
+  }
+  assert(reader.error().empty() && it == expected.end());
+}
+
+void testLsm(const std::string& path) {
+  std::string log = book::logPathFor(path);
+  unlink(log.c_str());
+  std::map<int32_t, std::string> expected;
+  book::Writer writer;
+  bool ok = writer.open(path, true);
+  // not sorted by id
+  for (int i = 0; ok && i < 1000; i++) {
+    tutorial::Person p = makePerson(i * 7 % 1000);
+    expected[p.id()] = p.SerializeAsString();
+    ok = writer.append(p);
+  }
+  ok = ok && writer.close();
+  assert(ok);
+  assert(readMerged(path) == expected);
+
+  // Changes, some of them to the same id
+  book::ChangeLog changes;
+  ok = changes.open(path);
+  auto upsert = [&](int id, const std::string& name) {
+    tutorial::Person p = makePerson(id);
+    p.set_name(name);
+    expected[id] = p.SerializeAsString();
+    ok = ok && changes.upsert(p);
+  };
+  auto remove = [&](int id) {
+    expected.erase(id);
+    ok = ok && changes.remove(id);
+  };
+  upsert(10, "Ten");
+  upsert(2000, "New");
+  remove(20);
+  remove(5000);
+  upsert(30, "Thirty");
+  upsert(30, "Thirty again");
+  remove(40);
+  upsert(40, "Forty");
+  upsert(2001, "Gone");
+  remove(2001);
+  remove(-1);
+  for (int id = 100; id < 400; id++) {
+    upsert(id, "Changed " + std::to_string(id));
+  }
+  ok = ok && changes.close();
+  assert(ok);
+
+  // The log has no people of its own
+  book::Reader reader;
+  tutorial::Person p;
+  ok = reader.open(log);
+  assert(ok && reader.format() == book::Format::kLog && !reader.next(&p) && !reader.error().empty());
+  book::ChangeSet set;
+  ok = set.load(path);
+  assert(ok && set.records() == 311 && set.find(20)->deleted && !set.find(30)->deleted && !set.find(1));
+  assert(readMerged(path) == expected);
+
+  // Little memory: the base and the log are spilled in many runs
+  book::CompactStats stats;
+  std::string error;
+  ok = book::compactBook(path, 4096, &stats, &error);
+  assert(ok && error.empty());
+  assert(!stats.base_sorted && stats.runs > 10 && stats.changes == 311 && stats.people == expected.size());
+  checkCompacted(path, expected);
+  assert(readMerged(path) == expected);
+
+  // A compacted base is merged as is, with the log sorted in one run
+  ok = changes.open(path);
+  remove(0);
+  upsert(999, "Last");
+  upsert(-5, "First");
+  ok = ok && changes.close();
+  assert(ok);
+  ok = book::compactBook(path, 1 << 20, &stats, &error);
+  assert(ok && stats.base_sorted && stats.runs == 1 && stats.changes == 3);
+  checkCompacted(path, expected);
+
+  // Nothing to fold in: the book stays the same
+  ok = book::compactBook(path, 1 << 20, &stats, &error);
+  assert(ok && stats.base_sorted && stats.runs == 0 && stats.people == expected.size());
+  checkCompacted(path, expected);
+
+  // A corrupt log fails compaction and leaves the book alone
+  ok = changes.open(path);
+  upsert(3000, "Lost");
+  ok = ok && changes.close();
+  assert(ok);
+  {
+    std::ofstream out(log, std::ios::binary | std::ios::app);
+    out << "\x05" "ab";
+  }
+  ok = book::compactBook(path, 1 << 20, &stats, &error);
+  assert(!ok && !error.empty());
+  expected.erase(3000);
+  unlink(log.c_str());
+  checkCompacted(path, expected);
+}
+
+// Every id of a blocked book is found in the one block holding it
+void checkBlockedLookups(const std::string& path, int ids) {
+  book::BlockedBook book;
+  book::Reader reader;
+  bool ok = book.open(path) && reader.open(path);
+  assert(ok);
+  for (int id = 0; id < ids; id += 37) {
+    auto blocks = book.findId(id);
+    assert(blocks.size() == 1);
+    assert(book.findName("Person " + std::to_string(id)) == blocks);
+    tutorial::Person p;
+    bool hit = false;
+    ok = reader.seek(static_cast<int64_t>(book.block(blocks[0]).offset));
+    for (uint32_t i = 0; ok && i < book.block(blocks[0]).people; i++) {
+      ok = reader.next(&p);
+      hit = hit || p.SerializeAsString() == makePerson(id).SerializeAsString();
+    }
+    assert(ok && hit);
+  }
+  assert(book.findId(ids).empty() && book.findId(-1).empty() && book.findName("Nobody").empty());
+}
+
+void testBlocked(const std::string& path) {
+  std::string blocked = path + ".blocked";
+  unlink(book::logPathFor(blocked).c_str());
+  book::Writer writer;
+  bool ok = writer.open(path, true);
+  // not sorted by id
+  for (int i = 0; ok && i < 1000; i++) {
+    ok = writer.append(makePerson(i * 7 % 1000));
+  }
+  ok = ok && writer.close();
+  assert(ok);
+
+  // Small blocks: many of them
+  book::BlockedWriter bw;
+  ok = bw.open(blocked, 2048);
+  book::Reader reader;
+  ok = ok && reader.open(path);
+  std::string_view record;
+  while (ok && reader.nextRaw(&record)) {
+    ok = bw.appendRaw(record);
+  }
+  ok = ok && bw.close();
+  assert(ok && bw.blocks() > 10);
+  struct stat st {}, bst {};
+  stat(path.c_str(), &st);
+  stat(blocked.c_str(), &bst);
+  assert(bst.st_size < st.st_size);
+
+  // Read like a stream book, through every input
+  book::Format format;
+  std::vector<tutorial::Person> want = readAll(path, &format), got = readAll(blocked, &format);
+  assert(format == book::Format::kBlocked && got.size() == want.size());
+  for (size_t i = 0; i < got.size(); i++) {
+    assert(got[i].SerializeAsString() == want[i].SerializeAsString());
+  }
+  book::Writer appender;
+  ok = appender.open(blocked);
+  assert(!ok && !appender.error().empty());
+
+  // Decompressed in parallel, a chunk of one or a few blocks
+  cutils::ThreadPool pool(3);
+  for (size_t chunk_bytes : {1, 4096}) {
+    checkParallel(pool, {blocked, path}, chunk_bytes);
+  }
+  checkBlockedLookups(blocked, 1000);
+
+  // Compaction keeps the book blocked, now sorted by id (so without an ids
+  // table)
+  book::ChangeLog log;
+  ok = log.open(blocked) && log.remove(1000 - 1) && log.close();
+  book::CompactStats stats;
+  std::string error;
+  ok = ok && book::compactBook(blocked, 1 << 20, &stats, &error);
+  assert(ok && stats.people == 999);
+  ok = reader.open(blocked);
+  assert(ok && reader.format() == book::Format::kBlocked);
+  struct stat cst {};
+  stat(blocked.c_str(), &cst);
+  assert(cst.st_size < bst.st_size);
+  checkBlockedLookups(blocked, 999);
+
+  // A block whose table entry has another raw size is refused
+  int fd = open(blocked.c_str(), O_RDWR);
+  book::BlockedFooter footer;
+  book::BlockInfo info;
+  ok = fd >= 0 && book::readBlockedFooter(fd, &footer) &&
+       pread(fd, &info, sizeof(info), book::blockTablesStart(footer.blocks_end)) == sizeof(info);
+  assert(ok);
+  info.raw_size--;
+  ok = pwrite(fd, &info, sizeof(info), book::blockTablesStart(footer.blocks_end)) == sizeof(info);
+  close(fd);
+  assert(ok);
+  ok = reader.open(blocked) && !reader.next(&got[0]);
+  assert(ok && !reader.error().empty());
+  ok = bw.open(blocked, book::kMaxBlockBytes + 1);
+  assert(!ok && !bw.error().empty());
+
+  // A truncated book is refused
+  ok = bw.open(blocked) && bw.append(makePerson(1)) && bw.close();
+  assert(ok);
+  stat(blocked.c_str(), &cst);
+  int err = truncate(blocked.c_str(), cst.st_size - 1);
+  assert(err == 0);
+  ok = reader.open(blocked);
+  assert(!ok && !reader.error().empty());
+  book::BlockedBook book;
+  ok = book.open(blocked);
+  assert(!ok);
+  unlink(blocked.c_str());
+}
+
+// Blocks inflate to exactly the size given, and no further
+void testInflate() {
+  std::string raw(32 << 20, 'x'), deflated;
+  {
+    google::protobuf::io::StringOutputStream str(&deflated);
+    google::protobuf::io::GzipOutputStream::Options opts;
+    opts.format = google::protobuf::io::GzipOutputStream::ZLIB;
+    google::protobuf::io::GzipOutputStream out(&str, opts);
+    google::protobuf::io::CodedOutputStream(&out).WriteRaw(raw.data(), static_cast<int>(raw.size()));
+    bool ok = out.Close();
+    assert(ok && deflated.size() < (1 << 20));
+  }
+  std::string got;
+  for (uint32_t size : {100u, static_cast<uint32_t>(book::kMaxBlockBytes)}) {
+    bool ok = book::inflateBlock(deflated, size, &got);
+    assert(!ok && got.size() <= size);
+  }
+  bool ok = book::inflateBlock(deflated, static_cast<uint32_t>(raw.size()), &got);
+  assert(!ok && got.empty());
+
+  raw.resize(1 << 20);
+  deflated.clear();
+  {
+    google::protobuf::io::StringOutputStream str(&deflated);
+    google::protobuf::io::GzipOutputStream::Options opts;
+    opts.format = google::protobuf::io::GzipOutputStream::ZLIB;
+    google::protobuf::io::GzipOutputStream out(&str, opts);
+    google::protobuf::io::CodedOutputStream(&out).WriteRaw(raw.data(), static_cast<int>(raw.size()));
+    ok = out.Close();
+    assert(ok);
+  }
+  ok = book::inflateBlock(deflated, (1 << 20) + 1, &got);
+  assert(!ok);
+  ok = book::inflateBlock(deflated, 1 << 20, &got);
+  assert(ok && got == raw);
+}
+
+void testSynthetic() {
+  tutorial::Person a, b;
+  book::SyntheticOptions options;
+  int emails = 0;
+  for (uint64_t i = 0; i < 1000; i++) {
+    book::syntheticPerson(i, &a);
+    book::syntheticPerson(i, options, &b);
+    assert(a.SerializeAsString() == b.SerializeAsString() && a.id() == static_cast<int32_t>(i));
+    assert(a.phones_size() <= 3);
+    emails += !a.email().empty();
+  }
+  assert(emails > 600 && emails < 740);
+
+  // The default people stay those of the books and benchmarks made before
+  // the options existed
+  std::string all;
+  for (uint64_t i = 0; i < 1000; i++) {
+    book::syntheticPerson(i, &a);
+    all += a.SerializeAsString();
+  }
+  assert(book::Index::nameKey(all) == 0xa039574bc9248d59ULL);
+
+  options.email_percent = 0;
+  options.min_phones = options.max_phones = 2;
+  for (uint64_t i = 0; i < 100; i++) {
+    book::syntheticPerson(i, options, &a);
+    assert(a.email().empty() && a.phones_size() == 2);
+  }
+  options.seed = 1;
+  book::syntheticPerson(7, options, &b);
+  book::syntheticPerson(7, book::SyntheticOptions(), &a);
+  assert(a.SerializeAsString() != b.SerializeAsString());
+}
+
+std::string varint(uint64_t v) {
+  std::string out;
+  for (; v >= 0x80; v >>= 7) {
+    out += static_cast<char>(v | 0x80);
+  }
+  return out + static_cast<char>(v);
+}
+
+std::string lengthDelimited(uint32_t field, const std::string& bytes) {
+  return varint(field << 3 | 2) + varint(bytes.size()) + bytes;
+}
+
+// decodePersonRef() takes a record if and only if libprotobuf does, and
+// decodes the same fields; returns whether it took it
+bool checkPersonRef(const std::string& record) {
+  tutorial::Person want;
+  bool parsed = want.ParseFromString(record);
+  book::PersonRef ref;
+  bool ok = book::decodePersonRef(record, &ref);
+  book::PhoneCursor phones = ref.phones;
+  book::PhoneView phone;
+  int n = 0;
+  for (; ok && phones.next(&phone); n++) {
+    assert(!parsed || (n < want.phones_size() && phone.number == want.phones(n).number() &&
+                       phone.type == want.phones(n).type()));
+  }
+  ok = ok && !phones.error();
+  assert(ok == parsed);
+  if (parsed) {
+    assert(n == want.phones_size() && ref.phones_size == static_cast<uint32_t>(n));
+    assert(ref.name == want.name() && ref.id == want.id() && ref.email == want.email());
+    assert(ref.has_updated == want.has_last_updated());
+    assert(ref.updated_seconds == want.last_updated().seconds() && ref.updated_nanos == want.last_updated().nanos());
+  }
+  return parsed;
+}
+
+// A random field of a random wire type (of a known number or not)
+std::string randomField(std::mt19937& rng) {
+  auto pick = [&rng](uint32_t n) { return std::uniform_int_distribution<uint32_t>(0, n)(rng); };
+  uint32_t field = pick(1) ? pick(6) : pick(1 << 20);
+  uint32_t type = pick(7);
+  std::string out = varint(field << 3 | type);
+  std::string bytes(pick(6), 0);
+  for (auto& c : bytes) {
+    c = static_cast<char>(pick(1) ? 'a' + pick(25) : pick(255));
+  }
+  switch (type) {
+    case 0:
+      return out + varint(static_cast<uint64_t>(rng()) << pick(40));
+    case 1:
+      return out + std::string(8, 'x');
+    case 2:
+      return out + varint(bytes.size()) + bytes;
+    case 3:
+      return out + (pick(1) ? randomField(rng) : bytes) + varint(field << 3 | 4);
+    case 5:
+      return out + "abcd";
+    default:
+      return out + bytes;
+  }
+}
+
+// A record with a few random changes
+std::string mutate(std::string s, std::mt19937& rng) {
+  auto pick = [&rng](uint32_t n) { return std::uniform_int_distribution<uint32_t>(0, n)(rng); };
+  for (uint32_t ops = 1 + pick(2); ops > 0; ops--) {
+    size_t at = s.empty() ? 0 : pick(s.size() - 1);
+    switch (pick(7)) {
+      case 0:
+        if (!s.empty()) {
+          s[at] ^= static_cast<char>(1 << pick(7));
+        }
+        break;
+      case 1:
+        if (!s.empty()) {
+          s[at] = static_cast<char>(pick(255));
+        }
+        break;
+      case 2:
+        s.resize(at);
+        break;
+      case 3:
+        s.insert(at, 1, static_cast<char>(pick(255)));
+        break;
+      case 4:
+        s.erase(at, pick(3));
+        break;
+      case 5:
+        // repeated fields: scalars take the last, submessages merge
+        s += s.substr(0, at);
+        break;
+      case 6:
+        s += lengthDelimited(tutorial::Person::kPhonesFieldNumber,
+                             pick(1) ? randomField(rng) : randomField(rng) + randomField(rng));
+        break;
+      default:
+        s += randomField(rng);
+        break;
+    }
+  }
+  return s;
+}
+
+void testPersonRef() {
+  google::protobuf::LogSilencer silence;  // libprotobuf logs bad UTF-8
+
+  std::vector<std::string> records;
+  for (int i = -50; i < 200; i++) {
+    tutorial::Person p = makePerson(i);
+    if (i % 3 == 0) {
+      book::syntheticPerson(i, &p);
+    }
+    records.push_back(p.SerializeAsString());
+    bool ok = checkPersonRef(records.back());
+    assert(ok);
+  }
+
+  // Nothing is allocated, phones included
+  size_t before = allocations;
+  book::PersonRef ref;
+  book::PhoneView phone;
+  uint64_t phones = 0;
+  for (const auto& record : records) {
+    bool ok = book::decodePersonRef(record, &ref);
+    assert(ok);
+    for (book::PhoneCursor cursor = ref.phones; cursor.next(&phone);) {
+      phones++;
+    }
+  }
+  assert(allocations == before && phones > 100);
+
+  // Mutated records
+  std::mt19937 rng(42);
+  int taken = 0;
+  for (int i = 0; i < 100000; i++) {
+    taken += checkPersonRef(mutate(records[rng() % records.size()], rng));
+  }
+  assert(taken > 10000 && taken < 90000);
+
+  // Corners of the wire format and UTF-8
+  const std::string name = varint(1 << 3 | 2);
+  const std::string group(1, 6 << 3 | 3), end_group(1, 6 << 3 | 4);
+  const struct {
+    std::string record;
+    bool ok;
+  } cases[] = {
+      {name + "\x02" "ab", true},
+      {name + std::string("\x82\x80\x80\x80\x00" "ab", 7), true},      // overlong size
+      {name + std::string("\x82\x80\x80\x80\x80\x00" "ab", 8), false},  // longer than 5 bytes
+      {std::string("\x10") + "\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01", true},
+      {std::string("\x10") + "\xff\xff\xff\xff\xff\xff\xff\xff\xff\x81\x01", false},
+      {std::string("\x90\x80\x80\x80\x00\x05", 6), true},  // overlong tag of id
+      {std::string("\x00", 1), false},
+      {"\x01" "abcdefgh", false},  // field 0
+      {end_group, false},
+      {"\x37", false},  // wire type 7
+      {group + end_group, true},
+      {group + std::string(1, 7 << 3 | 4), false},
+      {std::string(100, group[0]) + std::string(100, end_group[0]), true},
+      {std::string(101, group[0]) + std::string(101, end_group[0]), false},
+      {lengthDelimited(4, std::string(99, group[0]) + std::string(99, end_group[0])), true},
+      {lengthDelimited(4, std::string(100, group[0]) + std::string(100, end_group[0])), false},
+      {lengthDelimited(4, std::string("\x00", 1)), false},
+      {lengthDelimited(4, end_group), false},
+      {lengthDelimited(5, "\x08\x01") + lengthDelimited(5, "\x10\x02"), true},
+      {lengthDelimited(1, "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80"), true},
+      {lengthDelimited(1, std::string("a\0b", 3)), true},
+      {lengthDelimited(1, "\xc0\x80"), false},          // overlong
+      {lengthDelimited(1, "\xe0\x9f\xbf"), false},      // overlong
+      {lengthDelimited(1, "\xed\xa0\x80"), false},      // surrogate
+      {lengthDelimited(1, "\xf4\x90\x80\x80"), false},  // past U+10FFFF
+      {lengthDelimited(1, "\xf5\x80\x80\x80"), false},
+      {lengthDelimited(1, "abcdefgh\xc3"), false},        // cut short
+      {lengthDelimited(1, "\x80"), false},
+      {lengthDelimited(3, "\xff"), false},
+      {lengthDelimited(4, lengthDelimited(1, "\xff")), false},
+      {lengthDelimited(4, lengthDelimited(1, "\xef\xbf\xbf")), true},
+  };
+  for (const auto& c : cases) {
+    bool ok = checkPersonRef(c.record);
+    assert(ok == c.ok);
+  }
+}
+
+// Import text into a new book at path, people read back into got
+bool importText(const std::string& path, book::ImportFormat format, const std::string& text, size_t batch_bytes,
+                std::vector<tutorial::Person>* got, std::string* error) {
+  const std::string input = path + ".in";
+  std::ofstream(input, std::ios::trunc | std::ios::binary) << text;
+  int fd = open(input.c_str(), O_RDONLY);
+  assert(fd >= 0);
+  cutils::ThreadPool pool(3);
+  book::Writer writer;
+  book::ImportStats stats;
+  bool ok = writer.open(path, true);
+  assert(ok);
+  ok = book::importPeople(fd, format, pool, &writer, &stats, error, batch_bytes);
+  ok = writer.close() && ok;
+  close(fd);
+  unlink(input.c_str());
+  // a record too long stops the reads
+  assert(stats.bytes_read == text.size() || !ok);
+  book::Format f;
+  *got = readAll(path, &f);
+  assert(!ok || got->size() == stats.people);
+  return ok;
+}
+
+void testImport(const std::string& path) {
+  std::vector<tutorial::Person> people;
+  for (int i = 0; i < 300; i++) {
+    people.push_back(makePerson(i));
+    if (i % 2 == 0) {
+      book::syntheticPerson(i, &people.back());
+    }
+  }
+  people[5].set_name("Quote \"me\", twice\r\nand\tagain \xc3\xa9");
+  people[6].set_email("a,b@example.com");
+  people[7].mutable_phones(0)->set_type(static_cast<tutorial::Person::PhoneType>(7));
+
+  // What list_people writes imports back as is, in any batch size
+  for (auto format : {book::OutputFormat::kCsv, book::OutputFormat::kNdjson}) {
+    book::Formatter formatter(format);
+    std::string text;
+    formatter.begin(&text);
+    for (const auto& p : people) {
+      formatter.append(p, &text);
+    }
+    formatter.end(&text);
+    auto import_format = format == book::OutputFormat::kCsv ? book::ImportFormat::kCsv : book::ImportFormat::kNdjson;
+    for (size_t batch_bytes : {size_t{1}, size_t{1000}, book::kImportBatchBytes}) {
+      std::vector<tutorial::Person> got;
+      std::string error;
+      bool ok = importText(path, import_format, text, batch_bytes, &got, &error);
+      assert(ok && error.empty() && got.size() == people.size());
+      for (size_t i = 0; i < got.size(); i++) {
+        assert(got[i].SerializeAsString() == people[i].SerializeAsString());
+      }
+    }
+  }
+
+  // Columns in any order, unknown ones ignored, CRLF, blank lines and no
+  // line end at the end
+  std::vector<tutorial::Person> got;
+  std::string error;
+  bool ok = importText(path, book::ImportFormat::kCsv,
+                       "name,extra,id,phones\r\n\"A, \"\"B\"\"\",\"x\ny\",3,HOME:1;2:22\r\n\nC,,-4,", 1, &got, &error);
+  assert(ok && got.size() == 2);
+  assert(got[0].name() == "A, \"B\"" && got[0].id() == 3 && got[0].phones_size() == 2);
+  assert(got[0].phones(0).type() == tutorial::Person::HOME && got[0].phones(1).number() == "22");
+  assert(got[1].name() == "C" && got[1].id() == -4 && got[1].phones_size() == 0);
+  ok = importText(path, book::ImportFormat::kNdjson,
+                  "{\"id\": 9, \"x\": [1, {\"y\": null}], \"name\": \"\\u00e9\\ud83d\\ude00\", "
+                  "\"phones\": [{\"type\": 2, \"number\": \"5\"}]}\n",
+                  1000, &got, &error);
+  assert(ok && got.size() == 1 && got[0].id() == 9 && got[0].name() == "\xc3\xa9\xf0\x9f\x98\x80");
+  assert(got[0].phones(0).type() == tutorial::Person::WORK);
+
+  // A bad record is named, and nothing from its batch on is written
+  const std::string csv = "id,name\n1,a\n2,b\nx,c\n4,d\n";
+  ok = importText(path, book::ImportFormat::kCsv, csv, 1, &got, &error);
+  assert(!ok && error.find("record 3") == 0 && got.size() == 2);
+  for (const char* bad : {"id,name\n1,a,b\n", "id,name\n1\n", "id,name\n1,\"a\n", "id,updated\n1,yesterday\n",
+                          "id,phones\n1,555\n", "id,id\n"}) {
+    ok = importText(path, book::ImportFormat::kCsv, bad, 1000, &got, &error);
+    assert(!ok && !error.empty() && got.empty());
+  }
+  // A quote opens a quoted field only at the start of one; a record may be
+  // up to kMaxImportRecordBytes, not buffered past it
+  ok = importText(path, book::ImportFormat::kCsv, "id,name\n1,a\"b\n2,\"c\"\"\n\"\n", 1, &got, &error);
+  assert(ok && got.size() == 2 && got[0].name() == "a\"b" && got[1].name() == "c\"\n");
+  std::string long_name(book::kMaxImportRecordBytes, 'x');
+  ok = importText(path, book::ImportFormat::kCsv, "id,name\n1,a\n2,\"" + long_name + "\n3,b\n" + long_name, 1, &got,
+                  &error);
+  assert(!ok && error == "record 2: longer than 1048576 bytes (unbalanced quotes?)" && got.size() == 1);
+  ok = importText(path, book::ImportFormat::kNdjson, "{\"name\": \"" + long_name + "\"}\n", 1000, &got, &error);
+  assert(!ok && error == "record 1: longer than 1048576 bytes" && got.empty());
+  for (const char* bad : {"{\"id\": 1\n", "{\"id\": \"1\"}\n", "[]\n", "{\"name\": \"\\x\"}\n", "{} {}\n"}) {
+    ok = importText(path, book::ImportFormat::kNdjson, bad, 1000, &got, &error);
+    assert(!ok && error.find("record 1") == 0 && got.empty());
+  }
+
+  // Strings must be UTF-8: Latin-1, overlong forms, encoded or unpaired
+  // surrogates and code points past U+10FFFF are refused
+  for (const char* bad : {"caf\xe9", "\xc0\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xe2\x82"}) {
+    ok = importText(path, book::ImportFormat::kCsv, std::string("id,name\n1,a\n2,") + bad + "\n", 1, &got, &error);
+    assert(!ok && error == "record 2: invalid UTF-8 in column 2" && got.size() == 1);
+    ok = importText(path, book::ImportFormat::kNdjson, std::string("{\"name\": \"") + bad + "\"}\n", 1000, &got,
+                    &error);
+    assert(!ok && error == "record 1: invalid UTF-8 in a string" && got.empty());
+  }
+  for (const char* bad : {"\\udc00", "\\udfff", "\\ud800", "\\ud800x", "\\ud800\\u0041"}) {
+    ok = importText(path, book::ImportFormat::kNdjson, std::string("{\"email\": \"") + bad + "\"}\n", 1000, &got,
+                    &error);
+    assert(!ok && error == "record 1: invalid UTF-8 in a string" && got.empty());
+  }
+}
+
+// The people of LiveIndex records, as ids
+std::vector<int32_t> liveIds(const book::LiveIndex& index, const std::vector<book::LiveRecord>& records) {
+  std::vector<int32_t> ids;
+  tutorial::Person p;
+  std::string record;
+  for (const auto& r : records) {
+    record.clear();
+    bool ok = index.record(r, &record) && p.ParseFromString(record);
+    assert(ok);
+    ids.push_back(p.id());
+  }
+  return ids;
+}
+
+void testLiveIndex(const std::string& path) {
+  book::Writer writer;
+  bool ok = writer.open(path, true);
+  assert(ok);
+  for (int id = 0; id < 100; id++) {
+    writer.append(makePerson(id));
+  }
+  writer.append(makePerson(7));  // a duplicate id and name
+  writer.close();
+
+  book::LiveIndex index;
+  ok = index.open(path);
+  assert(ok && index.size() == 101);
+  std::vector<book::LiveRecord> records;
+  ok = index.findId(7, 10, &records);
+  assert(ok && liveIds(index, records) == std::vector<int32_t>({7, 7}) && records[0].offset < records[1].offset);
+  records.clear();
+  ok = index.findId(7, 1, &records);
+  assert(!ok && records.size() == 1);
+  records.clear();
+  ok = index.findId(100, 10, &records) && index.findNamePrefix("nobody", 10, &records);
+  assert(ok && records.empty());
+
+  // By name: "Person 1" is 1, 10..19 (but not 2 or 100+ yet), in name order
+  ok = index.findNamePrefix("Person 1", 100, &records);
+  assert(ok && liveIds(index, records) == std::vector<int32_t>({1, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19}));
+  records.clear();
+  ok = index.findNamePrefix("Person 1", 3, &records);
+  assert(!ok && liveIds(index, records) == std::vector<int32_t>({1, 10, 11}));
+  records.clear();
+  ok = index.findNamePrefix("", 1000, &records);
+  assert(ok && records.size() == 101);
+  records.clear();
+
+  // Appends are picked up by update(), a few at a time in the tail, then
+  // merged into the sorted arrays past kLiveTail
+  for (int chunk = 0; chunk < 3; chunk++) {
+    ok = writer.open(path);
+    assert(ok);
+    for (size_t id = 100 + chunk * book::kLiveTail; id < 100 + (chunk + 1) * book::kLiveTail; id += 2) {
+      writer.append(makePerson(static_cast<int>(id)));
+    }
+    writer.append(makePerson(1));
+    writer.close();
+    ok = index.update();
+    assert(ok && index.end() == writer.offset());
+  }
+  ok = index.findId(1, 10, &records);
+  assert(ok && liveIds(index, records) == std::vector<int32_t>({1, 1, 1, 1}));
+  records.clear();
+  ok = index.findId(100 + 2 * book::kLiveTail, 10, &records);
+  assert(ok && records.size() == 1);
+  records.clear();
+  ok = index.findNamePrefix("Person 100", 100, &records);
+  assert(ok && liveIds(index, records) == std::vector<int32_t>({100, 1000, 1002, 1004, 1006, 1008}));
+  records.clear();
+  ok = index.findNamePrefix("Person 1", 4, &records);
+  assert(!ok && liveIds(index, records) == std::vector<int32_t>({1, 1, 1, 1}));
+  records.clear();
+
+  // A record still being written waits until it's whole
+  std::string framed = makePerson(-5).SerializeAsString();
+  framed.insert(0, 1, static_cast<char>(framed.size()));
+  int64_t end = index.end();
+  uint64_t size = index.size();
+  int fd = open(path.c_str(), O_WRONLY | O_APPEND);
+  assert(fd >= 0);
+  ssize_t n = write(fd, framed.data(), 5);
+  assert(n == 5);
+  ok = index.update() && index.findId(-5, 10, &records);
+  assert(ok && records.empty() && index.end() == end && index.size() == size);
+  n = write(fd, framed.data() + 5, framed.size() - 5);
+  assert(n == static_cast<ssize_t>(framed.size() - 5));
+  close(fd);
+  ok = index.update() && index.findId(-5, 10, &records);
+  assert(ok && liveIds(index, records) == std::vector<int32_t>({-5}) && index.size() == size + 1);
+
+  // A shrunk book is an error, a legacy one isn't taken
+  assert(!index.truncated());
+  int err = truncate(path.c_str(), end);
+  assert(err == 0 && index.truncated());
+  ok = index.update();
+  assert(!ok && !index.error().empty());
+  // The records past the new end fail to read rather than fault, as the
+  // server reads them after checking truncated()
+  std::string record = "kept";
+  ok = index.record(records[0], &record);
+  assert(!ok && record == "kept");
+  records.clear();
+  ok = index.findId(1, 10, &records) && index.record(records[0], &record);
+  assert(ok && record.size() == 4 + records[0].size);
+  records.clear();
+
+  // Nor while the book is truncated and regrown under the reads
+  ok = index.findNamePrefix("", 10000, &records);
+  assert(ok && records.size() == index.size());
+  std::atomic<bool> done{false};
+  std::thread shrinker([&] {
+    while (!done) {
+      int rc = truncate(path.c_str(), book::kStreamMagicLen) | truncate(path.c_str(), end);
+      assert(rc == 0);
+    }
+  });
+  for (int pass = 0; pass < 50; pass++) {
+    for (const auto& r : records) {
+      record.clear();
+      index.record(r, &record);  // short or zeros, whichever it meets
+    }
+  }
+  done = true;
+  shrinker.join();
+  records.clear();
+  tutorial::AddressBook ab;
+  *ab.add_people() = makePerson(1);
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << ab.SerializeAsString();
+  ok = index.open(path);
+  assert(!ok && !index.error().empty() && !index.isOpen() && !index.truncated());
+}
+
+}  // namespace
+
+int main() {
+  char tmpl[] = "/tmp/book_test.XXXXXX";
+  int fd = mkstemp(tmpl);
+  assert(fd >= 0);
+  close(fd);
+
+  testStream(tmpl);
+  testLegacy(tmpl);
+  testIndex(tmpl);
+  testParallel(tmpl);
+  testPersonView(tmpl);
+  testOutput(tmpl);
+  testLsm(tmpl);
+  testBlocked(tmpl);
+  testInflate();
+  testSynthetic();
+  testImport(tmpl);
+  testPersonRef();
+  testLiveIndex(tmpl);
+  unlink(tmpl);
+
+  // Gets here only if above test passes
+  printf("PASSED\n");
+  return 0;
+}
@@ -1,12 +1,22 @@
 // See README.txt for information and build instructions.
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
-#include <fstream>
 #include <google/protobuf/util/time_util.h>
 #include <iostream>
 #include <string>
 
 #include "addressbook.pb.h"
+#include "book/import.hpp"
+#include "book/index.hpp"
+#include "book/lsm.hpp"
+#include "book/stream.hpp"
+#include "cutils/tpool.hpp"
 
 using namespace std;
 
@@ -57,42 +67,150 @@ void PromptForAddress(tutorial::Person* person) {
   *person->mutable_last_updated() = TimeUtil::SecondsToTimestamp(time(NULL));
 }
 
-// Main function:  Reads the entire address book from a file,
-//   adds one person based on user input, then writes it back out to the same
-//   file.
+// Most threads an import runs on
+constexpr long kMaxThreads = 1024;
+
+// Appends the people of a CSV or NDJSON file (or stdin) in bulk, converting
+//   them on a thread pool (see book/import.hpp).
+int ImportPeople(int argc, char* argv[]) {
+  book::ImportFormat format;
+  long threads = 0;
+  int arg = 2;
+  char* end = nullptr;
+  bool valid = true;
+  if (argc > 3 && string(argv[2]) == "--threads") {
+    // 0 for one per CPU
+    errno = 0;
+    threads = strtol(argv[3], &end, 0);
+    valid = end != argv[3] && !*end && errno == 0 && threads >= 0 && threads <= kMaxThreads;
+    arg = 4;
+  }
+  if (!valid || !book::parseImportFormat(string(argv[1]).substr(strlen("--import=")), &format) ||
+      argc - arg < 1 || argc - arg > 2) {
+    cerr << "Usage:  " << argv[0] << " --import=csv|ndjson [--threads N] ADDRESS_BOOK_FILE [FILE|-]" << endl;
+    return -1;
+  }
+  const string path = argv[arg];
+  const string input = argc - arg == 2 ? argv[arg + 1] : "-";
+
+  // The people go to the end of the book; they'd overtake the changes of a
+  // log (and blocked books can't be appended to)
+  if (access(book::logPathFor(path).c_str(), F_OK) == 0) {
+    cerr << path << ": has a change log; run compact_book first" << endl;
+    return -1;
+  }
+  int fd = input == "-" ? STDIN_FILENO : open(input.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    perror(input.c_str());
+    return -1;
+  }
+  book::Writer writer;
+  if (!writer.open(path)) {
+    cerr << writer.error() << endl;
+    return -1;
+  }
+
+  cutils::ThreadPool pool(static_cast<unsigned int>(threads));
+  book::ImportStats stats;
+  string error;
+  bool ok = book::importPeople(fd, format, pool, &writer, &stats, &error);
+  if (!writer.close() && ok) {
+    error = writer.error();
+    ok = false;
+  }
+  if (fd != STDIN_FILENO) {
+    close(fd);
+  }
+  if (!ok) {
+    cerr << "Failed to import " << input << ": " << error << " (" << stats.people << " people imported)" << endl;
+    return -1;
+  }
+  cerr << "Imported " << stats.people << " people" << endl;
+
+  book::Index index;
+  if (!index.update(path)) {
+    cerr << "Warning: failed to update index: " << index.error() << endl;
+  }
+  google::protobuf::ShutdownProtobufLibrary();
+  return 0;
+}
+
+// Main function:  Appends one person based on user input to the address
+//   book file (a stream book, see book/stream.hpp), without reading or
+//   rewriting the people already in it. With --replace or --delete, or once
+//   the book has a change log (or is blocked), the change goes to the log (see
+//   book/lsm.hpp). --import appends people in bulk instead.
 int main(int argc, char* argv[]) {
   // Verify that the version of the library that we linked against is
   // compatible with the version of the headers we compiled against.
   GOOGLE_PROTOBUF_VERIFY_VERSION;
 
-  if (argc != 2) {
-    cerr << "Usage:  " << argv[0] << " ADDRESS_BOOK_FILE" << endl;
-    return -1;
+  if (argc > 1 && string(argv[1]).rfind("--import=", 0) == 0) {
+    return ImportPeople(argc, argv);
   }
 
-  tutorial::AddressBook address_book;
-
-  {
-    // Read the existing address book.
-    fstream input(argv[1], ios::in | ios::binary);
-    if (!input) {
-      cout << argv[1] << ": File not found.  Creating a new file." << endl;
-    } else if (!address_book.ParseFromIstream(&input)) {
-      cerr << "Failed to parse address book." << endl;
+  string mode = argc > 2 ? argv[1] : "";
+  bool valid = argc == 2 || (argc == 3 && mode == "--replace");
+  long delete_id = 0;
+  if (argc == 4 && mode == "--delete") {
+    // IDs are int32 (see addressbook.proto)
+    char* end = nullptr;
+    errno = 0;
+    delete_id = strtol(argv[2], &end, 0);
+    valid = end != argv[2] && !*end && errno == 0 && delete_id >= INT32_MIN && delete_id <= INT32_MAX;
+  }
+  if (!valid) {
+    cerr << "Usage:  " << argv[0] << " [--replace | --delete ID] ADDRESS_BOOK_FILE" << endl;
+    cerr << "        " << argv[0] << " --import=csv|ndjson [--threads N] ADDRESS_BOOK_FILE [FILE|-]" << endl;
+    return -1;
+  }
+  const string path = argv[argc - 1];
+
+  // Blocked books can't be appended to (see book/blocked.hpp)
+  book::Reader probe;
+  bool blocked = probe.open(path) && probe.format() == book::Format::kBlocked;
+  probe.close();
+  bool logged = !mode.empty() || blocked || access(book::logPathFor(path).c_str(), F_OK) == 0;
+  if (logged) {
+    // Updates and deletes are appended to the log of the book, which the
+    // readers apply on the fly until compact_book folds it in
+    book::ChangeLog log;
+    bool ok = log.open(path);
+    if (ok && mode == "--delete") {
+      ok = log.remove(static_cast<int32_t>(delete_id));
+    } else if (ok) {
+      tutorial::Person person;
+      PromptForAddress(&person);
+      ok = log.upsert(person);
+    }
+    if (!log.close() || !ok) {
+      cerr << "Failed to write change log: " << log.error() << endl;
       return -1;
     }
+    google::protobuf::ShutdownProtobufLibrary();
+    return 0;
+  }
+
+  book::Writer writer;
+  if (!writer.open(path)) {
+    cerr << writer.error() << endl;
+    return -1;
   }
 
   // Add an address.
-  PromptForAddress(address_book.add_people());
+  tutorial::Person person;
+  PromptForAddress(&person);
 
-  {
-    // Write the new address book back to disk.
-    fstream output(argv[1], ios::out | ios::trunc | ios::binary);
-    if (!address_book.SerializeToOstream(&output)) {
-      cerr << "Failed to write address book." << endl;
-      return -1;
-    }
+  if (!writer.append(person) || !writer.close()) {
+    cerr << "Failed to write address book: " << writer.error() << endl;
+    return -1;
+  }
+
+  // Index the new person (lookup_person would catch up on its own, but
+  // add_person runs once per person anyway)
+  book::Index index;
+  if (!index.update(path)) {
+    cerr << "Warning: failed to update index: " << index.error() << endl;
   }
 
   // Optional:  Delete all global objects allocated by libprotobuf.
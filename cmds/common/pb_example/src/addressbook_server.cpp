@@ -0,0 +1,521 @@
+// Answers lookups of an address book from memory over a Unix domain socket:
+// the book is indexed once (see book/live_index.hpp) and followed as people
+// are appended to it, so a lookup costs microseconds instead of a scan of the
+// book. Clients send batches of queries (see proto/query.proto).
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "book/live_index.hpp"
+#include "book/lsm.hpp"
+#include "query.pb.h"
+
+namespace {
+
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::CodedOutputStream;
+
+// People returned by a query that sets no limit
+constexpr uint32_t kDefaultLimit = 100;
+// Largest --limit
+constexpr long kMaxLimit = 1 << 20;
+// Largest QueryBatch taken
+constexpr uint32_t kMaxRequestBytes = 16 << 20;
+// Size of a ResultBatch past which the people are left out (and their
+// queries marked truncated), well within the varint32 it's framed by
+constexpr uint32_t kMaxResponseBytes = 64 << 20;
+// Bytes of requests read from a connection before answering them: enough for
+// the largest one and its size
+constexpr size_t kMaxInputBytes = kMaxRequestBytes + 16;
+// Bytes of responses waiting for a client to read them, past which its
+// requests aren't answered (nor read) until it does
+constexpr size_t kMaxOutputBytes = 16 << 20;
+constexpr int kMaxEvents = 64;
+constexpr size_t kReadBytes = 64 << 10;
+
+void usage(const char* prog) {
+  std::cerr << "Usage:  " << prog << " [-s|--socket PATH] [-l|--limit N] ADDRESS_BOOK_FILE" << std::endl
+            << "  -s, --socket=PATH  Unix domain socket to listen on (default ADDRESS_BOOK_FILE.sock)" << std::endl
+            << "  -l, --limit=N      People returned by a query that sets no limit, and the most any query"
+            << std::endl
+            << "                     returns (default " << kDefaultLimit << ", at most " << kMaxLimit << ")"
+            << std::endl;
+}
+
+void appendVarint(uint32_t v, std::string* out) {
+  uint8_t buf[5];  // the longest varint32
+  out->append(reinterpret_cast<char*>(buf), CodedOutputStream::WriteVarint32ToArray(v, buf) - buf);
+}
+
+// A ResultBatch of an error, framed
+void appendError(const std::string& message, std::string* out) {
+  tutorial::ResultBatch error;
+  error.set_error(message);
+  appendVarint(static_cast<uint32_t>(error.ByteSizeLong()), out);
+  error.AppendToString(out);
+}
+
+struct Connection {
+  int fd;
+  std::string in;   // bytes of requests read so far
+  std::string out;  // framed responses, written up to out_pos
+  size_t out_pos = 0;
+  uint32_t events = EPOLLIN | EPOLLRDHUP;  // waited for
+  bool eof = false;  // the client is done sending
+};
+
+class Server {
+ public:
+  ~Server();
+
+  bool open(const std::string& book, const std::string& socket_path, uint32_t limit);
+  bool run();
+
+ private:
+  void addFd(int fd, uint32_t events);
+  void accept();
+  void onBookEvents();
+  bool reload();
+  void reloadOrKeep();
+  // false to close the connection
+  bool onReadable(Connection* conn);
+  bool serve(Connection* conn);
+  bool flush(Connection* conn);
+  void close(Connection* conn);
+  void answer(std::string_view request, std::string* out);
+
+  std::string book_, book_name_, socket_path_;
+  uint32_t limit_ = kDefaultLimit;
+  // Replaced whole by reload(), so a failed one leaves it be
+  std::unique_ptr<book::LiveIndex> index_ = std::make_unique<book::LiveIndex>();
+  int epfd_ = -1, listen_fd_ = -1, inotify_fd_ = -1, signal_fd_ = -1;
+  std::unordered_map<int, std::unique_ptr<Connection>> conns_;
+
+  // Reused by answer()
+  tutorial::QueryBatch batch_;
+  std::vector<book::LiveRecord> records_;
+  std::string body_, result_;
+  uint64_t queries_ = 0;
+};
+
+Server::~Server() {
+  for (auto& conn : conns_) {
+    ::close(conn.first);
+  }
+  for (int fd : {epfd_, listen_fd_, inotify_fd_, signal_fd_}) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+  if (listen_fd_ >= 0) {
+    unlink(socket_path_.c_str());
+  }
+}
+
+void Server::addFd(int fd, uint32_t events) {
+  struct epoll_event ev {};
+  ev.events = events;
+  ev.data.fd = fd;
+  epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
+}
+
+bool Server::open(const std::string& book, const std::string& socket_path, uint32_t limit) {
+  book_ = book;
+  socket_path_ = socket_path;
+  limit_ = limit;
+  if (access(book::logPathFor(book).c_str(), F_OK) == 0) {
+    std::cerr << book << ": has a change log; run compact_book first" << std::endl;
+    return false;
+  }
+  auto t0 = std::chrono::steady_clock::now();
+  if (!index_->open(book)) {
+    std::cerr << index_->error() << std::endl;
+    return false;
+  }
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  std::cerr << "Indexed " << index_->size() << " people in " << ms << " ms" << std::endl;
+
+  // Appends show as modifications of the book in its directory, and a book
+  // rewritten by compact_book or convert_book as one moved over it
+  size_t slash = book.rfind('/');
+  std::string dir = slash == std::string::npos ? "." : book.substr(0, slash + 1);
+  book_name_ = book.substr(slash == std::string::npos ? 0 : slash + 1);
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ < 0 || inotify_add_watch(inotify_fd_, dir.c_str(), IN_MODIFY | IN_MOVED_TO | IN_CREATE) < 0) {
+    perror(dir.c_str());
+    return false;
+  }
+
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  sigprocmask(SIG_BLOCK, &mask, nullptr);
+  signal_fd_ = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+  struct sockaddr_un addr {};
+  addr.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << socket_path << ": socket path too long" << std::endl;
+    return false;
+  }
+  strcpy(addr.sun_path, socket_path.c_str());
+  unlink(socket_path.c_str());
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0 || bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      listen(listen_fd_, SOMAXCONN) != 0) {
+    perror(socket_path.c_str());
+    return false;
+  }
+
+  epfd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epfd_ < 0 || signal_fd_ < 0) {
+    perror("epoll_create1");
+    return false;
+  }
+  addFd(listen_fd_, EPOLLIN);
+  addFd(inotify_fd_, EPOLLIN);
+  addFd(signal_fd_, EPOLLIN);
+  return true;
+}
+
+bool Server::run() {
+  struct epoll_event evs[kMaxEvents];
+  for (;;) {
+    int n = epoll_wait(epfd_, evs, kMaxEvents, -1);
+    if (n < 0 && errno != EINTR) {
+      perror("epoll_wait");
+      return false;
+    }
+    for (int i = 0; i < n; i++) {
+      int fd = evs[i].data.fd;
+      if (fd == signal_fd_) {
+        std::cerr << "Answered " << queries_ << " queries" << std::endl;
+        return true;
+      }
+      if (fd == listen_fd_) {
+        accept();
+        continue;
+      }
+      if (fd == inotify_fd_) {
+        onBookEvents();
+        continue;
+      }
+      auto it = conns_.find(fd);
+      if (it == conns_.end()) {
+        continue;
+      }
+      Connection* conn = it->second.get();
+      bool ok = !(evs[i].events & (EPOLLERR | EPOLLHUP)) || (evs[i].events & EPOLLIN);
+      if (ok && (evs[i].events & (EPOLLIN | EPOLLRDHUP))) {
+        ok = onReadable(conn);
+      } else if (ok && (evs[i].events & EPOLLOUT)) {
+        ok = serve(conn);
+      }
+      if (!ok) {
+        close(conn);
+      }
+    }
+  }
+}
+
+void Server::accept() {
+  int fd;
+  while ((fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+    auto conn = std::make_unique<Connection>();
+    conn->fd = fd;
+    addFd(fd, conn->events);
+    conns_[fd] = std::move(conn);
+  }
+}
+
+void Server::onBookEvents() {
+  alignas(struct inotify_event) char buf[4096];
+  bool grown = false, replaced = false;
+  ssize_t n;
+  while ((n = read(inotify_fd_, buf, sizeof(buf))) > 0) {
+    for (char* p = buf; p < buf + n;) {
+      auto* ev = reinterpret_cast<struct inotify_event*>(p);
+      std::string name = ev->len ? ev->name : "";
+      if (name == book_name_) {
+        grown |= (ev->mask & IN_MODIFY) != 0;
+        replaced |= (ev->mask & (IN_MOVED_TO | IN_CREATE)) != 0;
+      } else if (name == book_name_ + ".log" && (ev->mask & IN_CREATE)) {
+        std::cerr << "Warning: " << book_ << " has a change log now, whose changes aren't served" << std::endl;
+      }
+      p += sizeof(struct inotify_event) + ev->len;
+    }
+  }
+  if (replaced || (grown && !index_->isOpen())) {
+    reloadOrKeep();
+  } else if (grown && !index_->update()) {
+    std::cerr << index_->error() << std::endl;
+    reloadOrKeep();
+  }
+}
+
+bool Server::reload() {
+  auto t0 = std::chrono::steady_clock::now();
+  auto index = std::make_unique<book::LiveIndex>();
+  if (!index->open(book_)) {
+    std::cerr << "Failed to reload: " << index->error() << std::endl;
+    return false;
+  }
+  index_ = std::move(index);
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  std::cerr << "Reindexed " << index_->size() << " people in " << ms << " ms" << std::endl;
+  return true;
+}
+
+// The index of a book replaced or rewritten in place: a new one, else the
+// previous one as long as the people it holds are still in the book
+void Server::reloadOrKeep() {
+  if (reload()) {
+    return;
+  }
+  if (index_->truncated()) {
+    std::cerr << "Not serving " << book_ << " until it can be indexed again" << std::endl;
+    index_->close();
+  } else if (index_->isOpen()) {
+    std::cerr << "Serving the previous index of " << book_ << std::endl;
+  }
+}
+
+bool Server::onReadable(Connection* conn) {
+  // The rest waits for the next EPOLLIN, once the requests read are answered
+  while (!conn->eof && conn->in.size() < kMaxInputBytes) {
+    size_t at = conn->in.size();
+    conn->in.resize(at + kReadBytes);
+    ssize_t n = read(conn->fd, &conn->in[at], kReadBytes);
+    conn->in.resize(at + std::max<ssize_t>(n, 0));
+    if (n == 0) {
+      // Shut down (or closed): the requests sent before still get answers
+      conn->eof = true;
+      break;
+    }
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+  }
+  return serve(conn);
+}
+
+// Answer the whole requests read, in order, while the responses waiting to be
+// written stay under kMaxOutputBytes, and write them
+bool Server::serve(Connection* conn) {
+  bool more = true;
+  while (more) {
+    // Drop what's written once it's as long as the rest, which is then moved
+    // no more than once per byte written
+    if (conn->out_pos >= conn->out.size() - conn->out_pos) {
+      conn->out.erase(0, conn->out_pos);
+      conn->out_pos = 0;
+    }
+    more = false;
+    size_t pos = 0;
+    while (pos < conn->in.size()) {
+      if (conn->out.size() - conn->out_pos >= kMaxOutputBytes) {
+        more = true;
+        break;
+      }
+      CodedInputStream cin(reinterpret_cast<const uint8_t*>(conn->in.data()) + pos,
+                           static_cast<int>(std::min<size_t>(conn->in.size() - pos, INT_MAX)));
+      uint32_t size;
+      if (!cin.ReadVarint32(&size)) {
+        break;
+      }
+      if (size > kMaxRequestBytes) {
+        return false;
+      }
+      size_t start = pos + cin.CurrentPosition();
+      if (conn->in.size() - start < size) {
+        break;
+      }
+      answer(std::string_view(conn->in).substr(start, size), &conn->out);
+      pos = start + size;
+    }
+    conn->in.erase(0, pos);
+    if (!flush(conn)) {
+      return false;
+    }
+    // Answer on at once if the client took all of it
+    more = more && conn->out.empty();
+  }
+  // All answered: what's left of a client done sending is part of a request
+  if (conn->eof && conn->out.empty()) {
+    return false;
+  }
+
+  // Read on while the client keeps up with the responses, and wait for room
+  // only while there's something left to write
+  uint32_t events = 0;
+  if (!conn->eof && conn->out.size() - conn->out_pos < kMaxOutputBytes) {
+    events |= EPOLLIN | EPOLLRDHUP;
+  }
+  if (!conn->out.empty()) {
+    events |= EPOLLOUT;
+  }
+  if (events != conn->events) {
+    struct epoll_event ev {};
+    ev.events = events;
+    ev.data.fd = conn->fd;
+    epoll_ctl(epfd_, EPOLL_CTL_MOD, conn->fd, &ev);
+    conn->events = events;
+  }
+  return true;
+}
+
+bool Server::flush(Connection* conn) {
+  while (conn->out_pos < conn->out.size()) {
+    ssize_t n = send(conn->fd, conn->out.data() + conn->out_pos, conn->out.size() - conn->out_pos, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    if (n < 0) {
+      return false;
+    }
+    conn->out_pos += n;
+  }
+  if (conn->out_pos == conn->out.size()) {
+    conn->out.clear();
+    conn->out_pos = 0;
+  }
+  return true;
+}
+
+void Server::close(Connection* conn) {
+  int fd = conn->fd;
+  epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+  ::close(fd);
+  conns_.erase(fd);
+}
+
+void Server::answer(std::string_view request, std::string* out) {
+  // The people are copied into the ResultBatch as the bytes they are in the
+  // book: a QueryResult's repeated Person is a series of length-delimited
+  // records on the wire
+  if (!batch_.ParseFromArray(request.data(), static_cast<int>(request.size()))) {
+    appendError("malformed QueryBatch", out);
+    return;
+  }
+  // A book truncated since it was indexed no longer holds all its people
+  if (index_->truncated()) {
+    std::cerr << book_ << ": shrank below the people indexed" << std::endl;
+    reloadOrKeep();
+  }
+  if (!index_->isOpen()) {
+    appendError("address book unavailable", out);
+    return;
+  }
+  body_.clear();
+  for (const auto& query : batch_.queries()) {
+    records_.clear();
+    size_t limit = query.limit() ? std::min(query.limit(), limit_) : limit_;
+    bool complete = true;
+    if (query.key_case() == tutorial::Query::kId) {
+      complete = index_->findId(query.id(), limit, &records_);
+    } else if (query.key_case() == tutorial::Query::kNamePrefix) {
+      complete = index_->findNamePrefix(query.name_prefix(), limit, &records_);
+    }
+    result_.clear();
+    for (const auto& r : records_) {
+      if (body_.size() + result_.size() + r.size > kMaxResponseBytes) {
+        complete = false;
+        break;
+      }
+      result_ += static_cast<char>(tutorial::QueryResult::kPeopleFieldNumber << 3 | 2);
+      appendVarint(r.size, &result_);
+      if (!index_->record(r, &result_)) {
+        // Truncated after the check above
+        std::cerr << book_ << ": shrank below the people indexed" << std::endl;
+        appendError("address book unavailable", out);
+        reloadOrKeep();
+        return;
+      }
+    }
+    if (!complete) {
+      result_ += static_cast<char>(tutorial::QueryResult::kTruncatedFieldNumber << 3);
+      result_ += '\1';
+    }
+    body_ += static_cast<char>(tutorial::ResultBatch::kResultsFieldNumber << 3 | 2);
+    appendVarint(static_cast<uint32_t>(result_.size()), &body_);
+    body_ += result_;
+  }
+  queries_ += batch_.queries_size();
+  appendVarint(static_cast<uint32_t>(body_.size()), out);
+  *out += body_;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+  std::string socket_path;
+  long limit = kDefaultLimit;
+  static const struct option long_opts[] = {{"socket", required_argument, nullptr, 's'},
+                                            {"limit", required_argument, nullptr, 'l'},
+                                            {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "s:l:", long_opts, nullptr)) != -1) {
+    if (opt == 's') {
+      socket_path = optarg;
+      continue;
+    }
+    char* end = nullptr;
+    if (opt == 'l') {
+      errno = 0;
+      limit = strtol(optarg, &end, 0);
+    }
+    if (opt != 'l' || end == optarg || *end || errno != 0 || limit <= 0 || limit > kMaxLimit) {
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  if (optind != argc - 1) {
+    usage(argv[0]);
+    return -1;
+  }
+  const std::string book = argv[optind];
+  if (socket_path.empty()) {
+    socket_path = book + ".sock";
+  }
+
+  bool ok;
+  {
+    Server server;
+    ok = server.open(book, socket_path, static_cast<uint32_t>(limit)) && server.run();
+  }
+  google::protobuf::ShutdownProtobufLibrary();
+  return ok ? 0 : -1;
+}
@@ -0,0 +1,64 @@
+// Folds the change log of an address book (see book/lsm.hpp) into the book,
+// leaving a book sorted by id with one person per id and no log.
+
+#include <getopt.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "book/lsm.hpp"
+
+namespace {
+
+// Default memory for sorting, in MB
+constexpr long kDefaultMemoryMb = 64;
+
+void usage(const char* prog) {
+  std::cerr << "Usage:  " << prog << " [-m|--memory MB] ADDRESS_BOOK_FILE" << std::endl
+            << "  -m, --memory=MB  Memory for sorting changes before spilling them to disk (default "
+            << kDefaultMemoryMb << ")" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+  long memory_mb = kDefaultMemoryMb;
+  static const struct option long_opts[] = {{"memory", required_argument, nullptr, 'm'}, {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "m:", long_opts, nullptr)) != -1) {
+    // In MB, so that it still fits in a size_t in bytes
+    char* end = nullptr;
+    errno = 0;
+    memory_mb = opt == 'm' ? strtol(optarg, &end, 0) : 0;
+    if (opt != 'm' || end == optarg || *end || errno != 0 || memory_mb <= 0 ||
+        static_cast<unsigned long>(memory_mb) > (SIZE_MAX >> 20)) {
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  if (optind != argc - 1) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  auto t0 = std::chrono::steady_clock::now();
+  book::CompactStats stats;
+  std::string error;
+  if (!book::compactBook(argv[optind], static_cast<size_t>(memory_mb) << 20, &stats, &error)) {
+    std::cerr << "Failed to compact address book: " << error << std::endl;
+    return -1;
+  }
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  std::cerr << "people: " << stats.people << ", changes: " << stats.changes << ", runs: " << stats.runs
+            << (stats.base_sorted ? " (base already sorted)" : "") << ", written: " << stats.bytes_written
+            << " bytes, " << ms << " ms" << std::endl;
+
+  google::protobuf::ShutdownProtobufLibrary();
+  return 0;
+}
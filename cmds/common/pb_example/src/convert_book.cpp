@@ -0,0 +1,97 @@
+// Migrates an address book to the stream format (see book/stream.hpp), or with
+// --blocked to the block-compressed format (see book/blocked.hpp). The input is
+// read one person at a time, so memory use doesn't grow with the size of the
+// book.
+
+#include <getopt.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "addressbook.pb.h"
+#include "book/blocked.hpp"
+#include "book/stream.hpp"
+
+namespace {
+
+void usage(const char* prog) {
+  std::cerr << "Usage:  " << prog << " [-b|--blocked[=KB]] IN_ADDRESS_BOOK_FILE OUT_ADDRESS_BOOK_FILE" << std::endl
+            << "  -b, --blocked[=KB]  Write compressed blocks of KB uncompressed (default "
+            << (book::kDefaultBlockBytes >> 10) << ", at most " << (book::kMaxBlockBytes >> 10) << ")" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+  size_t block_bytes = 0;
+  static const struct option long_opts[] = {{"blocked", optional_argument, nullptr, 'b'}, {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "b::", long_opts, nullptr)) != -1) {
+    char* end = nullptr;
+    errno = 0;
+    long kb = opt != 'b' ? 0 : optarg ? strtol(optarg, &end, 0) : static_cast<long>(book::kDefaultBlockBytes >> 10);
+    if (kb <= 0 || (optarg && (end == optarg || *end || errno != 0)) ||
+        static_cast<unsigned long>(kb) > (book::kMaxBlockBytes >> 10)) {
+      usage(argv[0]);
+      return -1;
+    }
+    block_bytes = static_cast<size_t>(kb) << 10;
+  }
+  if (optind != argc - 2) {
+    usage(argv[0]);
+    return -1;
+  }
+  const std::string in_path = argv[optind], out_path = argv[optind + 1];
+  if (in_path == out_path) {
+    std::cerr << "Input and output must be different files" << std::endl;
+    return -1;
+  }
+
+  book::Reader reader;
+  book::Writer writer;
+  book::BlockedWriter blocked;
+  if (!reader.open(in_path)) {
+    std::cerr << reader.error() << std::endl;
+    return -1;
+  }
+  if (reader.format() == book::Format::kLog) {
+    std::cerr << in_path << ": a change log has no people (see book/lsm.hpp)" << std::endl;
+    return -1;
+  }
+  if (block_bytes ? !blocked.open(out_path, block_bytes) : !writer.open(out_path, true)) {
+    std::cerr << (block_bytes ? blocked.error() : writer.error()) << std::endl;
+    return -1;
+  }
+
+  // Records are copied as is, without parsing them
+  std::string_view record;
+  uint64_t count = 0;
+  while (reader.nextRaw(&record)) {
+    if (block_bytes ? !blocked.appendRaw(record) : !writer.appendRaw(record)) {
+      std::cerr << out_path << ": " << (block_bytes ? blocked.error() : writer.error()) << std::endl;
+      return -1;
+    }
+    count++;
+  }
+  if (!reader.error().empty()) {
+    std::cerr << in_path << ": " << reader.error() << std::endl;
+    return -1;
+  }
+  if (block_bytes ? !blocked.close() : !writer.close()) {
+    std::cerr << out_path << ": " << (block_bytes ? blocked.error() : writer.error()) << std::endl;
+    return -1;
+  }
+  std::cout << "Converted " << count << " people";
+  if (block_bytes) {
+    std::cout << " into " << blocked.blocks() << " blocks of " << blocked.offset() << " bytes";
+  }
+  std::cout << std::endl;
+
+  google::protobuf::ShutdownProtobufLibrary();
+  return 0;
+}
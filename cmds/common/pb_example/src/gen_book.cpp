@@ -0,0 +1,139 @@
+// Writes a synthetic address book (see book/synthetic.hpp): the same options
+// always give the same book, so books of any size can be made for tests and
+// benchmarks without typing people into add_person.
+
+#include <getopt.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "addressbook.pb.h"
+#include "book/blocked.hpp"
+#include "book/stream.hpp"
+#include "book/synthetic.hpp"
+
+namespace {
+
+void usage(const char* prog) {
+  std::cerr << "Usage:  " << prog << " [OPTIONS] ADDRESS_BOOK_FILE" << std::endl
+            << "  -n, --people=N         People to write (default 1000)" << std::endl
+            << "  -s, --seed=N           Seed of the people (default 0)" << std::endl
+            << "  -e, --email-percent=P  Percent of people with an email (default 67)" << std::endl
+            << "  -p, --phones=MIN:MAX   Phones per person, uniformly distributed (default 0:3)" << std::endl
+            << "  -l, --legacy           Write one AddressBook instead of a stream book" << std::endl
+            << "  -b, --blocked[=KB]     Write a block-compressed book (see book/blocked.hpp)" << std::endl;
+}
+
+bool parseCount(const char* arg, unsigned long* n) {
+  char* end;
+  errno = 0;
+  *n = strtoul(arg, &end, 0);
+  // strtoul() takes "-1" as ULONG_MAX
+  return *arg && *arg != '-' && !*end && errno == 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+  unsigned long people = 1000, n;
+  book::SyntheticOptions options;
+  bool legacy = false;
+  size_t block_bytes = 0;
+  static const struct option long_opts[] = {
+      {"people", required_argument, nullptr, 'n'},        {"seed", required_argument, nullptr, 's'},
+      {"email-percent", required_argument, nullptr, 'e'}, {"phones", required_argument, nullptr, 'p'},
+      {"legacy", no_argument, nullptr, 'l'},              {"blocked", optional_argument, nullptr, 'b'},
+      {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "n:s:e:p:lb::", long_opts, nullptr)) != -1) {
+    bool ok = true;
+    std::string arg = optarg ? optarg : "";
+    size_t colon = arg.find(':');
+    unsigned long max = 0;
+    switch (opt) {
+      case 'n':
+        // The people get ids 0..N-1, and ids are int32
+        ok = parseCount(optarg, &people) && people <= INT32_MAX;
+        break;
+      case 's':
+        ok = parseCount(optarg, &n);
+        options.seed = n;
+        break;
+      case 'e':
+        ok = parseCount(optarg, &n) && n <= 100;
+        options.email_percent = static_cast<uint32_t>(n);
+        break;
+      case 'p':
+        ok = colon != std::string::npos && parseCount(arg.substr(0, colon).c_str(), &n) &&
+             parseCount(arg.substr(colon + 1).c_str(), &max) && n <= max && max <= 1000;
+        options.min_phones = static_cast<uint32_t>(n);
+        options.max_phones = static_cast<uint32_t>(max);
+        break;
+      case 'l':
+        legacy = true;
+        break;
+      case 'b':
+        n = book::kDefaultBlockBytes >> 10;
+        ok = (!optarg || parseCount(optarg, &n)) && n > 0;
+        block_bytes = n << 10;
+        break;
+      default:
+        ok = false;
+    }
+    if (!ok) {
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  if (optind != argc - 1 || (legacy && block_bytes)) {
+    usage(argv[0]);
+    return -1;
+  }
+  const std::string path = argv[optind];
+
+  bool ok = true;
+  std::string error;
+  if (legacy) {
+    // The tutorial format: the whole book is built in memory first
+    tutorial::AddressBook address_book;
+    for (unsigned long i = 0; i < people; i++) {
+      book::syntheticPerson(i, options, address_book.add_people());
+    }
+    std::ofstream out(path, std::ios::out | std::ios::trunc | std::ios::binary);
+    ok = address_book.SerializeToOstream(&out) && out.flush();
+    error = "write error";
+  } else if (block_bytes) {
+    book::BlockedWriter writer;
+    tutorial::Person person;
+    ok = writer.open(path, block_bytes);
+    for (unsigned long i = 0; ok && i < people; i++) {
+      book::syntheticPerson(i, options, &person);
+      ok = writer.append(person);
+    }
+    ok = writer.close() && ok;
+    error = writer.error();
+  } else {
+    book::Writer writer;
+    tutorial::Person person;
+    ok = writer.open(path, true);
+    for (unsigned long i = 0; ok && i < people; i++) {
+      book::syntheticPerson(i, options, &person);
+      ok = writer.append(person);
+    }
+    ok = writer.close() && ok;
+    error = writer.error();
+  }
+  if (!ok) {
+    std::cerr << path << ": " << error << std::endl;
+    return -1;
+  }
+
+  google::protobuf::ShutdownProtobufLibrary();
+  return 0;
+}
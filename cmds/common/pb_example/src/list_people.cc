@@ -1,76 +1,307 @@
 // See README.txt for information and build instructions.
 
-#include <fstream>
-#include <google/protobuf/util/time_util.h>
+#include <getopt.h>
+#include <google/protobuf/arena.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "addressbook.pb.h"
+#include "book/lsm.hpp"
+#include "book/output.hpp"
+#include "book/parallel.hpp"
+#include "book/person_view.hpp"
+#include "book/stream.hpp"
+#include "cutils/tpool.hpp"
 
 using namespace std;
 
-using google::protobuf::util::TimeUtil;
+// Bytes of a book decoded by one task with --threads
+constexpr size_t kChunkBytes = 1 << 20;
 
 // Iterates though all people in the AddressBook and prints info about them.
-void ListPeople(const tutorial::AddressBook& address_book) {
+void ListPeople(const tutorial::AddressBook& address_book, book::OutputWriter* out) {
   for (int i = 0; i < address_book.people_size(); i++) {
-    const tutorial::Person& person = address_book.people(i);
-
-    cout << "Person ID: " << person.id() << endl;
-    cout << "  Name: " << person.name() << endl;
-    if (person.email() != "") {
-      cout << "  E-mail address: " << person.email() << endl;
-    }
+    out->write(address_book.people(i));
+  }
+}
 
-    for (int j = 0; j < person.phones_size(); j++) {
-      const tutorial::Person::PhoneNumber& phone_number = person.phones(j);
-
-      switch (phone_number.type()) {
-        case tutorial::Person::MOBILE:
-          cout << "  Mobile phone #: ";
-          break;
-        case tutorial::Person::HOME:
-          cout << "  Home phone #: ";
-          break;
-        case tutorial::Person::WORK:
-          cout << "  Work phone #: ";
-          break;
-        default:
-          cout << "  Unknown phone #: ";
-          break;
-      }
-      cout << phone_number.number() << endl;
-    }
-    if (person.has_last_updated()) {
-      cout << "  Updated: " << TimeUtil::ToString(person.last_updated()) << endl;
-    }
+// Reads all the people of the book into address_book.
+bool ReadAddressBook(book::MergedReader* reader, tutorial::AddressBook* address_book) {
+  while (reader->next(address_book->add_people())) {
   }
+  // drop the person next() failed on
+  address_book->mutable_people()->RemoveLast();
+  return reader->error().empty();
+}
+
+double MsSince(chrono::steady_clock::time_point t0) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
 }
 
-// Main function:  Reads the entire address book from a file and prints all
-//   the information inside.
+long PeakRssKb() {
+  struct rusage ru;
+  return getrusage(RUSAGE_SELF, &ru) == 0 ? ru.ru_maxrss : -1;
+}
+
+void Usage(const char* prog) {
+  cerr << "Usage:  " << prog << " [OPTIONS] ADDRESS_BOOK_FILE..." << endl
+       << "  -w, --whole   Parse the whole book into one AddressBook first" << endl
+       << "  -a, --arena   With --whole, allocate the AddressBook on an Arena" << endl
+       << "  -c, --count   Print the number of people instead of the people" << endl
+       << "  -s, --stats   Print read/teardown time and peak RSS to stderr" << endl
+       << "  -i, --input=mmap|fd|fstream" << endl
+       << "                Read the file through an mmap (default), read(2) or std::ifstream" << endl
+       << "  -j, --threads=N" << endl
+       << "                Decode chunks of the book on N threads (0: one per CPU)" << endl
+       << "  -f, --fields=FIELD,..." << endl
+       << "                Print only some of name, id, email, phones, updated; the others" << endl
+       << "                are skipped over without being decoded" << endl
+       << "  -F, --filter=id=N|id=LO:HI|name=PREFIX|has_email" << endl
+       << "                List only the people matching all the filters given" << endl
+       << "  -o, --output=text|csv|ndjson|columnar" << endl
+       << "                Output format (see book/output.hpp); columnar doesn't go with --threads" << endl;
+}
+
+// Main function:  Reads the address book from a file (or the shards of one
+//   from several files) and prints all the information inside. By default
+//   people are read one at a time into a single reused Person, so memory use
+//   doesn't grow with the book. Changes logged by add_person --replace or
+//   --delete are applied as the book is read.
 int main(int argc, char* argv[]) {
   // Verify that the version of the library that we linked against is
   // compatible with the version of the headers we compiled against.
   GOOGLE_PROTOBUF_VERIFY_VERSION;
 
-  if (argc != 2) {
-    cerr << "Usage:  " << argv[0] << " ADDRESS_BOOK_FILE" << endl;
+  bool whole = false, arena = false, count_only = false, stats = false;
+  book::Input input = book::Input::kMmap;
+  long threads = -1;
+  uint32_t fields = 0;
+  book::Filter filter;
+  bool filtered = false;
+  book::OutputFormat format = book::OutputFormat::kText;
+  static const struct option long_opts[] = {
+      {"whole", no_argument, nullptr, 'w'},       {"arena", no_argument, nullptr, 'a'},
+      {"count", no_argument, nullptr, 'c'},       {"stats", no_argument, nullptr, 's'},
+      {"input", required_argument, nullptr, 'i'}, {"threads", required_argument, nullptr, 'j'},
+      {"fields", required_argument, nullptr, 'f'}, {"filter", required_argument, nullptr, 'F'},
+      {"output", required_argument, nullptr, 'o'}, {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "wacsi:j:f:F:o:", long_opts, nullptr)) != -1) {
+    switch (opt) {
+      case 'w':
+        whole = true;
+        break;
+      case 'a':
+        arena = true;
+        break;
+      case 'c':
+        count_only = true;
+        break;
+      case 's':
+        stats = true;
+        break;
+      case 'i':
+        if (string(optarg) == "mmap") {
+          input = book::Input::kMmap;
+        } else if (string(optarg) == "fd") {
+          input = book::Input::kFd;
+        } else if (string(optarg) == "fstream") {
+          input = book::Input::kFstream;
+        } else {
+          Usage(argv[0]);
+          return -1;
+        }
+        break;
+      case 'j':
+        threads = strtol(optarg, nullptr, 0);
+        if (threads < 0) {
+          Usage(argv[0]);
+          return -1;
+        }
+        break;
+      case 'f':
+        fields = book::parseFields(optarg);
+        if (!fields) {
+          Usage(argv[0]);
+          return -1;
+        }
+        break;
+      case 'F':
+        filtered = true;
+        if (!filter.add(optarg)) {
+          Usage(argv[0]);
+          return -1;
+        }
+        break;
+      case 'o':
+        if (!book::parseOutputFormat(optarg, &format)) {
+          Usage(argv[0]);
+          return -1;
+        }
+        break;
+      default:
+        Usage(argv[0]);
+        return -1;
+    }
+  }
+  bool projected = fields || filtered;
+  if (optind == argc || (arena && !whole) || (whole && threads >= 0) || (projected && (whole || threads >= 0)) ||
+      (format == book::OutputFormat::kColumnar && threads >= 0)) {
+    Usage(argv[0]);
     return -1;
   }
+  vector<string> paths(argv + optind, argv + argc);
+  if (!fields) {
+    fields = book::kFieldAll;
+  }
 
-  tutorial::AddressBook address_book;
+  // All the output goes through one large buffer, written out as it fills
+  unique_ptr<book::OutputWriter> out;
+  if (!count_only) {
+    out = make_unique<book::OutputWriter>(STDOUT_FILENO, format, fields);
+  }
+
+  // Applies the change log of a book, if any (see book/lsm.hpp)
+  book::MergedReader reader;
+  string error;
+  bool ok = true;
+  uint64_t count = 0;
+  double read_ms, teardown_ms = 0;
+  auto t0 = chrono::steady_clock::now();
+  if (threads >= 0) {
+    // Split the books into chunks of whole records (reading only the record
+    // headers), decode the chunks on a thread pool and print their output in
+    // the original order
+    vector<book::Chunk> chunks;
+    for (const auto& path : paths) {
+      if (access(book::logPathFor(path).c_str(), F_OK) == 0) {
+        cerr << path << ": has a change log, compact it with compact_book to use --threads" << endl;
+        return -1;
+      }
+      if (!book::splitBook(path, kChunkBytes, &chunks, &error)) {
+        cerr << error << endl;
+        return -1;
+      }
+    }
+    cutils::ThreadPool pool(threads);
+    book::DecodeFn decode = [](const tutorial::Person&, string*) {};
+    if (!count_only) {
+      decode = [format, fields](const tutorial::Person& person, string* chunk_out) {
+        thread_local book::Formatter formatter(format, fields);
+        formatter.append(person, chunk_out);
+      };
+    }
+    book::EmitFn emit = [](const string&) {};
+    if (out) {
+      emit = [&out](const string& chunk_out) { out->writeRaw(chunk_out); };
+    }
+    ok = book::decodeParallel(pool, chunks, decode, emit, &count, &error);
+    read_ms = MsSince(t0);
+  } else if (projected) {
+    // Decode straight off the wire: the fields the filter needs first, and
+    // the rest of the fields to print only for people who pass it
+    uint32_t filter_fields = filter.fields();
+    uint32_t print_fields = count_only ? 0 : fields & ~filter_fields;
+    string_view record;
+    book::PersonView person;
+    for (size_t i = 0; ok && i < paths.size(); i++) {
+      if (!reader.open(paths[i], input)) {
+        cerr << reader.error() << endl;
+        return -1;
+      }
+      while (ok && reader.nextRaw(&record)) {
+        ok = !filter_fields || book::decodePerson(record, filter_fields, &person);
+        if (ok && filter.matches(person)) {
+          count++;
+          ok = !print_fields || book::decodePerson(record, print_fields, &person);
+          if (ok && !count_only) {
+            out->write(person);
+          }
+        }
+      }
+      error = ok ? reader.error() : "malformed person before offset " + to_string(reader.offset());
+      ok = error.empty();
+    }
+    read_ms = MsSince(t0);
+  } else if (!whole) {
+    // Reused for every record: next() Clear()s it, which keeps the memory of
+    // its strings and phones around for the next one
+    tutorial::Person person;
+    for (size_t i = 0; ok && i < paths.size(); i++) {
+      if (!reader.open(paths[i], input)) {
+        cerr << reader.error() << endl;
+        return -1;
+      }
+      while (reader.next(&person)) {
+        count++;
+        if (!count_only) {
+          out->write(person);
+        }
+      }
+      ok = reader.error().empty();
+      error = reader.error();
+    }
+    read_ms = MsSince(t0);
+  } else {
+    // On an Arena, all the messages and strings of the book come out of a few
+    // large blocks which are freed at once instead of message by message
+    google::protobuf::ArenaOptions arena_opts;
+    arena_opts.start_block_size = 64 << 10;
+    arena_opts.max_block_size = 8 << 20;
+    unique_ptr<google::protobuf::Arena> msg_arena;
+    unique_ptr<tutorial::AddressBook> heap_book;
+    tutorial::AddressBook* address_book;
+    if (arena) {
+      msg_arena = make_unique<google::protobuf::Arena>(arena_opts);
+      address_book = google::protobuf::Arena::CreateMessage<tutorial::AddressBook>(msg_arena.get());
+    } else {
+      heap_book = make_unique<tutorial::AddressBook>();
+      address_book = heap_book.get();
+    }
 
-  {
-    // Read the existing address book.
-    fstream input(argv[1], ios::in | ios::binary);
-    if (!address_book.ParseFromIstream(&input)) {
-      cerr << "Failed to parse address book." << endl;
-      return -1;
+    for (size_t i = 0; ok && i < paths.size(); i++) {
+      if (!reader.open(paths[i], input)) {
+        cerr << reader.error() << endl;
+        return -1;
+      }
+      ok = ReadAddressBook(&reader, address_book);
+      error = reader.error();
+    }
+    read_ms = MsSince(t0);
+    count = address_book->people_size();
+    if (ok && !count_only) {
+      ListPeople(*address_book, out.get());
     }
+
+    t0 = chrono::steady_clock::now();
+    heap_book.reset();
+    msg_arena.reset();
+    teardown_ms = MsSince(t0);
+  }
+  if (!ok) {
+    cerr << "Failed to parse address book: " << error << endl;
+    return -1;
+  }
+  if (out && !out->close()) {
+    cerr << out->error() << endl;
+    return -1;
   }
 
-  ListPeople(address_book);
+  if (count_only) {
+    cout << count << endl;
+  }
+  if (stats) {
+    cerr << "people: " << count << ", read: " << read_ms << " ms, teardown: " << teardown_ms
+         << " ms, peak RSS: " << PeakRssKb() << " KB" << endl;
+  }
 
   // Optional:  Delete all global objects allocated by libprotobuf.
   google::protobuf::ShutdownProtobufLibrary();
@@ -0,0 +1,141 @@
+// Looks people up in a stream address book by id or name through its sidecar
+// index (see book/index.hpp), reading only the matching records. The index is
+// brought up to date with the book first, and the change log of the book (see
+// book/lsm.hpp) overrides what the index finds. A blocked book (see
+// book/blocked.hpp) carries its own index, and only the blocks holding a match
+// are read.
+
+#include <getopt.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "addressbook.pb.h"
+#include "book/blocked.hpp"
+#include "book/index.hpp"
+#include "book/lsm.hpp"
+#include "book/print.hpp"
+#include "book/stream.hpp"
+
+namespace {
+
+void usage(const char* prog) {
+  std::cerr << "Usage:  " << prog << " ADDRESS_BOOK_FILE (--id ID | --name NAME)..." << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+  // (is_id, value) in command line order
+  std::vector<std::pair<bool, std::string>> queries;
+  static const struct option long_opts[] = {
+      {"id", required_argument, nullptr, 'i'}, {"name", required_argument, nullptr, 'n'}, {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "i:n:", long_opts, nullptr)) != -1) {
+    if (opt != 'i' && opt != 'n') {
+      usage(argv[0]);
+      return -1;
+    }
+    queries.emplace_back(opt == 'i', optarg);
+  }
+  if (optind != argc - 1 || queries.empty()) {
+    usage(argv[0]);
+    return -1;
+  }
+  const std::string path = argv[optind];
+
+  // Point reads: read(2) pulls in little more than the records read, where
+  // the mmap of a Reader is set up for read-ahead
+  book::Reader reader;
+  if (!reader.open(path, book::Input::kFd)) {
+    std::cerr << reader.error() << std::endl;
+    return -1;
+  }
+  bool blocked = reader.format() == book::Format::kBlocked;
+  book::Index index;
+  book::BlockedBook blocks;
+  if (blocked ? !blocks.open(path) : !index.update(path) || !index.open(path)) {
+    std::cerr << (blocked ? blocks.error() : index.error()) << std::endl;
+    return -1;
+  }
+  book::ChangeSet changes;
+  if (!changes.load(path)) {
+    std::cerr << changes.error() << std::endl;
+    return -1;
+  }
+
+  tutorial::Person person;
+  int found = 0;
+  for (const auto& q : queries) {
+    // (offset, people to read from there): records, or whole blocks
+    std::vector<std::pair<int64_t, uint32_t>> reads;
+    int32_t id = 0;
+    if (q.first) {
+      // IDs are int32 (see addressbook.proto)
+      char* end = nullptr;
+      errno = 0;
+      long value = strtol(q.second.c_str(), &end, 0);
+      if (end == q.second.c_str() || *end || errno != 0 || value < INT32_MIN || value > INT32_MAX) {
+        usage(argv[0]);
+        return -1;
+      }
+      id = static_cast<int32_t>(value);
+      // A logged change replaces all the people of its id
+      if (const book::ChangeSet::Entry* change = changes.find(id)) {
+        if (!change->deleted && person.ParseFromString(change->person)) {
+          book::printPerson(std::cout, person);
+          found++;
+        }
+        continue;
+      }
+    }
+    if (blocked) {
+      for (uint32_t b : q.first ? blocks.findId(id) : blocks.findName(q.second)) {
+        reads.emplace_back(blocks.block(b).offset, blocks.block(b).people);
+      }
+    } else {
+      for (int64_t off : q.first ? index.findId(id) : index.findName(q.second)) {
+        reads.emplace_back(off, 1);
+      }
+    }
+
+    for (const auto& r : reads) {
+      if (!reader.seek(r.first)) {
+        std::cerr << path << ": bad offset " << r.first << std::endl;
+        return -1;
+      }
+      for (uint32_t i = 0; i < r.second; i++) {
+        if (!reader.next(&person)) {
+          std::cerr << path << ": bad record at offset " << r.first << " " << reader.error() << std::endl;
+          return -1;
+        }
+        // Names are indexed by hash, and blocks hold other people too
+        if ((q.first ? person.id() != id : person.name() != q.second) || changes.find(person.id())) {
+          continue;
+        }
+        book::printPerson(std::cout, person);
+        found++;
+      }
+    }
+    if (!q.first) {
+      // The log is small next to the book: check its people directly
+      for (int32_t id : changes.ids()) {
+        const book::ChangeSet::Entry* change = changes.find(id);
+        if (!change->deleted && person.ParseFromString(change->person) && person.name() == q.second) {
+          book::printPerson(std::cout, person);
+          found++;
+        }
+      }
+    }
+  }
+
+  google::protobuf::ShutdownProtobufLibrary();
+  return found ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <cutils/trace.h>
+
+// Convert binary trace (from trace_flush()) to Chrome trace_event JSON
+int
+main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s TRACE_FILE [JSON_FILE]\n", argv[0]);
+        return -1;
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        fprintf(stderr, "%s: %s\n", argv[1], strerror(errno));
+        return -1;
+    }
+    FILE *out = argc == 3 ? fopen(argv[2], "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "%s: %s\n", argv[2], strerror(errno));
+        fclose(in);
+        return -1;
+    }
+
+    int count = trace_to_json(in, out);
+    fclose(in);
+    if (out != stdout) {
+        fclose(out);
+    }
+    if (count < 0) {
+        fprintf(stderr, "Failed to convert %s: %s\n", argv[1],
+                strerror(-count));
+        return -1;
+    }
+    fprintf(stderr, "Converted %d events\n", count);
+    return 0;
+}
@@ -0,0 +1,303 @@
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include <cutils/alloc.h>
+#include <cutils/hist.h>
+#include <cutils/list.h>
+#include <cutils/time.h>
+#include <cutils/timeout_list.h>
+
+/*
+ * Throughput and latency benchmarks of the cutils containers and allocator,
+ * printed as one JSON document (stdout) to track regressions:
+ *
+ *   {"ops": N, "max_threads": T, "timer_overhead_ns": x,
+ *    "results": [{"name": ..., "threads": ..., "ops": ..., "ops_per_sec": ...,
+ *                 "p50_ns": ..., "p99_ns": ..., "max_ns": ...,
+ *                 "peak_rss_kb": ...}, ...],
+ *    "peak_rss_kb": ...}
+ *
+ * timeout_list operations are timed one by one (they take a mutex, and tail
+ * latency under contention is the point). The single-threaded micro-ops
+ * (list, allocator) cost about as much as a timestamp, so they are timed in
+ * batches of LAT_BATCH and every op of a batch records the batch average.
+ * peak_rss_kb is the process peak (ru_maxrss) after each benchmark.
+ */
+
+#define DEFAULT_OPS (1000 * 1000)
+#define LAT_BATCH 64
+// Size of timeout_list entries and their timeout
+#define TOLIST_ENTSZ 64
+#define TOLIST_TIMEOUT_MS 10
+
+static int nresults;
+
+static long
+peak_rss_kb(void)
+{
+    struct rusage ru;
+    return getrusage(RUSAGE_SELF, &ru) == 0 ? ru.ru_maxrss : -1;
+}
+
+/*
+ * @brief  Print the JSON object of one benchmark result
+ *
+ * @param[in] name        Name of the benchmarked operation
+ * @param[in] threads     Number of threads running the operation
+ * @param[in] ops         Number of operations (all threads)
+ * @param[in] elapsed_ns  Wall time of the run
+ * @param[in] lat         Latencies of the operations
+ */
+static void
+report(const char *name, unsigned int threads, uint64_t ops,
+       uint64_t elapsed_ns, const hist_t *lat)
+{
+    printf("%s\n    {\"name\": \"%s\", \"threads\": %u, \"ops\": %llu, "
+           "\"ops_per_sec\": %.0f, \"p50_ns\": %llu, \"p99_ns\": %llu, "
+           "\"max_ns\": %llu, \"peak_rss_kb\": %ld}",
+           nresults++ ? "," : "", name, threads, (unsigned long long)ops,
+           elapsed_ns ? (double)ops * 1e9 / (double)elapsed_ns : 0.0,
+           (unsigned long long)hist_percentile(lat, 50.0),
+           (unsigned long long)hist_percentile(lat, 99.0),
+           (unsigned long long)lat->max, peak_rss_kb());
+}
+
+// Average cost of a gettsc() call (included in every timed op)
+static double
+timer_overhead_ns(void)
+{
+    uint64_t t0 = gettsc();
+    for (int i = 0; i < 1000000; i++) {
+        gettsc();
+    }
+    return (double)(gettsc() - t0) / 1000000;
+}
+
+/*
+ * timeout_list: producers put while one consumer keeps getting the newest
+ * entry (and so expiring old ones)
+ */
+typedef struct {
+    tolist_ctx_t *ctx;
+    uint64_t ops;
+    int *done;
+    hist_t *lat;
+    uint64_t nops; // out: ops done (consumer)
+} tolist_arg_t;
+
+static void *
+tolist_producer(void *arg)
+{
+    tolist_arg_t *a = arg;
+    char ent[TOLIST_ENTSZ] = { 0 };
+    for (uint64_t i = 0; i < a->ops; i++) {
+        *(uint64_t *)ent = i;
+        uint64_t t0 = gettsc();
+        timout_list_put(a->ctx, ent);
+        hist_record_since(a->lat, t0);
+    }
+    return NULL;
+}
+
+static void *
+tolist_consumer(void *arg)
+{
+    tolist_arg_t *a = arg;
+    char buf[TOLIST_ENTSZ];
+    while (!__atomic_load_n(a->done, __ATOMIC_ACQUIRE)) {
+        uint64_t t0 = gettsc();
+        timout_list_get(a->ctx, buf, sizeof(buf));
+        hist_record_since(a->lat, t0);
+        a->nops++;
+    }
+    return NULL;
+}
+
+static void
+bench_tolist(uint64_t ops, unsigned int nprod)
+{
+    tolist_ctx_t *ctx = timout_list_init(TOLIST_TIMEOUT_MS, TOLIST_ENTSZ);
+    int done = 0;
+    pthread_t thr[nprod + 1];
+    tolist_arg_t args[nprod + 1];
+    for (unsigned int i = 0; i <= nprod; i++) {
+        args[i] = (tolist_arg_t){ .ctx = ctx,
+                                  .ops = ops / nprod,
+                                  .done = &done,
+                                  .lat = zmalloc(sizeof(hist_t)) };
+    }
+
+    uint64_t t0 = gettsc();
+    pthread_create(&thr[nprod], NULL, tolist_consumer, &args[nprod]);
+    for (unsigned int i = 0; i < nprod; i++) {
+        pthread_create(&thr[i], NULL, tolist_producer, &args[i]);
+    }
+    for (unsigned int i = 0; i < nprod; i++) {
+        pthread_join(thr[i], NULL);
+    }
+    uint64_t elapsed = gettsc() - t0;
+    __atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+    pthread_join(thr[nprod], NULL);
+
+    for (unsigned int i = 1; i < nprod; i++) {
+        hist_merge(args[0].lat, args[i].lat);
+    }
+    report("timeout_list_put", nprod, args[0].lat->count, elapsed,
+           args[0].lat);
+    report("timeout_list_get", 1, args[nprod].nops, elapsed, args[nprod].lat);
+
+    for (unsigned int i = 0; i <= nprod; i++) {
+        free(args[i].lat);
+    }
+    timeout_list_fini(ctx);
+}
+
+// list.h: intrusive list of preallocated nodes
+typedef struct {
+    uint64_t v;
+    list_node_t node;
+} bench_node_t;
+
+/*
+ * Time ops in batches of LAT_BATCH: op_body runs for every index i of
+ * [0, n) and every op of a batch records the average of the batch.
+ */
+#define BATCHED(lat, n, op_body)                                           \
+    do {                                                                   \
+        for (uint64_t _b = 0; _b < (n); _b += LAT_BATCH) {                 \
+            uint64_t _e = _b + LAT_BATCH < (n) ? _b + LAT_BATCH : (n);     \
+            uint64_t _t0 = gettsc();                                       \
+            for (uint64_t i = _b; i < _e; i++) {                           \
+                op_body;                                                   \
+            }                                                              \
+            hist_record_n((lat), (gettsc() - _t0) / (_e - _b), _e - _b);   \
+        }                                                                  \
+    } while (0)
+
+static void
+bench_list(uint64_t ops)
+{
+    bench_node_t *nodes = zalloc(ops, sizeof(bench_node_t));
+    uint64_t *order = zalloc(ops, sizeof(uint64_t));
+    hist_t *lat = zmalloc(sizeof(hist_t));
+    list_t l;
+    list_init(&l, offsetof(bench_node_t, node));
+
+    // random deletion order (Fisher-Yates with a fixed seed)
+    srandom(1);
+    for (uint64_t i = 0; i < ops; i++) {
+        order[i] = i;
+    }
+    for (uint64_t i = ops - 1; i > 0; i--) {
+        uint64_t j = (uint64_t)random() % (i + 1);
+        uint64_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    uint64_t t0 = gettsc();
+    BATCHED(lat, ops, list_insert_tail(&l, &nodes[i]));
+    report("list_insert_tail", 1, ops, gettsc() - t0, lat);
+
+    hist_init(lat);
+    volatile uint64_t sum = 0;
+    bench_node_t *n = list_head(&l);
+    t0 = gettsc();
+    BATCHED(lat, ops, {
+        sum += n->v;
+        n = list_next(&l, n);
+    });
+    report("list_iterate", 1, ops, gettsc() - t0, lat);
+
+    hist_init(lat);
+    t0 = gettsc();
+    BATCHED(lat, ops, list_delete(&l, &nodes[order[i]]));
+    report("list_delete_random", 1, ops, gettsc() - t0, lat);
+
+    hist_init(lat);
+    t0 = gettsc();
+    BATCHED(lat, ops, {
+        list_insert_head(&l, &nodes[i]);
+        if (i & 1) {
+            list_delete_head(&l);
+        }
+    });
+    report("list_insert_head_delete_head", 1, ops, gettsc() - t0, lat);
+
+    while (list_delete_head(&l)) {
+    }
+    list_fini(&l);
+    free(lat);
+    free(order);
+    free(nodes);
+}
+
+// Allocator: zmalloc() (calloc), malloc() for reference, and free()
+static void
+bench_alloc(uint64_t ops)
+{
+    static const size_t sizes[] = { 32, 256, 4096 };
+    void **ptrs = zalloc(ops, sizeof(void *));
+    hist_t *lat = zmalloc(sizeof(hist_t));
+    char name[64];
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t sz = sizes[s];
+
+        hist_init(lat);
+        uint64_t t0 = gettsc();
+        BATCHED(lat, ops, ptrs[i] = zmalloc(sz));
+        snprintf(name, sizeof(name), "zmalloc_%zu", sz);
+        report(name, 1, ops, gettsc() - t0, lat);
+
+        hist_init(lat);
+        t0 = gettsc();
+        BATCHED(lat, ops, free(ptrs[i]));
+        snprintf(name, sizeof(name), "free_zmalloc_%zu", sz);
+        report(name, 1, ops, gettsc() - t0, lat);
+
+        hist_init(lat);
+        t0 = gettsc();
+        BATCHED(lat, ops, ptrs[i] = malloc(sz));
+        snprintf(name, sizeof(name), "malloc_%zu", sz);
+        report(name, 1, ops, gettsc() - t0, lat);
+
+        hist_init(lat);
+        t0 = gettsc();
+        BATCHED(lat, ops, free(ptrs[i]));
+        snprintf(name, sizeof(name), "free_malloc_%zu", sz);
+        report(name, 1, ops, gettsc() - t0, lat);
+    }
+
+    free(lat);
+    free(ptrs);
+}
+
+int
+main(int argc, char *argv[])
+{
+    long ops = argc > 1 ? strtol(argv[1], NULL, 0) : DEFAULT_OPS;
+    long maxthr = argc > 2 ? strtol(argv[2], NULL, 0) : 4;
+    if (ops <= 0 || maxthr <= 0) {
+        fprintf(stderr, "Usage: %s [OPS] [MAX_PRODUCERS]\n", argv[0]);
+        return -1;
+    }
+
+    printf("{\"ops\": %ld, \"max_threads\": %ld, \"timer_overhead_ns\": %.2f,"
+           "\n  \"results\": [",
+           ops, maxthr, timer_overhead_ns());
+    // 1, 2, 4, ... and maxthr producers
+    for (long n = 1;; n = n * 2 > maxthr ? maxthr : n * 2) {
+        bench_tolist((uint64_t)ops, (unsigned int)n);
+        if (n == maxthr) {
+            break;
+        }
+    }
+    bench_list((uint64_t)ops);
+    bench_alloc((uint64_t)ops);
+    printf("\n  ],\n  \"peak_rss_kb\": %ld}\n", peak_rss_kb());
+    return 0;
+}
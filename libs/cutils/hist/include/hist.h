@@ -0,0 +1,172 @@
+#ifndef CUTILS_HIST_H
+#define CUTILS_HIST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <cutils/time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fixed-memory log-linear (HDR-style) histogram of 64bit values
+ *
+ * Values below HIST_SUB_COUNT are recorded exactly. Every power-of-2 range
+ * above that is split in HIST_SUB_COUNT linear sub-buckets, which bounds
+ * the relative error of any reported value to 1/HIST_SUB_COUNT (~1.6%)
+ * across the full uint64_t range.
+ *
+ * Recording is O(1) and never allocates. A zero-filled hist_t is a valid
+ * empty histogram. An instance isn't thread-safe: give each thread its own
+ * (e.g. static __thread hist_t) and hist_merge() them for reporting.
+ *
+ * hist_init(h)                   initialize (or reset) a histogram
+ * hist_record(h, v)              record value v
+ * hist_record_n(h, v, n)         record value v n times
+ * hist_record_since(h, t0)       record gettsc() - t0 (nanoseconds)
+ * hist_merge(dst, src)           add all the values of src to dst
+ * hist_percentile(h, p)          value at percentile p (0.0 .. 100.0)
+ * hist_mean(h)                   mean of recorded values
+ * hist_dump(h, fp, name, fmt)    print summary as text or JSON
+ */
+
+#define HIST_SUB_BITS 6
+#define HIST_SUB_COUNT (1U << HIST_SUB_BITS)
+#define HIST_NBUCKETS (64 - HIST_SUB_BITS + 1)
+#define HIST_NBINS (HIST_NBUCKETS * HIST_SUB_COUNT)
+
+typedef struct {
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum; // wraps beyond 2^64 ns (~584 years) of cumulative values
+    uint64_t bins[HIST_NBINS];
+} hist_t;
+
+// Output formats of hist_dump()
+typedef enum {
+    HIST_FMT_TEXT = 0,
+    HIST_FMT_JSON,
+} hist_fmt_t;
+
+/*
+ * @brief  Map a value to its bin index
+ *
+ * @param[in] v  Value
+ *
+ * @return  Index of the bin value v belongs to
+ */
+static inline unsigned int __attribute__((always_inline))
+hist_bin(uint64_t v)
+{
+    if (v < HIST_SUB_COUNT) {
+        return (unsigned int)v;
+    }
+    unsigned int shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+    return ((shift + 1) << HIST_SUB_BITS) +
+           (unsigned int)((v >> shift) - HIST_SUB_COUNT);
+}
+
+/*
+ * @brief  Initialize (or reset) a histogram
+ *
+ * @param[in] h  Histogram
+ */
+extern void hist_init(hist_t *h);
+
+/*
+ * @brief  Record a value n times
+ *
+ * @param[in] h  Histogram
+ * @param[in] v  Value to record
+ * @param[in] n  Number of occurrences of v
+ */
+static inline void
+hist_record_n(hist_t *h, uint64_t v, uint64_t n)
+{
+    if (h->count == 0 || v < h->min) {
+        h->min = v;
+    }
+    h->bins[hist_bin(v)] += n;
+    h->count += n;
+    h->sum += v * n;
+    if (v > h->max) {
+        h->max = v;
+    }
+}
+
+/*
+ * @brief  Record a value
+ *
+ * @param[in] h  Histogram
+ * @param[in] v  Value to record
+ */
+static inline void
+hist_record(hist_t *h, uint64_t v)
+{
+    hist_record_n(h, v, 1);
+}
+
+/*
+ * @brief  Record nanoseconds elapsed since a gettsc() timestamp
+ *
+ * @param[in] h   Histogram
+ * @param[in] t0  Start timestamp as returned by gettsc()
+ *
+ * @return  Current timestamp (handy as t0 of the next interval)
+ */
+static inline uint64_t
+hist_record_since(hist_t *h, uint64_t t0)
+{
+    uint64_t now = gettsc();
+    hist_record(h, now > t0 ? now - t0 : 0);
+    return now;
+}
+
+/*
+ * @brief  Add all the values recorded in src to dst
+ *
+ * @param[in] dst  Destination histogram
+ * @param[in] src  Source histogram (unchanged)
+ */
+extern void hist_merge(hist_t *dst, const hist_t *src);
+
+/*
+ * @brief  Get value at a given percentile. Returned value is the highest
+ *         value equivalent (same bin) to the exact one, capped at max.
+ *
+ * @param[in] h  Histogram
+ * @param[in] p  Percentile (0.0 .. 100.0)
+ *
+ * @return  Value at percentile p, 0 if histogram is empty
+ */
+extern uint64_t hist_percentile(const hist_t *h, double p);
+
+/*
+ * @brief  Get mean of the recorded values
+ *
+ * @param[in] h  Histogram
+ *
+ * @return  Mean of recorded values, 0 if histogram is empty
+ */
+extern double hist_mean(const hist_t *h);
+
+/*
+ * @brief  Print one-line summary (count, min, mean, p50, p90, p99, p999, max)
+ *
+ * @param[in] h     Histogram
+ * @param[in] fp    Stream to print to
+ * @param[in] name  Name of the histogram (may be NULL)
+ * @param[in] fmt   Output format
+ *
+ * @return  Number of characters printed if success, negative value otherwise
+ */
+extern int hist_dump(const hist_t *h, FILE *fp, const char *name,
+                     hist_fmt_t fmt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CUTILS_HIST_H
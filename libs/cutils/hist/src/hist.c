@@ -0,0 +1,120 @@
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <cutils/hist.h>
+
+/*
+ * @brief  Get the highest value that maps to a given bin
+ *
+ * @param[in] idx  Bin index
+ *
+ * @return  Highest value equivalent to the bin
+ */
+static uint64_t
+hist_bin_highest(unsigned int idx)
+{
+    unsigned int bucket = idx >> HIST_SUB_BITS;
+    uint64_t sub = idx & (HIST_SUB_COUNT - 1);
+    if (bucket == 0) {
+        return sub;
+    }
+    unsigned int shift = bucket - 1;
+    uint64_t low = (sub + HIST_SUB_COUNT) << shift;
+    return low + ((1ULL << shift) - 1);
+}
+
+void
+hist_init(hist_t *h)
+{
+    assert(h);
+    memset(h, 0, sizeof(*h)); // NOLINT
+}
+
+void
+hist_merge(hist_t *dst, const hist_t *src)
+{
+    assert(dst && src);
+    if (src->count == 0) {
+        return;
+    }
+    if (dst->count == 0 || src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    for (unsigned int i = 0; i < HIST_NBINS; i++) {
+        dst->bins[i] += src->bins[i];
+    }
+}
+
+uint64_t
+hist_percentile(const hist_t *h, double p)
+{
+    assert(h);
+    if (h->count == 0) {
+        return 0;
+    }
+    if (p <= 0.0) {
+        return h->min;
+    }
+    if (p >= 100.0) {
+        return h->max;
+    }
+
+    // rank of the value at percentile p (1-based, rounded up)
+    double r = p / 100.0 * h->count;
+    uint64_t rank = (uint64_t)r;
+    if (rank < r || rank == 0) {
+        rank++;
+    }
+
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < HIST_NBINS; i++) {
+        seen += h->bins[i];
+        if (seen >= rank) {
+            uint64_t v = hist_bin_highest(i);
+            return v < h->max ? (v > h->min ? v : h->min) : h->max;
+        }
+    }
+    return h->max;
+}
+
+double
+hist_mean(const hist_t *h)
+{
+    assert(h);
+    return h->count ? (double)h->sum / h->count : 0.0;
+}
+
+int
+hist_dump(const hist_t *h, FILE *fp, const char *name, hist_fmt_t fmt)
+{
+    assert(h && fp);
+    name = name ? name : "hist";
+    uint64_t min = h->count ? h->min : 0;
+    uint64_t p50 = hist_percentile(h, 50.0);
+    uint64_t p90 = hist_percentile(h, 90.0);
+    uint64_t p99 = hist_percentile(h, 99.0);
+    uint64_t p999 = hist_percentile(h, 99.9);
+
+    if (fmt == HIST_FMT_JSON) {
+        return fprintf(fp,
+                       "{\"name\":\"%s\",\"count\":%" PRIu64
+                       ",\"min\":%" PRIu64 ",\"mean\":%.1f,\"p50\":%" PRIu64
+                       ",\"p90\":%" PRIu64 ",\"p99\":%" PRIu64
+                       ",\"p999\":%" PRIu64 ",\"max\":%" PRIu64 "}\n",
+                       name, h->count, min, hist_mean(h), p50, p90, p99, p999,
+                       h->max);
+    }
+    return fprintf(fp,
+                   "%s: count=%" PRIu64 " min=%" PRIu64
+                   " mean=%.1f p50=%" PRIu64 " p90=%" PRIu64 " p99=%" PRIu64
+                   " p999=%" PRIu64 " max=%" PRIu64 "\n",
+                   name, h->count, min, hist_mean(h), p50, p90, p99, p999,
+                   h->max);
+}
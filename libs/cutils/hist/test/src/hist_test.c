@@ -0,0 +1,64 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <cutils/hist.h>
+
+// Values recorded per histogram
+#define NVALS 100000
+
+// Relative error bound of a reported value
+#define WITHIN(v, exact) \
+    ((v) >= (exact) && (v) <= (exact) + (exact) / HIST_SUB_COUNT)
+
+int
+main(void)
+{
+    static hist_t h1, h2, all;
+
+    // Every value maps to a valid bin and bins grow with values
+    assert(hist_bin(0) == 0);
+    assert(hist_bin(UINT64_MAX) == HIST_NBINS - 1);
+    for (uint64_t v = 1; v < (1ULL << 20); v++) {
+        assert(hist_bin(v) >= hist_bin(v - 1));
+    }
+
+    // Empty (zero-filled) histogram
+    assert(hist_percentile(&h1, 50.0) == 0 && hist_mean(&h1) == 0.0);
+
+    // 1..NVALS split across two "per-thread" histograms, then merged
+    for (uint64_t v = 1; v <= NVALS; v++) {
+        hist_record(v % 2 ? &h1 : &h2, v);
+    }
+    hist_init(&all);
+    hist_merge(&all, &h1);
+    hist_merge(&all, &h2);
+    assert(all.count == NVALS && all.min == 1 && all.max == NVALS);
+    assert(hist_mean(&all) == (NVALS + 1) / 2.0);
+    assert(WITHIN(hist_percentile(&all, 50.0), NVALS / 2));
+    assert(WITHIN(hist_percentile(&all, 99.0), NVALS / 100 * 99));
+    assert(WITHIN(hist_percentile(&all, 99.9), NVALS / 1000 * 999));
+    assert(hist_percentile(&all, 100.0) == NVALS);
+    assert(hist_percentile(&all, 0.0) == 1);
+
+    // Small values are exact
+    hist_init(&h1);
+    hist_record_n(&h1, 7, 99);
+    hist_record(&h1, 42);
+    assert(hist_percentile(&h1, 99.0) == 7);
+    assert(hist_percentile(&h1, 99.9) == 42);
+
+    // JSON dump
+    char buf[256] = { 0 };
+    FILE *fp = fmemopen(buf, sizeof(buf), "w");
+    assert(fp);
+    int len = hist_dump(&h1, fp, "small", HIST_FMT_JSON);
+    fclose(fp);
+    assert(len > 0 && strstr(buf, "\"count\":100,"));
+    assert(strstr(buf, "\"p50\":7,"));
+    hist_dump(&all, stdout, "merged", HIST_FMT_TEXT);
+
+    // Gets here only if above test passes
+    printf("PASSED\n");
+    return 0;
+}
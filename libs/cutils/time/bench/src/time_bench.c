@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <cutils/time.h>
+
+// Number of timestamps read per clock source
+#define DEFAULT_ITERS 10000000
+
+typedef uint64_t (*tsfn_t)(void);
+
+#if CLKSRC_HAS_CYCLES
+static uint64_t
+read_cycles(void)
+{
+    return clksrc_read_cycles();
+}
+#endif
+
+/*
+ * @brief  Measure average cost of a timestamp function
+ *
+ * @param[in] fn     Timestamp function to measure
+ * @param[in] iters  Number of calls to make
+ *
+ * @return  Average nanoseconds per call
+ */
+static double
+bench_ns_per_call(tsfn_t fn, long iters)
+{
+    volatile uint64_t sink = 0;
+    uint64_t t0 = gettsc_raw();
+    for (long i = 0; i < iters; i++) {
+        sink += fn();
+    }
+    uint64_t t1 = gettsc_raw();
+    (void)sink;
+    return (double)(t1 - t0) / iters;
+}
+
+/*
+ * @brief  Select clock source and measure cost of gettsc() through it
+ *
+ * @param[in] src    Clock source to select
+ * @param[in] iters  Number of calls to make
+ */
+static void
+bench_clksrc(clksrc_t src, long iters)
+{
+    if (clksrc_set(src) != 0) {
+        printf("%-24s %10s\n", clksrc_name(src), "n/a");
+        return;
+    }
+    printf("%-24s %10.2f ns/call\n", clksrc_name(src),
+           bench_ns_per_call(gettsc, iters));
+}
+
+int
+main(int argc, char *argv[])
+{
+    long iters = argc > 1 ? strtol(argv[1], NULL, 0) : DEFAULT_ITERS;
+    if (iters <= 0) {
+        fprintf(stderr, "Usage: %s [ITERATIONS]\n", argv[0]);
+        return -1;
+    }
+
+    printf("cycle counter: %llu Hz\n", (unsigned long long)clksrc_cycles_hz());
+    printf("gettsc() via clock source (%ld calls each)\n", iters);
+    bench_clksrc(CLKSRC_TSC, iters);
+    bench_clksrc(CLKSRC_MONOTONIC_RAW, iters);
+    bench_clksrc(CLKSRC_MONOTONIC_COARSE, iters);
+
+    printf("direct calls\n");
+#if CLKSRC_HAS_CYCLES
+    printf("%-24s %10.2f ns/call\n", "clksrc_read_cycles",
+           bench_ns_per_call(read_cycles, iters));
+#endif
+    printf("%-24s %10.2f ns/call\n", "gettsc_raw",
+           bench_ns_per_call(gettsc_raw, iters));
+    printf("%-24s %10.2f ns/call\n", "gettsc_coarse",
+           bench_ns_per_call(gettsc_coarse, iters));
+    return 0;
+}
@@ -8,23 +8,199 @@
 extern "C" {
 #endif
 
+/*
+ * Clock source layer backing gettsc()
+ *
+ * CLKSRC_AUTO              pick TSC if invariant and calibrated, else RAW
+ * CLKSRC_TSC               rdtsc (x86_64) / cntvct_el0 (aarch64) scaled to ns
+ * CLKSRC_MONOTONIC_RAW     clock_gettime(CLOCK_MONOTONIC_RAW) (legacy)
+ * CLKSRC_MONOTONIC_COARSE  clock_gettime(CLOCK_MONOTONIC_COARSE); cheapest
+ *                          but only tick (~1-4ms) granular
+ *
+ * The TSC is calibrated (~10ms) and CLKSRC_AUTO resolved once, when the
+ * library is loaded (see clksrc_init()), and the source can be changed with
+ * clksrc_set(). TSC is calibrated against MONOTONIC_RAW
+ * but COARSE follows the (NTP slewed) MONOTONIC timeline, so select the source
+ * once at startup rather than comparing timestamps across a switch.
+ */
+typedef enum {
+    CLKSRC_AUTO = 0,
+    CLKSRC_TSC,
+    CLKSRC_MONOTONIC_RAW,
+    CLKSRC_MONOTONIC_COARSE,
+    CLKSRC_MAX,
+} clksrc_t;
+
+#if defined(__x86_64__) || defined(__aarch64__)
+#define CLKSRC_HAS_CYCLES 1
+#else
+#define CLKSRC_HAS_CYCLES 0
+#endif
+
+// Cycle counter to nanosecond conversion: ns = base_ns + (dcyc * mult) >> shift
+#define CLKSRC_SHIFT 32
+
+// Clock source state shared by all the gettsc() callers (see src/time.c)
+typedef struct {
+    int src; // active clksrc_t, CLKSRC_AUTO until resolved
+    uint64_t mult;
+    uint64_t base_cyc;
+    uint64_t base_ns;
+    uint64_t cyc_hz;
+} clksrc_state_t;
+
+extern clksrc_state_t clksrc_state;
+
+/*
+ * @brief  Calibrate TSC and resolve CLKSRC_AUTO. Done by a constructor when
+ *         the library is loaded, so there's no need to call it but from
+ *         other constructors that read the clock (it's idempotent).
+ */
+extern void clksrc_init(void);
+
+/*
+ * @brief  Select clock source used by gettsc() and friends
+ *
+ * @param[in] src  Clock source to use
+ *
+ * @return  0 if success, negative errno otherwise
+ *          -EINVAL   Bogus src
+ *          -ENOTSUP  Clock source isn't usable on this machine
+ */
+extern int clksrc_set(clksrc_t src);
+
+/*
+ * @brief  Get clock source currently used by gettsc() (resolves it if not
+ *         done already)
+ *
+ * @return  Active clock source (never CLKSRC_AUTO)
+ */
+extern clksrc_t clksrc_get(void);
+
+/*
+ * @brief  Get printable name of a clock source
+ *
+ * @param[in] src  Clock source
+ *
+ * @return  Name of the clock source, "unknown" for bogus src
+ */
+extern const char *clksrc_name(clksrc_t src);
+
+/*
+ * @brief  Get calibrated frequency of the cycle counter
+ *
+ * @return  Cycle counter frequency in Hz, 0 if TSC clock source isn't usable
+ */
+extern uint64_t clksrc_cycles_hz(void);
+
+/*
+ * @brief  Slow path of gettsc() for non-TSC clock sources
+ *
+ * @return  64bit current timestamp value in nanoseconds
+ */
+extern uint64_t gettsc_slow(void);
+
+/*
+ * @brief  Get timestamp of given POSIX clock with nanosecond granularity
+ *
+ * @param[in] clk  POSIX clock id
+ *
+ * @return  64bit current timestamp value in nanoseconds
+ */
+static inline uint64_t
+gettsc_clock(clockid_t clk)
+{
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * @brief  Get current timestamp with nanosecond granularity.
+ *         Always uses CLOCK_MONOTONIC_RAW regardless of clock source.
+ *
+ * @return  64bit current timestamp value in nanoseconds
+ */
+static inline uint64_t
+gettsc_raw(void)
+{
+    return gettsc_clock(CLOCK_MONOTONIC_RAW);
+}
+
+/*
+ * @brief  Get current timestamp with tick (~1-4ms) granularity.
+ *         Always uses CLOCK_MONOTONIC_COARSE regardless of clock source.
+ *         Good for millisecond-granular timeouts.
+ *
+ * @return  64bit current timestamp value in nanoseconds
+ */
+static inline uint64_t
+gettsc_coarse(void)
+{
+    return gettsc_clock(CLOCK_MONOTONIC_COARSE);
+}
+
+#if CLKSRC_HAS_CYCLES
+/*
+ * @brief  Read raw value of CPU cycle counter
+ *
+ * @return  64bit cycle counter value
+ */
+static inline uint64_t __attribute__((always_inline))
+clksrc_read_cycles(void)
+{
+#if defined(__x86_64__)
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+#else
+    uint64_t cyc;
+    __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r"(cyc)::"memory");
+    return cyc;
+#endif
+}
+
+/*
+ * @brief  Convert cycle counter value to nanoseconds as per calibration.
+ *         Signed delta tolerates counters that trail calibration base by few
+ *         cycles on other cpus.
+ *
+ * @param[in] cyc  Cycle counter value
+ *
+ * @return  64bit timestamp value in nanoseconds
+ */
+static inline uint64_t __attribute__((always_inline))
+clksrc_cycles_to_ns(uint64_t cyc)
+{
+    int64_t dcyc = (int64_t)(cyc - clksrc_state.base_cyc);
+    __extension__ __int128 dns = (__int128)dcyc * clksrc_state.mult;
+    return clksrc_state.base_ns + (int64_t)(dns >> CLKSRC_SHIFT);
+}
+#endif
+
 /*
  * @brief  Get current timestamp with nanosecond granularity.
- *         Uses CLOCK_MONOTNOIC_RAW. Good for testing short durations.
+ *         Uses active clock source (see clksrc_set()). Good for testing
+ *         short durations.
  *
  * @return  64bit current timestamp value in nanoseconds
  */
 static inline uint64_t
 gettsc(void)
 {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
-    return ts.tv_sec * 1000000000 + ts.tv_nsec;
+#if CLKSRC_HAS_CYCLES
+    if (__builtin_expect(
+            __atomic_load_n(&clksrc_state.src, __ATOMIC_ACQUIRE) == CLKSRC_TSC,
+            1)) {
+        return clksrc_cycles_to_ns(clksrc_read_cycles());
+    }
+#endif
+    return gettsc_slow();
 }
 
 /*
  * @brief  Get current timestamp with microsecond granularity.
- *         Uses CLOCK_MONOTNOIC_RAW. Good for testing short durations.
+ *         Uses active clock source. Good for testing short durations.
  *
  * @return  64bit current timestamp value in microseconds
  */
@@ -36,7 +212,7 @@ gettsc_us(void)
 
 /*
  * @brief  Get current timestamp with millisecond granularity.
- *         Uses CLOCK_MONOTNOIC_RAW. Good for testing short durations.
+ *         Uses active clock source. Good for testing short durations.
  *
  * @return  64bit current timestamp value in milliseconds
  */
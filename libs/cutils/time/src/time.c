@@ -0,0 +1,212 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+#include <cutils/time.h>
+
+// Duration of TSC calibration window (done once, at load time)
+#define CLKSRC_CALIB_NS (10 * 1000000ULL)
+// Sane range of cycle counter frequencies
+#define CLKSRC_MIN_HZ (1000000ULL)
+#define CLKSRC_MAX_HZ (10000000000ULL)
+
+clksrc_state_t clksrc_state = { .src = CLKSRC_AUTO };
+
+static pthread_once_t clksrc_once = PTHREAD_ONCE_INIT;
+static bool clksrc_tsc_ok;
+
+static const char *clksrc_names[CLKSRC_MAX] = {
+    [CLKSRC_AUTO] = "auto",
+    [CLKSRC_TSC] = "tsc",
+    [CLKSRC_MONOTONIC_RAW] = "monotonic_raw",
+    [CLKSRC_MONOTONIC_COARSE] = "monotonic_coarse",
+};
+
+#if CLKSRC_HAS_CYCLES
+/*
+ * @brief  Check if cycle counter ticks at constant rate regardless of
+ *         cpu frequency and power states (i.e. usable as a clock)
+ *
+ * @return  true if cycle counter is invariant, false otherwise
+ */
+static bool
+clksrc_cycles_invariant(void)
+{
+#if defined(__x86_64__)
+    // CPUID.80000007H:EDX[8] is "Invariant TSC"
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 ||
+        eax < 0x80000007) {
+        return false;
+    }
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return (edx & (1U << 8)) != 0;
+#else
+    // Generic timer (cntvct_el0) is architecturally constant rate
+    return true;
+#endif
+}
+
+/*
+ * @brief  Take a (MONOTONIC_RAW, cycles) sample pair. Retries few times to
+ *         pick the pair with the tightest bracket around cycles read.
+ *
+ * @param[out] ns   MONOTONIC_RAW timestamp in nanoseconds
+ * @param[out] cyc  Cycle counter value taken at ns
+ */
+static void
+clksrc_sample(uint64_t *ns, uint64_t *cyc)
+{
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < 8; i++) {
+        uint64_t t0 = gettsc_raw();
+        uint64_t c = clksrc_read_cycles();
+        uint64_t t1 = gettsc_raw();
+        // the first sample is always taken, so the outputs are always set
+        if (i == 0 || t1 - t0 < best) {
+            best = t1 - t0;
+            *ns = t0 + (t1 - t0) / 2;
+            *cyc = c;
+        }
+    }
+}
+
+/*
+ * @brief  Calibrate cycle counter against MONOTONIC_RAW
+ *
+ * @return  true if calibrated successfully, false otherwise
+ */
+static bool
+clksrc_calibrate(void)
+{
+    if (!clksrc_cycles_invariant()) {
+        return false;
+    }
+
+    uint64_t ns0, cyc0, ns1, cyc1;
+    clksrc_sample(&ns0, &cyc0);
+    struct timespec ts = { .tv_nsec = CLKSRC_CALIB_NS };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+        continue;
+    }
+    clksrc_sample(&ns1, &cyc1);
+    if (cyc1 <= cyc0 || ns1 <= ns0) {
+        return false;
+    }
+
+    uint64_t hz = (cyc1 - cyc0) * 1000000000ULL / (ns1 - ns0);
+#if defined(__aarch64__)
+    // Prefer architected frequency when firmware has programmed it
+    uint64_t frq;
+    __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(frq));
+    if (frq) {
+        hz = frq;
+    }
+#endif
+    if (hz < CLKSRC_MIN_HZ || hz > CLKSRC_MAX_HZ) {
+        return false;
+    }
+
+    clksrc_state.cyc_hz = hz;
+    clksrc_state.mult = (1000000000ULL << CLKSRC_SHIFT) / hz;
+    clksrc_state.base_cyc = cyc1;
+    clksrc_state.base_ns = ns1;
+    return true;
+}
+#endif
+
+/*
+ * @brief  One-time init of clock source: calibrate TSC and resolve
+ *         CLKSRC_AUTO unless user has already picked a source
+ */
+static void
+clksrc_resolve(void)
+{
+#if CLKSRC_HAS_CYCLES
+    clksrc_tsc_ok = clksrc_calibrate();
+#endif
+    int expected = CLKSRC_AUTO;
+    int src = clksrc_tsc_ok ? CLKSRC_TSC : CLKSRC_MONOTONIC_RAW;
+    __atomic_compare_exchange_n(&clksrc_state.src, &expected, src, false,
+                                __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+void
+clksrc_init(void)
+{
+    pthread_once(&clksrc_once, clksrc_resolve);
+}
+
+/*
+ * @brief  Calibrate at load time, so that no gettsc() call pays for it
+ */
+static void __attribute__((constructor))
+clksrc_ctor(void)
+{
+    clksrc_init();
+}
+
+int
+clksrc_set(clksrc_t src)
+{
+    if (src < CLKSRC_AUTO || src >= CLKSRC_MAX) {
+        return -EINVAL;
+    }
+
+    clksrc_init();
+    if (src == CLKSRC_AUTO) {
+        src = clksrc_tsc_ok ? CLKSRC_TSC : CLKSRC_MONOTONIC_RAW;
+    } else if (src == CLKSRC_TSC && !clksrc_tsc_ok) {
+        return -ENOTSUP;
+    }
+    __atomic_store_n(&clksrc_state.src, src, __ATOMIC_RELEASE);
+    return 0;
+}
+
+clksrc_t
+clksrc_get(void)
+{
+    int src = __atomic_load_n(&clksrc_state.src, __ATOMIC_ACQUIRE);
+    // Only before clksrc_ctor() has run, e.g. from another constructor
+    if (__builtin_expect(src == CLKSRC_AUTO, 0)) {
+        clksrc_init();
+        src = __atomic_load_n(&clksrc_state.src, __ATOMIC_ACQUIRE);
+    }
+    return src;
+}
+
+const char *
+clksrc_name(clksrc_t src)
+{
+    if (src < CLKSRC_AUTO || src >= CLKSRC_MAX) {
+        return "unknown";
+    }
+    return clksrc_names[src];
+}
+
+uint64_t
+clksrc_cycles_hz(void)
+{
+    clksrc_init();
+    return clksrc_tsc_ok ? clksrc_state.cyc_hz : 0;
+}
+
+uint64_t
+gettsc_slow(void)
+{
+    switch (clksrc_get()) {
+#if CLKSRC_HAS_CYCLES
+    case CLKSRC_TSC:
+        return clksrc_cycles_to_ns(clksrc_read_cycles());
+#endif
+    case CLKSRC_MONOTONIC_COARSE:
+        return gettsc_coarse();
+    default:
+        return gettsc_raw();
+    }
+}
@@ -0,0 +1,129 @@
+#ifndef CUTILS_TIMER_H
+#define CUTILS_TIMER_H
+
+#include <stdint.h>
+#include <cutils/list.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Timer service: multiplexes one-shot and periodic timers onto a single
+ * timerfd driven by an epoll loop on a service thread.
+ *
+ * Pending timers live in a hierarchical timing wheel (256 slots of one tick,
+ * then 3 levels of 64 slots) so arm and cancel are O(1). The timerfd is only
+ * programmed for the next non-empty tick (or the next cascade of the upper
+ * levels), and a timer's slack lets it fire on a coarser tick boundary
+ * within [deadline, deadline + slack] so nearby deadlines share wakeups.
+ *
+ * Callbacks run on the service thread, or on one of the service's worker
+ * threads when the timer is created with TIMER_F_WORKER. Callbacks must not
+ * block the service thread for long since that delays all the other timers.
+ *
+ * Timer entries are owned by the caller (no allocation on arm). An entry
+ * must not be freed while armed or while its callback may be running; the
+ * callback itself is a safe place to free a one-shot timer.
+ */
+
+typedef struct timer_svc timer_svc_t; // timer service context handle
+typedef struct timer_ent timer_ent_t;
+
+typedef void (*timer_cb_t)(timer_ent_t *t, void *arg);
+
+// Run callback on a worker thread instead of the service thread
+#define TIMER_F_WORKER (1U << 0)
+
+// A timer (fields are private to the service)
+struct timer_ent {
+    timer_cb_t cb;
+    void *arg;
+    uint32_t flags;
+    uint32_t state;
+    uint64_t due;      // nominal expiry tick
+    uint64_t deadline; // expiry tick after applying slack
+    uint64_t period;   // ticks, 0 for one-shot
+    uint64_t slack;    // ticks
+    uint64_t overruns; // periods skipped since armed
+    list_t *slot;
+    list_node_t node;
+    list_node_t rnode;
+};
+
+// Timer service statistics
+typedef struct {
+    uint64_t wakeups; // timerfd expirations handled
+    uint64_t fired;   // callbacks run
+    uint64_t pending; // timers in the wheel
+} timer_svc_stats_t;
+
+/*
+ * @brief  Create a timer service and start its service thread
+ *
+ * @param[in] tick_ms   Resolution of the wheel in milliseconds (0 for 1ms)
+ * @param[in] nworkers  Number of worker threads for TIMER_F_WORKER timers
+ *
+ * @return  Context handle for the timer service if success, NULL otherwise
+ */
+extern timer_svc_t *timer_svc_init(uint32_t tick_ms, unsigned int nworkers);
+
+/*
+ * @brief  Stop and destroy a timer service. Pending timers are dropped
+ *         without running their callbacks.
+ *
+ * @param[in] svc  Context handle for previously created timer service
+ */
+extern void timer_svc_fini(timer_svc_t *svc);
+
+/*
+ * @brief  Initialize a timer entry
+ *
+ * @param[in] t      Timer entry
+ * @param[in] cb     Callback to run on expiry
+ * @param[in] arg    Argument to callback
+ * @param[in] flags  TIMER_F_* flags
+ */
+extern void timer_ent_init(timer_ent_t *t, timer_cb_t cb, void *arg,
+                           uint32_t flags);
+
+/*
+ * @brief  Arm (or re-arm) a timer
+ *
+ * @param[in] svc        Context handle for previously created timer service
+ * @param[in] t          Initialized timer entry
+ * @param[in] delay_ms   Delay of first expiry from now in milliseconds
+ * @param[in] period_ms  Period of subsequent expiries, 0 for one-shot
+ * @param[in] slack_ms   Tolerated lateness used to coalesce wakeups
+ *
+ * @return  0 if success, negative errno otherwise
+ *          -EINVAL  Uninitialized timer entry
+ */
+extern int timer_svc_arm(timer_svc_t *svc, timer_ent_t *t, uint64_t delay_ms,
+                         uint64_t period_ms, uint64_t slack_ms);
+
+/*
+ * @brief  Cancel a timer. Its callback may still be running (but won't be
+ *         invoked again) when this returns.
+ *
+ * @param[in] svc  Context handle for previously created timer service
+ * @param[in] t    Timer entry
+ *
+ * @return  0 if a pending expiry was cancelled, negative errno otherwise
+ *          -ENOENT  Timer wasn't armed or queued
+ */
+extern int timer_svc_cancel(timer_svc_t *svc, timer_ent_t *t);
+
+/*
+ * @brief  Get statistics of a timer service
+ *
+ * @param[in]  svc    Context handle for previously created timer service
+ * @param[out] stats  Statistics
+ */
+extern void timer_svc_stats(timer_svc_t *svc, timer_svc_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CUTILS_TIMER_H
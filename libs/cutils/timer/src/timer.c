@@ -0,0 +1,532 @@
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/alloc.h>
+#include <cutils/list.h>
+#include <cutils/time.h>
+#include <cutils/timer.h>
+#include <cutils/types.h>
+
+// Timing wheel geometry: level 0 has 256 slots of 1 tick, each of the upper
+// levels has 64 slots spanning 64x the range of the level below it
+#define TW_L0_BITS 8
+#define TW_L0_SIZE (1U << TW_L0_BITS)
+#define TW_LN_BITS 6
+#define TW_LN_SIZE (1U << TW_LN_BITS)
+#define TW_NLEVELS 3
+// Timers further out are parked in the last level and re-inserted later
+#define TW_MAX_DELTA (1ULL << (TW_L0_BITS + TW_NLEVELS * TW_LN_BITS))
+#define TW_LN_SHIFT(lvl) (TW_L0_BITS + (lvl)*TW_LN_BITS)
+
+// timer_ent_t state bits
+#define TIMER_S_INIT (1U << 0)    // initialized by timer_ent_init()
+#define TIMER_S_PENDING (1U << 1) // in the wheel
+#define TIMER_S_QUEUED (1U << 2)  // in runq/workq waiting for callback
+
+#define NSEC_PER_MSEC 1000000ULL
+#define NSEC_PER_SEC 1000000000ULL
+
+// timer service context definition
+struct timer_svc {
+    uint64_t tick_ns;
+    uint64_t base_ns;    // CLOCK_MONOTONIC time of tick 0
+    uint64_t now_tick;   // next tick to process
+    uint64_t armed_tick; // tick timerfd is armed for, UINT64_MAX if none
+    uint64_t l0_count;
+    uint64_t ln_count;
+    uint64_t l0_map[TW_L0_SIZE / 64]; // non-empty level 0 slots
+    list_t l0[TW_L0_SIZE];
+    list_t ln[TW_NLEVELS][TW_LN_SIZE];
+    list_t runq; // callbacks for service thread
+    list_t workq; // callbacks for worker threads
+    pthread_mutex_t mut;
+    pthread_cond_t workcv;
+    int tfd;
+    int efd;
+    int epfd;
+    bool stop;
+    pthread_t thr;
+    unsigned int nworkers;
+    pthread_t *workers;
+    timer_svc_stats_t stats;
+};
+
+static inline uint64_t
+timer_now_ns(void)
+{
+    // timerfd runs on CLOCK_MONOTONIC and so must the wheel
+    return gettsc_clock(CLOCK_MONOTONIC);
+}
+
+/*
+ * @brief  Pick a tick in [due, due + slack] at the coarsest power-of-2
+ *         boundary so that timers with overlapping windows share ticks
+ *
+ * @param[in] due    Nominal expiry tick
+ * @param[in] slack  Tolerated lateness in ticks
+ *
+ * @return  Expiry tick
+ */
+static uint64_t
+tw_apply_slack(uint64_t due, uint64_t slack)
+{
+    uint64_t limit = due + slack;
+    uint64_t mask = due ^ limit;
+    if (slack == 0 || mask == 0) {
+        return due;
+    }
+    mask = (1ULL << (63 - __builtin_clzll(mask))) - 1;
+    return limit & ~mask;
+}
+
+static void
+tw_insert(timer_svc_t *svc, timer_ent_t *t)
+{
+    uint64_t e = MAX(t->deadline, svc->now_tick);
+    uint64_t delta = e - svc->now_tick;
+    list_t *slot = NULL;
+
+    if (delta < TW_L0_SIZE) {
+        unsigned int idx = e & (TW_L0_SIZE - 1);
+        slot = &svc->l0[idx];
+        svc->l0_map[idx / 64] |= 1ULL << (idx % 64);
+        svc->l0_count++;
+    } else {
+        if (delta >= TW_MAX_DELTA) {
+            e = svc->now_tick + TW_MAX_DELTA - 1;
+            delta = TW_MAX_DELTA - 1;
+        }
+        unsigned int lvl = 0;
+        while (delta >= 1ULL << TW_LN_SHIFT(lvl + 1)) {
+            lvl++;
+        }
+        slot = &svc->ln[lvl][(e >> TW_LN_SHIFT(lvl)) & (TW_LN_SIZE - 1)];
+        svc->ln_count++;
+    }
+    list_insert_tail(slot, t);
+    t->slot = slot;
+    t->state |= TIMER_S_PENDING;
+}
+
+static void
+tw_remove(timer_svc_t *svc, timer_ent_t *t)
+{
+    list_delete(t->slot, t);
+    if (t->slot >= svc->l0 && t->slot < svc->l0 + TW_L0_SIZE) {
+        unsigned int idx = t->slot - svc->l0;
+        if (list_empty(t->slot)) {
+            svc->l0_map[idx / 64] &= ~(1ULL << (idx % 64));
+        }
+        svc->l0_count--;
+    } else {
+        svc->ln_count--;
+    }
+    t->slot = NULL;
+    t->state &= ~TIMER_S_PENDING;
+}
+
+// Re-distribute timers of an upper level slot to the levels below
+static void
+tw_cascade(timer_svc_t *svc, unsigned int lvl, unsigned int idx)
+{
+    list_t tmp;
+    timer_ent_t *t = NULL;
+
+    list_move(&svc->ln[lvl][idx], &tmp);
+    while ((t = list_delete_head(&tmp))) {
+        svc->ln_count--;
+        tw_insert(svc, t);
+    }
+    list_fini(&tmp);
+}
+
+// Handle a timer taken off level 0 at svc->now_tick
+static void
+tw_expire(timer_svc_t *svc, timer_ent_t *t)
+{
+    // Parked far-out timer isn't due yet
+    if (t->deadline > svc->now_tick) {
+        tw_insert(svc, t);
+        return;
+    }
+
+    if (t->period) {
+        t->due += t->period;
+        if (t->due <= svc->now_tick) {
+            uint64_t skipped = (svc->now_tick - t->due) / t->period + 1;
+            t->due += skipped * t->period;
+            t->overruns += skipped;
+        }
+        t->deadline = tw_apply_slack(t->due, t->slack);
+        tw_insert(svc, t);
+    }
+
+    if (t->state & TIMER_S_QUEUED) {
+        // previous expiry is still waiting for its callback
+        t->overruns++;
+    } else {
+        list_insert_tail(t->flags & TIMER_F_WORKER ? &svc->workq : &svc->runq,
+                         t);
+        t->state |= TIMER_S_QUEUED;
+    }
+}
+
+// Process all the ticks up to (and including) target
+static void
+tw_advance(timer_svc_t *svc, uint64_t target)
+{
+    while (svc->now_tick <= target) {
+        uint64_t now = svc->now_tick;
+        unsigned int idx = now & (TW_L0_SIZE - 1);
+
+        if (idx == 0 && svc->ln_count) {
+            for (unsigned int lvl = 0; lvl < TW_NLEVELS; lvl++) {
+                unsigned int i = (now >> TW_LN_SHIFT(lvl)) & (TW_LN_SIZE - 1);
+                tw_cascade(svc, lvl, i);
+                if (i != 0) {
+                    break;
+                }
+            }
+        }
+
+        if (!list_empty(&svc->l0[idx])) {
+            list_t tmp;
+            timer_ent_t *t = NULL;
+            svc->l0_map[idx / 64] &= ~(1ULL << (idx % 64));
+            list_move(&svc->l0[idx], &tmp);
+            while ((t = list_delete_head(&tmp))) {
+                svc->l0_count--;
+                t->slot = NULL;
+                t->state &= ~TIMER_S_PENDING;
+                tw_expire(svc, t);
+            }
+            list_fini(&tmp);
+        }
+
+        // Nothing in level 0: jump to next cascade (or target)
+        if (svc->l0_count == 0) {
+            svc->now_tick = MIN((now | (TW_L0_SIZE - 1)) + 1, target + 1);
+        } else {
+            svc->now_tick = now + 1;
+        }
+    }
+}
+
+// Get next tick that needs processing, UINT64_MAX if none
+static uint64_t
+tw_next(timer_svc_t *svc)
+{
+    uint64_t now = svc->now_tick;
+    uint64_t base = now & ~(uint64_t)(TW_L0_SIZE - 1);
+    unsigned int idx = now & (TW_L0_SIZE - 1);
+    unsigned int w0 = idx / 64;
+    uint64_t next = UINT64_MAX;
+
+    if (svc->l0_count) {
+        // slots at or after idx are in this round, the ones before in next
+        for (unsigned int w = w0; w < TW_L0_SIZE / 64 && next == UINT64_MAX;
+             w++) {
+            uint64_t m = svc->l0_map[w];
+            m &= w == w0 ? ~0ULL << (idx % 64) : ~0ULL;
+            if (m) {
+                next = base + w * 64 + __builtin_ctzll(m);
+            }
+        }
+        for (unsigned int w = 0; w <= w0 && next == UINT64_MAX; w++) {
+            uint64_t m = svc->l0_map[w];
+            m &= w == w0 ? (1ULL << (idx % 64)) - 1 : ~0ULL;
+            if (m) {
+                next = base + TW_L0_SIZE + w * 64 + __builtin_ctzll(m);
+            }
+        }
+    }
+    if (svc->ln_count) {
+        next = MIN(next, idx == 0 ? now : base + TW_L0_SIZE);
+    }
+    return next;
+}
+
+// Program timerfd for the next tick that needs processing
+static void
+timer_svc_rearm(timer_svc_t *svc)
+{
+    uint64_t next = tw_next(svc);
+    if (next == svc->armed_tick) {
+        return;
+    }
+
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its)); // NOLINT
+    if (next != UINT64_MAX) {
+        uint64_t ns = svc->base_ns + next * svc->tick_ns;
+        its.it_value.tv_sec = ns / NSEC_PER_SEC;
+        its.it_value.tv_nsec = ns % NSEC_PER_SEC;
+    }
+    timerfd_settime(svc->tfd, TFD_TIMER_ABSTIME, &its, NULL);
+    svc->armed_tick = next;
+}
+
+static void
+timer_svc_run(timer_svc_t *svc, list_t *q)
+{
+    timer_ent_t *t = NULL;
+    while ((t = list_delete_head(q))) {
+        t->state &= ~TIMER_S_QUEUED;
+        svc->stats.fired++;
+        pthread_mutex_unlock(&svc->mut);
+        t->cb(t, t->arg); // may free t
+        pthread_mutex_lock(&svc->mut);
+    }
+}
+
+static void *
+timer_svc_thread(void *arg)
+{
+    timer_svc_t *svc = arg;
+    struct epoll_event evs[2];
+
+    for (;;) {
+        int n = epoll_wait(svc->epfd, evs, 2, -1);
+        if (n < 0 && errno != EINTR) {
+            break;
+        }
+
+        bool fired = false;
+        for (int i = 0; i < n; i++) {
+            uint64_t val;
+            if (read(evs[i].data.fd, &val, sizeof(val)) > 0 &&
+                evs[i].data.fd == svc->tfd) {
+                fired = true;
+            }
+        }
+
+        pthread_mutex_lock(&svc->mut);
+        if (svc->stop) {
+            pthread_mutex_unlock(&svc->mut);
+            break;
+        }
+        if (fired) {
+            svc->stats.wakeups++;
+            // timerfd has disarmed itself after expiring
+            svc->armed_tick = UINT64_MAX;
+        }
+        tw_advance(svc, (timer_now_ns() - svc->base_ns) / svc->tick_ns);
+        timer_svc_rearm(svc);
+        if (!list_empty(&svc->workq)) {
+            pthread_cond_broadcast(&svc->workcv);
+        }
+        timer_svc_run(svc, &svc->runq);
+        pthread_mutex_unlock(&svc->mut);
+    }
+    return NULL;
+}
+
+static void *
+timer_svc_worker(void *arg)
+{
+    timer_svc_t *svc = arg;
+
+    pthread_mutex_lock(&svc->mut);
+    while (!svc->stop) {
+        if (list_empty(&svc->workq)) {
+            pthread_cond_wait(&svc->workcv, &svc->mut);
+        } else {
+            timer_svc_run(svc, &svc->workq);
+        }
+    }
+    pthread_mutex_unlock(&svc->mut);
+    return NULL;
+}
+
+static void
+timer_svc_free(timer_svc_t *svc)
+{
+    if (svc->epfd >= 0) {
+        close(svc->epfd);
+    }
+    if (svc->efd >= 0) {
+        close(svc->efd);
+    }
+    if (svc->tfd >= 0) {
+        close(svc->tfd);
+    }
+    pthread_cond_destroy(&svc->workcv);
+    pthread_mutex_destroy(&svc->mut);
+    free(svc->workers);
+    free(svc);
+}
+
+timer_svc_t *
+timer_svc_init(uint32_t tick_ms, unsigned int nworkers)
+{
+    timer_svc_t *svc = zmalloc(sizeof(timer_svc_t));
+    svc->tick_ns = (tick_ms ? tick_ms : 1) * NSEC_PER_MSEC;
+    svc->base_ns = timer_now_ns();
+    svc->armed_tick = UINT64_MAX;
+    for (unsigned int i = 0; i < TW_L0_SIZE; i++) {
+        list_init(&svc->l0[i], offsetof(timer_ent_t, node));
+    }
+    for (unsigned int lvl = 0; lvl < TW_NLEVELS; lvl++) {
+        for (unsigned int i = 0; i < TW_LN_SIZE; i++) {
+            list_init(&svc->ln[lvl][i], offsetof(timer_ent_t, node));
+        }
+    }
+    list_init(&svc->runq, offsetof(timer_ent_t, rnode));
+    list_init(&svc->workq, offsetof(timer_ent_t, rnode));
+    pthread_mutex_init(&svc->mut, NULL);
+    pthread_cond_init(&svc->workcv, NULL);
+
+    svc->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    svc->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    svc->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (svc->tfd < 0 || svc->efd < 0 || svc->epfd < 0) {
+        timer_svc_free(svc);
+        return NULL;
+    }
+    struct epoll_event ev = { .events = EPOLLIN };
+    ev.data.fd = svc->tfd;
+    epoll_ctl(svc->epfd, EPOLL_CTL_ADD, svc->tfd, &ev);
+    ev.data.fd = svc->efd;
+    epoll_ctl(svc->epfd, EPOLL_CTL_ADD, svc->efd, &ev);
+
+    svc->workers = zalloc(MAX(nworkers, 1), sizeof(pthread_t));
+    if (pthread_create(&svc->thr, NULL, timer_svc_thread, svc) != 0) {
+        timer_svc_free(svc);
+        return NULL;
+    }
+    for (; svc->nworkers < nworkers; svc->nworkers++) {
+        if (pthread_create(&svc->workers[svc->nworkers], NULL,
+                           timer_svc_worker, svc) != 0) {
+            timer_svc_fini(svc);
+            return NULL;
+        }
+    }
+    return svc;
+}
+
+void
+timer_svc_fini(timer_svc_t *svc)
+{
+    if (!svc) {
+        return;
+    }
+
+    uint64_t one = 1;
+    pthread_mutex_lock(&svc->mut);
+    svc->stop = true;
+    pthread_cond_broadcast(&svc->workcv);
+    pthread_mutex_unlock(&svc->mut);
+    if (write(svc->efd, &one, sizeof(one)) != sizeof(one)) {
+        assert(0);
+    }
+    pthread_join(svc->thr, NULL);
+    for (unsigned int i = 0; i < svc->nworkers; i++) {
+        pthread_join(svc->workers[i], NULL);
+    }
+
+    // Drop whatever is left
+    timer_ent_t *t = NULL;
+    for (unsigned int i = 0; i < TW_L0_SIZE; i++) {
+        while ((t = list_head(&svc->l0[i]))) {
+            tw_remove(svc, t);
+        }
+        list_fini(&svc->l0[i]);
+    }
+    for (unsigned int lvl = 0; lvl < TW_NLEVELS; lvl++) {
+        for (unsigned int i = 0; i < TW_LN_SIZE; i++) {
+            while ((t = list_head(&svc->ln[lvl][i]))) {
+                tw_remove(svc, t);
+            }
+            list_fini(&svc->ln[lvl][i]);
+        }
+    }
+    while ((t = list_delete_head(&svc->runq)) ||
+           (t = list_delete_head(&svc->workq))) {
+        t->state &= ~TIMER_S_QUEUED;
+    }
+    timer_svc_free(svc);
+}
+
+void
+timer_ent_init(timer_ent_t *t, timer_cb_t cb, void *arg, uint32_t flags)
+{
+    assert(t && cb);
+    memset(t, 0, sizeof(*t)); // NOLINT
+    t->cb = cb;
+    t->arg = arg;
+    t->flags = flags;
+    t->state = TIMER_S_INIT;
+}
+
+int
+timer_svc_arm(timer_svc_t *svc, timer_ent_t *t, uint64_t delay_ms,
+              uint64_t period_ms, uint64_t slack_ms)
+{
+    assert(svc && t);
+    if (!(t->state & TIMER_S_INIT)) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&svc->mut);
+    if (t->state & TIMER_S_PENDING) {
+        tw_remove(svc, t);
+    }
+
+    // Idle wheel may lag behind; catch up so new timer lands in level 0
+    uint64_t now = timer_now_ns() - svc->base_ns;
+    if (svc->l0_count == 0 && svc->ln_count == 0) {
+        svc->now_tick = MAX(svc->now_tick, now / svc->tick_ns);
+    }
+
+    uint64_t tick_ms = svc->tick_ns / NSEC_PER_MSEC;
+    t->due = (now + delay_ms * NSEC_PER_MSEC + svc->tick_ns - 1) / svc->tick_ns;
+    t->period = period_ms ? (period_ms + tick_ms - 1) / tick_ms : 0;
+    t->slack = slack_ms / tick_ms;
+    t->overruns = 0;
+    t->deadline = tw_apply_slack(t->due, t->slack);
+    tw_insert(svc, t);
+    timer_svc_rearm(svc);
+    pthread_mutex_unlock(&svc->mut);
+    return 0;
+}
+
+int
+timer_svc_cancel(timer_svc_t *svc, timer_ent_t *t)
+{
+    assert(svc && t);
+    int err = -ENOENT;
+
+    pthread_mutex_lock(&svc->mut);
+    if (t->state & TIMER_S_PENDING) {
+        tw_remove(svc, t);
+        timer_svc_rearm(svc);
+        err = 0;
+    }
+    if (t->state & TIMER_S_QUEUED) {
+        list_delete(t->flags & TIMER_F_WORKER ? &svc->workq : &svc->runq, t);
+        t->state &= ~TIMER_S_QUEUED;
+        err = 0;
+    }
+    pthread_mutex_unlock(&svc->mut);
+    return err;
+}
+
+void
+timer_svc_stats(timer_svc_t *svc, timer_svc_stats_t *stats)
+{
+    assert(svc && stats);
+    pthread_mutex_lock(&svc->mut);
+    *stats = svc->stats;
+    stats->pending = svc->l0_count + svc->ln_count;
+    pthread_mutex_unlock(&svc->mut);
+}
@@ -0,0 +1,164 @@
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <cutils/time.h>
+#include <cutils/timer.h>
+
+#define NTIMERS 1000
+// Tolerated lateness of a callback (loaded CI machines)
+#define MAX_LATE_NS (50 * 1000000ULL)
+
+typedef struct {
+    timer_ent_t t;
+    uint64_t armed_ns;
+    uint64_t delay_ms;
+    uint64_t fired_ns;
+    pthread_t thr;
+    int nfired;
+} test_timer_t;
+
+static test_timer_t timers[NTIMERS];
+static int nfired;
+
+static void
+test_cb(timer_ent_t *t, void *arg)
+{
+    test_timer_t *tt = arg;
+    assert(&tt->t == t);
+    tt->fired_ns = gettsc_clock(CLOCK_MONOTONIC);
+    tt->thr = pthread_self();
+    __atomic_add_fetch(&tt->nfired, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&nfired, 1, __ATOMIC_RELAXED);
+}
+
+// Arm n one-shot timers with delays of 1..100ms
+static void
+arm_timers(timer_svc_t *svc, int n, uint64_t slack_ms, uint32_t flags)
+{
+    __atomic_store_n(&nfired, 0, __ATOMIC_RELAXED);
+    for (int i = 0; i < n; i++) {
+        test_timer_t *tt = &timers[i];
+        timer_ent_init(&tt->t, test_cb, tt, flags);
+        tt->delay_ms = i % 100 + 1;
+        tt->nfired = 0;
+        tt->armed_ns = gettsc_clock(CLOCK_MONOTONIC);
+        int err = timer_svc_arm(svc, &tt->t, tt->delay_ms, 0, slack_ms);
+        assert(err == 0);
+    }
+}
+
+// Wait (up to 2s) till n callbacks have run
+static void
+wait_fired(int n)
+{
+    for (int i = 0; i < 2000 && __atomic_load_n(&nfired, __ATOMIC_RELAXED) < n;
+         i++) {
+        usleep(1000);
+    }
+    assert(__atomic_load_n(&nfired, __ATOMIC_RELAXED) == n);
+}
+
+int
+main(void)
+{
+    timer_svc_t *svc = timer_svc_init(1, 2);
+    assert(svc);
+    timer_svc_stats_t st0, st1;
+
+    // Uninitialized timer
+    timer_ent_t bogus = { 0 };
+    int err = timer_svc_arm(svc, &bogus, 1, 0, 0);
+    assert(err == -EINVAL);
+
+    // One-shots fire once, never early and not much late
+    timer_svc_stats(svc, &st0);
+    arm_timers(svc, NTIMERS, 0, 0);
+    wait_fired(NTIMERS);
+    timer_svc_stats(svc, &st1);
+    for (int i = 0; i < NTIMERS; i++) {
+        test_timer_t *tt = &timers[i];
+        uint64_t due_ns = tt->armed_ns + tt->delay_ms * 1000000ULL;
+        assert(tt->nfired == 1);
+        assert(tt->fired_ns >= due_ns && tt->fired_ns - due_ns < MAX_LATE_NS);
+    }
+    assert(st1.pending == 0);
+    uint64_t wakeups_exact = st1.wakeups - st0.wakeups;
+
+    // Slack coalesces nearby deadlines into fewer wakeups
+    timer_svc_stats(svc, &st0);
+    arm_timers(svc, NTIMERS, 64, 0);
+    wait_fired(NTIMERS);
+    timer_svc_stats(svc, &st1);
+    uint64_t wakeups_slack = st1.wakeups - st0.wakeups;
+    printf("wakeups for %d timers: %llu exact, %llu with 64ms slack\n",
+           NTIMERS, (unsigned long long)wakeups_exact,
+           (unsigned long long)wakeups_slack);
+    assert(wakeups_slack * 2 < wakeups_exact);
+
+    // Worker callbacks run off the service thread
+    arm_timers(svc, 1, 0, 0);
+    wait_fired(1);
+    pthread_t svc_thr = timers[0].thr;
+    arm_timers(svc, 1, 0, TIMER_F_WORKER);
+    wait_fired(1);
+    assert(!pthread_equal(svc_thr, timers[0].thr));
+
+    // Cancelled timers don't fire
+    arm_timers(svc, 100, 0, 0);
+    for (int i = 0; i < 100; i += 2) {
+        err = timer_svc_cancel(svc, &timers[i].t);
+        assert(err == 0);
+    }
+    usleep(150 * 1000);
+    assert(__atomic_load_n(&nfired, __ATOMIC_RELAXED) == 50);
+    err = timer_svc_cancel(svc, &timers[1].t);
+    assert(err == -ENOENT);
+
+    // Periodic timer keeps firing till cancelled
+    test_timer_t *tt = &timers[0];
+    timer_ent_init(&tt->t, test_cb, tt, 0);
+    tt->nfired = 0;
+    err = timer_svc_arm(svc, &tt->t, 10, 10, 0);
+    assert(err == 0);
+    usleep(105 * 1000);
+    err = timer_svc_cancel(svc, &tt->t);
+    assert(err == 0);
+    int n = __atomic_load_n(&tt->nfired, __ATOMIC_RELAXED);
+    assert(n >= 8 && n <= 11);
+    usleep(30 * 1000);
+    assert(__atomic_load_n(&tt->nfired, __ATOMIC_RELAXED) == n);
+
+    // Timers beyond level 0 cascade down and fire on time
+    __atomic_store_n(&nfired, 0, __ATOMIC_RELAXED);
+    for (int i = 0; i < 3; i++) {
+        timer_ent_init(&timers[i].t, test_cb, &timers[i], 0);
+        timers[i].delay_ms = 300 + i * 200;
+        timers[i].armed_ns = gettsc_clock(CLOCK_MONOTONIC);
+        err = timer_svc_arm(svc, &timers[i].t, timers[i].delay_ms, 0, 0);
+        assert(err == 0);
+    }
+    wait_fired(3);
+    for (int i = 0; i < 3; i++) {
+        uint64_t due_ns = timers[i].armed_ns + timers[i].delay_ms * 1000000ULL;
+        assert(timers[i].fired_ns >= due_ns);
+        assert(timers[i].fired_ns - due_ns < MAX_LATE_NS);
+    }
+
+    // Far-out timers park in the upper levels
+    timer_ent_init(&tt->t, test_cb, tt, 0);
+    err = timer_svc_arm(svc, &tt->t, 7ULL * 24 * 3600 * 1000, 0, 0);
+    assert(err == 0);
+    timer_svc_stats(svc, &st1);
+    assert(st1.pending == 1);
+    err = timer_svc_cancel(svc, &tt->t);
+    assert(err == 0);
+
+    timer_svc_fini(svc);
+
+    // Gets here only if above test passes
+    printf("PASSED\n");
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cutils/time.h>
+#include <cutils/tpool.h>
+
+// Elements of the fine-grained parallel_for (grain of FINE_GRAIN)
+#define FINE_N (16 * 1024 * 1024)
+#define FINE_GRAIN 256
+// Depth of the fine-grained task tree (binary, ~1 task per leaf)
+#define TREE_DEPTH 18
+// Coarse tasks and iterations of work per task
+#define COARSE_TASKS 256
+#define COARSE_ITERS (200 * 1000)
+
+typedef struct {
+    tpool_t *pool;
+    tpool_group_t *group;
+    unsigned int depth;
+} tree_arg_t;
+
+static double *fine_buf;
+
+// A few flops per element: cost is dominated by scheduling at small grains
+static void
+fine_range(void *arg, size_t lo, size_t hi)
+{
+    (void)arg;
+    for (size_t i = lo; i < hi; i++) {
+        fine_buf[i] = fine_buf[i] * 1.000001 + 0.5;
+    }
+}
+
+static uint64_t
+spin_work(uint64_t iters)
+{
+    uint64_t x = iters;
+    for (uint64_t i = 0; i < iters; i++) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    return x;
+}
+
+static void
+coarse_task(void *arg)
+{
+    *(volatile uint64_t *)arg = spin_work(COARSE_ITERS);
+}
+
+static tree_arg_t tree_args[1U << (TREE_DEPTH + 1)];
+
+// Node i of a binary tree of tasks: spawns its two children (stolen by idle
+// workers) so tasks are created and run all over the pool
+static void
+tree_task(void *arg)
+{
+    tree_arg_t *t = arg;
+    size_t i = (size_t)(t - tree_args);
+    if (t->depth == 0) {
+        return;
+    }
+    for (size_t c = 2 * i + 1; c <= 2 * i + 2; c++) {
+        tree_args[c] = (tree_arg_t){ t->pool, t->group, t->depth - 1 };
+        tpool_submit(t->pool, t->group, tree_task, &tree_args[c]);
+    }
+}
+
+static double
+bench_fine_pfor(tpool_t *pool)
+{
+    uint64_t t0 = gettsc();
+    tpool_parallel_for(pool, 0, FINE_N, FINE_GRAIN, fine_range, NULL);
+    return (double)(gettsc() - t0) / 1e6;
+}
+
+static double
+bench_fine_tasks(tpool_t *pool)
+{
+    tpool_group_t group = TPOOL_GROUP_INIT;
+    uint64_t t0 = gettsc();
+    tree_args[0] = (tree_arg_t){ pool, &group, TREE_DEPTH };
+    tpool_submit(pool, &group, tree_task, &tree_args[0]);
+    tpool_group_wait(pool, &group);
+    return (double)(gettsc() - t0) / 1e6;
+}
+
+static double
+bench_coarse_tasks(tpool_t *pool)
+{
+    static uint64_t sink[COARSE_TASKS];
+    tpool_group_t group = TPOOL_GROUP_INIT;
+    uint64_t t0 = gettsc();
+    for (int i = 0; i < COARSE_TASKS; i++) {
+        tpool_submit(pool, &group, coarse_task, &sink[i]);
+    }
+    tpool_group_wait(pool, &group);
+    return (double)(gettsc() - t0) / 1e6;
+}
+
+typedef struct {
+    const char *name;
+    double (*fn)(tpool_t *pool);
+    double base_ms;
+} workload_t;
+
+int
+main(int argc, char *argv[])
+{
+    long maxthr = argc > 1 ? strtol(argv[1], NULL, 0)
+                           : sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t flags = argc > 2 && atoi(argv[2]) ? TPOOL_F_PIN : 0;
+    if (maxthr <= 0) {
+        fprintf(stderr, "Usage: %s [MAX_THREADS] [PIN]\n", argv[0]);
+        return -1;
+    }
+    fine_buf = calloc(FINE_N, sizeof(double));
+    if (!fine_buf) {
+        return -1;
+    }
+
+    workload_t wl[] = {
+        { "fine parallel_for", bench_fine_pfor, 0 },
+        { "fine task tree", bench_fine_tasks, 0 },
+        { "coarse tasks", bench_coarse_tasks, 0 },
+    };
+    int nwl = sizeof(wl) / sizeof(wl[0]);
+
+    printf("%-20s %8s %12s %8s\n", "workload", "threads", "ms", "speedup");
+    // 1, 2, 4, ... and maxthr
+    for (long nthr = 1;; nthr = nthr * 2 > maxthr ? maxthr : nthr * 2) {
+        tpool_t *pool = tpool_init((unsigned int)nthr, flags);
+        if (!pool) {
+            return -1;
+        }
+        for (int i = 0; i < nwl; i++) {
+            // best of 3 (first run also warms up the workers)
+            double ms = wl[i].fn(pool);
+            for (int r = 0; r < 2; r++) {
+                double m = wl[i].fn(pool);
+                ms = m < ms ? m : ms;
+            }
+            if (nthr == 1) {
+                wl[i].base_ms = ms;
+            }
+            printf("%-20s %8ld %12.2f %7.2fx\n", wl[i].name, nthr, ms,
+                   wl[i].base_ms / ms);
+        }
+        tpool_fini(pool);
+        if (nthr == maxthr) {
+            break;
+        }
+    }
+
+    free(fine_buf);
+    return 0;
+}
@@ -0,0 +1,111 @@
+#ifndef CUTILS_TPOOL_H
+#define CUTILS_TPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Work-stealing thread pool
+ *
+ * Every worker owns a fixed-size Chase-Lev deque: tasks submitted from a
+ * worker are pushed to (and popped LIFO from) the bottom of its own deque,
+ * while idle workers steal FIFO from the top of the others'. Tasks submitted
+ * from outside the pool (or overflowing a full deque) go to a shared
+ * injection queue. Workers spin briefly when out of work and then park on a
+ * futex till new tasks are submitted.
+ *
+ * Tasks are passed by value (no allocation per task). A task can be tracked
+ * by a task group which the submitter waits on; a worker waiting on a group
+ * keeps running other tasks meanwhile, so nested parallelism doesn't
+ * deadlock.
+ */
+
+typedef struct tpool tpool_t; // thread pool context handle
+
+typedef void (*tpool_fn_t)(void *arg);
+typedef void (*tpool_range_fn_t)(void *arg, size_t lo, size_t hi);
+
+// Pin worker i to the i-th CPU (mod number of CPUs) of the process
+#define TPOOL_F_PIN (1U << 0)
+
+// A group of tasks to wait on (must outlive its tasks)
+typedef struct {
+    uint32_t pending;
+} tpool_group_t;
+
+#define TPOOL_GROUP_INIT { 0 }
+
+/*
+ * @brief  Create a thread pool and start its workers
+ *
+ * @param[in] nthreads  Number of worker threads (0 for number of online CPUs)
+ * @param[in] flags     TPOOL_F_* flags
+ *
+ * @return  Context handle for the thread pool if success, NULL otherwise
+ */
+extern tpool_t *tpool_init(unsigned int nthreads, uint32_t flags);
+
+/*
+ * @brief  Run the remaining tasks, stop the workers and destroy a thread
+ *         pool. Must not be called from a task.
+ *
+ * @param[in] pool  Context handle for previously created thread pool
+ */
+extern void tpool_fini(tpool_t *pool);
+
+/*
+ * @brief  Get number of worker threads of a thread pool
+ *
+ * @param[in] pool  Context handle for previously created thread pool
+ *
+ * @return  Number of worker threads
+ */
+extern unsigned int tpool_nthreads(tpool_t *pool);
+
+/*
+ * @brief  Submit a task
+ *
+ * @param[in] pool   Context handle for previously created thread pool
+ * @param[in] group  Task group to add the task to (NULL for none)
+ * @param[in] fn     Task function
+ * @param[in] arg    Argument to task function
+ *
+ * @return  0 if success, negative errno otherwise
+ *          -ENOMEM  Injection queue couldn't grow
+ */
+extern int tpool_submit(tpool_t *pool, tpool_group_t *group, tpool_fn_t fn,
+                        void *arg);
+
+/*
+ * @brief  Wait till all the tasks of a group have run. The calling thread
+ *         runs pending tasks of the pool while waiting.
+ *
+ * @param[in] pool   Context handle for previously created thread pool
+ * @param[in] group  Task group
+ */
+extern void tpool_group_wait(tpool_t *pool, tpool_group_t *group);
+
+/*
+ * @brief  Run fn over [begin, end) in chunks of grain indices, in parallel
+ *         on the pool and the calling thread. Returns once all the chunks
+ *         have run. Can be nested (called from a task).
+ *
+ * @param[in] pool   Context handle for previously created thread pool
+ * @param[in] begin  First index
+ * @param[in] end    One past the last index
+ * @param[in] grain  Number of indices per call of fn (0 to pick one)
+ * @param[in] fn     Function run on every chunk [lo, hi)
+ * @param[in] arg    Argument to fn
+ */
+extern void tpool_parallel_for(tpool_t *pool, size_t begin, size_t end,
+                               size_t grain, tpool_range_fn_t fn, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CUTILS_TPOOL_H
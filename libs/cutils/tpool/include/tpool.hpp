@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "cutils/tpool.h"
+
+namespace cutils {
+
+namespace detail {
+
+// First exception thrown by the tasks of a call: exceptions must not unwind
+// through the C frames of the pool, they're rethrown once the tasks are done
+class FirstException {
+ public:
+  void capture() noexcept {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (!ex_) {
+      ex_ = std::current_exception();
+    }
+    caught_.store(true, std::memory_order_relaxed);
+  }
+  bool caught() const noexcept { return caught_.load(std::memory_order_relaxed); }
+  void rethrow() {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (ex_) {
+      caught_.store(false, std::memory_order_relaxed);
+      std::rethrow_exception(std::exchange(ex_, nullptr));
+    }
+  }
+
+ private:
+  std::mutex mu_;
+  std::exception_ptr ex_;
+  std::atomic<bool> caught_{false};
+};
+
+}  // namespace detail
+
+// RAII owner of a tpool_t (see cutils/tpool.h)
+class ThreadPool {
+ public:
+  explicit ThreadPool(unsigned int nthreads = 0, uint32_t flags = 0) : pool_(tpool_init(nthreads, flags)) {
+    if (!pool_) {
+      throw std::runtime_error("tpool_init failed");
+    }
+  }
+  ~ThreadPool() { tpool_fini(pool_); }
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  unsigned int size() const { return tpool_nthreads(pool_); }
+  tpool_t* get() const { return pool_; }
+
+  // Run fn(lo, hi) over chunks of [begin, end); returns once all have run.
+  // If fn throws, the chunks not started yet are skipped and the first
+  // exception is rethrown here.
+  template <typename F>
+  void parallelFor(size_t begin, size_t end, size_t grain, F&& fn) {
+    struct Body {
+      std::remove_reference_t<F>* fn;
+      detail::FirstException error;
+    } body{&fn, {}};
+    tpool_parallel_for(
+        pool_, begin, end, grain,
+        [](void* arg, size_t lo, size_t hi) {
+          auto* body = static_cast<Body*>(arg);
+          if (body->error.caught()) {
+            return;
+          }
+          try {
+            (*body->fn)(lo, hi);
+          } catch (...) {
+            body->error.capture();
+          }
+        },
+        &body);
+    body.error.rethrow();
+  }
+
+ private:
+  tpool_t* pool_;
+};
+
+// Group of tasks run on a ThreadPool; the destructor waits for them. wait()
+// rethrows the first exception a task threw, the destructor drops it.
+class TaskGroup {
+ public:
+  explicit TaskGroup(ThreadPool& pool) : pool_(pool) {}
+  ~TaskGroup() { tpool_group_wait(pool_.get(), &group_); }
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  template <typename F>
+  void run(F&& fn) {
+    auto* task = new Task{std::function<void()>(std::forward<F>(fn)), this};
+    if (tpool_submit(pool_.get(), &group_, &TaskGroup::trampoline, task) != 0) {
+      delete task;
+      throw std::bad_alloc();
+    }
+  }
+
+  void wait() {
+    tpool_group_wait(pool_.get(), &group_);
+    error_.rethrow();
+  }
+
+ private:
+  struct Task {
+    std::function<void()> fn;
+    TaskGroup* group;
+  };
+
+  static void trampoline(void* arg) {
+    std::unique_ptr<Task> task(static_cast<Task*>(arg));
+    try {
+      task->fn();
+    } catch (...) {
+      task->group->error_.capture();
+    }
+  }
+
+  ThreadPool& pool_;
+  tpool_group_t group_ = TPOOL_GROUP_INIT;
+  detail::FirstException error_;
+};
+
+}  // namespace cutils
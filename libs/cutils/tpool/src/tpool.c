@@ -0,0 +1,577 @@
+#define _GNU_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/alloc.h>
+#include <cutils/tpool.h>
+
+// Capacity of per-worker deques (power of 2)
+#define TPOOL_DEQUE_SIZE 4096
+#define TPOOL_DEQUE_MASK (TPOOL_DEQUE_SIZE - 1)
+// Initial capacity of the injection queue (power of 2)
+#define TPOOL_GQ_SIZE 1024
+// Rounds of looking for work before an idle worker parks
+#define TPOOL_SPINS 64
+// Max sleep of a group waiter before it looks for work again
+#define TPOOL_WAIT_NS (1000 * 1000)
+// Attempts to steal from a victim that keeps losing races
+#define TPOOL_STEAL_RETRIES 4
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define cpu_relax() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define cpu_relax() ((void)0)
+#endif
+
+typedef struct {
+    tpool_fn_t fn;
+    void *arg;
+    tpool_group_t *group;
+} tpool_task_t;
+
+// Chase-Lev deque of tasks (fixed capacity)
+typedef struct {
+    int64_t top __attribute__((aligned(64))); // stolen from here
+    int64_t bottom __attribute__((aligned(64))); // pushed/taken by owner
+    tpool_task_t buf[TPOOL_DEQUE_SIZE] __attribute__((aligned(64)));
+} tpool_deque_t;
+
+typedef struct {
+    tpool_deque_t dq;
+    tpool_t *pool;
+    uint64_t rng;
+    unsigned int id;
+    pthread_t thr;
+} tpool_worker_t;
+
+struct tpool {
+    unsigned int nworkers;
+    uint32_t flags;
+    tpool_worker_t *workers;
+
+    // injection queue (ring, grows when full)
+    pthread_mutex_t gq_mut;
+    tpool_task_t *gq;
+    size_t gq_cap;
+    size_t gq_head;
+    size_t gq_count;
+
+    // parking: futex word bumped on every notify while anyone sleeps
+    uint32_t epoch __attribute__((aligned(64)));
+    int32_t sleepers;
+    int stop;
+};
+
+static __thread tpool_worker_t *tpool_self;
+
+static inline void
+futex_wait(uint32_t *addr, uint32_t val, const struct timespec *timeout)
+{
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, timeout, NULL, 0);
+}
+
+static inline void
+futex_wake(uint32_t *addr, int n)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+/*
+ * Deque slots are read by thieves concurrently with the owner reusing them
+ * (a thief's copy is discarded when its CAS on top fails), so the slots are
+ * accessed field by field with relaxed atomics.
+ */
+static inline void
+task_store(tpool_task_t *slot, const tpool_task_t *task)
+{
+    __atomic_store_n(&slot->fn, task->fn, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->arg, task->arg, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->group, task->group, __ATOMIC_RELAXED);
+}
+
+static inline void
+task_load(tpool_task_t *slot, tpool_task_t *task)
+{
+    task->fn = __atomic_load_n(&slot->fn, __ATOMIC_RELAXED);
+    task->arg = __atomic_load_n(&slot->arg, __ATOMIC_RELAXED);
+    task->group = __atomic_load_n(&slot->group, __ATOMIC_RELAXED);
+}
+
+/*
+ * @brief  Push a task to the bottom of a deque (owner only)
+ *
+ * @return  true if success, false if the deque is full
+ */
+static bool
+dq_push(tpool_deque_t *dq, const tpool_task_t *task)
+{
+    int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED);
+    int64_t t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+    if (b - t >= TPOOL_DEQUE_SIZE) {
+        return false;
+    }
+    task_store(&dq->buf[b & TPOOL_DEQUE_MASK], task);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+/*
+ * @brief  Take a task from the bottom of a deque (owner only)
+ *
+ * @return  true if a task was taken, false if the deque is empty
+ */
+static bool
+dq_take(tpool_deque_t *dq, tpool_task_t *task)
+{
+    int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&dq->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t t = __atomic_load_n(&dq->top, __ATOMIC_RELAXED);
+    if (t > b) {
+        __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    task_load(&dq->buf[b & TPOOL_DEQUE_MASK], task);
+    if (t == b) {
+        // last task: race thieves for it
+        bool won = __atomic_compare_exchange_n(&dq->top, &t, t + 1, false,
+                                               __ATOMIC_SEQ_CST,
+                                               __ATOMIC_RELAXED);
+        __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+        return won;
+    }
+    return true;
+}
+
+/*
+ * @brief  Steal a task from the top of a deque
+ *
+ * @return  1 if a task was stolen, 0 if the deque is empty, -1 if lost a race
+ *          with the owner or another thief
+ */
+static int
+dq_steal(tpool_deque_t *dq, tpool_task_t *task)
+{
+    int64_t t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_ACQUIRE);
+    if (t >= b) {
+        return 0;
+    }
+    task_load(&dq->buf[t & TPOOL_DEQUE_MASK], task);
+    if (!__atomic_compare_exchange_n(&dq->top, &t, t + 1, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return -1;
+    }
+    return 1;
+}
+
+static bool
+dq_empty(tpool_deque_t *dq)
+{
+    return __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE) >=
+           __atomic_load_n(&dq->bottom, __ATOMIC_ACQUIRE);
+}
+
+static int
+gq_push(tpool_t *pool, const tpool_task_t *task)
+{
+    pthread_mutex_lock(&pool->gq_mut);
+    if (pool->gq_count == pool->gq_cap) {
+        size_t cap = pool->gq_cap * 2;
+        tpool_task_t *gq = zalloc_nb(cap, sizeof(tpool_task_t));
+        if (!gq) {
+            pthread_mutex_unlock(&pool->gq_mut);
+            return -ENOMEM;
+        }
+        for (size_t i = 0; i < pool->gq_count; i++) {
+            gq[i] = pool->gq[(pool->gq_head + i) & (pool->gq_cap - 1)];
+        }
+        free(pool->gq);
+        pool->gq = gq;
+        pool->gq_cap = cap;
+        pool->gq_head = 0;
+    }
+    pool->gq[(pool->gq_head + pool->gq_count) & (pool->gq_cap - 1)] = *task;
+    __atomic_store_n(&pool->gq_count, pool->gq_count + 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&pool->gq_mut);
+    return 0;
+}
+
+static bool
+gq_pop(tpool_t *pool, tpool_task_t *task)
+{
+    if (__atomic_load_n(&pool->gq_count, __ATOMIC_ACQUIRE) == 0) {
+        return false;
+    }
+    bool found = false;
+    pthread_mutex_lock(&pool->gq_mut);
+    if (pool->gq_count) {
+        *task = pool->gq[pool->gq_head];
+        pool->gq_head = (pool->gq_head + 1) & (pool->gq_cap - 1);
+        __atomic_store_n(&pool->gq_count, pool->gq_count - 1,
+                         __ATOMIC_RELAXED);
+        found = true;
+    }
+    pthread_mutex_unlock(&pool->gq_mut);
+    return found;
+}
+
+/*
+ * @brief  Find a task to run: own deque first, then the injection queue,
+ *         then steal from the other workers starting at a random one
+ *
+ * @param[in]  pool  Thread pool
+ * @param[in]  self  Calling worker (NULL if not a worker of pool)
+ * @param[out] task  Task found
+ *
+ * @return  true if a task was found
+ */
+static bool
+tpool_find(tpool_t *pool, tpool_worker_t *self, tpool_task_t *task)
+{
+    if (self && dq_take(&self->dq, task)) {
+        return true;
+    }
+    if (gq_pop(pool, task)) {
+        return true;
+    }
+
+    unsigned int n = __atomic_load_n(&pool->nworkers, __ATOMIC_ACQUIRE);
+    unsigned int start = 0;
+    if (self) {
+        // xorshift64
+        self->rng ^= self->rng << 13;
+        self->rng ^= self->rng >> 7;
+        self->rng ^= self->rng << 17;
+        start = (unsigned int)(self->rng % n);
+    }
+    for (unsigned int i = 0; i < n; i++) {
+        tpool_worker_t *w = &pool->workers[(start + i) % n];
+        if (w == self) {
+            continue;
+        }
+        for (int j = 0; j < TPOOL_STEAL_RETRIES; j++) {
+            int r = dq_steal(&w->dq, task);
+            if (r > 0) {
+                return true;
+            } else if (r == 0) {
+                break;
+            }
+            cpu_relax();
+        }
+    }
+    return false;
+}
+
+static bool
+tpool_has_work(tpool_t *pool)
+{
+    if (__atomic_load_n(&pool->gq_count, __ATOMIC_SEQ_CST)) {
+        return true;
+    }
+    unsigned int n = __atomic_load_n(&pool->nworkers, __ATOMIC_ACQUIRE);
+    for (unsigned int i = 0; i < n; i++) {
+        if (!dq_empty(&pool->workers[i].dq)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+tpool_run(tpool_task_t *task)
+{
+    tpool_group_t *g = task->group;
+    task->fn(task->arg);
+    if (g && __atomic_sub_fetch(&g->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+        // only the futex address is used: fine if the waiter already left
+        futex_wake(&g->pending, INT_MAX);
+    }
+}
+
+// Wake a parked worker (if any) after making a task visible
+static void
+tpool_notify(tpool_t *pool)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pool->sleepers, __ATOMIC_RELAXED) > 0) {
+        __atomic_add_fetch(&pool->epoch, 1, __ATOMIC_SEQ_CST);
+        futex_wake(&pool->epoch, 1);
+    }
+}
+
+/*
+ * Park an idle worker. Sleepers is raised before the final look for work,
+ * and notifiers bump epoch after publishing a task, so either the worker
+ * sees the task or its futex wait sees a stale epoch and returns.
+ */
+static void
+tpool_park(tpool_t *pool)
+{
+    uint32_t epoch = __atomic_load_n(&pool->epoch, __ATOMIC_ACQUIRE);
+    __atomic_add_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+    if (!tpool_has_work(pool) &&
+        !__atomic_load_n(&pool->stop, __ATOMIC_ACQUIRE)) {
+        futex_wait(&pool->epoch, epoch, NULL);
+    }
+    __atomic_sub_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+}
+
+static void *
+tpool_worker_main(void *arg)
+{
+    tpool_worker_t *w = arg;
+    tpool_t *pool = w->pool;
+    tpool_self = w;
+
+    unsigned int spins = 0;
+    tpool_task_t task;
+    for (;;) {
+        if (tpool_find(pool, w, &task)) {
+            tpool_run(&task);
+            spins = 0;
+            continue;
+        }
+        if (__atomic_load_n(&pool->stop, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        if (++spins < TPOOL_SPINS) {
+            cpu_relax();
+            continue;
+        }
+        tpool_park(pool);
+        spins = 0;
+    }
+    return NULL;
+}
+
+/*
+ * @brief  Pick the CPU of worker i: i-th CPU (mod count) of process affinity
+ *
+ * @return  CPU number, -1 if affinity couldn't be read
+ */
+static int
+tpool_cpu(unsigned int i)
+{
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        return -1;
+    }
+    int ncpus = CPU_COUNT(&set);
+    if (ncpus <= 0) {
+        return -1;
+    }
+    int nth = (int)(i % (unsigned int)ncpus);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set) && nth-- == 0) {
+            return cpu;
+        }
+    }
+    return -1;
+}
+
+tpool_t *
+tpool_init(unsigned int nthreads, uint32_t flags)
+{
+    if (nthreads == 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = n > 0 ? (unsigned int)n : 1;
+    }
+
+    tpool_t *pool = zmalloc_nb(sizeof(tpool_t));
+    if (!pool) {
+        return NULL;
+    }
+    pool->flags = flags;
+    pthread_mutex_init(&pool->gq_mut, NULL);
+    pool->gq_cap = TPOOL_GQ_SIZE;
+    pool->gq = zalloc_nb(pool->gq_cap, sizeof(tpool_task_t));
+    void *workers = NULL;
+    if (!pool->gq || posix_memalign(&workers, 64,
+                                    nthreads * sizeof(tpool_worker_t)) != 0) {
+        free(pool->gq);
+        free(pool);
+        return NULL;
+    }
+    memset(workers, 0, nthreads * sizeof(tpool_worker_t));
+    pool->workers = workers;
+    // deques of workers not started yet are just empty to thieves
+    pool->nworkers = nthreads;
+
+    for (unsigned int i = 0; i < nthreads; i++) {
+        tpool_worker_t *w = &pool->workers[i];
+        w->pool = pool;
+        w->id = i;
+        w->rng = 0x9e3779b97f4a7c15ULL * (i + 1);
+
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        int cpu = (flags & TPOOL_F_PIN) ? tpool_cpu(i) : -1;
+        if (cpu >= 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+        }
+        int err = pthread_create(&w->thr, &attr, tpool_worker_main, w);
+        pthread_attr_destroy(&attr);
+        if (err) {
+            // only join the started ones
+            __atomic_store_n(&pool->nworkers, i, __ATOMIC_RELEASE);
+            tpool_fini(pool);
+            return NULL;
+        }
+    }
+    return pool;
+}
+
+void
+tpool_fini(tpool_t *pool)
+{
+    if (!pool) {
+        return;
+    }
+    assert(!tpool_self || tpool_self->pool != pool);
+
+    __atomic_store_n(&pool->stop, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&pool->epoch, 1, __ATOMIC_SEQ_CST);
+    futex_wake(&pool->epoch, INT_MAX);
+    for (unsigned int i = 0; i < pool->nworkers; i++) {
+        pthread_join(pool->workers[i].thr, NULL);
+    }
+
+    // tasks pushed to the injection queue after the workers left
+    tpool_task_t task;
+    while (gq_pop(pool, &task)) {
+        tpool_run(&task);
+    }
+
+    pthread_mutex_destroy(&pool->gq_mut);
+    free(pool->workers);
+    free(pool->gq);
+    free(pool);
+}
+
+unsigned int
+tpool_nthreads(tpool_t *pool)
+{
+    return pool->nworkers;
+}
+
+int
+tpool_submit(tpool_t *pool, tpool_group_t *group, tpool_fn_t fn, void *arg)
+{
+    assert(pool && fn);
+    tpool_task_t task = { .fn = fn, .arg = arg, .group = group };
+    if (group) {
+        __atomic_add_fetch(&group->pending, 1, __ATOMIC_RELAXED);
+    }
+
+    tpool_worker_t *self = tpool_self;
+    if (!self || self->pool != pool || !dq_push(&self->dq, &task)) {
+        int err = gq_push(pool, &task);
+        if (err) {
+            if (group) {
+                __atomic_sub_fetch(&group->pending, 1, __ATOMIC_RELAXED);
+            }
+            return err;
+        }
+    }
+    tpool_notify(pool);
+    return 0;
+}
+
+void
+tpool_group_wait(tpool_t *pool, tpool_group_t *group)
+{
+    assert(pool && group);
+    tpool_worker_t *self = tpool_self;
+    if (self && self->pool != pool) {
+        self = NULL;
+    }
+
+    const struct timespec timeout = { .tv_nsec = TPOOL_WAIT_NS };
+    uint32_t pending;
+    tpool_task_t task;
+    while ((pending = __atomic_load_n(&group->pending, __ATOMIC_ACQUIRE))) {
+        if (tpool_find(pool, self, &task)) {
+            tpool_run(&task);
+            continue;
+        }
+        /*
+         * Remaining tasks of the group are running elsewhere. Sleep with a
+         * timeout since tasks submitted meanwhile only wake parked workers.
+         */
+        futex_wait(&group->pending, pending, &timeout);
+    }
+}
+
+// Shared state of a parallel_for: chunks are claimed off next
+typedef struct {
+    tpool_range_fn_t fn;
+    void *arg;
+    size_t end;
+    size_t grain;
+    size_t next __attribute__((aligned(64)));
+} tpool_pfor_t;
+
+static void
+tpool_pfor_task(void *arg)
+{
+    tpool_pfor_t *pf = arg;
+    size_t lo;
+    while ((lo = __atomic_fetch_add(&pf->next, pf->grain, __ATOMIC_RELAXED)) <
+           pf->end) {
+        size_t hi = pf->end - lo > pf->grain ? lo + pf->grain : pf->end;
+        pf->fn(pf->arg, lo, hi);
+    }
+}
+
+void
+tpool_parallel_for(tpool_t *pool, size_t begin, size_t end, size_t grain,
+                   tpool_range_fn_t fn, void *arg)
+{
+    assert(pool && fn);
+    if (begin >= end) {
+        return;
+    }
+    size_t n = end - begin;
+    if (grain == 0) {
+        // ~8 chunks per thread to even out imbalance
+        grain = n / (8 * ((size_t)pool->nworkers + 1));
+        grain = grain ? grain : 1;
+    }
+    // keep next from wrapping around: every thread may add grain past end
+    if (grain > (SIZE_MAX - end) / ((size_t)pool->nworkers + 1)) {
+        fn(arg, begin, end);
+        return;
+    }
+
+    tpool_pfor_t pf = { .fn = fn, .arg = arg, .end = end, .grain = grain,
+                        .next = begin };
+    tpool_group_t group = TPOOL_GROUP_INIT;
+    size_t nchunks = (n + grain - 1) / grain;
+    size_t nhelpers = nchunks - 1 < pool->nworkers ? nchunks - 1
+                                                   : pool->nworkers;
+    for (size_t i = 0; i < nhelpers; i++) {
+        if (tpool_submit(pool, &group, tpool_pfor_task, &pf) != 0) {
+            break;
+        }
+    }
+    tpool_pfor_task(&pf);
+    tpool_group_wait(pool, &group);
+}
@@ -0,0 +1,73 @@
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+#include "cutils/tpool.hpp"
+
+int main() {
+  cutils::ThreadPool pool(4);
+  assert(pool.size() == 4);
+
+  std::vector<int> v(100000);
+  pool.parallelFor(0, v.size(), 1000, [&](size_t lo, size_t hi) {
+    for (size_t i = lo; i < hi; i++) {
+      v[i] = static_cast<int>(i);
+    }
+  });
+  for (size_t i = 0; i < v.size(); i++) {
+    assert(v[i] == static_cast<int>(i));
+  }
+
+  std::atomic<int> count{0};
+  {
+    cutils::TaskGroup group(pool);
+    for (int i = 0; i < 1000; i++) {
+      group.run([&] {
+        // nested group from within a task
+        cutils::TaskGroup inner(pool);
+        inner.run([&] { count++; });
+        inner.run([&] { count++; });
+      });
+    }
+  }
+  assert(count == 2000);
+
+  // Exceptions of the tasks are rethrown once they're all done
+  bool thrown = false;
+  try {
+    pool.parallelFor(0, v.size(), 1000, [&](size_t lo, size_t) {
+      if (lo == 50000) {
+        throw std::runtime_error("chunk");
+      }
+    });
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+  assert(thrown);
+  thrown = false;
+  count = 0;
+  {
+    cutils::TaskGroup group(pool);
+    for (int i = 0; i < 100; i++) {
+      group.run([&, i] {
+        count++;
+        if (i % 10 == 0) {
+          throw std::runtime_error("task");
+        }
+      });
+    }
+    try {
+      group.wait();
+    } catch (const std::runtime_error&) {
+      thrown = true;
+    }
+    group.wait();  // rethrown once
+  }
+  assert(thrown && count == 100);
+
+  // Gets here only if above test passes
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,116 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <cutils/tpool.h>
+
+#define NTASKS 100000
+#define NRANGE (1000 * 1000)
+
+static tpool_t *pool;
+static uint64_t count;
+
+static void
+count_task(void *arg)
+{
+    (void)arg;
+    __atomic_add_fetch(&count, 1, __ATOMIC_RELAXED);
+}
+
+static void
+sum_range(void *arg, size_t lo, size_t hi)
+{
+    uint64_t sum = 0;
+    for (size_t i = lo; i < hi; i++) {
+        sum += i;
+    }
+    __atomic_add_fetch((uint64_t *)arg, sum, __ATOMIC_RELAXED);
+}
+
+// Task that submits more tasks to its own group (from a worker)
+static tpool_group_t spawn_group = TPOOL_GROUP_INIT;
+
+static void
+spawn_task(void *arg)
+{
+    uintptr_t depth = (uintptr_t)arg;
+    __atomic_add_fetch(&count, 1, __ATOMIC_RELAXED);
+    if (depth) {
+        for (int i = 0; i < 4; i++) {
+            int err = tpool_submit(pool, &spawn_group, spawn_task,
+                                   (void *)(depth - 1));
+            assert(err == 0);
+        }
+    }
+}
+
+// Task running a nested parallel_for (waits from within a worker)
+static void
+nested_task(void *arg)
+{
+    uint64_t sum = 0;
+    tpool_parallel_for(pool, 0, 10000, 100, sum_range, &sum);
+    assert(sum == 10000ULL * 9999 / 2);
+    __atomic_add_fetch((uint64_t *)arg, 1, __ATOMIC_RELAXED);
+}
+
+int
+main(void)
+{
+    pool = tpool_init(4, TPOOL_F_PIN);
+    assert(pool);
+    assert(tpool_nthreads(pool) == 4);
+
+    // Every task of a group runs exactly once before wait returns
+    tpool_group_t group = TPOOL_GROUP_INIT;
+    for (int i = 0; i < NTASKS; i++) {
+        int err = tpool_submit(pool, &group, count_task, NULL);
+        assert(err == 0);
+    }
+    tpool_group_wait(pool, &group);
+    assert(count == NTASKS);
+    assert(group.pending == 0);
+
+    // Tasks spawned from workers (own deques, stolen by the others)
+    count = 0;
+    int err = tpool_submit(pool, &spawn_group, spawn_task, (void *)6);
+    assert(err == 0);
+    tpool_group_wait(pool, &spawn_group);
+    // 1 + 4 + ... + 4^6
+    assert(count == (4 * 4 * 4 * 4 * 4 * 4 * 4 - 1) / 3);
+
+    // parallel_for covers the range exactly once, for any grain
+    size_t grains[] = { 0, 1, 7, 1000, NRANGE, 2 * NRANGE };
+    for (size_t i = 0; i < sizeof(grains) / sizeof(grains[0]); i++) {
+        uint64_t sum = 0;
+        tpool_parallel_for(pool, 0, NRANGE, grains[i], sum_range, &sum);
+        assert(sum == (uint64_t)NRANGE * (NRANGE - 1) / 2);
+    }
+    uint64_t sum = 0;
+    tpool_parallel_for(pool, 5, 5, 1, sum_range, &sum);
+    assert(sum == 0);
+
+    // Nested parallel_for from more tasks than workers doesn't deadlock
+    uint64_t ndone = 0;
+    group = (tpool_group_t)TPOOL_GROUP_INIT;
+    for (int i = 0; i < 64; i++) {
+        err = tpool_submit(pool, &group, nested_task, &ndone);
+        assert(err == 0);
+    }
+    tpool_group_wait(pool, &group);
+    assert(ndone == 64);
+
+    // Tasks still queued at fini are run
+    count = 0;
+    for (int i = 0; i < 1000; i++) {
+        err = tpool_submit(pool, NULL, count_task, NULL);
+        assert(err == 0);
+    }
+    tpool_fini(pool);
+    assert(count == 1000);
+
+    // Gets here only if above test passes
+    printf("PASSED\n");
+    return 0;
+}
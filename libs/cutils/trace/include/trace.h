@@ -0,0 +1,179 @@
+#ifndef CUTILS_TRACE_H
+#define CUTILS_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <cutils/list.h>
+#include <cutils/time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Per-thread binary event tracing
+ *
+ * Each thread records fixed-size events (begin/end/instant with a 64bit arg,
+ * timestamped with gettsc()) in its own lock-free single-producer ring. A
+ * ring is allocated on the first event of a thread. trace_flush() drains all
+ * the rings to a compact binary file that trace_to_json() (or the trace2json
+ * command) converts to Chrome trace_event JSON (chrome://tracing, Perfetto).
+ * Events are dropped (and counted) while a ring is full.
+ *
+ * Tracing compiles out entirely unless CUTILS_TRACE is defined: the macros
+ * below expand to nothing and their arguments aren't evaluated.
+ *
+ * TRACE_BEGIN(name, arg)    start of a duration event
+ * TRACE_END(name, arg)      end of the innermost duration event
+ * TRACE_INSTANT(name, arg)  point in time event
+ * TRACE_THREAD_NAME(name)   name the calling thread in the trace
+ *
+ * name must be a string with static storage (e.g. a literal); only its
+ * pointer is recorded.
+ */
+#ifdef CUTILS_TRACE
+#define TRACE_BEGIN(name, arg) trace_event(TRACE_EV_BEGIN, (name), (arg))
+#define TRACE_END(name, arg) trace_event(TRACE_EV_END, (name), (arg))
+#define TRACE_INSTANT(name, arg) trace_event(TRACE_EV_INSTANT, (name), (arg))
+#define TRACE_THREAD_NAME(name) trace_thread_name(name)
+#else
+#define TRACE_BEGIN(name, arg) ((void)0)
+#define TRACE_END(name, arg) ((void)0)
+#define TRACE_INSTANT(name, arg) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+// Default number of events per thread ring (power of 2)
+#define TRACE_DEFAULT_NEVENTS (64 * 1024)
+// Max length of a thread name (incl. NUL)
+#define TRACE_THREAD_NAME_LEN 32
+
+typedef enum {
+    TRACE_EV_BEGIN = 0,
+    TRACE_EV_END,
+    TRACE_EV_INSTANT,
+    TRACE_EV_THREAD_NAME, // metadata (only in flushed files)
+    TRACE_EV_MAX,
+} trace_ev_type_t;
+
+// An in-memory trace event
+typedef struct {
+    uint64_t ts;
+    const char *name;
+    uint64_t arg;
+    uint32_t type;
+    uint32_t rsvd;
+} trace_ev_t;
+
+// Per-thread ring of trace events
+typedef struct {
+    // written by owner thread only
+    uint64_t head;
+    uint64_t dropped;
+    uint64_t mask;
+    trace_ev_t *evs;
+    // written by trace_flush() only
+    uint64_t tail __attribute__((aligned(64)));
+    // bookkeeping
+    uint32_t tid;
+    int exited;
+    char tname[TRACE_THREAD_NAME_LEN];
+    list_node_t node;
+} trace_ring_t;
+
+extern __thread trace_ring_t *trace_ring_tls;
+
+/*
+ * @brief  Set number of events of per-thread rings allocated from now on
+ *         (optional, TRACE_DEFAULT_NEVENTS otherwise)
+ *
+ * @param[in] nevents  Number of events per ring (rounded up to power of 2)
+ *
+ * @return  0 if success, negative errno otherwise
+ *          -EINVAL  nevents is 0
+ */
+extern int trace_init(size_t nevents);
+
+/*
+ * @brief  Allocate and register trace ring of the calling thread
+ *
+ * @return  Ring of the calling thread, NULL if allocation failed or the
+ *          ring of the thread was already detached at its exit
+ */
+extern trace_ring_t *trace_ring_attach(void);
+
+/*
+ * @brief  Name the calling thread in the trace
+ *
+ * @param[in] name  Thread name (truncated to TRACE_THREAD_NAME_LEN - 1)
+ */
+extern void trace_thread_name(const char *name);
+
+/*
+ * @brief  Record a trace event in the ring of the calling thread
+ *
+ * @param[in] type  Event type (TRACE_EV_BEGIN|END|INSTANT)
+ * @param[in] name  Event name (must have static storage)
+ * @param[in] arg   Event argument
+ */
+static inline void
+trace_event(uint32_t type, const char *name, uint64_t arg)
+{
+    trace_ring_t *r = trace_ring_tls;
+    if (__builtin_expect(r == NULL, 0) && (r = trace_ring_attach()) == NULL) {
+        return;
+    }
+
+    uint64_t head = r->head;
+    if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) > r->mask) {
+        __atomic_store_n(&r->dropped, r->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+    trace_ev_t *ev = &r->evs[head & r->mask];
+    ev->ts = gettsc();
+    ev->name = name;
+    ev->arg = arg;
+    ev->type = type;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * @brief  Drain events of all the thread rings to a binary trace file.
+ *         Rings of exited threads are freed once drained. Can be called
+ *         periodically from any thread while others keep recording.
+ *
+ * @param[in] fp  Stream to append binary trace records to
+ *
+ * @return  Number of events written if success, negative errno otherwise
+ *          -EIO  Failed to write to fp
+ */
+extern int trace_flush(FILE *fp);
+
+/*
+ * @brief  Get number of events dropped due to full rings, summed over the
+ *         rings not freed yet: those of live threads and those of exited
+ *         threads that trace_flush() hasn't drained yet
+ *
+ * @return  Number of dropped events
+ */
+extern uint64_t trace_dropped(void);
+
+/*
+ * @brief  Convert a binary trace file (one or more trace_flush() outputs)
+ *         to Chrome trace_event JSON
+ *
+ * @param[in] in   Stream of binary trace records
+ * @param[in] out  Stream to write JSON to
+ *
+ * @return  Number of events converted if success, negative errno otherwise
+ *          -EINVAL  Malformed binary trace
+ *          -EIO     Failed to write to out
+ */
+extern int trace_to_json(FILE *in, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CUTILS_TRACE_H
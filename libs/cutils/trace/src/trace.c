@@ -0,0 +1,285 @@
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cutils/alloc.h>
+#include <cutils/list.h>
+#include <cutils/trace.h>
+
+// Sanity marker of every binary trace record
+#define TRACE_REC_MAGIC 0x43525443 // "CTRC"
+
+// A binary trace record (as written by trace_flush()), followed by name_len
+// bytes of event name
+typedef struct {
+    uint64_t ts;
+    uint64_t arg;
+    uint32_t pid;
+    uint32_t tid;
+    uint16_t type;
+    uint16_t name_len;
+    uint32_t magic;
+} trace_rec_t;
+
+__thread trace_ring_t *trace_ring_tls;
+// Set once the ring of the thread is detached: it records no more events
+static __thread int trace_tls_exited;
+
+static size_t trace_nevents = TRACE_DEFAULT_NEVENTS;
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_key;
+static pthread_mutex_t trace_mut = PTHREAD_MUTEX_INITIALIZER;
+static list_t trace_rings;
+
+static const char *trace_ph[TRACE_EV_MAX] = {
+    [TRACE_EV_BEGIN] = "B",
+    [TRACE_EV_END] = "E",
+    [TRACE_EV_INSTANT] = "i",
+    [TRACE_EV_THREAD_NAME] = "M",
+};
+
+// Thread-exit hook: ring is freed by trace_flush() once drained, so events
+// recorded by destructors that run after this one are dropped instead of
+// written to it (they go through trace_ring_attach(), which refuses them)
+static void
+trace_ring_detach(void *arg)
+{
+    trace_ring_t *r = arg;
+    trace_ring_tls = NULL;
+    trace_tls_exited = 1;
+    __atomic_store_n(&r->exited, 1, __ATOMIC_RELEASE);
+}
+
+static void
+trace_once_init(void)
+{
+    list_init(&trace_rings, offsetof(trace_ring_t, node));
+    pthread_key_create(&trace_key, trace_ring_detach);
+}
+
+int
+trace_init(size_t nevents)
+{
+    if (nevents == 0) {
+        return -EINVAL;
+    }
+    size_t n = 1;
+    while (n < nevents) {
+        n <<= 1;
+    }
+    pthread_mutex_lock(&trace_mut);
+    trace_nevents = n;
+    pthread_mutex_unlock(&trace_mut);
+    return 0;
+}
+
+trace_ring_t *
+trace_ring_attach(void)
+{
+    if (trace_tls_exited) {
+        return NULL;
+    }
+    pthread_once(&trace_once, trace_once_init);
+
+    pthread_mutex_lock(&trace_mut);
+    size_t nevents = trace_nevents;
+    pthread_mutex_unlock(&trace_mut);
+
+    trace_ring_t *r = zmalloc_nb(sizeof(trace_ring_t));
+    if (!r) {
+        return NULL;
+    }
+    r->evs = zalloc_nb(nevents, sizeof(trace_ev_t));
+    if (!r->evs) {
+        free(r);
+        return NULL;
+    }
+    r->mask = nevents - 1;
+    r->tid = (uint32_t)syscall(SYS_gettid);
+    pthread_setspecific(trace_key, r);
+
+    pthread_mutex_lock(&trace_mut);
+    list_insert_tail(&trace_rings, r);
+    pthread_mutex_unlock(&trace_mut);
+
+    trace_ring_tls = r;
+    return r;
+}
+
+void
+trace_thread_name(const char *name)
+{
+    trace_ring_t *r = trace_ring_tls ? trace_ring_tls : trace_ring_attach();
+    if (r && name) {
+        pthread_mutex_lock(&trace_mut);
+        strncpy(r->tname, name, sizeof(r->tname) - 1); // NOLINT
+        pthread_mutex_unlock(&trace_mut);
+    }
+}
+
+/*
+ * @brief  Write a binary trace record
+ *
+ * @param[in] fp    Stream to write to
+ * @param[in] rec   Record (name_len is filled in here)
+ * @param[in] name  Name of the event
+ * @param[in] max   Size of the buffer of name (at most UINT16_MAX is written)
+ *
+ * @return  0 if success, -EIO otherwise
+ */
+static int
+trace_write_rec(FILE *fp, trace_rec_t *rec, const char *name, size_t max)
+{
+    name = name ? name : "(null)";
+    size_t len = strnlen(name, max < UINT16_MAX ? max : UINT16_MAX);
+    rec->name_len = (uint16_t)len;
+    rec->magic = TRACE_REC_MAGIC;
+    if (fwrite(rec, sizeof(*rec), 1, fp) != 1 ||
+        fwrite(name, 1, len, fp) != len) {
+        return -EIO;
+    }
+    return 0;
+}
+
+int
+trace_flush(FILE *fp)
+{
+    assert(fp);
+    pthread_once(&trace_once, trace_once_init);
+
+    int err = 0;
+    int count = 0;
+    uint32_t pid = (uint32_t)getpid();
+    pthread_mutex_lock(&trace_mut);
+    trace_ring_t *r = list_head(&trace_rings);
+    while (r && !err) {
+        trace_ring_t *next = list_next(&trace_rings, r);
+        int exited = __atomic_load_n(&r->exited, __ATOMIC_ACQUIRE);
+        uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = r->tail;
+
+        if (r->tname[0] && head != tail) {
+            trace_rec_t rec = { .pid = pid,
+                                .tid = r->tid,
+                                .type = TRACE_EV_THREAD_NAME };
+            err = trace_write_rec(fp, &rec, r->tname, sizeof(r->tname));
+        }
+        for (; tail != head && !err; tail++, count++) {
+            const trace_ev_t *ev = &r->evs[tail & r->mask];
+            trace_rec_t rec = { .ts = ev->ts,
+                                .arg = ev->arg,
+                                .pid = pid,
+                                .tid = r->tid,
+                                .type = (uint16_t)ev->type };
+            err = trace_write_rec(fp, &rec, ev->name, UINT16_MAX);
+        }
+        __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+
+        if (exited && tail == head) {
+            list_delete(&trace_rings, r);
+            free(r->evs);
+            free(r);
+        }
+        r = next;
+    }
+    pthread_mutex_unlock(&trace_mut);
+
+    if (!err && fflush(fp) != 0) {
+        err = -EIO;
+    }
+    return err ? err : count;
+}
+
+uint64_t
+trace_dropped(void)
+{
+    pthread_once(&trace_once, trace_once_init);
+
+    uint64_t dropped = 0;
+    pthread_mutex_lock(&trace_mut);
+    for (trace_ring_t *r = list_head(&trace_rings); r;
+         r = list_next(&trace_rings, r)) {
+        dropped += __atomic_load_n(&r->dropped, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&trace_mut);
+    return dropped;
+}
+
+/*
+ * @brief  Write a string as JSON string literal
+ *
+ * @param[in] out  Stream to write to
+ * @param[in] s    String
+ * @param[in] len  Length of string
+ */
+static void
+trace_json_str(FILE *out, const char *s, size_t len)
+{
+    fputc('"', out);
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+int
+trace_to_json(FILE *in, FILE *out)
+{
+    assert(in && out);
+    int count = 0;
+    trace_rec_t rec;
+    char name[UINT16_MAX + 1];
+
+    fputs("{\"traceEvents\":[", out);
+    while (fread(&rec, sizeof(rec), 1, in) == 1) {
+        if (rec.magic != TRACE_REC_MAGIC || rec.type >= TRACE_EV_MAX ||
+            fread(name, 1, rec.name_len, in) != rec.name_len) {
+            return -EINVAL;
+        }
+
+        fputs(count ? ",\n" : "\n", out);
+        if (rec.type == TRACE_EV_THREAD_NAME) {
+            fputs("{\"name\":\"thread_name\",\"ph\":\"M\"", out);
+            fprintf(out, ",\"pid\":%" PRIu32 ",\"tid\":%" PRIu32, rec.pid,
+                    rec.tid);
+            fputs(",\"args\":{\"name\":", out);
+            trace_json_str(out, name, rec.name_len);
+            fputs("}}", out);
+        } else {
+            fputs("{\"name\":", out);
+            trace_json_str(out, name, rec.name_len);
+            fprintf(out,
+                    ",\"ph\":\"%s\",\"ts\":%" PRIu64 ".%03" PRIu64
+                    ",\"pid\":%" PRIu32 ",\"tid\":%" PRIu32,
+                    trace_ph[rec.type], rec.ts / 1000, rec.ts % 1000, rec.pid,
+                    rec.tid);
+            if (rec.type == TRACE_EV_INSTANT) {
+                fputs(",\"s\":\"t\"", out);
+            }
+            fprintf(out, ",\"args\":{\"arg\":%" PRIu64 "}}", rec.arg);
+        }
+        count++;
+    }
+    fputs("\n],\"displayTimeUnit\":\"ns\"}\n", out);
+
+    if (ferror(in)) {
+        return -EINVAL;
+    }
+    if (fflush(out) != 0 || ferror(out)) {
+        return -EIO;
+    }
+    return count;
+}
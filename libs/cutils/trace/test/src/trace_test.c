@@ -0,0 +1,134 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <cutils/time.h>
+#include <cutils/trace.h>
+
+#define NTHREADS 4
+#define NEVENTS 1024
+// Events recorded to measure per-event cost
+#define NBENCH (100 * NEVENTS)
+
+static void *
+worker(void *arg)
+{
+    (void)arg;
+    TRACE_THREAD_NAME("worker");
+    for (int i = 0; i < NEVENTS; i++) {
+        TRACE_BEGIN("work", i);
+        TRACE_END("work", i);
+    }
+    return NULL;
+}
+
+// Destructor of a key created after the trace one, so run after the ring of
+// the thread is detached
+static void
+late_destructor(void *arg)
+{
+    (void)arg;
+    TRACE_INSTANT("late", 0);
+}
+
+static void *
+late_worker(void *arg)
+{
+    pthread_setspecific(*(pthread_key_t *)arg, arg);
+    TRACE_INSTANT("early", 0);
+    return NULL;
+}
+
+// Count occurrences of a string in a buffer
+static int
+count_str(const char *buf, const char *s)
+{
+    int n = 0;
+    for (const char *p = buf; (p = strstr(p, s)); p += strlen(s)) {
+        n++;
+    }
+    return n;
+}
+
+int
+main(void)
+{
+    int err = trace_init(4 * NEVENTS);
+    assert(err == 0);
+
+    // Events from exited threads must survive till flushed
+    pthread_t tids[NTHREADS];
+    for (int i = 0; i < NTHREADS; i++) {
+        pthread_create(&tids[i], NULL, worker, NULL);
+    }
+    for (int i = 0; i < NTHREADS; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    TRACE_INSTANT("main \"quoted\"", 42);
+
+    FILE *bin = tmpfile();
+    assert(bin);
+    int count = trace_flush(bin);
+    assert(count == NTHREADS * NEVENTS * 2 + 1);
+    assert(trace_flush(bin) == 0);
+    assert(trace_dropped() == 0);
+
+    // Events recorded after the ring of a thread is detached are dropped,
+    // they aren't written to the ring trace_flush() frees
+    FILE *late = tmpfile();
+    assert(late);
+    pthread_key_t key;
+    pthread_key_create(&key, late_destructor);
+    for (int i = 0; i < NTHREADS; i++) {
+        pthread_create(&tids[i], NULL, late_worker, &key);
+    }
+    for (int i = 0; i < NTHREADS; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    assert(trace_flush(late) == NTHREADS);
+    assert(trace_flush(late) == 0);
+    pthread_key_delete(key);
+    fclose(late);
+
+    // Convert to JSON and check events made it
+    static char json[1 << 20];
+    FILE *out = fmemopen(json, sizeof(json) - 1, "w");
+    assert(out);
+    rewind(bin);
+    count = trace_to_json(bin, out);
+    fclose(out);
+    fclose(bin);
+    assert(count == NTHREADS * NEVENTS * 2 + 1 + NTHREADS);
+    assert(count_str(json, "\"ph\":\"B\"") == NTHREADS * NEVENTS);
+    assert(count_str(json, "\"ph\":\"E\"") == NTHREADS * NEVENTS);
+    assert(count_str(json, "\"name\":\"worker\"") == NTHREADS);
+    assert(strstr(json, "\"name\":\"main \\\"quoted\\\"\",\"ph\":\"i\""));
+
+    // Full ring drops (and counts) events instead of blocking
+    for (int i = 0; i < 8 * NEVENTS; i++) {
+        TRACE_INSTANT("fill", i);
+    }
+    assert(trace_dropped() == 8 * NEVENTS - 4 * NEVENTS);
+
+    // Cost of recording an event (flush time excluded)
+    bin = tmpfile();
+    assert(bin);
+    trace_flush(bin);
+    uint64_t elapsed = 0;
+    for (int i = 0; i < NBENCH; i += NEVENTS) {
+        uint64_t t0 = gettsc();
+        for (int j = 0; j < NEVENTS; j++) {
+            TRACE_INSTANT("bench", j);
+        }
+        elapsed += gettsc() - t0;
+        trace_flush(bin);
+    }
+    assert(trace_dropped() == 8 * NEVENTS - 4 * NEVENTS);
+    printf("%.1f ns/event\n", (double)elapsed / NBENCH);
+    fclose(bin);
+
+    // Gets here only if above test passes
+    printf("PASSED\n");
+    return 0;
+}
@@ -18,9 +18,12 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 // include ROS 1
+#include "ros/callback_queue.h"
 #include "ros/node_handle.h"
+#include "ros/spinner.h"
 
 // include ROS 2
 #include "rclcpp/node.hpp"
@@ -30,14 +33,35 @@
 namespace ros1_bridge
 {
 
+// A callback queue spun by a thread of its own, for the ROS 1 subscriber of
+// a bridged topic not to wait for the callbacks of other topics
+class Ros1CallbackQueue
+{
+public:
+  Ros1CallbackQueue();
+
+  ros::CallbackQueue *
+  get();
+
+private:
+  ros::CallbackQueue queue_;
+  // stopped before the queue is destroyed
+  ros::AsyncSpinner spinner_;
+};
+
 struct Bridge1to2Handles
 {
+  // shut down after the subscriber
+  std::shared_ptr<Ros1CallbackQueue> ros1_callback_queue;
   ros::Subscriber ros1_subscriber;
   rclcpp::PublisherBase::SharedPtr ros2_publisher;
 };
 
 struct Bridge2to1Handles
 {
+  // the mutually exclusive callback group of the subscriber, for the
+  // messages of a topic to be passed on in order but alongside other topics
+  rclcpp::CallbackGroup::SharedPtr ros2_callback_group;
   rclcpp::SubscriptionBase::SharedPtr ros2_subscriber;
   ros::Publisher ros1_publisher;
 };
@@ -48,6 +72,17 @@ struct BridgeHandles
   Bridge2to1Handles bridge2to1;
 };
 
+// Remove the options --ros1-threads N and --ros2-threads N from command line
+// arguments, setting the thread counts given: of the ROS 1 global callback
+// queue, which bridged topics don't use, and of the ROS 2 executor (0 for as
+// many as there are cores).
+// Return false, after printing why, if a count isn't a number.
+bool
+parse_thread_count_options(
+  std::vector<std::string> & args,
+  size_t & ros1_threads,
+  size_t & ros2_threads);
+
 bool
 get_1to2_mapping(
   const std::string & ros1_type_name,
@@ -81,7 +116,8 @@ create_bridge_from_1_to_2(
   size_t subscriber_queue_size,
   const std::string & ros2_type_name,
   const std::string & ros2_topic_name,
-  size_t publisher_queue_size);
+  size_t publisher_queue_size,
+  bool serialized = false);
 
 Bridge1to2Handles
 create_bridge_from_1_to_2(
@@ -92,7 +128,8 @@ create_bridge_from_1_to_2(
   size_t subscriber_queue_size,
   const std::string & ros2_type_name,
   const std::string & ros2_topic_name,
-  const rclcpp::QoS & publisher_qos);
+  const rclcpp::QoS & publisher_qos,
+  bool serialized = false);
 
 Bridge2to1Handles
 create_bridge_from_2_to_1(
@@ -125,7 +162,8 @@ create_bidirectional_bridge(
   const std::string & ros1_type_name,
   const std::string & ros2_type_name,
   const std::string & topic_name,
-  size_t queue_size = 10);
+  size_t queue_size = 10,
+  bool serialized_1_to_2 = false);
 
 }  // namespace ros1_bridge
 
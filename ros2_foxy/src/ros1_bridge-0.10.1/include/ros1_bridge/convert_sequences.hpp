@@ -0,0 +1,111 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROS1_BRIDGE__CONVERT_SEQUENCES_HPP_
+#define ROS1_BRIDGE__CONVERT_SEQUENCES_HPP_
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace ros1_bridge
+{
+
+// Whether a value of type T has the bytes of the same value of type U, so an
+// array of one can be copied to an array of the other with memcpy: the same
+// type, or the signed and unsigned variants of an integer (like ROS 1 byte,
+// an int8, and ROS 2 byte, an octet).
+// bool is left out since std::vector<bool> has no array of values.
+template<typename T, typename U>
+struct is_bitwise_convertible
+  : std::integral_constant<
+    bool,
+    std::is_trivially_copyable<T>::value && std::is_trivially_copyable<U>::value &&
+    !std::is_same<T, bool>::value && !std::is_same<U, bool>::value &&
+    (std::is_same<T, U>::value ||
+    (std::is_integral<T>::value && std::is_integral<U>::value && sizeof(T) == sizeof(U)))>
+{};
+
+// Copy a sequence of primitive values to a sequence of another type, like a
+// ROS 2 bounded sequence, resized to match
+template<typename SrcT, typename DstT>
+void
+convert_sequence(const SrcT & src, DstT & dst)
+{
+  dst.resize(src.size());
+  std::copy(src.begin(), src.end(), dst.begin());
+}
+
+namespace detail
+{
+
+template<typename T, typename SrcAllocatorT, typename U, typename DstAllocatorT>
+void
+assign_sequence(
+  const std::vector<T, SrcAllocatorT> & src, std::vector<U, DstAllocatorT> & dst,
+  std::true_type /* reinterpret */)
+{
+  // signed and unsigned variants of an integer may alias each other
+  auto data = reinterpret_cast<const U *>(src.data());
+  dst.assign(data, data + src.size());
+}
+
+template<typename T, typename SrcAllocatorT, typename U, typename DstAllocatorT>
+void
+assign_sequence(
+  const std::vector<T, SrcAllocatorT> & src, std::vector<U, DstAllocatorT> & dst,
+  std::false_type /* reinterpret */)
+{
+  dst.assign(src.begin(), src.end());
+}
+
+}  // namespace detail
+
+// Between vectors assign() allocates the exact size when growing and
+// constructs only the values copied, instead of first zeroing the values
+// resize() adds, and copies bitwise convertible values with memmove
+template<typename T, typename SrcAllocatorT, typename U, typename DstAllocatorT>
+void
+convert_sequence(const std::vector<T, SrcAllocatorT> & src, std::vector<U, DstAllocatorT> & dst)
+{
+  detail::assign_sequence(
+    src, dst, std::integral_constant<
+      bool, is_bitwise_convertible<T, U>::value && !std::is_same<T, U>::value>());
+}
+
+// Copy messages to messages of another type with the same layout, like the
+// ROS 1 and ROS 2 geometry_msgs/Point, as one block of bytes. The generated
+// factories assert the layouts are the same and size the destination.
+template<typename SrcT, typename DstT>
+void
+copy_message_block(const SrcT & src, DstT & dst)
+{
+  using SrcValueT = typename SrcT::value_type;
+  using DstValueT = typename DstT::value_type;
+  static_assert(
+    std::is_trivially_copyable<SrcValueT>::value && std::is_trivially_copyable<DstValueT>::value,
+    "messages not trivially copyable");
+  static_assert(sizeof(SrcValueT) == sizeof(DstValueT), "messages of different sizes");
+  if (src.size()) {
+    // trivially copyable but not trivial (their constructors set default values)
+    std::memcpy(
+      static_cast<void *>(&dst[0]), static_cast<const void *>(&src[0]),
+      src.size() * sizeof(SrcValueT));
+  }
+}
+
+}  // namespace ros1_bridge
+
+#endif  // ROS1_BRIDGE__CONVERT_SEQUENCES_HPP_
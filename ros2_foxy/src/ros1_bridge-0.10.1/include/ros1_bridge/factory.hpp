@@ -17,8 +17,13 @@
 
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "rmw/rmw.h"
 #include "rclcpp/rclcpp.hpp"
@@ -26,9 +31,13 @@
 // include ROS 1 message event
 #include "ros/message.h"
 
+#include "rcutils/error_handling.h"
 #include "rcutils/logging_macros.h"
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+#include "rosidl_typesupport_introspection_cpp/identifier.hpp"
 
 #include "ros1_bridge/factory_interface.hpp"
+#include "ros1_bridge/serialized_transcoding.hpp"
 
 namespace ros1_bridge
 {
@@ -37,10 +46,14 @@ template<typename ROS1_T, typename ROS2_T>
 class Factory : public FactoryInterface
 {
 public:
+  // transcodable_1_to_2: whether serialized ROS 1 messages of the type can be
+  // transcoded to ROS 2 ones as they are (see serialized_transcoding.hpp)
   Factory(
-    const std::string & ros1_type_name, const std::string & ros2_type_name)
+    const std::string & ros1_type_name, const std::string & ros2_type_name,
+    bool transcodable_1_to_2 = false)
   : ros1_type_name_(ros1_type_name),
-    ros2_type_name_(ros2_type_name)
+    ros2_type_name_(ros2_type_name),
+    transcodable_1_to_2_(transcodable_1_to_2)
   {}
 
   ros::Publisher
@@ -104,6 +117,48 @@ public:
     return node.subscribe(ops);
   }
 
+  ros::Subscriber
+  create_ros1_serialized_subscriber(
+    ros::NodeHandle node,
+    const std::string & topic_name,
+    size_t queue_size,
+    rclcpp::PublisherBase::SharedPtr ros2_pub,
+    rclcpp::Logger logger)
+  {
+    const rosidl_message_type_support_t * type_support = nullptr;
+    if (transcodable_1_to_2_) {
+      type_support = get_message_typesupport_handle(
+        rosidl_typesupport_cpp::get_message_type_support_handle<ROS2_T>(),
+        rosidl_typesupport_introspection_cpp::typesupport_identifier);
+      if (!type_support) {
+        rcutils_reset_error();
+      }
+    }
+    if (!type_support) {
+      RCLCPP_WARN(
+        logger, "Converting messages from ROS 1 %s to ROS 2 %s on topic %s: "
+        "they can't be passed as serialized messages",
+        ros1_type_name_.c_str(), ros2_type_name_.c_str(), topic_name.c_str());
+      return create_ros1_subscriber(node, topic_name, queue_size, ros2_pub, logger);
+    }
+
+    // the callbacks of a subscription don't run concurrently, so they can
+    // share the buffer of the ROS 2 messages
+    auto ros2_msg = std::make_shared<rclcpp::SerializedMessage>();
+    ros::SubscribeOptions ops;
+    ops.topic = topic_name;
+    ops.queue_size = queue_size;
+    ops.md5sum = ros::message_traits::md5sum<ROS1_T>();
+    ops.datatype = ros::message_traits::datatype<ROS1_T>();
+    ops.helper = ros::SubscriptionCallbackHelperPtr(
+      new ros::SubscriptionCallbackHelperT<
+        const ros::MessageEvent<Ros1SerializedMessage const> &>(
+        boost::bind(
+          &Factory<ROS1_T, ROS2_T>::ros1_serialized_callback,
+          _1, ros2_pub, type_support, ros2_msg, ros1_type_name_, ros2_type_name_, logger)));
+    return node.subscribe(ops);
+  }
+
   rclcpp::SubscriptionBase::SharedPtr
   create_ros2_subscriber(
     rclcpp::Node::SharedPtr node,
@@ -136,15 +191,18 @@ public:
     const std::string & topic_name,
     const rclcpp::QoS & qos,
     ros::Publisher ros1_pub,
-    rclcpp::PublisherBase::SharedPtr ros2_pub = nullptr)
+    rclcpp::PublisherBase::SharedPtr ros2_pub = nullptr,
+    rclcpp::CallbackGroup::SharedPtr callback_group = nullptr)
   {
     std::function<
       void(const typename ROS2_T::SharedPtr msg, const rclcpp::MessageInfo & msg_info)> callback;
     callback = std::bind(
       &Factory<ROS1_T, ROS2_T>::ros2_callback, std::placeholders::_1, std::placeholders::_2,
-      ros1_pub, ros1_type_name_, ros2_type_name_, node->get_logger(), ros2_pub);
+      ros1_pub, std::make_shared<Ros1MessageStorage>(), ros1_type_name_, ros2_type_name_,
+      node->get_logger(), ros2_pub);
     rclcpp::SubscriptionOptions options;
     options.ignore_local_publications = true;
+    options.callback_group = callback_group;
     return node->create_subscription<ROS2_T>(
       topic_name, qos, callback, options);
   }
@@ -164,6 +222,42 @@ public:
   }
 
 protected:
+  // the ROS 1 message a subscription converts ROS 2 messages into, which keeps
+  // the capacity of its arrays and strings from one message to the next.
+  // The mutex is only contended if the subscription is in a reentrant
+  // callback group.
+  struct Ros1MessageStorage
+  {
+    std::mutex mutex;
+    ROS1_T msg;
+  };
+
+  // whether to drop a ROS 1 message: one without connection header or one
+  // published by the bridge itself
+  template<typename ROS1_MSG_T>
+  static
+  bool skip_ros1_message(
+    const ros::MessageEvent<ROS1_MSG_T const> & ros1_msg_event,
+    const std::string & ros1_type_name,
+    rclcpp::Logger logger)
+  {
+    const boost::shared_ptr<ros::M_string> & connection_header =
+      ros1_msg_event.getConnectionHeaderPtr();
+    if (!connection_header) {
+      RCLCPP_WARN(
+        logger, "Dropping ROS 1 message %s without connection header", ros1_type_name.c_str());
+      return true;
+    }
+
+    std::string key = "callerid";
+    if (connection_header->find(key) != connection_header->end()) {
+      if (connection_header->at(key) == "/ros_bridge") {
+        return true;
+      }
+    }
+    return false;
+  }
+
   static
   void ros1_callback(
     const ros::MessageEvent<ROS1_T const> & ros1_msg_event,
@@ -182,23 +276,27 @@ protected:
               ros2_pub->get_topic_name());
     }
 
-    const boost::shared_ptr<ros::M_string> & connection_header =
-      ros1_msg_event.getConnectionHeaderPtr();
-    if (!connection_header) {
-      RCLCPP_WARN(
-        logger, "Dropping ROS 1 message %s without connection header", ros1_type_name.c_str());
+    if (skip_ros1_message(ros1_msg_event, ros1_type_name, logger)) {
       return;
     }
 
-    std::string key = "callerid";
-    if (connection_header->find(key) != connection_header->end()) {
-      if (connection_header->at(key) == "/ros_bridge") {
-        return;
-      }
-    }
-
     const boost::shared_ptr<ROS1_T const> & ros1_msg = ros1_msg_event.getConstMessage();
 
+    // convert into memory of the middleware if it can loan it, which it only
+    // does for messages of a fixed size, saving it the copy on publish
+    if (std::is_trivially_destructible<ROS2_T>::value && typed_ros2_pub->can_loan_messages()) {
+      auto loaned_msg = typed_ros2_pub->borrow_loaned_message();
+      // the loaned memory doesn't necessarily hold a constructed message
+      ROS2_T * ros2_msg = new (&loaned_msg.get()) ROS2_T();
+      convert_1_to_2(*ros1_msg, *ros2_msg);
+      RCLCPP_INFO_ONCE(
+        logger, "Passing loaned message from ROS 1 %s to ROS 2 %s "
+        "(showing msg only once per type)",
+        ros1_type_name.c_str(), ros2_type_name.c_str());
+      typed_ros2_pub->publish(std::move(loaned_msg));
+      return;
+    }
+
     auto ros2_msg = std::make_unique<ROS2_T>();
     convert_1_to_2(*ros1_msg, *ros2_msg);
     RCLCPP_INFO_ONCE(
@@ -207,11 +305,52 @@ protected:
     typed_ros2_pub->publish(std::move(ros2_msg));
   }
 
+  static
+  void ros1_serialized_callback(
+    const ros::MessageEvent<Ros1SerializedMessage const> & ros1_msg_event,
+    rclcpp::PublisherBase::SharedPtr ros2_pub,
+    const rosidl_message_type_support_t * type_support,
+    std::shared_ptr<rclcpp::SerializedMessage> ros2_msg,
+    const std::string & ros1_type_name,
+    const std::string & ros2_type_name,
+    rclcpp::Logger logger)
+  {
+    typename rclcpp::Publisher<ROS2_T>::SharedPtr typed_ros2_pub;
+    typed_ros2_pub =
+      std::dynamic_pointer_cast<typename rclcpp::Publisher<ROS2_T>>(ros2_pub);
+
+    if (!typed_ros2_pub) {
+      throw std::runtime_error(
+              "Invalid type " + ros2_type_name + " for ROS 2 publisher " +
+              ros2_pub->get_topic_name());
+    }
+
+    if (skip_ros1_message(ros1_msg_event, ros1_type_name, logger)) {
+      return;
+    }
+
+    const std::vector<uint8_t> & ros1_data = ros1_msg_event.getConstMessage()->data;
+    try {
+      transcode_1_to_2(type_support, ros1_data.data(), ros1_data.size(), *ros2_msg);
+    } catch (std::exception & e) {
+      // malformed messages, and failures to grow the ROS 2 one (like bad_alloc)
+      RCLCPP_WARN(
+        logger, "Dropping ROS 1 message %s: %s", ros1_type_name.c_str(), e.what());
+      return;
+    }
+    RCLCPP_INFO_ONCE(
+      logger, "Passing serialized message from ROS 1 %s to ROS 2 %s "
+      "(showing msg only once per type)",
+      ros1_type_name.c_str(), ros2_type_name.c_str());
+    typed_ros2_pub->publish(*ros2_msg);
+  }
+
   static
   void ros2_callback(
     typename ROS2_T::SharedPtr ros2_msg,
     const rclcpp::MessageInfo & msg_info,
     ros::Publisher ros1_pub,
+    std::shared_ptr<Ros1MessageStorage> ros1_storage,
     const std::string & ros1_type_name,
     const std::string & ros2_type_name,
     rclcpp::Logger logger,
@@ -244,12 +383,21 @@ protected:
       return;
     }
 
-    ROS1_T ros1_msg;
-    convert_2_to_1(*ros2_msg, ros1_msg);
     RCLCPP_INFO_ONCE(
       logger, "Passing message from ROS 2 %s to ROS 1 %s (showing msg only once per type)",
       ros2_type_name.c_str(), ros1_type_name.c_str());
-    ros1_pub.publish(ros1_msg);
+    // publishing a message by reference serializes it right away, so it can
+    // be reused for the next one
+    std::unique_lock<std::mutex> lock(ros1_storage->mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      // another thread is converting a message of this subscription
+      ROS1_T ros1_msg;
+      convert_2_to_1(*ros2_msg, ros1_msg);
+      ros1_pub.publish(ros1_msg);
+      return;
+    }
+    convert_2_to_1(*ros2_msg, ros1_storage->msg);
+    ros1_pub.publish(ros1_storage->msg);
   }
 
 public:
@@ -268,6 +416,7 @@ public:
 
   std::string ros1_type_name_;
   std::string ros2_type_name_;
+  bool transcodable_1_to_2_;
 };
 
 template<class ROS1_T, class ROS2_T>
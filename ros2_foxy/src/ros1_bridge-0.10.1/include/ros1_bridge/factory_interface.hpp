@@ -83,6 +83,17 @@ public:
     rclcpp::PublisherBase::SharedPtr ros2_pub,
     rclcpp::Logger logger) = 0;
 
+  // like create_ros1_subscriber(), but passing the messages on without
+  // deserializing them where the types allow it (converting them otherwise)
+  virtual
+  ros::Subscriber
+  create_ros1_serialized_subscriber(
+    ros::NodeHandle node,
+    const std::string & topic_name,
+    size_t queue_size,
+    rclcpp::PublisherBase::SharedPtr ros2_pub,
+    rclcpp::Logger logger) = 0;
+
   virtual
   rclcpp::SubscriptionBase::SharedPtr
   create_ros2_subscriber(
@@ -108,7 +119,8 @@ public:
     const std::string & topic_name,
     const rclcpp::QoS & qos,
     ros::Publisher ros1_pub,
-    rclcpp::PublisherBase::SharedPtr ros2_pub = nullptr) = 0;
+    rclcpp::PublisherBase::SharedPtr ros2_pub = nullptr,
+    rclcpp::CallbackGroup::SharedPtr callback_group = nullptr) = 0;
 
   virtual
   void
@@ -0,0 +1,121 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROS1_BRIDGE__SERIALIZED_TRANSCODING_HPP_
+#define ROS1_BRIDGE__SERIALIZED_TRANSCODING_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// include ROS 1 serialization
+#include "ros/message_traits.h"
+#include "ros/serialization.h"
+
+// include ROS 2 serialized messages
+#include "rclcpp/serialized_message.hpp"
+#include "rosidl_runtime_c/message_type_support_struct.h"
+
+namespace ros1_bridge
+{
+
+// A ROS 1 message of any type kept as it was received (like
+// topic_tools::ShapeShifter), for bridging it without deserializing it
+struct Ros1SerializedMessage
+{
+  std::vector<uint8_t> data;
+};
+
+// Transcode a serialized ROS 1 message to the CDR serialization of a ROS 2
+// message type, given the introspection type support of that type.
+// This is only valid if the ROS 1 type has the fields of the ROS 2 type in the
+// same order and with the same primitive types, as the generated factories
+// check (std_msgs/Header being the one exception: its ROS 1 seq is dropped).
+// The CDR message is reused, keeping its capacity.
+// Throws std::runtime_error if the ROS 1 message doesn't match the type, and
+// what growing the CDR message throws (like std::bad_alloc).
+void
+transcode_1_to_2(
+  const rosidl_message_type_support_t * ros2_introspection_type_support,
+  const uint8_t * ros1_data,
+  size_t ros1_size,
+  rclcpp::SerializedMessage & ros2_cdr_msg);
+
+}  // namespace ros1_bridge
+
+namespace ros
+{
+namespace message_traits
+{
+
+template<>
+struct IsMessage<ros1_bridge::Ros1SerializedMessage>: TrueType {};
+
+template<>
+struct MD5Sum<ros1_bridge::Ros1SerializedMessage>
+{
+  static const char * value() {return "*";}
+  static const char * value(const ros1_bridge::Ros1SerializedMessage &) {return value();}
+};
+
+template<>
+struct DataType<ros1_bridge::Ros1SerializedMessage>
+{
+  static const char * value() {return "*";}
+  static const char * value(const ros1_bridge::Ros1SerializedMessage &) {return value();}
+};
+
+template<>
+struct Definition<ros1_bridge::Ros1SerializedMessage>
+{
+  static const char * value() {return "";}
+  static const char * value(const ros1_bridge::Ros1SerializedMessage &) {return value();}
+};
+
+}  // namespace message_traits
+
+namespace serialization
+{
+
+template<>
+struct Serializer<ros1_bridge::Ros1SerializedMessage>
+{
+  template<typename Stream>
+  inline static void write(Stream & stream, const ros1_bridge::Ros1SerializedMessage & m)
+  {
+    if (!m.data.empty()) {
+      std::memcpy(
+        stream.advance(static_cast<uint32_t>(m.data.size())), m.data.data(), m.data.size());
+    }
+  }
+
+  template<typename Stream>
+  inline static void read(Stream & stream, ros1_bridge::Ros1SerializedMessage & m)
+  {
+    // the whole stream is the message
+    uint32_t size = stream.getLength();
+    const uint8_t * data = stream.advance(size);
+    m.data.assign(data, data + size);
+  }
+
+  inline static uint32_t serializedLength(const ros1_bridge::Ros1SerializedMessage & m)
+  {
+    return static_cast<uint32_t>(m.data.size());
+  }
+};
+
+}  // namespace serialization
+}  // namespace ros
+
+#endif  // ROS1_BRIDGE__SERIALIZED_TRANSCODING_HPP_
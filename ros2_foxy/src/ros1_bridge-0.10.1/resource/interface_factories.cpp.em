@@ -28,11 +28,13 @@ from rosidl_parser.definition import NamespacedType
 #include "@(ros2_package_name)_factories.hpp"
 
 #include <algorithm>
+#include <cstddef>
 
 #include "rclcpp/rclcpp.hpp"
 
 // include builtin interfaces
 #include <ros1_bridge/convert_builtin_interfaces.hpp>
+#include <ros1_bridge/convert_sequences.hpp>
 
 // include ROS 1 services
 @[for service in mapped_services]@
@@ -67,7 +69,7 @@ get_factory_@(ros2_package_name)__@(interface_type)__@(interface.message_name)(c
         @(m.ros1_msg.package_name)::@(m.ros1_msg.message_name),
         @(m.ros2_msg.package_name)::msg::@(m.ros2_msg.message_name)
       >
-    >("@(m.ros1_msg.package_name)/@(m.ros1_msg.message_name)", ros2_type_name);
+    >("@(m.ros1_msg.package_name)/@(m.ros1_msg.message_name)", ros2_type_name, @('true' if m.transcodable_1_to_2 else 'false'));
   }
 @[end for]@
   return std::shared_ptr<FactoryInterface>();
@@ -127,6 +129,11 @@ if isinstance(ros2_fields[-1].type, NamespacedType):
     namespaces = ros2_fields[-1].type.namespaces
     assert len(namespaces) == 2 and namespaces[1] == 'msg', \
       "messages not using the '<pkg_name>, msg, <type_name>' triplet are not supported"
+
+if ros2_fields in m.block_copy_fields:
+    ros1_element_type = '%s::%s' % (ros1_fields[-1].pkg_name, ros1_fields[-1].msg_name)
+    ros2_element_type = '%s::msg::%s' % (
+        ros2_fields[-1].type.value_type.namespaces[0], ros2_fields[-1].type.value_type.name)
 }
 @[    if not isinstance(ros2_fields[-1].type, AbstractNestedType)]@
   // convert non-array field
@@ -152,8 +159,14 @@ if isinstance(ros2_fields[-1].type, NamespacedType):
   // bounded size sequence, check that the ros 1 vector size is not larger than the upper bound for the target
   assert(ros1_msg.@(ros1_field_selection).size() <= @(ros2_fields[-1].type.maximum_size));
 @[        end if]@
+@[        if not isinstance(ros2_fields[-1].type.value_type, NamespacedType)]@
+  // convert primitive sequence, sized to match the ros1 field
+  ros1_bridge::convert_sequence(
+    ros1_msg.@(ros1_field_selection), ros2_msg.@(ros2_field_selection));
+@[        else]@
   // resize ros2 field to match the ros1 field
   ros2_msg.@(ros2_field_selection).resize(ros1_msg.@(ros1_field_selection).size());
+@[        end if]@
 @[      else]@
   // statically sized array
   static_assert(
@@ -162,11 +175,23 @@ if isinstance(ros2_fields[-1].type, NamespacedType):
   );
 @[      end if]@
 @[      if not isinstance(ros2_fields[-1].type.value_type, NamespacedType)]@
+@[        if not isinstance(ros2_fields[-1].type, AbstractSequence)]@
   // convert primitive array elements
   std::copy(
     ros1_msg.@(ros1_field_selection).begin(),
     ros1_msg.@(ros1_field_selection).end(),
     ros2_msg.@(ros2_field_selection).begin());
+@[        end if]@
+@[      elif ros2_fields in m.block_copy_fields]@
+  // copy sub message elements as one block since their types have the same layout
+  static_assert(
+@[        for ros1_name, ros2_name in m.block_copy_fields[ros2_fields]]@
+    offsetof(@(ros1_element_type), @(ros1_name)) == offsetof(@(ros2_element_type), @(ros2_name)) &&
+@[        end for]@
+    sizeof(@(ros1_element_type)) == sizeof(@(ros2_element_type)),
+    "sub message types without the same layout");
+  ros1_bridge::copy_message_block(
+    ros1_msg.@(ros1_field_selection), ros2_msg.@(ros2_field_selection));
 @[      else]@
   // copy element wise since the type is different
   {
@@ -218,6 +243,11 @@ if isinstance(ros2_fields[-1].type, NamespacedType):
     namespaces = ros2_fields[-1].type.namespaces
     assert len(namespaces) == 2 and namespaces[1] == 'msg', \
       "messages not using the '<pkg_name>, msg, <type_name>' triplet are not supported"
+
+if ros2_fields in m.block_copy_fields:
+    ros1_element_type = '%s::%s' % (ros1_fields[-1].pkg_name, ros1_fields[-1].msg_name)
+    ros2_element_type = '%s::msg::%s' % (
+        ros2_fields[-1].type.value_type.namespaces[0], ros2_fields[-1].type.value_type.name)
 }
 @[    if not isinstance(ros2_fields[-1].type, AbstractNestedType)]@
   // convert non-array field
@@ -239,8 +269,14 @@ if isinstance(ros2_fields[-1].type, NamespacedType):
   // convert array or sequence field
 @[      if isinstance(ros2_fields[-1].type, AbstractSequence)]@
   // dynamically sized sequence, ensure destination vector size is large enough
+@[        if not isinstance(ros2_fields[-1].type.value_type, NamespacedType)]@
+  // convert primitive sequence, sized to match the ros2 field
+  ros1_bridge::convert_sequence(
+    ros2_msg.@(ros2_field_selection), ros1_msg.@(ros1_field_selection));
+@[        else]@
   // resize ros1 field to match the ros2 field
   ros1_msg.@(ros1_field_selection).resize(ros2_msg.@(ros2_field_selection).size());
+@[        end if]@
 @[      else]@
   // statically sized array
   static_assert(
@@ -249,11 +285,23 @@ if isinstance(ros2_fields[-1].type, NamespacedType):
   );
 @[      end if]@
 @[      if not isinstance(ros2_fields[-1].type.value_type, NamespacedType)]@
+@[        if not isinstance(ros2_fields[-1].type, AbstractSequence)]@
   // convert primitive array elements
   std::copy(
     ros2_msg.@(ros2_field_selection).begin(),
     ros2_msg.@(ros2_field_selection).end(),
     ros1_msg.@(ros1_field_selection).begin());
+@[        end if]@
+@[      elif ros2_fields in m.block_copy_fields]@
+  // copy sub message elements as one block since their types have the same layout
+  static_assert(
+@[        for ros1_name, ros2_name in m.block_copy_fields[ros2_fields]]@
+    offsetof(@(ros1_element_type), @(ros1_name)) == offsetof(@(ros2_element_type), @(ros2_name)) &&
+@[        end for]@
+    sizeof(@(ros1_element_type)) == sizeof(@(ros2_element_type)),
+    "sub message types without the same layout");
+  ros1_bridge::copy_message_block(
+    ros2_msg.@(ros2_field_selection), ros1_msg.@(ros1_field_selection));
 @[      else]@
   // copy element wise since the type is different
   {
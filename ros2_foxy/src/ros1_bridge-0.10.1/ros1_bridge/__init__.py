@@ -206,6 +206,28 @@ def generate_messages(rospack=None):
             if ros2_msg in m.depends_on_ros2_messages:
                 m.depends_on_ros2_messages.remove(ros2_msg)
 
+    # the mappings a mapping depends on come first
+    # (std_msgs/Time and Duration are a time or duration each, like their ROS 2 counterparts)
+    transcodable_pairs = {
+        (('std_msgs', msg_name), ('builtin_interfaces', msg_name))
+        for msg_name in ('Duration', 'Time')}
+    for m in ordered_mappings:
+        m.transcodable_1_to_2 = is_transcodable_1_to_2(m, transcodable_pairs)
+        if m.transcodable_1_to_2:
+            transcodable_pairs.add((
+                (m.ros1_msg.package_name, m.ros1_msg.message_name),
+                (m.ros2_msg.package_name, m.ros2_msg.message_name)))
+
+    # the layouts of the messages a mapping can copy arrays of as a block
+    block_layouts = {}
+    for m in ordered_mappings:
+        determine_block_copy_fields(m, block_layouts)
+        layout = get_block_layout(m, block_layouts)
+        if layout:
+            block_layouts[(
+                (m.ros1_msg.package_name, m.ros1_msg.message_name),
+                (m.ros2_msg.package_name, m.ros2_msg.message_name))] = layout
+
     if mappings:
         print('%d mappings can not be generated due to missing dependencies:' % len(mappings),
               file=sys.stderr)
@@ -784,6 +806,205 @@ def determine_field_mapping(ros1_msg, ros2_msg, mapping_rules, msg_idx):
     return mapping
 
 
+# sizes of the primitive types serialized the same in ROS 1 and CDR
+ROS1_PRIMITIVE_SIZES = {
+    'bool': 1, 'byte': 1, 'char': 1, 'int8': 1, 'uint8': 1,
+    'int16': 2, 'uint16': 2,
+    'int32': 4, 'uint32': 4, 'float32': 4,
+    'int64': 8, 'uint64': 8, 'float64': 8,
+}
+ROS2_PRIMITIVE_SIZES = {
+    'boolean': 1, 'octet': 1, 'char': 1, 'int8': 1, 'uint8': 1,
+    'int16': 2, 'uint16': 2,
+    'int32': 4, 'uint32': 4, 'float': 4,
+    'int64': 8, 'uint64': 8, 'double': 8,
+}
+
+
+def is_transcodable_1_to_2(mapping, transcodable_pairs):
+    """
+    Return whether serialized ROS 1 messages of a mapping can be transcoded to CDR as they are.
+
+    That is if the ROS 1 message has the fields of the ROS 2 message in the same order with
+    the same primitive types, each field mapped to the one of the same name, recursively
+    (see ros1_bridge/serialized_transcoding.hpp).
+    The ROS 1 std_msgs/Header is the exception: its seq, which ROS 2 dropped, is skipped.
+
+    :type mapping: Mapping
+    :param transcodable_pairs: a set of ((ros1_package, ros1_name), (ros2_package, ros2_name))
+    of the transcodable mappings the fields can refer to
+    """
+    ros1_spec = load_ros1_message(mapping.ros1_msg)
+    if not ros1_spec:
+        return False
+    ros2_spec = load_ros2_message(mapping.ros2_msg)
+    ros1_fields = list(ros1_spec.parsed_fields())
+    if (mapping.ros1_msg.package_name, mapping.ros1_msg.message_name) == \
+            ('std_msgs', 'Header'):
+        if not ros1_fields or ros1_fields[0].name != 'seq':
+            return False
+        ros1_fields = ros1_fields[1:]
+    ros2_members = list(ros2_spec.structure.members)
+    if len(ros1_fields) != len(ros2_members) or \
+            len(mapping.fields_1_to_2) != len(ros1_fields):
+        return False
+
+    for (ros1_selection, ros2_selection), ros1_field, ros2_member in zip(
+        mapping.fields_1_to_2.items(), ros1_fields, ros2_members
+    ):
+        # the fields mapped (by name or by rule) must be the ones in the same place
+        if [f.name for f in ros1_selection] != [ros1_field.name] or \
+                [m.name for m in ros2_selection] != [ros2_member.name]:
+            return False
+        ros2_type = ros2_member.type
+        if ros1_field.is_array:
+            if not isinstance(ros2_type, rosidl_parser.definition.AbstractNestedType):
+                return False
+            if ros1_field.array_len is None:
+                if not isinstance(ros2_type, rosidl_parser.definition.AbstractSequence):
+                    return False
+            elif not isinstance(ros2_type, rosidl_parser.definition.Array) or \
+                    ros2_type.size != ros1_field.array_len:
+                return False
+            ros2_type = ros2_type.value_type
+        elif isinstance(ros2_type, rosidl_parser.definition.AbstractNestedType):
+            return False
+        if not is_transcodable_type_1_to_2(
+            ros1_field, mapping.ros1_msg.package_name, ros2_type, transcodable_pairs
+        ):
+            return False
+    return True
+
+
+def is_transcodable_type_1_to_2(ros1_field, ros1_package_name, ros2_type, transcodable_pairs):
+    ros1_type = ros1_field.base_type
+    if ros1_type in ROS1_PRIMITIVE_SIZES:
+        return isinstance(ros2_type, rosidl_parser.definition.BasicType) and \
+            ROS2_PRIMITIVE_SIZES.get(ros2_type.typename) == ROS1_PRIMITIVE_SIZES[ros1_type]
+    if ros1_type == 'string':
+        return isinstance(ros2_type, rosidl_parser.definition.AbstractString)
+    if not isinstance(ros2_type, rosidl_parser.definition.NamespacedType) or \
+            len(ros2_type.namespaces) != 2 or ros2_type.namespaces[1] != 'msg':
+        return False
+    ros2_name = (ros2_type.namespaces[0], ros2_type.name)
+    # both are two 32 bit integers
+    if ros1_type in ('time', 'duration'):
+        return ros2_name == ('builtin_interfaces', ros1_type.capitalize())
+    if ros1_field.is_header:
+        ros1_name = ('std_msgs', 'Header')
+    elif '/' in ros1_type:
+        ros1_name = tuple(ros1_type.split('/'))
+    else:
+        ros1_name = (ros1_package_name, ros1_type)
+    return (ros1_name, ros2_name) in transcodable_pairs
+
+
+# the primitive types of the same size and representation in the ROS 1 and ROS 2 structs,
+# bool aside since a ROS 1 bool is a uint8 which may hold other values
+ROS1_FLOATING_POINT_TYPES = {'float32': 'float', 'float64': 'double'}
+
+
+def is_block_copyable_type(ros1_type, ros2_type):
+    if not isinstance(ros2_type, rosidl_parser.definition.BasicType):
+        return False
+    if ros1_type in ROS1_FLOATING_POINT_TYPES:
+        return ROS1_FLOATING_POINT_TYPES[ros1_type] == ros2_type.typename
+    # integers of the same size, the signed and unsigned variants having the same bytes
+    return ros1_type != 'bool' and ros2_type.typename != 'boolean' and \
+        ros2_type.typename not in ROS1_FLOATING_POINT_TYPES.values() and \
+        ros1_type in ROS1_PRIMITIVE_SIZES and \
+        ROS2_PRIMITIVE_SIZES.get(ros2_type.typename) == ROS1_PRIMITIVE_SIZES[ros1_type]
+
+
+def get_block_layout(mapping, block_layouts):
+    """
+    Return the layout of the messages of a mapping if they can be copied as a block of bytes.
+
+    That is if the ROS 1 message has the fields of the ROS 2 message in the same order with
+    primitive types of the same size, or fixed size arrays of them, or messages which can be
+    copied as a block themselves, each field mapped to the one of the same name.
+    Whether the structs do have the same layout is left to static assertions in the generated
+    code, on their sizes and the offsets of the fields returned.
+
+    :type mapping: Mapping
+    :param block_layouts: a dict of the layouts of the mappings the fields can refer to,
+    by ((ros1_package, ros1_name), (ros2_package, ros2_name))
+    :return: a list of (ros1_field_selection, ros2_field_selection) of the primitive fields
+    (and arrays), the selections being member names separated by `.`, or None
+    """
+    ros1_spec = load_ros1_message(mapping.ros1_msg)
+    if not ros1_spec:
+        return None
+    ros2_spec = load_ros2_message(mapping.ros2_msg)
+    ros1_fields = list(ros1_spec.parsed_fields())
+    ros2_members = list(ros2_spec.structure.members)
+    # an empty ROS 2 message has a placeholder member
+    if not ros1_fields or len(ros1_fields) != len(ros2_members) or \
+            len(mapping.fields_1_to_2) != len(ros1_fields):
+        return None
+
+    layout = []
+    for (ros1_selection, ros2_selection), ros1_field, ros2_member in zip(
+        mapping.fields_1_to_2.items(), ros1_fields, ros2_members
+    ):
+        # the fields mapped (by name or by rule) must be the ones in the same place
+        if [f.name for f in ros1_selection] != [ros1_field.name] or \
+                [m.name for m in ros2_selection] != [ros2_member.name]:
+            return None
+        ros2_type = ros2_member.type
+        if ros1_field.is_array:
+            if ros1_field.array_len is None or \
+                    not isinstance(ros2_type, rosidl_parser.definition.Array) or \
+                    ros2_type.size != ros1_field.array_len or \
+                    not is_block_copyable_type(ros1_field.base_type, ros2_type.value_type):
+                return None
+            layout.append((ros1_field.name, ros2_member.name))
+        elif is_block_copyable_type(ros1_field.base_type, ros2_type):
+            layout.append((ros1_field.name, ros2_member.name))
+        else:
+            sub_layout = get_field_block_layout(
+                ros1_field, mapping.ros1_msg.package_name, ros2_type, block_layouts)
+            if not sub_layout:
+                return None
+            layout += [
+                (ros1_field.name + '.' + ros1_name, ros2_member.name + '.' + ros2_name)
+                for ros1_name, ros2_name in sub_layout]
+    return layout
+
+
+def get_field_block_layout(ros1_field, ros1_package_name, ros2_type, block_layouts):
+    if not isinstance(ros2_type, rosidl_parser.definition.NamespacedType) or \
+            len(ros2_type.namespaces) != 2 or ros2_type.namespaces[1] != 'msg':
+        return None
+    if '/' in ros1_field.base_type:
+        ros1_name = tuple(ros1_field.base_type.split('/'))
+    else:
+        ros1_name = (ros1_package_name, ros1_field.base_type)
+    return block_layouts.get((ros1_name, (ros2_type.namespaces[0], ros2_type.name)))
+
+
+def determine_block_copy_fields(mapping, block_layouts):
+    """
+    Find the arrays of messages of a mapping whose elements can be copied as a block.
+
+    Each is added to `mapping.block_copy_fields` with the layout of its elements.
+
+    :type mapping: Mapping
+    :param block_layouts: a dict of layouts as returned by `get_block_layout`, by
+    ((ros1_package, ros1_name), (ros2_package, ros2_name))
+    """
+    for ros1_fields, ros2_fields in mapping.fields_1_to_2.items():
+        ros1_field = ros1_fields[-1]
+        ros2_type = ros2_fields[-1].type
+        if not ros1_field.is_array or \
+                not isinstance(ros2_type, rosidl_parser.definition.AbstractNestedType):
+            continue
+        layout = get_field_block_layout(
+            ros1_field, ros1_field.pkg_name, ros2_type.value_type, block_layouts)
+        if layout:
+            mapping.block_copy_fields[ros2_fields] = layout
+
+
 def load_ros1_message(ros1_msg):
     msg_context = genmsg.MsgContext.create_default()
     message_path = os.path.join(ros1_msg.prefix_path, ros1_msg.message_name + '.msg')
@@ -874,7 +1095,9 @@ class Mapping:
         'ros2_msg',
         'fields_1_to_2',
         'fields_2_to_1',
-        'depends_on_ros2_messages'
+        'depends_on_ros2_messages',
+        'transcodable_1_to_2',
+        'block_copy_fields'
     ]
 
     def __init__(self, ros1_msg, ros2_msg):
@@ -883,6 +1106,8 @@ class Mapping:
         self.fields_1_to_2 = OrderedDict()
         self.fields_2_to_1 = OrderedDict()
         self.depends_on_ros2_messages = set()
+        self.transcodable_1_to_2 = False
+        self.block_copy_fields = {}
 
     def add_field_pair(self, ros1_fields, ros2_members):
         """
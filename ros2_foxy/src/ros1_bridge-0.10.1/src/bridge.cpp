@@ -12,7 +12,12 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "ros1_bridge/bridge.hpp"
 
@@ -20,6 +25,50 @@
 namespace ros1_bridge
 {
 
+Ros1CallbackQueue::Ros1CallbackQueue()
+: spinner_(1, &queue_)
+{
+  spinner_.start();
+}
+
+ros::CallbackQueue *
+Ros1CallbackQueue::get()
+{
+  return &queue_;
+}
+
+bool
+parse_thread_count_options(
+  std::vector<std::string> & args,
+  size_t & ros1_threads,
+  size_t & ros2_threads)
+{
+  for (auto it = args.begin(); it != args.end(); ) {
+    size_t * threads = nullptr;
+    if (*it == "--ros1-threads") {
+      threads = &ros1_threads;
+    } else if (*it == "--ros2-threads") {
+      threads = &ros2_threads;
+    } else {
+      ++it;
+      continue;
+    }
+    bool valid = it + 1 != args.end() && !(it + 1)->empty() &&
+      (it + 1)->find_first_not_of("0123456789") == std::string::npos;
+    if (valid) {
+      errno = 0;
+      *threads = strtoul((it + 1)->c_str(), nullptr, 10);
+      valid = errno != ERANGE;
+    }
+    if (!valid) {
+      fprintf(stderr, "%s needs a number of threads\n", it->c_str());
+      return false;
+    }
+    it = args.erase(it, it + 2);
+  }
+  return true;
+}
+
 Bridge1to2Handles
 create_bridge_from_1_to_2(
   ros::NodeHandle ros1_node,
@@ -29,7 +78,8 @@ create_bridge_from_1_to_2(
   size_t subscriber_queue_size,
   const std::string & ros2_type_name,
   const std::string & ros2_topic_name,
-  size_t publisher_queue_size)
+  size_t publisher_queue_size,
+  bool serialized)
 {
   return create_bridge_from_1_to_2(
     ros1_node,
@@ -39,7 +89,8 @@ create_bridge_from_1_to_2(
     subscriber_queue_size,
     ros2_type_name,
     ros2_topic_name,
-    rclcpp::QoS(rclcpp::KeepLast(publisher_queue_size)));
+    rclcpp::QoS(rclcpp::KeepLast(publisher_queue_size)),
+    serialized);
 }
 
 Bridge1to2Handles
@@ -51,16 +102,27 @@ create_bridge_from_1_to_2(
   size_t subscriber_queue_size,
   const std::string & ros2_type_name,
   const std::string & ros2_topic_name,
-  const rclcpp::QoS & publisher_qos)
+  const rclcpp::QoS & publisher_qos,
+  bool serialized)
 {
   auto factory = get_factory(ros1_type_name, ros2_type_name);
   auto ros2_pub = factory->create_ros2_publisher(
     ros2_node, ros2_topic_name, publisher_qos);
 
-  auto ros1_sub = factory->create_ros1_subscriber(
-    ros1_node, ros1_topic_name, subscriber_queue_size, ros2_pub, ros2_node->get_logger());
+  // the subscriber uses the callback queue of the node handle
+  auto ros1_callback_queue = std::make_shared<Ros1CallbackQueue>();
+  ros1_node.setCallbackQueue(ros1_callback_queue->get());
+  ros::Subscriber ros1_sub;
+  if (serialized) {
+    ros1_sub = factory->create_ros1_serialized_subscriber(
+      ros1_node, ros1_topic_name, subscriber_queue_size, ros2_pub, ros2_node->get_logger());
+  } else {
+    ros1_sub = factory->create_ros1_subscriber(
+      ros1_node, ros1_topic_name, subscriber_queue_size, ros2_pub, ros2_node->get_logger());
+  }
 
   Bridge1to2Handles handles;
+  handles.ros1_callback_queue = ros1_callback_queue;
   handles.ros1_subscriber = ros1_sub;
   handles.ros2_publisher = ros2_pub;
   return handles;
@@ -107,10 +169,13 @@ create_bridge_from_2_to_1(
   auto ros1_pub = factory->create_ros1_publisher(
     ros1_node, ros1_topic_name, publisher_queue_size);
 
+  auto ros2_callback_group = ros2_node->create_callback_group(
+    rclcpp::CallbackGroupType::MutuallyExclusive);
   auto ros2_sub = factory->create_ros2_subscriber(
-    ros2_node, ros2_topic_name, subscriber_qos, ros1_pub, ros2_pub);
+    ros2_node, ros2_topic_name, subscriber_qos, ros1_pub, ros2_pub, ros2_callback_group);
 
   Bridge2to1Handles handles;
+  handles.ros2_callback_group = ros2_callback_group;
   handles.ros2_subscriber = ros2_sub;
   handles.ros1_publisher = ros1_pub;
   return handles;
@@ -123,7 +188,8 @@ create_bidirectional_bridge(
   const std::string & ros1_type_name,
   const std::string & ros2_type_name,
   const std::string & topic_name,
-  size_t queue_size)
+  size_t queue_size,
+  bool serialized_1_to_2)
 {
   RCLCPP_INFO(
     ros2_node->get_logger(), "create bidirectional bridge for topic %s",
@@ -131,7 +197,8 @@ create_bidirectional_bridge(
   BridgeHandles handles;
   handles.bridge1to2 = create_bridge_from_1_to_2(
     ros1_node, ros2_node,
-    ros1_type_name, topic_name, queue_size, ros2_type_name, topic_name, queue_size);
+    ros1_type_name, topic_name, queue_size, ros2_type_name, topic_name, queue_size,
+    serialized_1_to_2);
   handles.bridge2to1 = create_bridge_from_2_to_1(
     ros2_node, ros1_node,
     ros2_type_name, topic_name, queue_size, ros1_type_name, topic_name, queue_size,
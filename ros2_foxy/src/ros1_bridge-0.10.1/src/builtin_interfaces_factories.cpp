@@ -39,7 +39,7 @@ get_factory_builtin_interfaces(
         std_msgs::Duration,
         builtin_interfaces::msg::Duration
       >
-    >("std_msgs/Duration", ros2_type_name);
+    >("std_msgs/Duration", ros2_type_name, true);
   }
   if (
     (ros1_type_name == "std_msgs/Time" || ros1_type_name == "") &&
@@ -50,7 +50,7 @@ get_factory_builtin_interfaces(
         std_msgs::Time,
         builtin_interfaces::msg::Time
       >
-    >("std_msgs/Time", ros2_type_name);
+    >("std_msgs/Time", ros2_type_name, true);
   }
   return std::shared_ptr<FactoryInterface>();
 }
@@ -90,6 +90,10 @@ bool parse_command_options(
     ss << "a matching subscriber." << std::endl;
     ss << " --bridge-all-2to1-topics: Bridge all ROS 2 topics to ROS 1, whether or not there is ";
     ss << "a matching subscriber." << std::endl;
+    ss << " --ros1-threads N: Threads for the ROS 1 services and the polling of the master ";
+    ss << "(default: 1), each topic bridged from ROS 1 having a thread of its own." << std::endl;
+    ss << " --ros2-threads N: Threads for the ROS 2 executor (default: 0, one per core), ";
+    ss << "each topic bridged from ROS 2 being passed on by one at a time." << std::endl;
     std::cout << ss.str();
     return false;
   }
@@ -464,6 +468,13 @@ int main(int argc, char * argv[])
   {
     return 0;
   }
+  // unlike --help, an invalid thread count is an error
+  size_t ros1_threads = 1;
+  size_t ros2_threads = 0;
+  std::vector<std::string> thread_args(argv, argv + argc);
+  if (!ros1_bridge::parse_thread_count_options(thread_args, ros1_threads, ros2_threads)) {
+    return 1;
+  }
 
   // ROS 2 node
   rclcpp::init(argc, argv);
@@ -785,15 +796,21 @@ int main(int argc, char * argv[])
     std::chrono::seconds(1), ros2_poll);
 
 
-  // ROS 1 asynchronous spinner
-  ros::AsyncSpinner async_spinner(1);
+  // ROS 1 asynchronous spinner (the bridged topics have threads of their own)
+  ros::AsyncSpinner async_spinner(ros1_threads);
   async_spinner.start();
 
-  // ROS 2 spinning loop
-  rclcpp::executors::SingleThreadedExecutor executor;
-  while (ros1_node.ok() && rclcpp::ok()) {
-    executor.spin_node_once(ros2_node);
-  }
+  // ROS 2 executor, spinning until either side shuts down
+  rclcpp::executors::MultiThreadedExecutor executor(rclcpp::ExecutorOptions(), ros2_threads);
+  executor.add_node(ros2_node);
+  auto ros1_shutdown_timer = ros2_node->create_wall_timer(
+    std::chrono::seconds(1), [&ros1_node, &executor]() -> void
+    {
+      if (!ros1_node.ok()) {
+        executor.cancel();
+      }
+    });
+  executor.spin();
 
   return 0;
 }
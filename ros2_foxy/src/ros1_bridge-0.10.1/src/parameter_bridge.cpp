@@ -14,6 +14,7 @@
 
 #include <list>
 #include <string>
+#include <vector>
 
 // include ROS 1
 #ifdef __clang__
@@ -51,6 +52,8 @@ int main(int argc, char * argv[])
   // topic: the name of the topic to bridge (e.g. '/topic_name')
   // type: the type of the topic to bridge (e.g. 'pkgname/msg/MsgName')
   // queue_size: the queue size to use (default: 100)
+  // serialized: pass ROS 1 messages on to ROS 2 without deserializing them,
+  //   where the types allow it (default: false)
   const char * topics_parameter_name = "topics";
   // the services parameters need to be arrays
   // and each item needs to be a dictionary with the following keys;
@@ -58,14 +61,22 @@ int main(int argc, char * argv[])
   // type: the type of the service to bridge (e.g. 'pkgname/srv/SrvName')
   const char * services_1_to_2_parameter_name = "services_1_to_2";
   const char * services_2_to_1_parameter_name = "services_2_to_1";
-  if (argc > 1) {
-    topics_parameter_name = argv[1];
+  // the options --ros1-threads N and --ros2-threads N may come before or after
+  // these arguments
+  size_t ros1_threads = 1;
+  size_t ros2_threads = 0;
+  std::vector<std::string> args(argv, argv + argc);
+  if (!ros1_bridge::parse_thread_count_options(args, ros1_threads, ros2_threads)) {
+    return 1;
   }
-  if (argc > 2) {
-    services_1_to_2_parameter_name = argv[2];
+  if (args.size() > 1) {
+    topics_parameter_name = args[1].c_str();
   }
-  if (argc > 3) {
-    services_2_to_1_parameter_name = argv[3];
+  if (args.size() > 2) {
+    services_1_to_2_parameter_name = args[2].c_str();
+  }
+  if (args.size() > 3) {
+    services_2_to_1_parameter_name = args[3].c_str();
   }
 
   // Topics
@@ -81,6 +92,9 @@ int main(int argc, char * argv[])
       if (!queue_size) {
         queue_size = 100;
       }
+      bool serialized = topics[i].hasMember("serialized") &&
+        topics[i]["serialized"].getType() == XmlRpc::XmlRpcValue::TypeBoolean &&
+        static_cast<bool>(topics[i]["serialized"]);
       printf(
         "Trying to create bidirectional bridge for topic '%s' "
         "with ROS 2 type '%s'\n",
@@ -88,7 +102,7 @@ int main(int argc, char * argv[])
 
       try {
         ros1_bridge::BridgeHandles handles = ros1_bridge::create_bidirectional_bridge(
-          ros1_node, ros2_node, "", type_name, topic_name, queue_size);
+          ros1_node, ros2_node, "", type_name, topic_name, queue_size, serialized);
         all_handles.push_back(handles);
       } catch (std::runtime_error & e) {
         fprintf(
@@ -228,15 +242,21 @@ int main(int argc, char * argv[])
       services_2_to_1_parameter_name);
   }
 
-  // ROS 1 asynchronous spinner
-  ros::AsyncSpinner async_spinner(1);
+  // ROS 1 asynchronous spinner (the bridged topics have threads of their own)
+  ros::AsyncSpinner async_spinner(ros1_threads);
   async_spinner.start();
 
-  // ROS 2 spinning loop
-  rclcpp::executors::SingleThreadedExecutor executor;
-  while (ros1_node.ok() && rclcpp::ok()) {
-    executor.spin_node_once(ros2_node, std::chrono::milliseconds(1000));
-  }
+  // ROS 2 executor, spinning until either side shuts down
+  rclcpp::executors::MultiThreadedExecutor executor(rclcpp::ExecutorOptions(), ros2_threads);
+  executor.add_node(ros2_node);
+  auto ros1_shutdown_timer = ros2_node->create_wall_timer(
+    std::chrono::seconds(1), [&ros1_node, &executor]() -> void
+    {
+      if (!ros1_node.ok()) {
+        executor.cancel();
+      }
+    });
+  executor.spin();
 
   return 0;
 }
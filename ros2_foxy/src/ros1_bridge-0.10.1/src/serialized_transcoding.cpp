@@ -0,0 +1,245 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "rosidl_typesupport_introspection_cpp/field_types.hpp"
+#include "rosidl_typesupport_introspection_cpp/message_introspection.hpp"
+
+#include "ros1_bridge/serialized_transcoding.hpp"
+
+namespace ros1_bridge
+{
+
+namespace
+{
+
+using rosidl_typesupport_introspection_cpp::MessageMember;
+using rosidl_typesupport_introspection_cpp::MessageMembers;
+
+// ROS 1 serializes fields back to back, little endian, with a uint32 length
+// in front of strings and variable-length arrays
+class Ros1Reader
+{
+public:
+  Ros1Reader(const uint8_t * data, size_t size)
+  : data_(data), end_(data + size)
+  {}
+
+  const uint8_t * take(size_t size)
+  {
+    if (static_cast<size_t>(end_ - data_) < size) {
+      throw std::runtime_error("ROS 1 message shorter than its type");
+    }
+    const uint8_t * data = data_;
+    data_ += size;
+    return data;
+  }
+
+  uint32_t take_uint32()
+  {
+    uint32_t value;
+    std::memcpy(&value, take(sizeof(value)), sizeof(value));
+    return value;
+  }
+
+  bool done() const
+  {
+    return data_ == end_;
+  }
+
+private:
+  const uint8_t * data_;
+  const uint8_t * end_;
+};
+
+// CDR (little endian) aligns a primitive to its size, counted from the end of
+// the encapsulation header, and ends strings with a NUL counted in their length
+class CdrWriter
+{
+public:
+  CdrWriter(rclcpp::SerializedMessage & msg, size_t expected_size)
+  : msg_(msg)
+  {
+    if (msg_.capacity() < expected_size) {
+      msg_.reserve(expected_size);
+    }
+    msg_.get_rcl_serialized_message().buffer_length = 0;
+    static const uint8_t encapsulation[] = {0x00, 0x01, 0x00, 0x00};  // CDR_LE
+    std::memcpy(put(sizeof(encapsulation)), encapsulation, sizeof(encapsulation));
+  }
+
+  uint8_t * put(size_t size)
+  {
+    auto & buffer = msg_.get_rcl_serialized_message();
+    if (buffer.buffer_capacity - buffer.buffer_length < size) {
+      msg_.reserve(std::max(2 * buffer.buffer_capacity, buffer.buffer_length + size));
+    }
+    uint8_t * data = buffer.buffer + buffer.buffer_length;
+    buffer.buffer_length += size;
+    return data;
+  }
+
+  void align(size_t alignment)
+  {
+    size_t offset = (msg_.get_rcl_serialized_message().buffer_length - 4) % alignment;
+    if (offset) {
+      std::memset(put(alignment - offset), 0, alignment - offset);
+    }
+  }
+
+  void put_uint32(uint32_t value)
+  {
+    align(sizeof(value));
+    std::memcpy(put(sizeof(value)), &value, sizeof(value));
+  }
+
+private:
+  rclcpp::SerializedMessage & msg_;
+};
+
+size_t primitive_size(uint8_t type_id)
+{
+  namespace ts = rosidl_typesupport_introspection_cpp;
+  switch (type_id) {
+    case ts::ROS_TYPE_BOOLEAN:
+    case ts::ROS_TYPE_OCTET:
+    case ts::ROS_TYPE_CHAR:
+    case ts::ROS_TYPE_UINT8:
+    case ts::ROS_TYPE_INT8:
+      return 1;
+    case ts::ROS_TYPE_UINT16:
+    case ts::ROS_TYPE_INT16:
+      return 2;
+    case ts::ROS_TYPE_FLOAT:
+    case ts::ROS_TYPE_UINT32:
+    case ts::ROS_TYPE_INT32:
+      return 4;
+    case ts::ROS_TYPE_DOUBLE:
+    case ts::ROS_TYPE_UINT64:
+    case ts::ROS_TYPE_INT64:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+void transcode_members(const MessageMembers * members, Ros1Reader & in, CdrWriter & out);
+
+// count values of a member, a single one or the elements of an array
+void transcode_values(
+  const MessageMember & member, size_t count, Ros1Reader & in, CdrWriter & out)
+{
+  if (member.type_id_ == rosidl_typesupport_introspection_cpp::ROS_TYPE_STRING) {
+    for (size_t i = 0; i < count; ++i) {
+      uint32_t size = in.take_uint32();
+      if (member.string_upper_bound_ && size > member.string_upper_bound_) {
+        throw std::runtime_error(
+                std::string("string longer than the bound of field ") + member.name_);
+      }
+      // taken first, so a size past the end of the message throws before
+      // anything is reserved for it
+      const uint8_t * src = in.take(size);
+      out.put_uint32(size + 1);
+      uint8_t * data = out.put(size + 1);
+      std::memcpy(data, src, size);
+      data[size] = '\0';
+    }
+    return;
+  }
+  if (member.type_id_ == rosidl_typesupport_introspection_cpp::ROS_TYPE_MESSAGE) {
+    auto sub_members = static_cast<const MessageMembers *>(member.members_->data);
+    for (size_t i = 0; i < count; ++i) {
+      transcode_members(sub_members, in, out);
+    }
+    return;
+  }
+  if (member.type_id_ == rosidl_typesupport_introspection_cpp::ROS_TYPE_BOOLEAN) {
+    // a ROS 1 bool is a uint8 which may hold any value, where CDR takes only
+    // 0 and 1, so it isn't copied as is
+    const uint8_t * src = in.take(count);
+    uint8_t * data = out.put(count);
+    for (size_t i = 0; i < count; ++i) {
+      data[i] = src[i] != 0;
+    }
+    return;
+  }
+  size_t size = primitive_size(member.type_id_);
+  if (!size) {
+    throw std::runtime_error(std::string("unsupported type of field ") + member.name_);
+  }
+  if (count > SIZE_MAX / size) {
+    throw std::runtime_error(std::string("array too long in field ") + member.name_);
+  }
+  // the same bytes on both sides, but an empty array isn't aligned in CDR
+  if (count) {
+    const uint8_t * src = in.take(count * size);
+    out.align(size);
+    std::memcpy(out.put(count * size), src, count * size);
+  }
+}
+
+void transcode_members(const MessageMembers * members, Ros1Reader & in, CdrWriter & out)
+{
+  if (
+    std::strcmp(members->message_namespace_, "std_msgs::msg") == 0 &&
+    std::strcmp(members->message_name_, "Header") == 0)
+  {
+    // ROS 1 headers start with a seq which ROS 2 dropped
+    in.take(sizeof(uint32_t));
+  }
+  for (uint32_t i = 0; i < members->member_count_; ++i) {
+    const MessageMember & member = members->members_[i];
+    if (!member.is_array_) {
+      transcode_values(member, 1, in, out);
+      continue;
+    }
+    size_t count = member.array_size_;
+    if (!member.array_size_ || member.is_upper_bound_) {
+      // sequences have their length in front on both sides
+      count = in.take_uint32();
+      if (member.is_upper_bound_ && count > member.array_size_) {
+        throw std::runtime_error(
+                std::string("array longer than the bound of field ") + member.name_);
+      }
+      out.put_uint32(static_cast<uint32_t>(count));
+    }
+    transcode_values(member, count, in, out);
+  }
+}
+
+}  // namespace
+
+void
+transcode_1_to_2(
+  const rosidl_message_type_support_t * ros2_introspection_type_support,
+  const uint8_t * ros1_data,
+  size_t ros1_size,
+  rclcpp::SerializedMessage & ros2_cdr_msg)
+{
+  auto members = static_cast<const MessageMembers *>(ros2_introspection_type_support->data);
+  Ros1Reader in(ros1_data, ros1_size);
+  // enough for most messages: the header plus some padding and NULs
+  CdrWriter out(ros2_cdr_msg, ros1_size + ros1_size / 8 + 64);
+  transcode_members(members, in, out);
+  if (!in.done()) {
+    throw std::runtime_error("ROS 1 message longer than its type");
+  }
+}
+
+}  // namespace ros1_bridge
@@ -12,11 +12,16 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <string>
 
 // include ROS 1
+#include "ros/callback_queue.h"
 #include "ros/message.h"
 #ifdef __clang__
 # pragma clang diagnostic push
@@ -71,8 +76,43 @@ void ros1ChatterCallback(const ros::MessageEvent<std_msgs::String const> & ros1_
 }
 
 
+// the value of an option like --ros2-threads N, if given, checked like
+// ros1_bridge::parse_thread_count_options() does (this example doesn't link
+// the ros1_bridge library)
+bool get_thread_count_option(int argc, char * argv[], const char * option, size_t & count)
+{
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], option) != 0) {
+      continue;
+    }
+    const char * value = i + 1 < argc ? argv[i + 1] : "";
+    bool valid = *value && strspn(value, "0123456789") == strlen(value);
+    if (valid) {
+      errno = 0;
+      count = strtoul(value, nullptr, 10);
+      valid = errno != ERANGE;
+    }
+    if (!valid) {
+      fprintf(stderr, "%s needs a number of threads\n", option);
+      return false;
+    }
+  }
+  return true;
+}
+
 int main(int argc, char * argv[])
 {
+  // threads of the ROS 1 global callback queue and of the ROS 2 executor (0
+  // for one per core)
+  size_t ros1_threads = 1;
+  size_t ros2_threads = 0;
+  if (
+    !get_thread_count_option(argc, argv, "--ros1-threads", ros1_threads) ||
+    !get_thread_count_option(argc, argv, "--ros2-threads", ros2_threads))
+  {
+    return 1;
+  }
+
   // ROS 1 node and publisher
   ros::init(argc, argv, "ros_bridge");
   ros::NodeHandle ros1_node;
@@ -84,25 +124,38 @@ int main(int argc, char * argv[])
   ros2_pub = ros2_node->create_publisher<std_msgs::msg::String>(
     "chatter", 10);
 
-  // ROS 1 subscriber
-  ros::Subscriber ros1_sub = ros1_node.subscribe(
+  // ROS 1 subscriber, with a callback queue and a thread of its own
+  ros::CallbackQueue ros1_chatter_queue;
+  ros::NodeHandle ros1_chatter_node;
+  ros1_chatter_node.setCallbackQueue(&ros1_chatter_queue);
+  ros::Subscriber ros1_sub = ros1_chatter_node.subscribe(
     "chatter", 10, ros1ChatterCallback);
+  ros::AsyncSpinner ros1_chatter_spinner(1, &ros1_chatter_queue);
+  ros1_chatter_spinner.start();
 
-  // ROS 2 subscriber
+  // ROS 2 subscriber, in a mutually exclusive callback group of its own
   rclcpp::SubscriptionOptions options;
   options.ignore_local_publications = true;
+  options.callback_group = ros2_node->create_callback_group(
+    rclcpp::CallbackGroupType::MutuallyExclusive);
   auto ros2_sub = ros2_node->create_subscription<std_msgs::msg::String>(
     "chatter", rclcpp::SensorDataQoS(), ros2ChatterCallback, options);
 
   // ROS 1 asynchronous spinner
-  ros::AsyncSpinner async_spinner(1);
+  ros::AsyncSpinner async_spinner(ros1_threads);
   async_spinner.start();
 
-  // ROS 2 spinning loop
-  rclcpp::executors::SingleThreadedExecutor executor;
-  while (ros1_node.ok() && rclcpp::ok()) {
-    executor.spin_node_once(ros2_node, std::chrono::milliseconds(1000));
-  }
+  // ROS 2 executor, spinning until either side shuts down
+  rclcpp::executors::MultiThreadedExecutor executor(rclcpp::ExecutorOptions(), ros2_threads);
+  executor.add_node(ros2_node);
+  auto ros1_shutdown_timer = ros2_node->create_wall_timer(
+    std::chrono::seconds(1), [&ros1_node, &executor]() -> void
+    {
+      if (!ros1_node.ok()) {
+        executor.cancel();
+      }
+    });
+  executor.spin();
 
   return 0;
 }
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <string>
+#include <vector>
 
 // include ROS 1
 #ifdef __clang__
@@ -32,6 +33,13 @@
 
 int main(int argc, char * argv[])
 {
+  size_t ros1_threads = 1;
+  size_t ros2_threads = 0;
+  std::vector<std::string> args(argv, argv + argc);
+  if (!ros1_bridge::parse_thread_count_options(args, ros1_threads, ros2_threads)) {
+    return 1;
+  }
+
   // ROS 1 node
   ros::init(argc, argv, "ros_bridge");
   ros::NodeHandle ros1_node;
@@ -49,15 +57,21 @@ int main(int argc, char * argv[])
   auto handles = ros1_bridge::create_bidirectional_bridge(
     ros1_node, ros2_node, ros1_type_name, ros2_type_name, topic_name, queue_size);
 
-  // ROS 1 asynchronous spinner
-  ros::AsyncSpinner async_spinner(1);
+  // ROS 1 asynchronous spinner (the bridged topics have threads of their own)
+  ros::AsyncSpinner async_spinner(ros1_threads);
   async_spinner.start();
 
-  // ROS 2 spinning loop
-  rclcpp::executors::SingleThreadedExecutor executor;
-  while (ros1_node.ok() && rclcpp::ok()) {
-    executor.spin_node_once(ros2_node, std::chrono::milliseconds(1000));
-  }
+  // ROS 2 executor, spinning until either side shuts down
+  rclcpp::executors::MultiThreadedExecutor executor(rclcpp::ExecutorOptions(), ros2_threads);
+  executor.add_node(ros2_node);
+  auto ros1_shutdown_timer = ros2_node->create_wall_timer(
+    std::chrono::seconds(1), [&ros1_node, &executor]() -> void
+    {
+      if (!ros1_node.ok()) {
+        executor.cancel();
+      }
+    });
+  executor.spin();
 
   return 0;
 }
@@ -0,0 +1,101 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Microbenchmark of the conversion of primitive sequences the generated
+// factories do, like the data of an image or a point cloud: resize() and
+// std::copy() as they used to against ros1_bridge::convert_sequence().
+// Each is timed into a new destination, as for a new ROS 2 message, and into
+// a reused one. Usage: benchmark_convert_sequences [ITERATIONS]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "ros1_bridge/convert_sequences.hpp"
+
+namespace
+{
+
+template<typename SrcT, typename DstT>
+void resize_and_copy(const SrcT & src, DstT & dst)
+{
+  dst.resize(src.size());
+  std::copy(src.begin(), src.end(), dst.begin());
+}
+
+template<typename T, typename U, typename ConvertT>
+double time_conversion(
+  const std::vector<T> & src, bool reuse, int iterations, ConvertT convert)
+{
+  std::vector<U> dst;
+  double seconds = 0;
+  for (int i = 0; i < iterations; ++i) {
+    if (!reuse) {
+      std::vector<U>().swap(dst);
+    }
+    auto start = std::chrono::steady_clock::now();
+    convert(src, dst);
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (dst.size() != src.size() || dst.back() != static_cast<U>(src.back())) {
+      fprintf(stderr, "conversion failed\n");
+      exit(1);
+    }
+  }
+  return seconds / iterations;
+}
+
+template<typename T, typename U>
+void benchmark(const char * name, int iterations)
+{
+  for (size_t mb = 1; mb <= 8; mb *= 2) {
+    std::vector<T> src(mb * 1024 * 1024 / sizeof(T));
+    for (size_t i = 0; i < src.size(); ++i) {
+      src[i] = static_cast<T>(i);
+    }
+    for (bool reuse : {false, true}) {
+      double before = time_conversion<T, U>(
+        src, reuse, iterations, [](const std::vector<T> & from, std::vector<U> & to) {
+          resize_and_copy(from, to);
+        });
+      double after = time_conversion<T, U>(
+        src, reuse, iterations, [](const std::vector<T> & from, std::vector<U> & to) {
+          ros1_bridge::convert_sequence(from, to);
+        });
+      printf(
+        "%-14s %zu MB %-6s resize+copy %8.1f us %6.2f GB/s  convert_sequence %8.1f us %6.2f GB/s"
+        "  x%.2f\n",
+        name, mb, reuse ? "reused" : "new", before * 1e6, mb / 1024.0 / before, after * 1e6,
+        mb / 1024.0 / after, before / after);
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  int iterations = argc > 1 ? atoi(argv[1]) : 200;
+  if (iterations <= 0) {
+    fprintf(stderr, "Usage: %s [ITERATIONS]\n", argv[0]);
+    return 1;
+  }
+  benchmark<uint8_t, uint8_t>("uint8->uint8", iterations);
+  benchmark<int8_t, uint8_t>("int8->uint8", iterations);
+  benchmark<float, float>("float->float", iterations);
+  benchmark<double, double>("double->double", iterations);
+  return 0;
+}
@@ -0,0 +1,220 @@
+// Copyright 2026 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// include ROS 1 messages
+#include "std_msgs/Bool.h"
+#include "std_msgs/Float64MultiArray.h"
+#include "std_msgs/Header.h"
+#include "std_msgs/String.h"
+
+// include ROS 2 messages
+#include "rclcpp/serialization.hpp"
+#include "rclcpp/serialized_message.hpp"
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+#include "rosidl_typesupport_introspection_cpp/identifier.hpp"
+#include "std_msgs/msg/bool.hpp"
+#include "std_msgs/msg/float64_multi_array.hpp"
+#include "std_msgs/msg/header.hpp"
+#include "std_msgs/msg/string.hpp"
+
+#include "ros1_bridge/serialized_transcoding.hpp"
+
+namespace
+{
+
+template<typename ROS1_T>
+std::vector<uint8_t> serialize_ros1(const ROS1_T & msg)
+{
+  std::vector<uint8_t> data(ros::serialization::serializationLength(msg));
+  ros::serialization::OStream stream(data.data(), static_cast<uint32_t>(data.size()));
+  ros::serialization::serialize(stream, msg);
+  return data;
+}
+
+template<typename ROS2_T>
+const rosidl_message_type_support_t * introspection_type_support()
+{
+  return get_message_typesupport_handle(
+    rosidl_typesupport_cpp::get_message_type_support_handle<ROS2_T>(),
+    rosidl_typesupport_introspection_cpp::typesupport_identifier);
+}
+
+// The CDR bytes after the encapsulation header, without the padding its
+// options may announce at the end
+std::vector<uint8_t> cdr_payload(const rclcpp::SerializedMessage & msg)
+{
+  const auto & buffer = msg.get_rcl_serialized_message();
+  EXPECT_GE(buffer.buffer_length, 4u);
+  size_t padding = buffer.buffer[3] & 0x3;
+  return std::vector<uint8_t>(buffer.buffer + 4, buffer.buffer + buffer.buffer_length - padding);
+}
+
+// Transcode the ROS 1 message, and check it's what rclcpp serializes of the
+// ROS 2 one and that it deserializes back to it
+template<typename ROS2_T, typename ROS1_T>
+void expect_transcoded(const ROS1_T & ros1_msg, const ROS2_T & ros2_msg)
+{
+  std::vector<uint8_t> ros1_data = serialize_ros1(ros1_msg);
+  rclcpp::SerializedMessage transcoded;
+  ros1_bridge::transcode_1_to_2(
+    introspection_type_support<ROS2_T>(), ros1_data.data(), ros1_data.size(), transcoded);
+
+  rclcpp::Serialization<ROS2_T> serialization;
+  rclcpp::SerializedMessage expected;
+  serialization.serialize_message(&ros2_msg, &expected);
+  EXPECT_EQ(cdr_payload(expected), cdr_payload(transcoded));
+
+  ROS2_T deserialized;
+  serialization.deserialize_message(&transcoded, &deserialized);
+  EXPECT_EQ(ros2_msg, deserialized);
+}
+
+}  // namespace
+
+TEST(SerializedTranscoding, strings)
+{
+  for (const char * data : {"", "a", "hello world", "not aligned"}) {
+    std_msgs::String ros1_msg;
+    ros1_msg.data = data;
+    std_msgs::msg::String ros2_msg;
+    ros2_msg.data = data;
+    expect_transcoded(ros1_msg, ros2_msg);
+  }
+}
+
+TEST(SerializedTranscoding, header)
+{
+  // the ROS 1 seq is dropped
+  std_msgs::Header ros1_msg;
+  ros1_msg.seq = 42;
+  ros1_msg.stamp.sec = 1234;
+  ros1_msg.stamp.nsec = 5678;
+  ros1_msg.frame_id = "base_link";
+  std_msgs::msg::Header ros2_msg;
+  ros2_msg.stamp.sec = 1234;
+  ros2_msg.stamp.nanosec = 5678;
+  ros2_msg.frame_id = "base_link";
+  expect_transcoded(ros1_msg, ros2_msg);
+}
+
+TEST(SerializedTranscoding, bools)
+{
+  for (bool data : {false, true}) {
+    std_msgs::Bool ros1_msg;
+    ros1_msg.data = data;
+    std_msgs::msg::Bool ros2_msg;
+    ros2_msg.data = data;
+    expect_transcoded(ros1_msg, ros2_msg);
+  }
+
+  // a ROS 1 bool is a uint8, which may hold other values than 0 and 1: any
+  // of them is true, and CDR takes only 1 for it
+  const uint8_t ros1_data[] = {2};
+  rclcpp::SerializedMessage transcoded;
+  ros1_bridge::transcode_1_to_2(
+    introspection_type_support<std_msgs::msg::Bool>(), ros1_data, sizeof(ros1_data), transcoded);
+  EXPECT_EQ(std::vector<uint8_t>({1}), cdr_payload(transcoded));
+  std_msgs::msg::Bool deserialized;
+  rclcpp::Serialization<std_msgs::msg::Bool>().deserialize_message(&transcoded, &deserialized);
+  EXPECT_TRUE(deserialized.data);
+}
+
+TEST(SerializedTranscoding, nested_messages_and_arrays)
+{
+  // an array of messages holding strings, then doubles aligned to 8 in CDR
+  std_msgs::Float64MultiArray ros1_msg;
+  std_msgs::msg::Float64MultiArray ros2_msg;
+  for (const char * label : {"rows", "cols"}) {
+    std_msgs::MultiArrayDimension ros1_dim;
+    ros1_dim.label = label;
+    ros1_dim.size = 2;
+    ros1_dim.stride = 3;
+    ros1_msg.layout.dim.push_back(ros1_dim);
+    std_msgs::msg::MultiArrayDimension ros2_dim;
+    ros2_dim.label = label;
+    ros2_dim.size = 2;
+    ros2_dim.stride = 3;
+    ros2_msg.layout.dim.push_back(ros2_dim);
+  }
+  ros1_msg.layout.data_offset = 1;
+  ros2_msg.layout.data_offset = 1;
+  ros1_msg.data = {1.5, -2.0, 3.25};
+  ros2_msg.data = {1.5, -2.0, 3.25};
+  expect_transcoded(ros1_msg, ros2_msg);
+
+  // empty arrays
+  expect_transcoded(std_msgs::Float64MultiArray(), std_msgs::msg::Float64MultiArray());
+}
+
+TEST(SerializedTranscoding, reused_message)
+{
+  const rosidl_message_type_support_t * type_support =
+    introspection_type_support<std_msgs::msg::String>();
+  rclcpp::SerializedMessage transcoded;
+  rclcpp::Serialization<std_msgs::msg::String> serialization;
+  for (const char * data : {"a longer string first", "then a short one"}) {
+    std_msgs::String ros1_msg;
+    ros1_msg.data = data;
+    std::vector<uint8_t> ros1_data = serialize_ros1(ros1_msg);
+    ros1_bridge::transcode_1_to_2(type_support, ros1_data.data(), ros1_data.size(), transcoded);
+    std_msgs::msg::String deserialized;
+    serialization.deserialize_message(&transcoded, &deserialized);
+    EXPECT_EQ(data, deserialized.data);
+  }
+}
+
+TEST(SerializedTranscoding, malformed_messages)
+{
+  const rosidl_message_type_support_t * type_support =
+    introspection_type_support<std_msgs::msg::Float64MultiArray>();
+  std_msgs::Float64MultiArray ros1_msg;
+  ros1_msg.data = {1.0, 2.0};
+  std::vector<uint8_t> ros1_data = serialize_ros1(ros1_msg);
+  rclcpp::SerializedMessage transcoded;
+
+  std::vector<uint8_t> shorter(ros1_data.begin(), ros1_data.end() - 1);
+  EXPECT_THROW(
+    ros1_bridge::transcode_1_to_2(type_support, shorter.data(), shorter.size(), transcoded),
+    std::runtime_error);
+  std::vector<uint8_t> longer(ros1_data);
+  longer.push_back(0);
+  EXPECT_THROW(
+    ros1_bridge::transcode_1_to_2(type_support, longer.data(), longer.size(), transcoded),
+    std::runtime_error);
+
+  // lengths past the end of the message throw before anything is reserved
+  // for them: of a string, and of an array
+  size_t capacity = transcoded.capacity();
+  const uint32_t length = 0xffffffff;
+  std::vector<uint8_t> huge(8, 0);
+  huge[0] = 1;  // one dim
+  std::memcpy(&huge[4], &length, sizeof(length));  // of a label that long
+  EXPECT_THROW(
+    ros1_bridge::transcode_1_to_2(type_support, huge.data(), huge.size(), transcoded),
+    std::runtime_error);
+  huge.assign(12, 0);  // no dims, a data_offset of 0
+  std::memcpy(&huge[8], &length, sizeof(length));  // and that many doubles
+  EXPECT_THROW(
+    ros1_bridge::transcode_1_to_2(type_support, huge.data(), huge.size(), transcoded),
+    std::runtime_error);
+  EXPECT_EQ(capacity, transcoded.capacity());
+}